@@ -0,0 +1,147 @@
+#pragma once
+#include "Geometry.h"
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+// Dynamic AABB tree. Leaves store a "fat" box padded by a margin so small
+// movements refit nothing; only a proxy that leaves its fat box is removed
+// and reinserted. Nodes live in one array with a free list, so inserting and
+// removing proxies never touches the heap once the array has grown.
+class BVH {
+public:
+    static constexpr int32_t NULL_NODE = -1;
+
+    explicit BVH(float margin = 0.1f);
+
+    // Proxy management; userData is returned from queries
+    int32_t CreateProxy(const AABB& bounds, uint32_t userData);
+    void DestroyProxy(int32_t proxy);
+
+    // Returns true if the proxy had to be reinserted
+    bool MoveProxy(int32_t proxy, const AABB& bounds);
+
+    uint32_t GetUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+    const AABB& GetFatBounds(int32_t proxy) const { return m_nodes[proxy].bounds; }
+
+    size_t GetProxyCount() const { return m_proxyCount; }
+    int32_t GetHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+
+    // Queries report candidate proxies whose fat box passes the test; callers
+    // apply the exact test for their object type. Callbacks return false to
+    // stop the traversal early.
+    template<typename Fn>
+    void Query(const AABB& bounds, Fn&& callback) const {
+        Traverse([&](const AABB& box) { return box.Overlaps(bounds); }, callback);
+    }
+
+    template<typename Fn>
+    void QuerySphere(const glm::vec3& center, float radius, Fn&& callback) const {
+        Traverse([&](const AABB& box) { return box.IntersectsSphere(center, radius); }, callback);
+    }
+
+    template<typename Fn>
+    void QueryFrustum(const Frustum& frustum, Fn&& callback) const {
+        Traverse([&](const AABB& box) { return frustum.IntersectsAABB(box); }, callback);
+    }
+
+    // callback(proxy, currentMaxDistance) returns the new maximum distance:
+    // the hit distance to clip the ray, the old value to ignore the proxy,
+    // or a negative value to stop
+    template<typename Fn>
+    void RayCast(const Ray& ray, float maxDistance, Fn&& callback) const {
+        if (m_root == NULL_NODE) return;
+
+        int32_t stack[STACK_CAPACITY];
+        std::vector<int32_t> overflow;
+        int32_t count = 0;
+        stack[count++] = m_root;
+
+        while (count > 0 || !overflow.empty()) {
+            int32_t nodeId;
+            if (!overflow.empty()) {
+                nodeId = overflow.back();
+                overflow.pop_back();
+            } else {
+                nodeId = stack[--count];
+            }
+
+            const Node& node = m_nodes[nodeId];
+            if (ray.IntersectAABB(node.bounds, maxDistance) < 0.0f) continue;
+
+            if (node.IsLeaf()) {
+                float result = callback(nodeId, maxDistance);
+                if (result < 0.0f) return;
+                maxDistance = std::min(maxDistance, result);
+            } else {
+                Push(stack, count, overflow, node.child1);
+                Push(stack, count, overflow, node.child2);
+            }
+        }
+    }
+
+private:
+    static constexpr int32_t STACK_CAPACITY = 256;
+
+    struct Node {
+        AABB bounds;
+        int32_t parent = NULL_NODE; // Next free node while on the free list
+        int32_t child1 = NULL_NODE;
+        int32_t child2 = NULL_NODE;
+        int32_t height = 0; // Leaf = 0, free node = -1
+        uint32_t userData = 0;
+
+        bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    static void Push(int32_t* stack, int32_t& count, std::vector<int32_t>& overflow, int32_t node) {
+        if (count < STACK_CAPACITY) {
+            stack[count++] = node;
+        } else {
+            overflow.push_back(node);
+        }
+    }
+
+    template<typename Test, typename Fn>
+    void Traverse(Test&& test, Fn&& callback) const {
+        if (m_root == NULL_NODE) return;
+
+        int32_t stack[STACK_CAPACITY];
+        std::vector<int32_t> overflow;
+        int32_t count = 0;
+        stack[count++] = m_root;
+
+        while (count > 0 || !overflow.empty()) {
+            int32_t nodeId;
+            if (!overflow.empty()) {
+                nodeId = overflow.back();
+                overflow.pop_back();
+            } else {
+                nodeId = stack[--count];
+            }
+
+            const Node& node = m_nodes[nodeId];
+            if (!test(node.bounds)) continue;
+
+            if (node.IsLeaf()) {
+                if (!callback(nodeId)) return;
+            } else {
+                Push(stack, count, overflow, node.child1);
+                Push(stack, count, overflow, node.child2);
+            }
+        }
+    }
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t node);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t node);
+    void RefitAncestors(int32_t node);
+
+    std::vector<Node> m_nodes;
+    int32_t m_root = NULL_NODE;
+    int32_t m_freeList = NULL_NODE;
+    size_t m_proxyCount = 0;
+    float m_margin;
+};
@@ -0,0 +1,324 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <functional>
+#include "JobSystem.h"
+
+// =============================================================================
+// ENTITY HANDLES
+// =============================================================================
+
+// An entity is a 20-bit slot index plus an 11-bit version, so a valid handle
+// always fits in a positive int (the form scripts and Light::id use)
+using Entity = uint32_t;
+
+constexpr Entity NULL_ENTITY = 0xFFFFFFFFu;
+constexpr uint32_t ENTITY_INDEX_BITS = 20;
+constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+constexpr uint32_t ENTITY_VERSION_MASK = 0x7FFu;
+
+constexpr uint32_t EntityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+constexpr uint32_t EntityVersion(Entity entity) { return (entity >> ENTITY_INDEX_BITS) & ENTITY_VERSION_MASK; }
+constexpr Entity MakeEntity(uint32_t index, uint32_t version) {
+    return (index & ENTITY_INDEX_MASK) | ((version & ENTITY_VERSION_MASK) << ENTITY_INDEX_BITS);
+}
+
+// =============================================================================
+// COMPONENT STORAGE
+// =============================================================================
+
+// Type-erased base so the registry can strip every component from an entity
+class IComponentPool {
+public:
+    virtual ~IComponentPool() = default;
+    virtual void Remove(Entity entity) = 0;
+    virtual bool Contains(Entity entity) const = 0;
+    virtual size_t Size() const = 0;
+};
+
+// Sparse set: components live in one contiguous array, with a sparse index
+// table mapping entity slots to positions in it. Removal swaps the last
+// element into the hole, so iteration never sees gaps.
+template<typename T>
+class ComponentPool : public IComponentPool {
+public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    template<typename... Args>
+    T& Emplace(Entity entity, Args&&... args) {
+        uint32_t index = EntityIndex(entity);
+        if (index >= m_sparse.size()) {
+            m_sparse.resize(index + 1, INVALID_INDEX);
+        }
+
+        if (m_sparse[index] != INVALID_INDEX) {
+            m_entities[m_sparse[index]] = entity;
+            return m_components[m_sparse[index]] = T{std::forward<Args>(args)...};
+        }
+
+        m_sparse[index] = static_cast<uint32_t>(m_components.size());
+        m_entities.push_back(entity);
+        m_components.push_back(T{std::forward<Args>(args)...});
+        return m_components.back();
+    }
+
+    void Remove(Entity entity) override {
+        if (!Contains(entity)) return;
+
+        uint32_t dense = m_sparse[EntityIndex(entity)];
+        uint32_t last = static_cast<uint32_t>(m_components.size() - 1);
+
+        if (dense != last) {
+            m_components[dense] = std::move(m_components[last]);
+            m_entities[dense] = m_entities[last];
+            m_sparse[EntityIndex(m_entities[dense])] = dense;
+        }
+
+        m_components.pop_back();
+        m_entities.pop_back();
+        m_sparse[EntityIndex(entity)] = INVALID_INDEX;
+    }
+
+    bool Contains(Entity entity) const override {
+        uint32_t index = EntityIndex(entity);
+        return index < m_sparse.size() &&
+               m_sparse[index] != INVALID_INDEX &&
+               m_entities[m_sparse[index]] == entity;
+    }
+
+    size_t Size() const override { return m_components.size(); }
+
+    T* TryGet(Entity entity) {
+        return Contains(entity) ? &m_components[m_sparse[EntityIndex(entity)]] : nullptr;
+    }
+
+    const T* TryGet(Entity entity) const {
+        return Contains(entity) ? &m_components[m_sparse[EntityIndex(entity)]] : nullptr;
+    }
+
+    // Dense column access; index i of Components() belongs to Entities()[i]
+    T* Components() { return m_components.data(); }
+    const T* Components() const { return m_components.data(); }
+    const Entity* Entities() const { return m_entities.data(); }
+
+    void Reserve(size_t count) {
+        m_components.reserve(count);
+        m_entities.reserve(count);
+    }
+
+private:
+    std::vector<uint32_t> m_sparse;
+    std::vector<Entity> m_entities;
+    std::vector<T> m_components;
+};
+
+// Non-owning window onto one component column, handed to Lua so scripts
+// can walk every component of a type without one userdata per entity
+template<typename T>
+struct ComponentView {
+    ComponentPool<T>* pool = nullptr;
+
+    size_t Size() const { return pool ? pool->Size() : 0; }
+
+    T& At(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range("Component view index out of range");
+        }
+        return pool->Components()[index];
+    }
+
+    Entity EntityAt(size_t index) const {
+        if (index >= Size()) {
+            throw std::out_of_range("Component view index out of range");
+        }
+        return pool->Entities()[index];
+    }
+};
+
+// =============================================================================
+// REGISTRY
+// =============================================================================
+
+namespace detail {
+    inline uint32_t NextComponentTypeId() {
+        static uint32_t next = 0;
+        return next++;
+    }
+}
+
+template<typename T>
+uint32_t ComponentTypeId() {
+    static const uint32_t id = detail::NextComponentTypeId();
+    return id;
+}
+
+class Registry {
+public:
+    Entity Create() {
+        if (!m_freeList.empty()) {
+            uint32_t index = m_freeList.back();
+            m_freeList.pop_back();
+            return MakeEntity(index, m_versions[index]);
+        }
+
+        uint32_t index = static_cast<uint32_t>(m_versions.size());
+        if (index > ENTITY_INDEX_MASK) {
+            throw std::runtime_error("Entity limit reached");
+        }
+        m_versions.push_back(0);
+        return MakeEntity(index, 0);
+    }
+
+    void Destroy(Entity entity) {
+        if (!Valid(entity)) return;
+
+        for (auto& listener : m_destroyListeners) {
+            listener(entity);
+        }
+
+        for (auto& pool : m_pools) {
+            if (pool) pool->Remove(entity);
+        }
+
+        uint32_t index = EntityIndex(entity);
+        m_versions[index] = (m_versions[index] + 1) & ENTITY_VERSION_MASK;
+        m_freeList.push_back(index);
+    }
+
+    // Called before an entity's components are stripped, so systems can
+    // release external state such as spatial index proxies
+    void AddDestroyListener(std::function<void(Entity)> listener) {
+        m_destroyListeners.push_back(std::move(listener));
+    }
+
+    bool Valid(Entity entity) const {
+        uint32_t index = EntityIndex(entity);
+        return entity != NULL_ENTITY && index < m_versions.size() &&
+               m_versions[index] == EntityVersion(entity);
+    }
+
+    // True if any pool still holds a component for the entity
+    bool HasAnyComponent(Entity entity) const {
+        for (const auto& pool : m_pools) {
+            if (pool && pool->Contains(entity)) return true;
+        }
+        return false;
+    }
+
+    size_t AliveCount() const { return m_versions.size() - m_freeList.size(); }
+
+    // Makes a destroyed handle valid again, for restoring snapshots that
+    // refer to entities by handle. Fails if the slot has been reused since.
+    bool Revive(Entity entity) {
+        if (entity == NULL_ENTITY) return false;
+        if (Valid(entity)) return true;
+
+        uint32_t index = EntityIndex(entity);
+        while (m_versions.size() <= index) {
+            m_freeList.push_back(static_cast<uint32_t>(m_versions.size()));
+            m_versions.push_back(0);
+        }
+
+        auto slot = std::find(m_freeList.begin(), m_freeList.end(), index);
+        if (slot == m_freeList.end()) {
+            return false;
+        }
+        m_freeList.erase(slot);
+        m_versions[index] = EntityVersion(entity);
+        return true;
+    }
+
+    template<typename T>
+    ComponentPool<T>& Pool() {
+        uint32_t id = ComponentTypeId<T>();
+        if (id >= m_pools.size()) {
+            m_pools.resize(id + 1);
+        }
+        if (!m_pools[id]) {
+            m_pools[id] = std::make_unique<ComponentPool<T>>();
+        }
+        return static_cast<ComponentPool<T>&>(*m_pools[id]);
+    }
+
+    template<typename T, typename... Args>
+    T& Emplace(Entity entity, Args&&... args) {
+        if (!Valid(entity)) {
+            throw std::invalid_argument("Emplace on invalid entity");
+        }
+        return Pool<T>().Emplace(entity, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    void Remove(Entity entity) { Pool<T>().Remove(entity); }
+
+    template<typename T>
+    bool Has(Entity entity) { return Pool<T>().Contains(entity); }
+
+    template<typename T>
+    T* TryGet(Entity entity) { return Pool<T>().TryGet(entity); }
+
+    template<typename T>
+    ComponentView<T> View() { return ComponentView<T>{&Pool<T>()}; }
+
+    // Calls fn(entity, first, others...) for every entity owning all of the
+    // listed components, walking the first component's dense array
+    template<typename First, typename... Others, typename Fn>
+    void Each(Fn&& fn) {
+        auto& pool = Pool<First>();
+        const Entity* entities = pool.Entities();
+        First* components = pool.Components();
+
+        for (size_t i = 0; i < pool.Size(); i++) {
+            Entity entity = entities[i];
+            if constexpr (sizeof...(Others) == 0) {
+                fn(entity, components[i]);
+            } else {
+                if ((Pool<Others>().Contains(entity) && ...)) {
+                    fn(entity, components[i], *Pool<Others>().TryGet(entity)...);
+                }
+            }
+        }
+    }
+
+    // Splits one component column into fixed-size chunks and runs
+    // fn(entities, components, count) on each chunk, spread over the job
+    // system's workers when one is attached. fn must not add or remove
+    // components while it runs.
+    template<typename T, typename Fn>
+    void ParallelEachChunk(size_t chunkSize, Fn&& fn) {
+        auto& pool = Pool<T>();
+        size_t count = pool.Size();
+        if (count == 0) return;
+
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        auto runRange = [&](size_t begin, size_t end) {
+            for (; begin < end; begin += chunkSize) {
+                size_t chunkEnd = std::min(begin + chunkSize, end);
+                fn(pool.Entities() + begin, pool.Components() + begin, chunkEnd - begin);
+            }
+        };
+
+        if (m_jobs) {
+            m_jobs->ParallelFor("ParallelEachChunk", count, chunkSize, runRange);
+        } else {
+            runRange(0, count);
+        }
+    }
+
+    // Workers that systems holding this registry may submit jobs to; the
+    // registry does not own it
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+    JobSystem* GetJobSystem() const { return m_jobs; }
+
+private:
+    std::vector<uint32_t> m_versions;
+    std::vector<uint32_t> m_freeList;
+    std::vector<std::unique_ptr<IComponentPool>> m_pools;
+    std::vector<std::function<void(Entity)>> m_destroyListeners;
+    JobSystem* m_jobs = nullptr;
+};
@@ -2,11 +2,20 @@
 #include <memory>
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include "Replay.h"
 
 class VulkanRenderer;
 class LuaManager;
 class LightingSystem;
 class Scene;
+class ShadowSystem;
+class FrameAllocator;
+class JobSystem;
+struct GLFWwindow;
 
 class Engine {
 public:
@@ -17,15 +26,85 @@ public:
     void Run();
     void Shutdown();
     
+    // Subsystem access for the scripting layer
+    LightingSystem* GetLightingSystem() const { return m_lightingSystem.get(); }
+    Scene* GetScene() const { return m_scene.get(); }
+    ShadowSystem* GetShadowSystem() const { return m_shadowSystem.get(); }
+    JobSystem* GetJobSystem() const { return m_jobSystem.get(); }
+    VulkanRenderer* GetRenderer() const { return m_renderer.get(); }
+    
+    // Switches between fullscreen on the primary monitor at its current
+    // video mode and the previous windowed placement (also bound to F11
+    // and Alt+Enter)
+    void SetFullscreen(bool fullscreen);
+    bool IsFullscreen() const;
+    
+    // Heap allocations (operator new and the Lua heap) made by the last
+    // frame's update and render; always 0 unless built with
+    // ENGINE_COUNT_ALLOCATIONS
+    uint64_t GetFrameHeapAllocations() const { return m_frameHeapAllocations; }
+    
+    // Transient allocations for the current frame, from update through render
+    FrameAllocator* GetFrameAllocator() { return m_frameAllocator.get(); }
+    
+    // Snapshots of the lights, lighting settings and script state (see
+    // Snapshot.h). Failures are logged and reported as false.
+    bool CaptureSnapshot(std::vector<std::byte>& snapshot);
+    bool RestoreSnapshot(std::span<const std::byte> snapshot);
+    bool SaveSnapshot(const std::string& path);
+    bool LoadSnapshot(const std::string& path); // Restores from a memory mapping of the file
+    
+    // Restores requested from scripts wait for the start of the next update,
+    // so no script has its state replaced while it runs; the last request wins
+    void RequestSnapshotRestore(std::shared_ptr<const std::vector<std::byte>> snapshot);
+    void RequestSnapshotLoad(const std::string& path);
+    
+    // Session recording for reproducible performance captures (see
+    // Replay.h). Requests take effect at the next frame boundary; a replay
+    // restores the snapshot its recording started from. quitWhenDone ends
+    // Run once playback stops, for unattended captures.
+    void StartRecording(const std::string& path);
+    void StartReplay(const std::string& path, ReplaySpeed speed, bool quitWhenDone = false);
+    void StopReplay(); // Stops recording or playback
+    ReplaySession& GetReplay() { return m_replay; }
+    
 private:
     void Update(float deltaTime);
     void Render();
+    void HandleKey(int key, int action, int mods);
+    void ApplyPendingSnapshot();
+    void ApplyReplayRequests();
     
+    std::unique_ptr<JobSystem> m_jobSystem; // Declared first so it outlives every system submitting to it
     std::unique_ptr<VulkanRenderer> m_renderer;
     std::unique_ptr<LuaManager> m_luaManager;
+    std::unique_ptr<Scene> m_scene; // Owns the registry the lighting system stores lights in
     std::unique_ptr<LightingSystem> m_lightingSystem;
-    std::unique_ptr<Scene> m_scene;
+    std::unique_ptr<ShadowSystem> m_shadowSystem;
+    std::unique_ptr<FrameAllocator> m_frameAllocator; // Transient per-frame data such as light lists
     
+    GLFWwindow* m_window = nullptr;
     bool m_isRunning = false;
+    
+    // Windowed placement restored when leaving fullscreen
+    int m_windowedX = 0;
+    int m_windowedY = 0;
+    int m_windowedWidth = 1280;
+    int m_windowedHeight = 720;
+    float m_elapsedTime = 0.0f;
+    uint64_t m_frameHeapAllocations = 0;
+    float m_shaderReloadTimer = 0.0f;
+    static constexpr float SHADER_RELOAD_INTERVAL = 0.5f; // Seconds between shader hot reload checks
     std::chrono::high_resolution_clock::time_point m_lastFrameTime;
+    
+    std::shared_ptr<const std::vector<std::byte>> m_pendingSnapshot;
+    std::string m_pendingSnapshotPath;
+    
+    ReplaySession m_replay;
+    std::vector<ReplayKeyEvent> m_replayKeys; // Key events of the frame being replayed
+    std::string m_pendingRecordPath;
+    std::string m_pendingReplayPath;
+    ReplaySpeed m_pendingReplaySpeed = ReplaySpeed::Recorded;
+    bool m_stopReplayRequested = false;
+    bool m_quitAfterReplay = false;
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for data that only lives until its frame slot comes round
+// again. Deallocation is a no-op and Reset rewinds everything at once. A
+// frame that outgrows the block spills into overflow blocks, which the next
+// Reset folds into one larger block, so after a few frames a steady
+// workload allocates nothing from the heap.
+class FrameArena : public std::pmr::memory_resource {
+public:
+    explicit FrameArena(size_t capacity = 1 << 20);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void Reset();
+
+    size_t GetUsed() const { return m_used; }   // Bytes taken since the last Reset, padding included
+    size_t GetPeak() const { return m_peak; }   // Largest GetUsed of any frame
+    size_t GetCapacity() const { return m_capacity; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::unique_ptr<std::byte[]> m_block;
+    size_t m_capacity = 0;
+    size_t m_offset = 0;
+    size_t m_used = 0;
+    size_t m_peak = 0;
+    std::vector<std::unique_ptr<std::byte[]>> m_overflow;
+};
+
+// One arena per frame in flight, so a frame's allocations stay valid until
+// its slot comes round again rather than only until the next BeginFrame.
+class FrameAllocator {
+public:
+    FrameAllocator(uint32_t frameCount, size_t capacityPerFrame = 1 << 20);
+
+    void BeginFrame(uint32_t frameIndex);
+
+    FrameArena& GetArena() { return *m_current; }
+    std::pmr::memory_resource* GetResource() { return m_current; }
+
+private:
+    std::vector<std::unique_ptr<FrameArena>> m_arenas;
+    FrameArena* m_current = nullptr;
+};
+
+// Number of heap allocations so far: global operator new calls plus those
+// reported through CountHeapAllocation by allocators that go to malloc
+// directly (the Lua state). Counting is compiled in with
+// ENGINE_COUNT_ALLOCATIONS (on in Debug builds); otherwise this returns 0.
+uint64_t GetHeapAllocationCount();
+bool IsHeapAllocationCountingEnabled();
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+void CountHeapAllocation();
+#else
+inline void CountHeapAllocation() {}
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include "VulkanRendererHelpers.h"
+
+// What the pacer optimizes for; see FramePacer::WaitForFrame
+enum class LatencyMode : int {
+    Throughput = 0, // CPU runs up to framesInFlight - 1 frames ahead of the GPU
+    LowLatency = 1  // CPU starts a frame only once the GPU has finished the previous one
+};
+
+// Decides when the CPU may start recording the next frame. Every submitted
+// frame signals one timeline semaphore with its frame number + 1, so the
+// value the semaphore has reached is the number of frames the GPU has
+// finished; waiting for a frame slot, retiring deferred destruction and
+// measuring GPU progress all read that one counter instead of per-slot
+// fences.
+//
+// The frames-in-flight count may change at any frame boundary: each slot
+// remembers the frame that last used it, so a slot is never reused before
+// that frame finished, whatever the count was then.
+class FramePacer {
+public:
+    FramePacer() = default;
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    void Initialize(VkDevice device);
+    void Destroy(); // Only after vkDeviceWaitIdle
+
+    // Clamped to [1, MAX_FRAMES_IN_FLIGHT]; takes effect from the next frame
+    void SetFramesInFlight(uint32_t count);
+    uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+
+    void SetLatencyMode(LatencyMode mode) { m_latencyMode = mode; }
+    LatencyMode GetLatencyMode() const { return m_latencyMode; }
+
+    // Blocks until the next frame may be recorded. In LowLatency mode that
+    // is once the GPU has drained the previous frame, so input sampled
+    // afterwards reaches the screen one frame sooner at the cost of CPU/GPU
+    // overlap. Only the first call per frame waits.
+    void WaitForFrame();
+    bool HasWaited() const { return m_waited; }
+
+    // Slot of the frame being recorded, in [0, MAX_FRAMES_IN_FLIGHT)
+    uint32_t GetSlot() const { return m_slot; }
+
+    // The frame being recorded signals GetTimeline() with GetSignalValue()
+    VkSemaphore GetTimeline() const { return m_timeline; }
+    uint64_t GetSignalValue() const { return m_frameNumber + 1; }
+
+    // Call once the recorded frame has been submitted; moves to the next slot
+    void FrameSubmitted();
+
+    uint64_t GetSubmittedFrames() const { return m_frameNumber; }
+    uint64_t GetCompletedFrames() const;
+
+    // Time the last WaitForFrame spent blocked, in milliseconds
+    float GetLastWaitMs() const { return m_lastWaitMs; }
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+
+    LatencyMode m_latencyMode = LatencyMode::Throughput;
+    uint32_t m_framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    uint32_t m_slot = 0;
+    uint64_t m_frameNumber = 0;                          // Frames submitted so far
+    uint64_t m_slotFrames[MAX_FRAMES_IN_FLIGHT] = {};    // Signal value of each slot's last frame
+    bool m_waited = false;
+    float m_lastWaitMs = 0.0f;
+};
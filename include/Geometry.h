@@ -0,0 +1,142 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// =============================================================================
+// BOUNDING VOLUMES AND CULLING PRIMITIVES
+// =============================================================================
+
+struct AABB {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    float SurfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool Contains(const AABB& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+               max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
+    bool Overlaps(const AABB& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x &&
+               min.y <= other.max.y && max.y >= other.min.y &&
+               min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const {
+        glm::vec3 closest = glm::clamp(center, min, max);
+        glm::vec3 delta = center - closest;
+        return glm::dot(delta, delta) <= radius * radius;
+    }
+
+    AABB Expanded(float margin) const {
+        return AABB{min - glm::vec3(margin), max + glm::vec3(margin)};
+    }
+
+    static AABB Union(const AABB& a, const AABB& b) {
+        return AABB{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+
+    static AABB FromSphere(const glm::vec3& center, float radius) {
+        return AABB{center - glm::vec3(radius), center + glm::vec3(radius)};
+    }
+};
+
+struct Ray {
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); // Normalized
+    
+    // Slab test; returns the entry distance along the ray or a negative value
+    // when the box is missed or lies beyond maxDistance
+    float IntersectAABB(const AABB& box, float maxDistance) const {
+        float tMin = 0.0f;
+        float tMax = maxDistance;
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::abs(direction[axis]) < 1e-8f) {
+                if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) {
+                    return -1.0f;
+                }
+                continue;
+            }
+            float inverse = 1.0f / direction[axis];
+            float t0 = (box.min[axis] - origin[axis]) * inverse;
+            float t1 = (box.max[axis] - origin[axis]) * inverse;
+            if (t0 > t1) std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if (tMin > tMax) {
+                return -1.0f;
+            }
+        }
+        return tMin;
+    }
+};
+
+// Plane in the form dot(normal, p) + distance = 0, normal pointing inward
+struct Plane {
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    float distance = 0.0f;
+
+    float SignedDistance(const glm::vec3& point) const {
+        return glm::dot(normal, point) + distance;
+    }
+};
+
+struct Frustum {
+    enum Side { Left = 0, Right, Bottom, Top, Near, Far };
+    std::array<Plane, 6> planes;
+
+    // Extracts the six planes from a view-projection matrix using Vulkan's
+    // [0, 1] clip-space depth range
+    static Frustum FromMatrix(const glm::mat4& viewProjection) {
+        auto row = [&](int i) {
+            return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                             viewProjection[2][i], viewProjection[3][i]);
+        };
+        glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+        std::array<glm::vec4, 6> raw = {
+            r3 + r0, r3 - r0, // left, right
+            r3 + r1, r3 - r1, // bottom, top
+            r2,      r3 - r2  // near, far
+        };
+
+        Frustum frustum;
+        for (size_t i = 0; i < raw.size(); i++) {
+            glm::vec3 normal(raw[i].x, raw[i].y, raw[i].z);
+            float length = glm::length(normal);
+            frustum.planes[i].normal = normal / length;
+            frustum.planes[i].distance = raw[i].w / length;
+        }
+        return frustum;
+    }
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const {
+        for (const Plane& plane : planes) {
+            if (plane.SignedDistance(center) < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IntersectsAABB(const AABB& box) const {
+        glm::vec3 center = box.Center();
+        glm::vec3 extents = box.Extents();
+        for (const Plane& plane : planes) {
+            float radius = glm::dot(extents, glm::abs(plane.normal));
+            if (plane.SignedDistance(center) < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,180 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+// =============================================================================
+// GPU STRUCT DESCRIPTIONS
+// =============================================================================
+//
+// Structs shared with shaders are described once, next to their C++
+// definition:
+//
+//     template<> struct GpuStruct<LightData> {
+//         static constexpr const char* name = "Light";
+//         static constexpr GpuField fields[] = {
+//             GPU_FIELD(LightData, position, "World position"),
+//             ...
+//         };
+//     };
+//     static_assert(GpuLayoutMatches<LightData>(GpuPacking::Std430));
+//
+// The description generates the GLSL declaration (GlslStruct, GlslBlock),
+// and GpuLayoutMatches checks at compile time that every C++ offset is the
+// one the GLSL packing rules give that member, so the two sides cannot
+// drift apart. Fields must be listed in declaration order.
+
+enum class GpuPacking {
+    Std140, // Uniform blocks: arrays and structs aligned to 16 bytes
+    Std430  // Storage blocks: natural alignment, vec3 still aligned to 16
+};
+
+struct GpuField {
+    const char* name = nullptr;
+    const char* glslType = nullptr;
+    const char* comment = nullptr;
+    size_t offset = 0;     // offsetof in the C++ struct
+    size_t cppSize = 0;    // sizeof the C++ member, all elements
+    size_t alignment = 0;  // std430 base alignment of one element
+    size_t size = 0;       // GLSL size of one element
+    size_t arrayCount = 0; // 0 = not an array
+    bool isStruct = false; // Element is itself a described struct
+};
+
+// Specialized for every struct shared with shaders; see above
+template<typename T>
+struct GpuStruct;
+
+namespace GpuDetail {
+    constexpr size_t RoundUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    struct TypeInfo {
+        const char* glslType;
+        size_t alignment;
+        size_t size;
+        bool isStruct;
+    };
+
+    template<typename T, typename = void>
+    struct IsDescribed : std::false_type {};
+    template<typename T>
+    struct IsDescribed<T, std::void_t<decltype(GpuStruct<T>::fields)>> : std::true_type {};
+
+    template<typename T>
+    constexpr TypeInfo TypeOf() {
+        if constexpr (std::is_same_v<T, float>) return {"float", 4, 4, false};
+        else if constexpr (std::is_same_v<T, int32_t>) return {"int", 4, 4, false};
+        else if constexpr (std::is_same_v<T, uint32_t>) return {"uint", 4, 4, false};
+        else if constexpr (std::is_same_v<T, glm::vec2>) return {"vec2", 8, 8, false};
+        else if constexpr (std::is_same_v<T, glm::vec3>) return {"vec3", 16, 12, false};
+        else if constexpr (std::is_same_v<T, glm::vec4>) return {"vec4", 16, 16, false};
+        else if constexpr (std::is_same_v<T, glm::ivec4>) return {"ivec4", 16, 16, false};
+        else if constexpr (std::is_same_v<T, glm::uvec4>) return {"uvec4", 16, 16, false};
+        else if constexpr (std::is_same_v<T, glm::mat4>) return {"mat4", 16, 64, false};
+        else if constexpr (IsDescribed<T>::value) {
+            size_t alignment = 4;
+            for (const GpuField& field : GpuStruct<T>::fields) {
+                alignment = std::max(alignment, field.alignment);
+            }
+            return {GpuStruct<T>::name, alignment, sizeof(T), true};
+        } else {
+            static_assert(IsDescribed<T>::value, "Type has no GLSL equivalent; describe it with GpuStruct");
+            return {};
+        }
+    }
+
+    template<typename Member>
+    constexpr GpuField MakeField(const char* name, size_t offset, const char* comment) {
+        using Element = std::remove_all_extents_t<Member>;
+        static_assert(std::rank_v<Member> <= 1, "Only one-dimensional arrays are supported");
+        TypeInfo type = TypeOf<Element>();
+
+        GpuField field;
+        field.name = name;
+        field.glslType = type.glslType;
+        field.comment = comment;
+        field.offset = offset;
+        field.cppSize = sizeof(Member);
+        field.alignment = type.alignment;
+        field.size = type.size;
+        field.arrayCount = std::is_array_v<Member> ? std::extent_v<Member> : 0;
+        field.isStruct = type.isStruct;
+        return field;
+    }
+
+    void AppendMembers(std::string& out, std::span<const GpuField> fields, const char* indent);
+}
+
+#define GPU_FIELD(Struct, member, comment) \
+    GpuDetail::MakeField<decltype(Struct::member)>(#member, offsetof(Struct, member), comment)
+
+// True when T's C++ layout is exactly what GLSL gives the described struct
+// under packing, including the size an array element occupies
+template<typename T>
+constexpr bool GpuLayoutMatches(GpuPacking packing) {
+    using GpuDetail::RoundUp;
+    bool std140 = packing == GpuPacking::Std140;
+
+    size_t offset = 0;
+    size_t structAlignment = 4;
+    for (const GpuField& field : GpuStruct<T>::fields) {
+        bool aggregate = field.arrayCount > 0 || field.isStruct;
+        size_t alignment = std140 && aggregate ? RoundUp(field.alignment, 16) : field.alignment;
+        size_t stride = RoundUp(field.size, alignment);
+        size_t size = field.arrayCount > 0 ? stride * field.arrayCount : field.size;
+
+        offset = RoundUp(offset, alignment);
+        if (field.offset != offset || field.cppSize != size) {
+            return false;
+        }
+        offset += size;
+        if (std140 && aggregate) {
+            offset = RoundUp(offset, alignment); // std140 pads after arrays and structs
+        }
+        structAlignment = std::max(structAlignment, alignment);
+    }
+
+    if (std140) {
+        structAlignment = RoundUp(structAlignment, 16);
+    }
+    return sizeof(T) == RoundUp(offset, structAlignment);
+}
+
+// "struct Name { ... };" for use in arrays and blocks
+template<typename T>
+std::string GlslStruct() {
+    std::string out = "struct ";
+    out += GpuStruct<T>::name;
+    out += " {\n";
+    GpuDetail::AppendMembers(out, GpuStruct<T>::fields, "    ");
+    out += "};\n";
+    return out;
+}
+
+// A uniform or storage block with T's members, e.g.
+// GlslBlock<LightBufferData>("std430, binding = 1", "readonly buffer", "lightBuffer")
+template<typename T>
+std::string GlslBlock(const char* layout, const char* storage, const char* instanceName) {
+    std::string out = "layout(";
+    out += layout;
+    out += ") ";
+    out += storage;
+    out += ' ';
+    out += GpuStruct<T>::name;
+    out += " {\n";
+    GpuDetail::AppendMembers(out, GpuStruct<T>::fields, "    ");
+    out += "} ";
+    out += instanceName;
+    out += ";\n";
+    return out;
+}
+
+// Octahedral encoding of a unit vector into [-1, 1]^2; decoded by
+// DecodeUnitVector in lights.glsl
+glm::vec2 EncodeUnitVector(const glm::vec3& direction);
@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// =============================================================================
+// JOB HANDLES
+// =============================================================================
+
+namespace JobDetail {
+    // Completion state shared by every job of one submission (a single job
+    // or all chunks of a parallel for)
+    struct Counter {
+        explicit Counter(uint32_t jobs) : pending(jobs) {}
+
+        std::atomic<uint32_t> pending;
+        std::mutex mutex;                                // Guards done, continuations and error
+        bool done = false;
+        std::vector<std::function<void()>> continuations; // Run by whichever thread finishes the last job
+        std::exception_ptr error;                        // First exception thrown by a job
+    };
+}
+
+// Refers to a submitted job or group of jobs. A default handle counts as
+// already complete, so it can be passed wherever a dependency is optional.
+class JobHandle {
+public:
+    JobHandle() = default;
+
+    bool IsDone() const { return !m_counter || m_counter->pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    explicit JobHandle(std::shared_ptr<JobDetail::Counter> counter) : m_counter(std::move(counter)) {}
+
+    std::shared_ptr<JobDetail::Counter> m_counter;
+};
+
+// =============================================================================
+// PROFILING
+// =============================================================================
+
+struct JobProfileEvent {
+    const char* name = nullptr; // Name given at submission, never null
+    uint32_t worker = 0;        // 0 is the thread that created the job system, ~0u a foreign thread inside Wait
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+using JobProfiler = std::function<void(const JobProfileEvent&)>;
+
+// =============================================================================
+// JOB SYSTEM
+// =============================================================================
+
+// Work-stealing scheduler. Every worker thread, and the thread that created
+// the system, owns a deque: new jobs go to the back of the submitting
+// thread's deque and are taken from there LIFO while they are still in
+// cache, and idle workers steal the oldest jobs from the front of the
+// others'. Dependencies are continuations, so a job that waits on another
+// is only queued once it can run and never blocks a worker.
+//
+// Jobs must not block on each other except through Wait, which runs other
+// jobs while it waits.
+class JobSystem {
+public:
+    // workerCount excludes the creating thread; by default one worker per
+    // remaining hardware thread
+    explicit JobSystem(uint32_t workerCount = DefaultWorkerCount());
+    ~JobSystem(); // Finishes queued jobs before joining the workers
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static uint32_t DefaultWorkerCount();
+
+    // Queues job to run once all dependencies have completed. name must
+    // outlive the job (a string literal) and is only used for profiling.
+    JobHandle Schedule(const char* name, std::function<void()> job,
+                       std::span<const JobHandle> dependencies = {});
+
+    // Runs fn(begin, end) over [0, count) in ranges of at most grainSize
+    // elements. The async form returns immediately; the ranges may run in
+    // any order and on any thread.
+    JobHandle ParallelForAsync(const char* name, size_t count, size_t grainSize,
+                               std::function<void(size_t, size_t)> fn,
+                               std::span<const JobHandle> dependencies = {});
+
+    template<typename Fn>
+    void ParallelFor(const char* name, size_t count, size_t grainSize, Fn&& fn) {
+        if (count == 0) return;
+        if (count <= grainSize || m_queues.size() == 1) {
+            fn(size_t(0), count); // Not worth a round trip through the queues
+            return;
+        }
+        Wait(ParallelForAsync(name, count, grainSize, std::forward<Fn>(fn)));
+    }
+
+    // Runs queued jobs on the calling thread until handle completes, then
+    // rethrows the first exception any of its jobs threw
+    void Wait(const JobHandle& handle);
+
+    // Called on the executing thread after every job. Set it while no jobs
+    // are in flight.
+    void SetProfiler(JobProfiler profiler) { m_profiler = std::move(profiler); }
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_queues.size()); }
+
+private:
+    struct Job {
+        std::function<void()> fn;
+        const char* name = nullptr;
+        std::shared_ptr<JobDetail::Counter> counter;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void Enqueue(std::vector<Job>& jobs);
+    bool TryRunOne(uint32_t self);
+    bool PopOrSteal(uint32_t self, Job& job);
+    void Execute(Job& job, uint32_t self);
+    void Complete(JobDetail::Counter& counter);
+    void WhenDone(std::span<const JobHandle> dependencies, std::function<void()> continuation);
+    void WorkerMain(uint32_t self);
+    uint32_t CurrentQueue() const;
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues; // [0] belongs to the creating thread
+    std::vector<std::thread> m_workers;
+    std::atomic<uint32_t> m_nextExternalQueue{0};       // Spreads submissions from unrelated threads
+
+    // Sleeping workers wake when a job is queued
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<int64_t> m_queuedJobs{0};
+    std::atomic<uint32_t> m_sleepers{0};
+    bool m_stopping = false;
+
+    JobProfiler m_profiler;
+};
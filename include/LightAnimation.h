@@ -0,0 +1,183 @@
+#pragma once
+#include "ECS.h"
+#include <vector>
+#include <cstdint>
+#include <tuple>
+#include <glm/glm.hpp>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+// =============================================================================
+// ANIMATION DESCRIPTIONS
+// =============================================================================
+
+// Speeds are angular (radians per second), matching the sin(time * k)
+// expressions scripts used before
+
+struct PulseAnimation {
+    float base = 1.0f;      // Intensity around which the light oscillates
+    float amplitude = 0.5f;
+    float speed = 1.0f;
+    float phase = 0.0f;
+    float minimum = 0.0f;   // Intensity floor
+};
+
+struct OrbitAnimation {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 1.0f;
+    float speed = 1.0f;
+    float phase = 0.0f;
+    float bobAmplitude = 0.0f; // Vertical oscillation around center.y
+    float bobSpeed = 0.0f;
+};
+
+struct FlickerAnimation {
+    float base = 1.0f;
+    float amount = 0.3f;    // Fraction of base intensity that noise may remove
+    float speed = 10.0f;    // Noise samples per second
+    float seed = 0.0f;
+};
+
+struct ColorCycleAnimation {
+    glm::vec3 speed = glm::vec3(0.5f, 0.7f, 0.3f); // Per channel
+    glm::vec3 phase = glm::vec3(0.0f);
+    float brightness = 1.0f;
+};
+
+enum class KeyframeProperty : int {
+    Intensity = 0,
+    Range = 1
+};
+
+enum class KeyframeInterpolation : int {
+    Step = 0,
+    Linear = 1,
+    Smooth = 2
+};
+
+struct Keyframe {
+    float time = 0.0f;
+    float value = 0.0f;
+};
+
+struct KeyframeAnimation {
+    KeyframeProperty property = KeyframeProperty::Intensity;
+    KeyframeInterpolation interpolation = KeyframeInterpolation::Linear;
+    std::vector<Keyframe> keys; // Sorted by time
+    bool loop = true;
+};
+
+// =============================================================================
+// ANIMATOR
+// =============================================================================
+
+// Evaluates procedural light animations natively. Each animation kind keeps
+// its parameters in structure-of-arrays form and is evaluated for every
+// track in one branch-free pass before the results are scattered into the
+// Light components.
+class LightAnimator {
+public:
+    void AddPulse(Entity light, const PulseAnimation& animation);
+    void AddOrbit(Entity light, const OrbitAnimation& animation);
+    void AddFlicker(Entity light, const FlickerAnimation& animation);
+    void AddColorCycle(Entity light, const ColorCycleAnimation& animation);
+    void AddKeyframes(Entity light, const KeyframeAnimation& animation);
+
+    // Removes every animation driving the light
+    void Stop(Entity light);
+    void Clear();
+
+    void Update(float deltaTime, Registry& registry);
+
+    size_t GetTrackCount() const;
+    double GetTime() const { return m_time; }
+
+    // The clock and every track, including each one's current angle, so a
+    // restored animator continues exactly where the snapshot was taken.
+    // ReadSnapshot replaces the whole animator and throws
+    // std::runtime_error on malformed data, leaving it untouched.
+    void WriteSnapshot(SnapshotWriter& out) const;
+    void ReadSnapshot(SnapshotReader& in);
+
+private:
+    // Each track advances its own wrapped angle (or noise position) rather
+    // than evaluating sin(speed * time), so precision never degrades as the
+    // session runs on. Columns(tracks) ties every parallel array of a track
+    // kind so removal and snapshots cannot miss one.
+    struct PulseTracks {
+        std::vector<Entity> targets;
+        std::vector<float> base, amplitude, speed, minimum;
+        std::vector<float> angle;
+        std::vector<float> result;
+
+        template<typename Self>
+        static auto Columns(Self& self) {
+            return std::tie(self.targets, self.base, self.amplitude, self.speed, self.minimum,
+                            self.angle, self.result);
+        }
+    };
+
+    struct OrbitTracks {
+        std::vector<Entity> targets;
+        std::vector<float> centerX, centerY, centerZ, radius, speed, bobAmplitude, bobSpeed;
+        std::vector<float> angle, bobAngle;
+        std::vector<float> resultX, resultY, resultZ;
+
+        template<typename Self>
+        static auto Columns(Self& self) {
+            return std::tie(self.targets, self.centerX, self.centerY, self.centerZ, self.radius, self.speed,
+                            self.bobAmplitude, self.bobSpeed, self.angle, self.bobAngle,
+                            self.resultX, self.resultY, self.resultZ);
+        }
+    };
+
+    struct FlickerTracks {
+        std::vector<Entity> targets;
+        std::vector<float> base, amount, speed;
+        std::vector<float> position;
+        std::vector<float> result;
+
+        template<typename Self>
+        static auto Columns(Self& self) {
+            return std::tie(self.targets, self.base, self.amount, self.speed, self.position, self.result);
+        }
+    };
+
+    struct ColorCycleTracks {
+        std::vector<Entity> targets;
+        std::vector<float> speedR, speedG, speedB, brightness;
+        std::vector<float> angleR, angleG, angleB;
+        std::vector<float> resultR, resultG, resultB;
+
+        template<typename Self>
+        static auto Columns(Self& self) {
+            return std::tie(self.targets, self.speedR, self.speedG, self.speedB, self.brightness,
+                            self.angleR, self.angleG, self.angleB, self.resultR, self.resultG, self.resultB);
+        }
+    };
+
+    struct KeyframeTracks {
+        std::vector<Entity> targets;
+        std::vector<KeyframeAnimation> animations;
+        std::vector<double> startTime; // m_time when added; tracks start at their first key
+
+        template<typename Self>
+        static auto Columns(Self& self) {
+            return std::tie(self.targets, self.animations, self.startTime);
+        }
+    };
+
+    void EvaluatePulses(float deltaTime);
+    void EvaluateOrbits(float deltaTime);
+    void EvaluateFlickers(float deltaTime);
+    void EvaluateColorCycles(float deltaTime);
+
+    PulseTracks m_pulses;
+    OrbitTracks m_orbits;
+    FlickerTracks m_flickers;
+    ColorCycleTracks m_colorCycles;
+    KeyframeTracks m_keyframes;
+
+    double m_time = 0.0; // Drives keyframe tracks
+};
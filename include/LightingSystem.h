@@ -1,8 +1,16 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <memory>
-#include <unordered_map>
+#include <memory_resource>
 #include <glm/glm.hpp>
+#include "ECS.h"
+#include "BVH.h"
+#include "LightAnimation.h"
+
+class SnapshotWriter;
+class SnapshotReader;
 
 enum class LightType : int {
     Directional = 0,
@@ -21,21 +29,66 @@ struct Light {
     float innerCone;
     float outerCone;
     bool enabled;
+    bool castShadows;
     
     Light() : id(-1), type(LightType::Point), position(0.0f), direction(0.0f, -1.0f, 0.0f),
               color(1.0f), intensity(1.0f), range(10.0f), innerCone(30.0f), 
-              outerCone(45.0f), enabled(true) {}
+              outerCone(45.0f), enabled(true), castShadows(true) {}
 };
 
+// Limits every Light obeys. The LightingSystem setters apply them, and so
+// must every path that writes components directly (component views, column
+// copies, snapshots); the spatial index and the shaders rely on them.
+namespace LightLimits {
+    constexpr float MIN_RANGE = 0.1f;
+    constexpr float MAX_INNER_CONE = 89.0f;
+    constexpr float MAX_OUTER_CONE = 90.0f;
+    
+    inline bool IsValidType(int type) {
+        return type >= static_cast<int>(LightType::Directional) && type <= static_cast<int>(LightType::Spot);
+    }
+    
+    inline float Range(float range) { return std::max(MIN_RANGE, range); }
+    inline float Intensity(float intensity) { return std::max(0.0f, intensity); }
+    inline float InnerCone(float innerCone) { return glm::clamp(innerCone, 0.0f, MAX_INNER_CONE); }
+    inline float OuterCone(float outerCone, float innerCone) { return glm::clamp(outerCone, innerCone, MAX_OUTER_CONE); }
+    
+    // Unit length; a zero or non-finite direction points straight down
+    inline glm::vec3 Direction(const glm::vec3& direction) {
+        float length = glm::length(direction);
+        return std::isfinite(length) && length > 0.0f ? direction / length : glm::vec3(0.0f, -1.0f, 0.0f);
+    }
+}
+
+// Counts of enabled lights by type, used to choose a lighting pipeline
+// specialized for the frame's light mix
+struct LightMix {
+    uint32_t directional = 0;
+    uint32_t point = 0;
+    uint32_t spot = 0;
+    bool sun = false; // Sun intensity above zero
+    
+    uint32_t Total() const { return directional + point + spot; }
+};
+
+// BVH proxy of a point or spot light, bounding the sphere of Light::range
+struct LightBoundsProxy {
+    int32_t proxy = BVH::NULL_NODE;
+};
+
+// Lights are Light components in the scene registry; a light id is the
+// owning entity handle
 class LightingSystem {
 public:
-    LightingSystem();
+    explicit LightingSystem(Registry& registry);
     ~LightingSystem();
     
     // Light management
     int CreateLight(LightType type = LightType::Point);
+    int AddLight(Entity entity, LightType type = LightType::Point);
     bool RemoveLight(int lightId);
     Light* GetLight(int lightId);
+    size_t GetLightCount() { return m_registry.Pool<Light>().Size(); }
     
     // Light properties
     void SetLightPosition(int lightId, const glm::vec3& position);
@@ -45,10 +98,22 @@ public:
     void SetLightRange(int lightId, float range);
     void SetLightCone(int lightId, float innerCone, float outerCone);
     void SetLightEnabled(int lightId, bool enabled);
+    void SetLightCastShadows(int lightId, bool castShadows);
     
     // Lighting calculations
     void Update(float deltaTime);
-    std::vector<Light> GetActiveLights() const;
+    LightAnimator& GetAnimator() { return m_animator; }
+    // Pass the frame arena for a per-frame copy that never touches the heap.
+    // Large light counts are compacted in parallel on the registry's jobs.
+    std::pmr::vector<Light> GetActiveLights(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+    LightMix GetLightMix() const;
+    
+    // Spatial queries over point and spot lights. QueryAffecting also
+    // reports every enabled directional light. QueryRadius serves scripts,
+    // which collect into the frame arena.
+    void QueryRadius(const glm::vec3& center, float radius, std::pmr::vector<int>& results);
+    void QueryAffecting(const AABB& bounds, std::vector<int>& results);
+    void QueryFrustum(const Frustum& frustum, std::vector<int>& results);
     
     // Global lighting settings
     void SetAmbientLight(const glm::vec3& color) { m_ambientLight = color; }
@@ -63,9 +128,21 @@ public:
     void SetSunIntensity(float intensity) { m_sunIntensity = intensity; }
     float GetSunIntensity() const { return m_sunIntensity; }
     
+    // Lights (as raw component arrays) and the global settings. Restoring
+    // keeps light ids: lights missing from the snapshot are removed and
+    // removed ones are recreated under their old handle. The animator is
+    // restored with them, clock and track phases included.
+    void WriteSnapshot(SnapshotWriter& out);
+    void ReadSnapshot(SnapshotReader& in);
+    
 private:
-    std::unordered_map<int, std::unique_ptr<Light>> m_lights;
-    int m_nextLightId = 1;
+    void SyncSpatialIndex();
+    void DestroyProxy(Entity entity);
+    
+    Registry& m_registry;
+    LightAnimator m_animator;
+    BVH m_spatialIndex;
+    bool m_spatialDirty = false;
     
     // Global lighting
     glm::vec3 m_ambientLight = glm::vec3(0.1f, 0.1f, 0.15f);
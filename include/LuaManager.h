@@ -2,42 +2,213 @@
 #include <sol/sol.hpp>
 #include <memory>
 #include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <variant>
 #include <glm/glm.hpp>
+#include "ScriptFFI.h"
+#include "JobSystem.h"
 
 class Engine;
+class SnapshotWriter;
+class SnapshotReader;
 class LightingSystem;
 class Scene;
 
+// Resource limits applied to a single sandboxed script. With LuaJIT, count
+// hooks do not fire inside compiled traces, so scripts stay interpreted
+// (and the instruction limit holds) unless loaded with the jit capability.
+struct ScriptQuota {
+    uint64_t instructionsPerCall = 10'000'000; // VM instructions per entry into the script
+    size_t memoryBytes = 64 * 1024 * 1024;     // Live heap attributed to the script
+    uint32_t maxSpawnedScripts = 16;           // Scene.loadAsync loads over the script's lifetime
+};
+
+// Engine features that reach beyond a script's own state, off unless the
+// script is loaded with them; engine code outside any sandbox has them all
+struct ScriptCapabilities {
+    bool snapshots = false; // Engine.captureSnapshot, restoreSnapshot, saveSnapshot, loadSnapshot
+    bool replay = false;    // Engine.startRecording, startReplay, stopReplay
+    bool jit = false;       // LuaJIT may compile the script, which its instruction quota cannot then bound
+};
+
+// Per-script environment and accounting
+struct ScriptSandbox {
+    std::string name;
+    uint32_t index = 0;
+    sol::environment env;
+    ScriptQuota quota;
+    ScriptCapabilities capabilities;
+
+    // Scripts loaded through Scene.loadAsync inherit their loader's quota
+    // and capabilities and count against the script that began the chain
+    uint32_t origin = 0;
+    uint32_t spawnedScripts = 0;
+
+    size_t memoryUsed = 0;
+    uint64_t instructionsUsed = 0;
+    bool overQuota = false;
+    bool terminated = false;
+};
+
+// Completion of asynchronous engine work that scripts await (see
+// Engine.async). Native code may resolve it from any thread; only the first
+// Resolve or Fail counts.
+class ScriptTask {
+public:
+    using Value = std::variant<std::monostate, bool, double, std::string>;
+
+    void Resolve(Value value = {});
+    void Fail(std::string error);
+
+    bool IsDone() const { return m_done.load(std::memory_order_acquire); }
+
+    // Valid once IsDone
+    bool Failed() const { return m_failed; }
+    const Value& GetValue() const { return m_value; }
+    const std::string& GetError() const { return m_error; }
+
+private:
+    std::atomic<bool> m_claimed{false};
+    std::atomic<bool> m_done{false};
+    bool m_failed = false;
+    Value m_value;
+    std::string m_error;
+};
+
 class LuaManager {
 public:
     LuaManager();
     ~LuaManager();
-    
+
     bool Initialize(Engine* engine);
     void Shutdown();
-    
+
     // Script execution
     bool LoadScript(const std::string& filename);
+    bool LoadScript(const std::string& filename, const ScriptQuota& quota, const ScriptCapabilities& capabilities = {});
     bool ExecuteString(const std::string& code);
-    
+
     // Engine bindings
     void RegisterEngineAPI();
     void RegisterLightingAPI();
     void RegisterSceneAPI();
-    
-    // Callbacks
+
+    // Callbacks. CallUpdate first resumes the coroutines whose awaited
+    // tasks completed, then runs every script's update().
     void SetUpdateCallback(std::function<void(float)> callback);
     void CallUpdate(float deltaTime);
-    
+
     sol::state& GetLuaState() { return m_lua; }
-    
+
+    // Sandbox inspection
+    const std::vector<std::unique_ptr<ScriptSandbox>>& GetScripts() const { return m_scripts; }
+    size_t GetTotalMemory() const { return m_totalMemory; }
+
+    // The script clock, then each script's globals and the upvalues of the
+    // functions it defines, in load order. Restoring matches scripts by
+    // position and name and skips ones that were terminated or are not
+    // loaded. Pending Engine.async work is not part of a snapshot; it keeps
+    // running, with timers keeping their remaining delay.
+    void WriteSnapshot(SnapshotWriter& out);
+    void ReadSnapshot(SnapshotReader& in);
+
+    // Coroutines, timers or script loads that have not finished yet
+    bool HasPendingAsync() const;
+    // Fails every pending task with `reason` and drops the coroutines
+    // waiting on them
+    void CancelAsync(const std::string& reason);
+
+    // Seeds math.random, which every script shares, so a replayed session
+    // draws the same numbers as the recorded one
+    void SeedRandom(uint32_t seed);
+
 private:
+    // Sandboxed scripts, in load order. Declared before m_lua because the
+    // allocator reads them while the state is being created and closed.
+    std::vector<std::unique_ptr<ScriptSandbox>> m_scripts;
+    ScriptSandbox* m_activeSandbox = nullptr;
+    uint32_t m_activeSandboxIndex = 0;
+    size_t m_totalMemory = 0;
+
     sol::state m_lua;
     Engine* m_engine = nullptr;
-    
+#ifdef ENGINE_LUAJIT
+    ScriptFFIApi m_ffiApi{}; // LightFFI holds a pointer to it
+#endif
+    sol::function m_sandboxGetmetatable; // See SANDBOX_PRELUDE
+    sol::function m_readOnlyProxy;
+
+    // Coroutines started by Engine.async, each suspended on one task.
+    // Declared after m_lua so their references are released before it closes.
+    struct ScriptCoroutine {
+        sol::thread thread;
+        sol::coroutine function;
+        uint32_t owner = 0;                     // Sandbox index, 0 for engine code
+        std::shared_ptr<ScriptTask> awaiting;   // Null once the function returned or failed
+        std::shared_ptr<ScriptTask> completion; // Resolved with the function's first return value
+    };
+
+    // Engine.wait and Engine.nextFrame: resolved once both the script clock
+    // and the update count reach the given values
+    struct ScriptTimer {
+        double time = 0.0;
+        uint64_t frame = 0;
+        std::shared_ptr<ScriptTask> task;
+    };
+
+    // Main-thread follow-up of background work, run once `after` completes
+    // and then settling `task`, the one scripts await. While a session is
+    // recorded or replayed, updates wait for `job` so the follow-up runs on
+    // the same update in both.
+    struct ScriptContinuation {
+        std::shared_ptr<ScriptTask> after;
+        JobHandle job;
+        std::shared_ptr<ScriptTask> task;
+        std::function<void()> run;
+    };
+
+    std::vector<std::unique_ptr<ScriptCoroutine>> m_coroutines;
+    std::vector<ScriptTimer> m_timers;
+    std::vector<ScriptContinuation> m_continuations;
+    double m_scriptTime = 0.0;  // Sum of update deltas, so waits follow simulated time
+    uint64_t m_scriptFrame = 0; // Updates so far
+
     std::function<void(float)> m_updateCallback;
-    
+
     // Helper functions for type conversion
     void RegisterMathTypes();
+    void RegisterBufferTypes();
     void RegisterUtilityFunctions();
-};
\ No newline at end of file
+    void RegisterComponentViews();
+    void RegisterAsyncAPI();
+    void RegisterFFIBindings();
+    void RegisterSnapshotAPI();
+    void RegisterReplayAPI();
+
+    // Async scheduling
+    std::shared_ptr<ScriptTask> StartCoroutine(const sol::function& function);
+    sol::protected_function_result StepCoroutine(ScriptCoroutine& coroutine, const ScriptTask* resumeWith);
+    std::shared_ptr<ScriptTask> CreateTimer(double delay);
+    std::shared_ptr<ScriptTask> LoadScriptAsync(const std::string& filename);
+    void UpdateAsync(float deltaTime);
+
+    // Sandboxing
+    sol::environment CreateSandboxEnvironment();
+    bool RunSandboxed(ScriptSandbox& sandbox, const std::function<sol::protected_function_result()>& body);
+    void TerminateScript(ScriptSandbox& sandbox, const std::string& reason);
+    ScriptSandbox& CreateScript(const std::string& name, const ScriptQuota& quota);
+    sol::protected_function_result RunLoadedChunk(ScriptSandbox& script, int loadStatus);
+    bool HasCapability(bool ScriptCapabilities::* capability, const char* function) const;
+
+    struct alignas(std::max_align_t) AllocationHeader {
+        uint32_t owner;
+    };
+
+    ScriptSandbox* GetSandboxByIndex(uint32_t index);
+    static void* Allocate(void* userData, void* ptr, size_t oldSize, size_t newSize);
+    static void InstructionHook(lua_State* L, lua_Debug* ar);
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "VulkanRendererHelpers.h"
+
+// Index of an image declared in the current frame's graph
+using RenderResource = uint32_t;
+constexpr RenderResource INVALID_RENDER_RESOURCE = 0xFFFFFFFFu;
+
+// How a pass uses an image. Each access implies a layout, the pipeline
+// stages and memory accesses involved, and the image usage it needs.
+enum class RenderAccess {
+    ColorAttachment,     // Rendered to (declared with WriteColor)
+    DepthAttachment,     // Depth tested and written (WriteDepth)
+    DepthReadOnly,       // Depth tested without writes (ReadDepth)
+    SampledFragment,     // Sampled in fragment shaders
+    SampledCompute,      // Sampled in compute shaders
+    StorageCompute,      // Read and written as a storage image in compute shaders
+    TransferSource,
+    TransferDestination
+};
+
+// Transient image owned by the graph. Only the extent and format are
+// chosen by the caller; usage follows from how the passes access it.
+struct RenderImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {0, 0};
+    VkImageUsageFlags extraUsage = 0;
+};
+
+// Where an imported image stands when the graph starts, so the first
+// barrier waits for the right work (e.g. the acquire semaphore's stage)
+struct RenderImageState {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkAccessFlags access = 0;
+};
+
+class RenderGraph;
+
+// Handed to a pass's setup callback to declare what it reads and writes.
+// Attachments are bound with dynamic rendering in declaration order.
+class RenderPassBuilder {
+public:
+    void WriteColor(RenderResource image, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                    VkClearColorValue clear = {});
+    void WriteDepth(RenderResource image, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                    float clearDepth = 1.0f);
+    void ReadDepth(RenderResource image);
+
+    // Non-attachment accesses, e.g. sampling another pass's output
+    void Read(RenderResource image, RenderAccess access);
+    void Write(RenderResource image, RenderAccess access);
+
+    // Keeps the pass even if nothing reads what it writes
+    void SetSideEffect();
+
+private:
+    friend class RenderGraph;
+    RenderPassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+    RenderGraph& m_graph;
+    uint32_t m_pass;
+};
+
+// Frame graph rebuilt every frame: passes declare the images they touch and
+// the graph
+//  - drops passes whose output nothing consumes,
+//  - records the layout transitions and barriers between passes, merged per
+//    pass and no stronger than the declared accesses need,
+//  - picks attachment store ops (an attachment nobody reads afterwards is
+//    never written back),
+//  - places transient images with disjoint lifetimes in the same memory.
+//
+// Transient images and their memory survive from frame to frame while the
+// graph's shape stays the same, so a steady frame allocates nothing. Buffers
+// are host-coherent or synchronized by their owners and are not tracked.
+class RenderGraph {
+public:
+    RenderGraph() = default;
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Loads the dynamic rendering entry points; requires VK_KHR_dynamic_rendering
+    void Initialize(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue);
+    void Destroy(); // Only after vkDeviceWaitIdle
+
+    // Starts declaring a new frame
+    void Reset();
+
+    // Images owned elsewhere (swap chain, shadow atlas). Writing one keeps
+    // the writer alive. The image ends the frame in finalLayout.
+    RenderResource ImportImage(const char* name, VkImage image, VkImageView view, VkFormat format,
+                               VkExtent2D extent, const RenderImageState& initial, VkImageLayout finalLayout);
+    RenderResource CreateImage(const char* name, const RenderImageDesc& desc);
+
+    // setup runs immediately; execute runs from Execute with the pass's
+    // attachments bound and the viewport and scissor covering them. name
+    // must outlive the frame (a string literal).
+    void AddPass(const char* name, const std::function<void(RenderPassBuilder&)>& setup,
+                 std::function<void(VkCommandBuffer)> execute);
+
+    // Culls passes and places transient images
+    void Compile();
+    void Execute(VkCommandBuffer commandBuffer);
+
+    // Valid once compiled, e.g. from a pass's execute callback
+    VkImage GetImage(RenderResource resource) const;
+    VkImageView GetImageView(RenderResource resource) const;
+    VkImageView GetSampledView(RenderResource resource) const; // Depth aspect only for depth/stencil formats
+    VkExtent2D GetExtent(RenderResource resource) const { return m_resources[resource].extent; }
+
+    // Statistics of the last compiled frame
+    uint32_t GetPassCount() const { return m_passCount; }
+    uint32_t GetCulledPassCount() const { return m_culledPassCount; }
+    VkDeviceSize GetTransientMemoryBytes() const { return m_transientMemoryBytes; }
+    VkDeviceSize GetTransientImageBytes() const { return m_transientImageBytes; } // Before aliasing
+
+private:
+    friend class RenderPassBuilder;
+
+    struct Resource {
+        const char* name = nullptr;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {0, 0};
+        VkImageAspectFlags aspect = 0;
+        bool imported = false;
+
+        // Imported images
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        RenderImageState initial;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        // Transient images
+        VkImageUsageFlags usage = 0;
+        uint32_t physical = 0xFFFFFFFFu;
+
+        // Alive passes touching the image, set by Compile
+        uint32_t firstPass = 0xFFFFFFFFu;
+        uint32_t lastPass = 0;
+    };
+
+    struct Access {
+        RenderResource resource;
+        RenderAccess access;
+        bool write;
+    };
+
+    struct Attachment {
+        RenderResource resource = INVALID_RENDER_RESOURCE;
+        VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        VkClearValue clear{};
+        bool readOnly = false;
+    };
+
+    struct Pass {
+        const char* name = nullptr;
+        std::function<void(VkCommandBuffer)> execute;
+        std::vector<Access> accesses;
+        std::vector<Attachment> colorAttachments;
+        Attachment depthAttachment;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    // A transient image and the memory block it is bound to
+    struct PhysicalImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageView sampledView = VK_NULL_HANDLE; // Only for sampled depth/stencil images
+        uint32_t block = 0;
+    };
+
+    // Memory shared by transient images with disjoint lifetimes. The last
+    // access is kept across frames: the next frame's first user must wait
+    // for it, since frames in flight share the block.
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        std::vector<std::pair<uint32_t, uint32_t>> lifetimes; // [first, last] pass of each occupant
+        VkPipelineStageFlags lastStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags lastAccess = 0;
+    };
+
+    // Tracked while recording
+    struct ImageState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags access = 0;
+    };
+
+    void AddAccess(uint32_t pass, RenderResource resource, RenderAccess access, bool write);
+    void CullPasses();
+    uint64_t TransientSignature() const;
+    void AllocateTransients();
+    void ReleaseTransients();
+    void RecordBarriers(VkCommandBuffer commandBuffer, uint32_t passIndex);
+    void BeginRendering(VkCommandBuffer commandBuffer, uint32_t passIndex);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    DeletionQueue* m_deletionQueue = nullptr;
+    PFN_vkCmdBeginRenderingKHR m_cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR m_cmdEndRendering = nullptr;
+
+    // Declared this frame. Passes beyond m_passCount are kept for the
+    // capacity of their vectors.
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    uint32_t m_passCount = 0;
+    uint32_t m_culledPassCount = 0;
+    bool m_compiled = false;
+
+    // Transient images, rebuilt only when the signature changes
+    std::vector<PhysicalImage> m_physicalImages;
+    std::vector<MemoryBlock> m_blocks;
+    uint64_t m_transientSignature = 0;
+    VkDeviceSize m_transientMemoryBytes = 0;
+    VkDeviceSize m_transientImageBytes = 0;
+
+    // Recording scratch
+    std::vector<ImageState> m_states;
+    std::vector<ImageState> m_blockStates; // Latest occupant of each block
+    std::vector<bool> m_needed;
+    std::vector<VkImageMemoryBarrier> m_barriers;
+    std::vector<VkRenderingAttachmentInfoKHR> m_colorInfos;
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// =============================================================================
+// SESSION RECORDING
+// =============================================================================
+
+enum class ReplayMode {
+    Off,
+    Recording,
+    Playback
+};
+
+enum class ReplaySpeed {
+    Recorded, // Each frame takes at least its recorded delta, like the original session
+    Maximum   // Frames run back to back
+};
+
+// Everything about a frame the simulation reads from outside
+struct ReplayFrame {
+    float deltaTime = 0.0f;
+    uint32_t width = 0;  // Framebuffer size, which sets the camera aspect ratio
+    uint32_t height = 0;
+};
+
+struct ReplayKeyEvent {
+    int32_t key = 0;
+    int32_t action = 0;
+    int32_t mods = 0;
+};
+
+// Logs what makes a session non-deterministic (frame deltas, framebuffer
+// size, key events and values scripts read from clocks and counters) so a
+// later run can feed the same inputs back and reproduce the session frame
+// for frame. A log starts with a snapshot of the state recording began
+// from (lights and their animations, script globals and the script clock)
+// and the random seed scripts were given. Suspended Engine.async coroutines
+// cannot be snapshotted, so the engine only starts recording when none are
+// pending.
+//
+// During playback the log drives the frames; every Sample must line up
+// with a logged value, and the first mismatch ends playback as diverged.
+// Playback times each frame and, when it ends, prints a summary and writes
+// the per-frame timings to <log>.timings.csv.
+class ReplaySession {
+public:
+    ReplaySession();
+    ~ReplaySession();
+
+    ReplaySession(const ReplaySession&) = delete;
+    ReplaySession& operator=(const ReplaySession&) = delete;
+
+    ReplayMode GetMode() const { return m_mode; }
+    uint64_t GetFrame() const { return m_frame; } // Frames recorded or played so far
+
+    // Recording
+    bool StartRecording(const std::string& path, std::span<const std::byte> snapshot, uint32_t seed);
+    void RecordKey(const ReplayKeyEvent& event);
+    void RecordFrame(const ReplayFrame& frame);
+
+    // Playback. GetStartSnapshot and GetSeed describe the state to restore
+    // before the first frame.
+    bool StartPlayback(const std::string& path, ReplaySpeed speed);
+    std::span<const std::byte> GetStartSnapshot() const { return m_startSnapshot; }
+    uint32_t GetSeed() const { return m_seed; }
+
+    // Returns the next frame and the key events logged before it, waiting
+    // for the recorded delta at ReplaySpeed::Recorded. False once playback
+    // has ended, whether at the end of the log or by diverging.
+    bool NextFrame(ReplayFrame& frame, std::vector<ReplayKeyEvent>& keys);
+    void ReportFrameTiming(float updateMs, float renderMs);
+
+    // A value read from outside the simulation: logged and returned while
+    // recording, replaced by the logged value during playback
+    double Sample(double live);
+
+    // Finishes the log, or ends playback and reports its timings
+    void Stop();
+
+private:
+    struct FrameTiming {
+        float deltaTime;
+        float updateMs;
+        float renderMs;
+        float frameMs;
+    };
+
+    void EndPlayback(const char* reason);
+    void WriteTimingReport();
+
+    template<typename T>
+    void WriteRecord(const T& value) {
+        m_file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadRecord(T& value);
+
+    ReplayMode m_mode = ReplayMode::Off;
+    ReplaySpeed m_speed = ReplaySpeed::Recorded;
+    std::string m_path;
+    uint64_t m_frame = 0;
+    uint32_t m_seed = 0;
+
+    // Recording
+    std::ofstream m_file;
+
+    // Playback reads the log in place from a memory mapping
+    std::unique_ptr<MappedFile> m_log;
+    size_t m_offset = 0;
+    std::span<const std::byte> m_startSnapshot;
+    std::chrono::steady_clock::time_point m_lastFrameStart;
+    ReplayFrame m_currentFrame;
+    std::vector<FrameTiming> m_timings;
+};
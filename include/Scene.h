@@ -0,0 +1,125 @@
+#pragma once
+#include "ECS.h"
+#include "Geometry.h"
+#include "BVH.h"
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Transform {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotation = glm::vec3(0.0f); // Euler angles in degrees
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Box extents of a spatially indexed entity, centered on its Transform.
+// Add and remove it through Scene so the BVH proxy stays in sync.
+struct Bounds {
+    glm::vec3 halfExtents = glm::vec3(0.5f);
+    int32_t proxy = BVH::NULL_NODE;
+    AABB indexed; // World bounds as of the last index sync
+};
+
+struct RayHit {
+    Entity entity = NULL_ENTITY;
+    float distance = 0.0f;
+};
+
+enum class CameraProjection : int {
+    Perspective = 0,
+    Orthographic = 1
+};
+
+// Camera component. Matrices and frustum planes are cached and only rebuilt
+// by Scene::Update when a setter has marked them dirty.
+struct Camera {
+    glm::vec3 position = glm::vec3(0.0f, 3.0f, 8.0f);
+    glm::vec3 target = glm::vec3(0.0f);
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    CameraProjection projectionType = CameraProjection::Perspective;
+    float fov = 60.0f;          // Vertical field of view in degrees
+    float orthoHeight = 10.0f;  // View height for orthographic cameras
+    float aspectRatio = 16.0f / 9.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    // Normalized sub-rectangle of the render target (x, y, width, height)
+    glm::vec4 viewport = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Cached results
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    Frustum frustum;
+
+    bool viewDirty = true;
+    bool projectionDirty = true;
+    uint32_t version = 0; // Incremented whenever the cached matrices change
+};
+
+class Scene {
+public:
+    Scene();
+    ~Scene();
+
+    void Update(float deltaTime);
+
+    // Entity management
+    Entity CreateEntity();
+    Entity CreateEntity(const glm::vec3& position);
+    void DestroyEntity(Entity entity);
+    bool IsValid(Entity entity) const { return m_registry.Valid(entity); }
+
+    // Cameras
+    Entity CreateCamera();
+    void SetActiveCamera(Entity camera);
+    Entity GetActiveCamera() const { return m_activeCamera; }
+    Camera* GetCamera(Entity camera) { return m_registry.TryGet<Camera>(camera); }
+    Camera* GetActiveCameraComponent() { return GetCamera(m_activeCamera); }
+
+    void SetCameraPosition(Entity camera, const glm::vec3& position);
+    void SetCameraTarget(Entity camera, const glm::vec3& target);
+    void SetCameraPerspective(Entity camera, float fov, float nearPlane, float farPlane);
+    void SetCameraOrthographic(Entity camera, float height, float nearPlane, float farPlane);
+    void SetCameraViewport(Entity camera, const glm::vec4& viewport);
+
+    // Aspect ratio of the render target; cameras derive theirs from it and
+    // their viewport rectangle
+    void SetTargetAspectRatio(float aspectRatio);
+
+    // Transform shortcuts
+    void SetPosition(Entity entity, const glm::vec3& position);
+    glm::vec3 GetPosition(Entity entity);
+
+    // Spatial index
+    void SetBounds(Entity entity, const glm::vec3& halfExtents);
+    void ClearBounds(Entity entity);
+    AABB GetWorldBounds(Entity entity);
+
+    // Old and new world bounds of every indexed entity that appeared, moved
+    // or disappeared since the last ClearChangedBounds. Cached shadow maps
+    // use these to find the tiles that must be redrawn.
+    const std::vector<AABB>& GetChangedBounds() const { return m_changedBounds; }
+    void ClearChangedBounds() { m_changedBounds.clear(); }
+
+    std::optional<RayHit> Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+    void QuerySphere(const glm::vec3& center, float radius, std::pmr::vector<Entity>& results); // Scripts pass the frame arena
+    void QueryFrustum(const Frustum& frustum, std::vector<Entity>& results);
+
+    Registry& GetRegistry() { return m_registry; }
+
+private:
+    void UpdateCameras();
+    void SyncSpatialIndex();
+
+    Registry m_registry;
+    Entity m_activeCamera = NULL_ENTITY;
+    float m_targetAspectRatio = 16.0f / 9.0f;
+
+    BVH m_spatialIndex;
+    bool m_spatialDirty = false;
+    std::vector<AABB> m_changedBounds;
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <glm/glm.hpp>
+
+// =============================================================================
+// SCRIPT BUFFERS
+// =============================================================================
+
+// Allocation function with lua_Alloc's contract (nsize 0 frees). Scripts'
+// buffers are allocated through the Lua state's allocator so they count
+// against the owning script's memory quota.
+struct BufferAllocator {
+    void* (*allocate)(void* userData, void* ptr, size_t oldSize, size_t newSize) = nullptr;
+    void* userData = nullptr;
+};
+
+// Zero-initialized float storage shared by the buffers viewing it
+class FloatStorage {
+public:
+    // Throws std::bad_alloc when the allocator refuses (e.g. over quota)
+    FloatStorage(size_t count, const BufferAllocator& allocator);
+    ~FloatStorage();
+
+    FloatStorage(const FloatStorage&) = delete;
+    FloatStorage& operator=(const FloatStorage&) = delete;
+
+    float* Data() { return m_data; }
+    size_t Size() const { return m_count; }
+
+private:
+    float* m_data = nullptr;
+    size_t m_count = 0;
+    BufferAllocator m_allocator;
+};
+
+// Contiguous floats for bulk numeric work in scripts. Copies share storage,
+// so a buffer obtained from a Vec3Array component writes through to it.
+class FloatBuffer {
+public:
+    FloatBuffer(size_t size, const BufferAllocator& allocator);
+    FloatBuffer(std::shared_ptr<FloatStorage> storage, size_t offset, size_t size);
+
+    size_t Size() const { return m_size; }
+    float* Data() const { return m_data; }
+    std::span<float> Span() const { return {m_data, m_size}; }
+
+    // Range checked; throws std::out_of_range
+    float Get(size_t index) const;
+    void Set(size_t index, float value) const;
+
+private:
+    std::shared_ptr<FloatStorage> m_storage;
+    float* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// Vectors stored as three float columns (all x, then all y, then all z), so
+// every kernel runs over a component as one contiguous FloatBuffer
+class Vec3Array {
+public:
+    Vec3Array(size_t size, const BufferAllocator& allocator);
+
+    size_t Size() const { return m_size; }
+    float* X() const { return m_storage->Data(); }
+    float* Y() const { return m_storage->Data() + m_size; }
+    float* Z() const { return m_storage->Data() + 2 * m_size; }
+
+    // Views sharing this array's storage; Component takes 0, 1 or 2
+    FloatBuffer Component(uint32_t axis) const;
+    FloatBuffer Flat() const; // All 3 * Size() floats, for component-agnostic kernels
+
+    glm::vec3 Get(size_t index) const; // Range checked; throws std::out_of_range
+    void Set(size_t index, const glm::vec3& value) const;
+
+private:
+    std::shared_ptr<FloatStorage> m_storage;
+    size_t m_size = 0;
+};
+
+// =============================================================================
+// KERNELS
+// =============================================================================
+
+// Straight loops over float arrays that compile to packed SIMD; in-place
+// operands may alias their sources
+namespace FloatKernels {
+    void Fill(float* out, size_t count, float value);
+    void Scale(float* out, size_t count, float scale);
+    void Offset(float* out, size_t count, float offset);
+    void Axpy(float* y, const float* x, size_t count, float a);         // y += a * x
+    void Lerp(float* out, const float* target, size_t count, float t);  // out += (target - out) * t
+    void Clamp(float* out, size_t count, float minimum, float maximum);
+
+    // out[i] = amplitude * sin(start + i * step)
+    void FillSin(float* out, size_t count, float start, float step, float amplitude);
+
+    // out[i] = amplitude * sin(angles[i] * frequency + phase)
+    void Sin(float* out, const float* angles, size_t count, float amplitude, float frequency, float phase);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+
+class LightingSystem;
+
+// =============================================================================
+// SCRIPT FFI
+// =============================================================================
+
+// Plain-C view of the lighting system for LuaJIT's FFI. Calls through these
+// function pointers are compiled into traces, so script loops driving many
+// lights skip sol2's argument checking and userdata dispatch entirely.
+//
+// The layouts below are mirrored by ScriptFFI::CDEF; change both together.
+
+struct ScriptVec3 {
+    float x, y, z;
+};
+
+// Snapshot of a Light's script-visible fields
+struct ScriptLightState {
+    int32_t type; // LightType; read-only, setLightState ignores it
+    ScriptVec3 position;
+    ScriptVec3 direction;
+    ScriptVec3 color;
+    float intensity;
+    float range;
+    float innerCone;
+    float outerCone;
+    bool enabled;
+    bool castShadows;
+};
+
+// Invalid light ids are ignored, like the LightingSystem setters; getLightState
+// returns 0 for them and leaves the state untouched
+struct ScriptFFIApi {
+    LightingSystem* lighting;
+    void (*setLightPosition)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightDirection)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightColor)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightIntensity)(LightingSystem*, int32_t, float);
+    void (*setLightRange)(LightingSystem*, int32_t, float);
+    void (*setLightCone)(LightingSystem*, int32_t, float, float);
+    void (*setLightEnabled)(LightingSystem*, int32_t, bool);
+    int32_t (*getLightState)(LightingSystem*, int32_t, ScriptLightState*);
+    void (*setLightState)(LightingSystem*, int32_t, const ScriptLightState*);
+};
+
+namespace ScriptFFI {
+    ScriptFFIApi MakeApi(LightingSystem& lighting);
+
+    // Shared by the FFI entry points and the Lua 5.4 fallback bindings
+    bool ReadLightState(LightingSystem& lighting, int32_t lightId, ScriptLightState& state);
+    void ApplyLightState(LightingSystem& lighting, int32_t lightId, const ScriptLightState& state);
+
+    // C declarations of the structs above, for ffi.cdef
+    extern const char* const CDEF;
+
+    // Lua chunk called with (ffi, cdef, api) that returns the LightFFI table;
+    // api is a light userdata pointing at a ScriptFFIApi
+    extern const char* const PRELUDE;
+}
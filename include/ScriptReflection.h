@@ -0,0 +1,316 @@
+#pragma once
+#include <sol/sol.hpp>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// =============================================================================
+// REFLECTED SCRIPT BINDINGS
+// =============================================================================
+
+// Native systems describe what scripts may call once, as constexpr lists of
+// fields and methods in a Reflect<System> specialization:
+//
+//   template<> struct ScriptReflection::Reflect<LightingSystem> {
+//       using Component = Light;
+//       static Light* Find(LightingSystem& system, int id);
+//       static constexpr auto fields = std::make_tuple(
+//           Field<&Light::color, &LightingSystem::SetLightColor>{"color"});
+//       static constexpr auto methods = std::make_tuple(
+//           Method<&LightingSystem::RemoveLight>{"remove"});
+//   };
+//
+// Bind then adds getColor(id), setColor(id, value) and remove(id) to a
+// table. Each binding is a plain lua_CFunction instantiated for its member
+// pointer, holding only the system pointer as an upvalue, so calls go
+// straight to the member function without std::function or sol's dynamic
+// dispatch. Mismatched setters, foreign members and duplicate names are
+// compile errors.
+//
+// Argument types are checked when ENGINE_SCRIPT_ARG_CHECKS is defined (Debug
+// builds). Otherwise numbers and booleans are read unchecked, which Lua
+// converts safely; userdata arguments are checked in every build, since an
+// unchecked read of the wrong userdata reads arbitrary memory.
+namespace ScriptReflection {
+
+    template<typename T>
+    struct MemberPointer;
+
+    template<typename C, typename T>
+    struct MemberPointer<T C::*> {
+        using Class = C;
+        using Type = T;
+    };
+
+    template<typename F>
+    struct MemberFunction;
+
+    template<typename R, typename C, typename... A>
+    struct MemberFunction<R (C::*)(A...)> {
+        using Class = C;
+        using Result = R;
+        using Arguments = std::tuple<std::remove_cvref_t<A>...>;
+    };
+
+    template<typename R, typename C, typename... A>
+    struct MemberFunction<R (C::*)(A...) const> : MemberFunction<R (C::*)(A...)> {};
+
+    namespace Detail {
+        template<typename Type, auto Setter>
+        constexpr bool SetterMatches() {
+            if constexpr (std::is_null_pointer_v<decltype(Setter)>) {
+                return true;
+            } else {
+                using Arguments = typename MemberFunction<decltype(Setter)>::Arguments;
+                return std::is_same_v<Arguments, std::tuple<int, Type>>;
+            }
+        }
+    }
+
+    // A member function bound as `name(...)`
+    template<auto Function>
+    struct Method {
+        using Traits = MemberFunction<decltype(Function)>;
+        const char* name;
+    };
+
+    // A component field bound as get<Name>(id), and as set<Name>(id, value)
+    // when a setter is given. Setters are system methods so they keep the
+    // system's invariants (clamping, spatial index updates).
+    template<auto Member, auto Setter = nullptr>
+    struct Field {
+        using Traits = MemberPointer<decltype(Member)>;
+        static constexpr bool SETTABLE = !std::is_null_pointer_v<decltype(Setter)>;
+        static_assert(Detail::SetterMatches<typename Traits::Type, Setter>(), "Field setter must take (int id, field type)");
+
+        const char* name;
+    };
+
+    // Specialized per bound system
+    template<typename System>
+    struct Reflect;
+
+    namespace Detail {
+        template<typename System>
+        constexpr auto Fields() {
+            if constexpr (requires { Reflect<System>::fields; }) {
+                return Reflect<System>::fields;
+            } else {
+                return std::tuple<>{};
+            }
+        }
+
+        template<typename System>
+        constexpr auto Methods() {
+            if constexpr (requires { Reflect<System>::methods; }) {
+                return Reflect<System>::methods;
+            } else {
+                return std::tuple<>{};
+            }
+        }
+
+        // `accessor` is prefix + name with the name's first letter raised
+        constexpr bool IsAccessor(std::string_view accessor, std::string_view prefix, std::string_view name) {
+            if (name.empty() || accessor.size() != prefix.size() + name.size() || !accessor.starts_with(prefix)) {
+                return false;
+            }
+            char first = name[0] >= 'a' && name[0] <= 'z' ? static_cast<char>(name[0] - 'a' + 'A') : name[0];
+            return accessor[prefix.size()] == first && accessor.substr(prefix.size() + 1) == name.substr(1);
+        }
+
+        template<typename System>
+        constexpr bool NamesAreUnique() {
+            constexpr auto fields = Fields<System>();
+            constexpr auto methods = Methods<System>();
+            auto fieldNames = std::apply([](auto... field) {
+                return std::array<std::string_view, sizeof...(field)>{field.name...};
+            }, fields);
+            auto methodNames = std::apply([](auto... method) {
+                return std::array<std::string_view, sizeof...(method)>{method.name...};
+            }, methods);
+
+            for (size_t i = 0; i < fieldNames.size(); i++) {
+                if (fieldNames[i].empty()) return false;
+                for (size_t j = i + 1; j < fieldNames.size(); j++) {
+                    if (fieldNames[i] == fieldNames[j]) return false;
+                }
+                for (std::string_view method : methodNames) {
+                    if (IsAccessor(method, "get", fieldNames[i]) || IsAccessor(method, "set", fieldNames[i])) return false;
+                }
+            }
+            for (size_t i = 0; i < methodNames.size(); i++) {
+                if (methodNames[i].empty()) return false;
+                for (size_t j = i + 1; j < methodNames.size(); j++) {
+                    if (methodNames[i] == methodNames[j]) return false;
+                }
+            }
+            return true;
+        }
+
+        template<typename T>
+        bool CheckArgument(lua_State* L, int index) {
+#ifndef ENGINE_SCRIPT_ARG_CHECKS
+            if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+                return true;
+            }
+#endif
+            return sol::stack::check<T>(L, index);
+        }
+
+        template<typename T>
+        constexpr const char* ExpectedName() {
+            if constexpr (std::is_same_v<T, bool>) {
+                return "boolean";
+            } else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+                return "number";
+            } else {
+                return "userdata";
+            }
+        }
+
+        // Index of the first argument of the wrong type, or 0. Raising the
+        // error is left to the caller so no C++ frame is unwound by longjmp.
+        template<typename... A, size_t... I>
+        int FindBadArgument(lua_State* L, std::tuple<A...>*, std::index_sequence<I...>) {
+            int bad = 0;
+            ((bad == 0 && !CheckArgument<A>(L, static_cast<int>(I) + 1) ? (bad = static_cast<int>(I) + 1) : 0), ...);
+            return bad;
+        }
+
+        template<typename... A, size_t... I>
+        const char* ExpectedAt(int index, std::tuple<A...>*, std::index_sequence<I...>) {
+            const char* expected = "value";
+            ((index == static_cast<int>(I) + 1 ? (expected = ExpectedName<A>()) : nullptr), ...);
+            return expected;
+        }
+
+        template<typename Arguments>
+        int CheckArguments(lua_State* L) {
+            constexpr size_t COUNT = std::tuple_size_v<Arguments>;
+            int bad = FindBadArgument(L, static_cast<Arguments*>(nullptr), std::make_index_sequence<COUNT>{});
+            if (bad == 0) {
+                return 0;
+            }
+            const char* expected = ExpectedAt(bad, static_cast<Arguments*>(nullptr), std::make_index_sequence<COUNT>{});
+            lua_pushfstring(L, "%s expected, got %s", expected, luaL_typename(L, bad));
+            return bad;
+        }
+
+        template<auto Function, typename... A, size_t... I>
+        int Invoke(lua_State* L, std::tuple<A...>*, std::index_sequence<I...>) {
+            using Traits = MemberFunction<decltype(Function)>;
+            auto* self = static_cast<typename Traits::Class*>(lua_touserdata(L, lua_upvalueindex(1)));
+            if constexpr (std::is_void_v<typename Traits::Result>) {
+                (self->*Function)(sol::stack::get<A>(L, static_cast<int>(I) + 1)...);
+                return 0;
+            } else {
+                return sol::stack::push(L, (self->*Function)(sol::stack::get<A>(L, static_cast<int>(I) + 1)...));
+            }
+        }
+
+        template<auto Function>
+        int Call(lua_State* L) {
+            using Arguments = typename MemberFunction<decltype(Function)>::Arguments;
+            if (int bad = CheckArguments<Arguments>(L)) {
+                return luaL_argerror(L, bad, lua_tostring(L, -1));
+            }
+            try {
+                return Invoke<Function>(L, static_cast<Arguments*>(nullptr),
+                                        std::make_index_sequence<std::tuple_size_v<Arguments>>{});
+            }
+            catch (const std::exception& e) {
+                lua_pushstring(L, e.what());
+            }
+            return lua_error(L);
+        }
+
+        // nil when no component has the id
+        template<typename System, auto Member>
+        int GetField(lua_State* L) {
+            if (CheckArguments<std::tuple<int>>(L)) {
+                return luaL_argerror(L, 1, lua_tostring(L, -1));
+            }
+            auto* system = static_cast<System*>(lua_touserdata(L, lua_upvalueindex(1)));
+            auto* component = Reflect<System>::Find(*system, sol::stack::get<int>(L, 1));
+            if (!component) {
+                lua_pushnil(L);
+                return 1;
+            }
+            return sol::stack::push(L, component->*Member);
+        }
+
+        inline std::string AccessorName(const char* prefix, const char* name) {
+            std::string accessor = std::string(prefix) + name;
+            accessor[std::strlen(prefix)] = static_cast<char>(std::toupper(static_cast<unsigned char>(name[0])));
+            return accessor;
+        }
+
+        template<typename System>
+        void SetClosure(lua_State* L, int table, const std::string& name, lua_CFunction function, System* system) {
+            lua_pushlightuserdata(L, system);
+            lua_pushcclosure(L, function, 1);
+            lua_setfield(L, table, name.c_str());
+        }
+
+        template<typename System, auto Member, auto Setter>
+        void BindField(lua_State* L, int table, System* system, const Field<Member, Setter>& field) {
+            static_assert(std::is_same_v<typename Field<Member, Setter>::Traits::Class, typename Reflect<System>::Component>,
+                          "Field does not belong to the system's component");
+            SetClosure(L, table, AccessorName("get", field.name), &GetField<System, Member>, system);
+            if constexpr (Field<Member, Setter>::SETTABLE) {
+                static_assert(std::is_same_v<typename MemberFunction<decltype(Setter)>::Class, System>,
+                              "Field setter is not a method of the system");
+                SetClosure(L, table, AccessorName("set", field.name), &Call<Setter>, system);
+            }
+        }
+
+        template<typename System, auto Function>
+        void BindMethod(lua_State* L, int table, System* system, const Method<Function>& method) {
+            static_assert(std::is_same_v<typename Method<Function>::Traits::Class, System>,
+                          "Method is not a member of the system");
+            SetClosure(L, table, method.name, &Call<Function>, system);
+        }
+
+        template<typename System, auto Member, auto Setter>
+        void ApplyField(System& system, int id, const sol::table& config, const Field<Member, Setter>& field) {
+            if constexpr (Field<Member, Setter>::SETTABLE) {
+                if (sol::optional<typename Field<Member, Setter>::Traits::Type> value = config[field.name]) {
+                    (system.*Setter)(id, *value);
+                }
+            }
+        }
+    }
+
+    // Adds the described fields and methods of `system` to `table`. The
+    // system must outlive the Lua state.
+    template<typename System>
+    void Bind(sol::table& table, System& system) {
+        static_assert(Detail::NamesAreUnique<System>(), "Script binding names must be unique and non-empty");
+
+        lua_State* L = table.lua_state();
+        table.push();
+        int index = lua_gettop(L);
+        std::apply([&](const auto&... field) {
+            (Detail::BindField(L, index, &system, field), ...);
+        }, Detail::Fields<System>());
+        std::apply([&](const auto&... method) {
+            (Detail::BindMethod(L, index, &system, method), ...);
+        }, Detail::Methods<System>());
+        lua_pop(L, 1);
+    }
+
+    // Applies every settable field present in `config` through its setter,
+    // e.g. for a create(config) function
+    template<typename System>
+    void ApplyFields(System& system, int id, const sol::table& config) {
+        std::apply([&](const auto&... field) {
+            (Detail::ApplyField(system, id, config, field), ...);
+        }, Detail::Fields<System>());
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <sol/sol.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include "Snapshot.h"
+
+// =============================================================================
+// SCRIPT STATE SNAPSHOTS
+// =============================================================================
+
+// Lua values in snapshot form. Nil, booleans, numbers, strings, vec3 and
+// tables are stored by value; tables are numbered as they are first met, so
+// shared references and cycles come back as the same table. Anything that
+// cannot be recreated from bytes (functions, coroutines, other userdata and
+// the `opaque` tables, i.e. engine tables copied into sandboxes) is stored as
+// a placeholder that keeps whatever the restoring state holds there.
+//
+// Restoring writes into the tables found at the same places where possible,
+// so metatables, functions and references held by native code survive a
+// restore. Entries of those tables that are missing from the snapshot are
+// removed unless they hold a function or other non-data value.
+namespace ScriptSnapshot {
+    constexpr uint32_t MAX_DEPTH = 128; // Deeper nesting is refused rather than risking the C stack
+
+    class Writer {
+    public:
+        Writer(lua_State* L, SnapshotWriter& out, std::unordered_set<const void*> opaque);
+
+        // Writes the value at the given absolute stack index
+        void WriteValue(int index);
+
+    private:
+        void WriteValue(int index, uint32_t depth);
+        void WriteTable(int index, uint32_t depth);
+
+        lua_State* m_L;
+        SnapshotWriter& m_out;
+        std::unordered_set<const void*> m_opaque;
+        std::unordered_map<const void*, uint32_t> m_tables;
+    };
+
+    class Reader {
+    public:
+        Reader(lua_State* L, SnapshotReader& in, std::unordered_set<const void*> opaque);
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Pushes the next value. `current` is the absolute stack index of
+        // what the destination holds now, or 0 if there is none.
+        void ReadValue(int current);
+
+    private:
+        void ReadValue(int current, uint32_t depth);
+        void ReadTable(int current, uint32_t depth);
+
+        lua_State* m_L;
+        SnapshotReader& m_in;
+        std::unordered_set<const void*> m_opaque;
+        std::unordered_set<const void*> m_claimed; // Live tables already restored into
+        int m_tables = LUA_NOREF;                   // Registry ref of id -> restored table
+    };
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <filesystem>
+#include <unordered_map>
+
+class JobSystem;
+
+enum class ShaderStage : int {
+    Vertex = 0,
+    Fragment = 1,
+    Compute = 2
+};
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+// One compiled permutation of a GLSL source file
+struct ShaderVariant {
+    std::string path;                  // GLSL source, e.g. "shaders/lighting.frag"
+    ShaderStage stage = ShaderStage::Vertex;
+    std::vector<ShaderDefine> defines;
+    std::string precompiledPath;       // SPIR-V used when the engine is built without shaderc
+};
+
+// Compiles GLSL to SPIR-V at runtime and keeps the results in memory and in
+// an on-disk cache. Cache entries are keyed by a hash of the source with its
+// includes expanded, the stage and the defines, so an unchanged shader is
+// never recompiled across runs and editing any included file invalidates
+// every permutation that uses it.
+class ShaderCompiler {
+public:
+    explicit ShaderCompiler(std::filesystem::path cacheDirectory = "shader_cache");
+
+    // Returns SPIR-V for the variant; throws std::runtime_error with the
+    // compiler log when the source does not compile
+    std::vector<uint32_t> Load(const ShaderVariant& variant);
+
+    // Builds every variant as jobs on `jobs` so permutations compile in
+    // parallel; results land in the memory cache for later Load calls.
+    // Throws the first failure after all variants finish.
+    void LoadAll(const std::vector<ShaderVariant>& variants, JobSystem& jobs);
+
+    // Source files (including #include dependencies) modified since they
+    // were last loaded. Each change is reported once.
+    std::vector<std::string> PollChangedSources();
+
+    // Text that #include "name" expands to instead of a file, for GLSL
+    // generated from C++ (see GpuLayout.h). It is part of the cache key like
+    // any included file. Set before loading the shaders that use it.
+    void SetGeneratedInclude(const std::string& name, std::string source);
+
+    // Drops in-memory results so the next Load re-reads sources
+    void ClearMemoryCache();
+
+    static bool IsRuntimeCompilationAvailable();
+
+    // Compiles already expanded GLSL without touching either cache
+    static std::vector<uint32_t> CompileSource(const std::string& source, const ShaderVariant& variant);
+
+private:
+    struct ExpandedSource {
+        std::string text;
+        std::vector<std::filesystem::path> dependencies; // The file itself first
+    };
+
+    ExpandedSource ExpandIncludes(const std::filesystem::path& path) const;
+    static uint64_t HashVariant(const std::string& source, const ShaderVariant& variant);
+
+    std::filesystem::path CachePath(const ShaderVariant& variant, uint64_t key) const;
+    bool ReadCache(const std::filesystem::path& path, std::vector<uint32_t>& spirv) const;
+    void WriteCache(const std::filesystem::path& path, const std::vector<uint32_t>& spirv) const;
+    void Watch(const std::vector<std::filesystem::path>& dependencies);
+
+    std::filesystem::path m_cacheDirectory;
+
+    std::mutex m_mutex; // Guards both maps; compilation itself runs unlocked
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_memoryCache;
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_watchedFiles;
+    std::unordered_map<std::string, std::string> m_generatedIncludes; // Not guarded: set before any Load
+};
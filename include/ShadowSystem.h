@@ -0,0 +1,155 @@
+#pragma once
+#include "Geometry.h"
+#include "VulkanRendererHelpers.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Light;
+struct Camera;
+class LightingSystem;
+
+constexpr uint32_t SHADOW_CASCADE_COUNT = 4;
+constexpr uint32_t MAX_SHADOW_TILES = 64;
+constexpr uint32_t POINT_SHADOW_FACES = 6;
+
+struct ShadowSettings {
+    uint32_t atlasSize = 4096;
+    uint32_t cascadeSize = 1024;
+    uint32_t minTileSize = 64;
+    uint32_t maxTileSize = 1024;
+    float shadowDistance = 60.0f;     // Sun shadows end this far from the camera
+    float cascadeSplitLambda = 0.75f; // 0 = uniform splits, 1 = logarithmic
+    float cascadeMargin = 0.15f;      // Spare cascade radius, so small camera moves reuse the cached map
+    float casterDistance = 100.0f;    // How far toward the sun casters are captured beyond a cascade
+    float resolutionScale = 1.0f;     // Tile texels per pixel of screen coverage
+    uint32_t retainFrames = 60;       // Frames the tiles of an unseen light survive before release
+};
+
+// Layout of the shadow uniform buffer read by lighting.frag (binding 3).
+// Atlas rectangles are UV offset (xy) and scale (zw).
+struct ShadowUniforms {
+    alignas(16) glm::mat4 cascadeViewProjection[SHADOW_CASCADE_COUNT];
+    alignas(16) glm::vec4 cascadeRects[SHADOW_CASCADE_COUNT];
+    alignas(16) glm::vec4 sunDirection;  // xyz = direction light travels, w = 1 when the sun casts shadows
+    alignas(16) glm::vec4 sunColor;      // rgb premultiplied by intensity
+    alignas(16) glm::ivec4 lightTiles[MAX_LIGHTS]; // x = first tile, y = tile count (0, 1 or 6)
+    alignas(16) glm::mat4 tileViewProjection[MAX_SHADOW_TILES];
+    alignas(16) glm::vec4 tileRects[MAX_SHADOW_TILES];
+};
+
+// Square region of the atlas in texels
+struct AtlasRect {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t size = 0;
+};
+
+// A tile whose contents are stale and must be redrawn this frame
+struct ShadowRenderView {
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    AtlasRect rect;
+};
+
+// Quadtree (buddy) allocator over a square atlas with power-of-two tiles.
+// Freeing a tile merges it with its three siblings once they are all free.
+class ShadowAtlas {
+public:
+    ShadowAtlas(uint32_t size, uint32_t minTileSize);
+
+    std::optional<AtlasRect> Allocate(uint32_t size);
+    void Free(const AtlasRect& rect);
+    void Reset();
+
+    uint32_t GetSize() const { return m_size; }
+    uint32_t ClampTileSize(uint32_t size) const;
+
+private:
+    uint32_t LevelOf(uint32_t size) const;
+    static uint32_t Key(uint32_t x, uint32_t y) { return (y << 16) | x; }
+
+    uint32_t m_size;
+    uint32_t m_minTileSize;
+    // Free squares per level (level 0 is the whole atlas), ordered so the
+    // lowest coordinates are handed out first
+    std::vector<std::set<uint32_t>> m_freeLists;
+};
+
+// Plans shadow maps for each frame: four stable cascades for the sun plus
+// atlas tiles for spot lights (one) and point lights (six cube faces), sized
+// by how much of the screen a light's range covers. Tiles keep their
+// contents between frames and are only queued for redraw when their matrix
+// changes or a caster inside them has moved.
+class ShadowSystem {
+public:
+    explicit ShadowSystem(const ShadowSettings& settings = ShadowSettings());
+
+    // lights must be in the order they are uploaded to the light buffer.
+    // changedCasters are the old and new bounds of casters that moved since
+    // the previous call.
+    void Update(const Camera& camera, std::span<const Light> lights, const LightingSystem& lighting,
+                const std::vector<AABB>& changedCasters, uint32_t screenHeight);
+
+    const ShadowUniforms& GetUniforms() const { return m_uniforms; }
+    const std::vector<ShadowRenderView>& GetRenderViews() const { return m_renderViews; }
+    const ShadowSettings& GetSettings() const { return m_settings; }
+
+    // Forces every tile to be redrawn, e.g. after the atlas image was recreated
+    void InvalidateAll();
+
+    size_t GetCachedTileCount() const;
+
+private:
+    struct CachedTile {
+        AtlasRect rect;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        Frustum frustum;
+        bool valid = false;
+    };
+
+    struct LightShadow {
+        uint32_t tileSize = 0;
+        std::vector<CachedTile> tiles;
+        uint64_t lastUsedFrame = 0;
+        uint64_t candidateFrame = 0; // Last frame the light was visible, even if it got no tiles
+    };
+
+    struct Candidate {
+        uint32_t index;
+        float coverage;
+    };
+
+    struct Cascade {
+        CachedTile tile;
+        glm::vec3 center = glm::vec3(0.0f);
+        glm::vec3 direction = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
+    void UpdateCascades(const Camera& camera, const glm::vec3& sunDirection);
+    void UpdateLightTiles(const Camera& camera, std::span<const Light> lights, uint32_t screenHeight);
+    bool AllocateTiles(LightShadow& shadow, uint32_t tileSize, uint32_t tileCount);
+    void ReleaseTiles(LightShadow& shadow);
+    void EvictStaleLights();
+
+    // Queues the tile for redraw if its matrix changed or a moved caster touches it
+    void RefreshTile(CachedTile& tile, const glm::mat4& viewProjection);
+
+    ShadowSettings m_settings;
+    ShadowAtlas m_atlas;
+
+    std::array<Cascade, SHADOW_CASCADE_COUNT> m_cascades;
+    std::unordered_map<int, LightShadow> m_lightShadows; // Keyed by light id
+
+    const std::vector<AABB>* m_changedCasters = nullptr;
+    uint64_t m_frame = 0;
+
+    ShadowUniforms m_uniforms{};
+    std::vector<ShadowRenderView> m_renderViews;
+    std::vector<Candidate> m_candidates; // Per-frame scratch, kept for its capacity
+};
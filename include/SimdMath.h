@@ -0,0 +1,79 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Branch-free scalar kernels written so that loops over float arrays
+// compile to packed SIMD instructions (SSE/AVX on x86, NEON on ARM)
+namespace SimdMath {
+
+constexpr float PI = 3.14159265358979f;
+constexpr float TWO_PI = 6.28318530717959f;
+constexpr float INV_TWO_PI = 0.15915494309189f;
+constexpr float HALF_PI = 1.57079632679490f;
+
+// Floats at or above 2^23 in magnitude are already whole numbers
+constexpr float INTEGRAL_LIMIT = 8388608.0f;
+// Smallest magnitude that does not fit in an int32_t
+constexpr float INT32_LIMIT = 2147483648.0f;
+
+// Round and floor through integer conversion, which vectorizes on every
+// target. Values that are already whole, infinite or NaN skip the
+// conversion (which would be undefined for them) and come back unchanged.
+inline float RoundToInt(float x) {
+    bool convertible = std::fabs(x) < INTEGRAL_LIMIT;
+    float safe = convertible ? x : 0.0f;
+    float rounded = static_cast<float>(static_cast<int32_t>(safe + std::copysign(0.5f, safe)));
+    return convertible ? rounded : x;
+}
+
+inline float FloorToInt(float x) {
+    bool convertible = std::fabs(x) < INTEGRAL_LIMIT;
+    float safe = convertible ? x : 0.0f;
+    float truncated = static_cast<float>(static_cast<int32_t>(safe));
+    float floored = safe < truncated ? truncated - 1.0f : truncated;
+    return convertible ? floored : x;
+}
+
+// sin(x) with ~4e-6 absolute error near the origin; float range reduction
+// grows it to ~6e-5 by |x| = 1000. Stays in [-1, 1] for any finite x and
+// is NaN for infinite or NaN x.
+inline float FastSin(float x) {
+    // Reduce to [-pi, pi]; the clamp holds the rounding error of huge x
+    // inside the interval
+    x -= TWO_PI * RoundToInt(x * INV_TWO_PI);
+    x = x < -PI ? -PI : (x > PI ? PI : x);
+
+    // Reflect into [-pi/2, pi/2] where the polynomial is accurate
+    float reflected = std::copysign(PI, x) - x;
+    x = std::fabs(x) > HALF_PI ? reflected : x;
+
+    float x2 = x * x;
+    return x * (1.0f + x2 * (-1.6666667e-1f + x2 * (8.3333310e-3f + x2 * (-1.9840874e-4f + x2 * 2.7525562e-6f))));
+}
+
+inline float FastCos(float x) {
+    return FastSin(x + HALF_PI);
+}
+
+// Cheap integer hash mapped to [0, 1); n outside the int32_t range or NaN
+// hashes as 0
+inline float Hash(float n) {
+    float safe = std::fabs(n) < INT32_LIMIT ? n : 0.0f;
+    uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(safe));
+    bits = (bits << 13) ^ bits;
+    bits = bits * (bits * bits * 15731u + 789221u) + 1376312589u;
+    return static_cast<float>(bits & 0x00FFFFFFu) * (1.0f / 16777216.0f);
+}
+
+// 1D value noise in [0, 1) with smoothstep interpolation
+inline float ValueNoise(float x) {
+    float cell = FloorToInt(x);
+    float t = x - cell;
+    t = t * t * (3.0f - 2.0f * t);
+    float a = Hash(cell);
+    float b = Hash(cell + 1.0f);
+    return a + (b - a) * t;
+}
+
+} // namespace SimdMath
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// =============================================================================
+// SNAPSHOT STREAMS
+// =============================================================================
+
+// Snapshots are one contiguous buffer: a header (magic, format version,
+// payload size and checksum) followed by the sections each system writes.
+// Values are stored in native byte order and layout, so a snapshot is only
+// meant to be restored by the same build on the same platform; the checksum
+// rejects truncated or corrupted data before anything is applied.
+
+class SnapshotWriter {
+public:
+    SnapshotWriter(); // Reserves the header
+
+    template<typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteBytes(const void* data, size_t size);
+    void WriteString(std::string_view text); // uint32 length, then the bytes
+
+    // Writes a placeholder to fill in with Patch once the value is known,
+    // e.g. an element count ahead of the elements
+    template<typename T>
+    size_t Reserve() {
+        size_t offset = m_data.size();
+        Write(T{});
+        return offset;
+    }
+
+    template<typename T>
+    void Patch(size_t offset, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(m_data.data() + offset, &value, sizeof(T));
+    }
+
+    size_t Size() const { return m_data.size(); }
+
+    // Completes the header; the writer is empty afterwards
+    std::vector<std::byte> Finish();
+
+private:
+    std::vector<std::byte> m_data;
+};
+
+// Reads a payload in place. Every read is bounds checked and throws
+// std::runtime_error past the end.
+class SnapshotReader {
+public:
+    // Checks the header and checksum of a whole snapshot; throws
+    // std::runtime_error if it is not one this build can restore
+    static SnapshotReader Open(std::span<const std::byte> snapshot);
+
+    template<typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    // View of the next `size` bytes; not aligned for any particular type
+    std::span<const std::byte> ReadBytes(size_t size);
+    std::string_view ReadString();
+
+    void Skip(size_t size) { ReadBytes(size); }
+    bool AtEnd() const { return m_offset == m_data.size(); }
+    size_t Remaining() const { return m_data.size() - m_offset; }
+
+private:
+    explicit SnapshotReader(std::span<const std::byte> data) : m_data(data) {}
+
+    std::span<const std::byte> m_data;
+    size_t m_offset = 0;
+};
+
+// One write of the whole buffer. Returns false and logs on failure.
+bool WriteSnapshotFile(const std::string& path, std::span<const std::byte> snapshot);
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using TextureHandle = uint32_t;
+constexpr TextureHandle INVALID_TEXTURE = 0xFFFFFFFFu;
+
+// =============================================================================
+// TEXTURE FILES
+// =============================================================================
+
+// Read-only memory mapping of a whole file. Pages are only faulted in when
+// a mip level is actually copied out, so unstreamed detail costs no RAM.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path); // Throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+// Byte range of one mip level inside the file, level 0 being the largest
+struct TextureLevel {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+struct TextureFileInfo {
+    uint32_t format = 0; // VkFormat, typically a BCn block format
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TextureLevel> levels;
+};
+
+// Reads the header and level index of a KTX2 file holding a single 2D
+// image without supercompression, i.e. data that can be copied to the GPU
+// as is. Throws std::runtime_error describing what is unsupported.
+TextureFileInfo ParseKtx2(const uint8_t* data, size_t size);
+
+// =============================================================================
+// STREAMER
+// =============================================================================
+
+struct TextureStreamingSettings {
+    uint64_t memoryBudget = 256ull << 20;      // Resident texel bytes across all textures
+    uint64_t uploadBytesPerFrame = 8ull << 20; // New detail copied per frame; one level may exceed it
+    uint32_t tailSize = 128;                   // Levels this size or smaller load with the texture and are never evicted
+    float mipBias = 0.0f;                      // Positive values stream coarser levels
+    uint32_t retainFrames = 120;               // Frames an unseen texture keeps its detail before it is dropped
+};
+
+// A texture whose resident levels become [newFirstMip, levelCount).
+// oldFirstMip equals the level count when nothing was resident yet.
+struct TextureResidencyChange {
+    TextureHandle texture = INVALID_TEXTURE;
+    uint32_t oldFirstMip = 0;
+    uint32_t newFirstMip = 0;
+};
+
+// Decides which mip levels of each texture are resident. Every texture
+// keeps its mip tail; finer levels are streamed in one at a time, coarse to
+// fine, for the textures covering the most screen, and taken away from the
+// least important ones first when the memory budget runs out. The streamer
+// only plans: the renderer applies each returned change.
+class TextureStreamer {
+public:
+    explicit TextureStreamer(const TextureStreamingSettings& settings = TextureStreamingSettings());
+
+    // Maps the file and validates its header; no texel data is read yet
+    TextureHandle Load(const std::string& path);
+    void Unload(TextureHandle texture);
+    bool IsValid(TextureHandle texture) const;
+
+    // Reports that the texture is drawn this frame spanning screenPixels
+    // (its larger on-screen dimension). The largest report of a frame wins.
+    void RequestUsage(TextureHandle texture, float screenPixels);
+
+    // Plans residency for the frame; evictions come before uploads. The
+    // list is reused by the next call.
+    const std::vector<TextureResidencyChange>& Update();
+
+    const TextureFileInfo& GetInfo(TextureHandle texture) const;
+    const uint8_t* GetLevelData(TextureHandle texture, uint32_t mip) const;
+    uint32_t GetResidentMip(TextureHandle texture) const;
+    uint32_t GetTailMip(TextureHandle texture) const;
+
+    // Size of levels [firstMip, levelCount)
+    uint64_t GetLevelRangeBytes(TextureHandle texture, uint32_t firstMip) const;
+
+    uint64_t GetResidentBytes() const { return m_residentBytes; }
+    size_t GetTextureCount() const { return m_textures.size() - m_freeHandles.size(); }
+    const TextureStreamingSettings& GetSettings() const { return m_settings; }
+
+private:
+    struct StreamedTexture {
+        std::unique_ptr<MappedFile> file;
+        TextureFileInfo info;
+        std::vector<uint64_t> bytesFrom; // bytesFrom[m] = size of levels [m, levelCount), one past the end is 0
+        uint32_t tailMip = 0;
+        uint32_t residentMip = 0;        // Level count while nothing is resident
+        uint32_t targetMip = 0;
+        float screenPixels = 0.0f;       // Largest request of the current frame
+        float priority = 0.0f;
+        uint64_t lastUsedFrame = 0;
+        bool live = false;
+    };
+
+    uint32_t DesiredMip(const StreamedTexture& texture) const;
+    void PlanTargets(const std::vector<TextureHandle>& order);
+
+    TextureStreamingSettings m_settings;
+    std::vector<StreamedTexture> m_textures; // Indexed by handle
+    std::vector<TextureHandle> m_freeHandles;
+    std::vector<TextureHandle> m_order; // Per-frame scratch, kept for its capacity
+    std::vector<TextureResidencyChange> m_changes;
+    uint64_t m_residentBytes = 0;
+    uint64_t m_frame = 0;
+};
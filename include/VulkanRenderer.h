@@ -4,7 +4,18 @@
 #include <vector>
 #include <optional>
 #include <array>
+#include <memory>
+#include <unordered_map>
+#include <span>
 #include <glm/glm.hpp>
+#include "VulkanRendererHelpers.h"
+#include "ShadowSystem.h"
+#include "ShaderCompiler.h"
+#include "TextureStreamer.h"
+#include "RenderGraph.h"
+#include "GpuLayout.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
@@ -30,6 +41,15 @@ struct Vertex {
     static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
 };
 
+// =============================================================================
+// SHADER-VISIBLE LAYOUTS
+// =============================================================================
+//
+// The GLSL declarations of the frame uniforms, lights and materials are
+// generated from their GpuStruct descriptions and reach the shaders as the
+// gpu_frame.glsl, gpu_lights.glsl and gpu_materials.glsl includes, so C++
+// is the only place to edit them.
+
 struct UniformBufferObject {
     alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
@@ -40,41 +60,268 @@ struct UniformBufferObject {
     alignas(4) int numLights;
 };
 
+template<> struct GpuStruct<UniformBufferObject> {
+    static constexpr const char* name = "UniformBufferObject";
+    static constexpr GpuField fields[] = {
+        GPU_FIELD(UniformBufferObject, model, ""),
+        GPU_FIELD(UniformBufferObject, view, ""),
+        GPU_FIELD(UniformBufferObject, proj, ""),
+        GPU_FIELD(UniformBufferObject, viewPos, ""),
+        GPU_FIELD(UniformBufferObject, time, ""),
+        GPU_FIELD(UniformBufferObject, ambientLight, ""),
+        GPU_FIELD(UniformBufferObject, numLights, ""),
+    };
+};
+static_assert(GpuLayoutMatches<UniformBufferObject>(GpuPacking::Std140));
+
+// One light in three vec4s: position and range, color and type, then the
+// octahedral-encoded direction with both cone cosines
 struct LightData {
-    alignas(16) glm::vec3 position;
-    alignas(16) glm::vec3 direction;
-    alignas(16) glm::vec3 color;
-    alignas(4) float intensity;
-    alignas(4) float range;
-    alignas(4) float innerCone;
-    alignas(4) float outerCone;
-    alignas(4) int type; // 0=directional, 1=point, 2=spot
-    alignas(4) int enabled;
-    alignas(8) glm::vec2 padding; // Ensure 16-byte alignment
+    glm::vec3 position{0.0f};
+    float range = 0.0f;         // 0 = unbounded (directional lights)
+    glm::vec3 color{0.0f};      // Premultiplied by intensity
+    uint32_t type = 0;          // LightType
+    glm::vec2 direction{0.0f};  // EncodeUnitVector of the direction light travels
+    float cosInnerCone = 1.0f;  // Spot lights: full intensity inside
+    float cosOuterCone = 0.0f;  // Spot lights: no light outside
+};
+
+template<> struct GpuStruct<LightData> {
+    static constexpr const char* name = "Light";
+    static constexpr GpuField fields[] = {
+        GPU_FIELD(LightData, position, ""),
+        GPU_FIELD(LightData, range, "0 = unbounded"),
+        GPU_FIELD(LightData, color, "Premultiplied by intensity"),
+        GPU_FIELD(LightData, type, "0=directional, 1=point, 2=spot"),
+        GPU_FIELD(LightData, direction, "Octahedral, see DecodeUnitVector"),
+        GPU_FIELD(LightData, cosInnerCone, ""),
+        GPU_FIELD(LightData, cosOuterCone, ""),
+    };
+};
+static_assert(GpuLayoutMatches<LightData>(GpuPacking::Std430) && GpuLayoutMatches<LightData>(GpuPacking::Std140));
+static_assert(sizeof(LightData) == 48);
+
+// Contents of a frame's light buffer (set 0, binding 1)
+struct LightBufferData {
+    uint32_t lightCount = 0;
+    alignas(16) LightData lights[MAX_LIGHTS];
+};
+
+template<> struct GpuStruct<LightBufferData> {
+    static constexpr const char* name = "LightBuffer";
+    static constexpr GpuField fields[] = {
+        GPU_FIELD(LightBufferData, lightCount, ""),
+        GPU_FIELD(LightBufferData, lights, ""),
+    };
+};
+static_assert(GpuLayoutMatches<LightBufferData>(GpuPacking::Std430));
+
+// =============================================================================
+// BINDLESS RESOURCES
+// =============================================================================
+
+// Capacity of the bindless texture table (set 1) and the material table
+// (set 0, binding 4). Slots are handed out by index and every draw picks its
+// material with a push constant, so adding textures or materials never
+// rebinds or reallocates a descriptor set.
+constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+constexpr uint32_t MAX_MATERIALS = 1024;
+constexpr uint32_t INVALID_BINDLESS_INDEX = 0xFFFFFFFFu;
+
+// One entry of the material storage buffer, std430. Texture fields hold
+// bindless slots; slots of streamed textures are kept current by the renderer.
+struct MaterialData {
+    alignas(16) glm::vec4 albedo = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+    alignas(4) float metallic = 0.0f;
+    alignas(4) float roughness = 0.5f;
+    alignas(4) float ao = 1.0f;
+    alignas(4) uint32_t albedoTexture = INVALID_BINDLESS_INDEX;            // Multiplies albedo.rgb
+    alignas(4) uint32_t metallicRoughnessTexture = INVALID_BINDLESS_INDEX; // G = roughness, B = metallic
+    alignas(4) uint32_t padding[3] = {};
+};
+
+template<> struct GpuStruct<MaterialData> {
+    static constexpr const char* name = "Material";
+    static constexpr GpuField fields[] = {
+        GPU_FIELD(MaterialData, albedo, ""),
+        GPU_FIELD(MaterialData, metallic, ""),
+        GPU_FIELD(MaterialData, roughness, ""),
+        GPU_FIELD(MaterialData, ao, ""),
+        GPU_FIELD(MaterialData, albedoTexture, "0xFFFFFFFF = untextured"),
+        GPU_FIELD(MaterialData, metallicRoughnessTexture, "G = roughness, B = metallic"),
+        GPU_FIELD(MaterialData, padding, ""),
+    };
 };
+static_assert(GpuLayoutMatches<MaterialData>(GpuPacking::Std430));
 
-constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-constexpr int MAX_LIGHTS = 32;
+enum class MaterialTexture : int {
+    Albedo = 0,
+    MetallicRoughness = 1
+};
+constexpr size_t MATERIAL_TEXTURE_COUNT = 2;
+
+// Per-draw data pushed before each vkCmdDrawIndexed
+struct DrawPushConstants {
+    alignas(16) glm::mat4 model;
+    alignas(4) uint32_t materialIndex;
+};
+
+struct DrawCommand {
+    glm::mat4 model = glm::mat4(1.0f);
+    uint32_t materialIndex = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;   // 0 = the whole mesh
+    int32_t vertexOffset = 0;
+    float screenSize = 0.0f;   // Pixels the mesh spans on screen, drives texture streaming; 0 = full height
+};
+
+struct LightMix;
+
+// Specialization constants of lighting.frag. The default describes the
+// generic pipeline that handles any light mix.
+struct LightingVariant {
+    uint32_t lightTypeMask = 0x7; // Bit per LightType present
+    uint32_t lightCount = 0;      // Fixed loop count, 0 = read from the light buffer
+    bool sun = true;
+    bool depthPrepass = false;    // Depth test EQUAL without writes against the prepass depth
+    
+    uint32_t Key() const {
+        return lightTypeMask | (lightCount << 3) | (sun ? 1u << 9 : 0u) | (depthPrepass ? 1u << 10 : 0u);
+    }
+};
+
+// Largest light count given its own fully unrolled pipeline variant
+constexpr uint32_t MAX_FIXED_LIGHT_COUNT = 8;
+
+// How the scene is lit; see VulkanRenderer::SetRenderPath
+enum class RenderPath : int {
+    Forward = 0, // Lights evaluated while rasterizing each draw
+    Deferred = 1 // Surfaces to a G-buffer first, then each light shades only the pixels it reaches
+};
+
+// Swap chain presentation; see VulkanRenderer::SetPresentMode
+enum class PresentMode : int {
+    Fifo = 0,     // Vsync; always supported
+    Mailbox = 1,  // Vsync without queueing: the newest frame replaces a waiting one
+    Immediate = 2 // No vsync; may tear
+};
+
+// Pushed by the deferred lighting and tonemap passes; must match deferred.vert
+struct DeferredPushConstants {
+    uint32_t mode; // 0 = fullscreen triangle, 1 = one quad per light
+};
 
 class VulkanRenderer {
 public:
     VulkanRenderer();
     ~VulkanRenderer();
     
-    bool Initialize(GLFWwindow* window);
+    // Shader and lighting variant builds run as jobs on `jobs`, which must
+    // outlive the renderer
+    bool Initialize(GLFWwindow* window, JobSystem* jobs);
     void Cleanup();
     
-    void BeginFrame();
+    // Blocks until the next frame may be recorded (see FramePacer). Call it
+    // before polling input so time spent waiting does not age the input;
+    // in LowLatency mode it also acquires the swap chain image, which is
+    // where FIFO presentation blocks. BeginFrame does whatever is left.
+    void WaitForNextFrame();
+    
+    // Returns false when no frame was started (e.g. the swap chain was out
+    // of date or the window is minimized); skip the frame's updates and
+    // EndFrame in that case
+    bool BeginFrame();
     void EndFrame();
     void UpdateUniforms(const UniformBufferObject& ubo);
-    void UpdateLights(const std::vector<LightData>& lights);
+    void UpdateLights(std::span<const LightData> lights);
+    
+    // Call before BeginFrame: the shadow pass is recorded ahead of the main
+    // pass. Views accumulate until a frame actually records them.
+    void UpdateShadows(const ShadowUniforms& uniforms, const std::vector<ShadowRenderView>& views);
+    uint32_t GetShadowAtlasSize() const { return m_shadowAtlasSize; }
+    
+    // Rebuilds pipelines whose GLSL sources changed on disk. A shader that
+    // fails to compile is reported and the previous pipeline stays in use.
+    void ReloadChangedShaders();
+    
+    // Picks the cheapest lighting pipeline for this frame's lights. Variants
+    // are built on a worker thread the first time they are needed; until
+    // then the generic pipeline is used.
+    void SetLightMix(const LightMix& mix);
+    const LightingVariant& GetLightingVariant() const { return m_lightingVariant; }
+    
+    // Lays down depth with a vertex-only pass before lighting, so the PBR
+    // shader runs once per visible pixel instead of once per overdrawn
+    // fragment. Takes effect from the next frame.
+    void SetDepthPrepass(bool enabled);
+    bool IsDepthPrepassEnabled() const { return m_depthPrepass; }
+    
+    // Deferred shading writes albedo, normals and roughness/metallic once,
+    // then shades point and spot lights only inside their screen bounds, so
+    // the cost grows with lit pixels rather than draws times lights. The
+    // depth prepass setting only applies to the forward path. Takes effect
+    // from the next frame.
+    void SetRenderPath(RenderPath path) { m_renderPath = path; }
+    RenderPath GetRenderPath() const { return m_renderPath; }
+    
+    // Modes the surface lacks fall back to FIFO. The swap chain is rebuilt
+    // at the next frame boundary.
+    void SetPresentMode(PresentMode mode);
+    PresentMode GetPresentMode() const { return m_presentMode; }
+    
+    // More frames in flight keep the GPU busier, fewer shorten the time
+    // from recording to display; see FramePacer
+    void SetFramesInFlight(uint32_t count) { m_framePacer.SetFramesInFlight(count); }
+    uint32_t GetFramesInFlight() const { return m_framePacer.GetFramesInFlight(); }
+    void SetLatencyMode(LatencyMode mode) { m_framePacer.SetLatencyMode(mode); }
+    LatencyMode GetLatencyMode() const { return m_framePacer.GetLatencyMode(); }
+    const FramePacer& GetFramePacer() const { return m_framePacer; }
     
     VkDevice GetDevice() const { return m_device; }
     VkPhysicalDevice GetPhysicalDevice() const { return m_physicalDevice; }
     
+    // Flags the swap chain for recreation at the next frame boundary; wired
+    // to the window's framebuffer size callback
+    void NotifyFramebufferResized() { m_framebufferResized = true; }
+    
+    // Bindless textures: returns the slot to store in MaterialData::albedoTexture.
+    // The view and sampler must stay alive until ReleaseTexture; the slot is
+    // reused only once frames that might sample it have retired. Releasing
+    // a slot that is not registered is logged and ignored.
+    uint32_t RegisterTexture(VkImageView view, VkSampler sampler);
+    void ReleaseTexture(uint32_t index);
+    
+    // Materials are edited on the CPU and copied to each frame's storage
+    // buffer before it is recorded. Material 0 is the default and always exists.
+    // Updating or destroying a material that does not exist does nothing.
+    uint32_t CreateMaterial(const MaterialData& material);
+    void UpdateMaterial(uint32_t index, const MaterialData& material);
+    void DestroyMaterial(uint32_t index);
+    
+    // Queues a draw for the next BeginFrame and reports its screen size to
+    // the texture streamer. Without queued draws the test mesh is drawn once
+    // with the default material.
+    void QueueDraw(const DrawCommand& draw);
+    
+    // Streamed textures from KTX2 files. Throws when the file is invalid or
+    // its format cannot be sampled on this device. Only the mip tail is
+    // resident at first; finer levels follow as draws ask for them.
+    TextureHandle LoadTexture(const std::string& path);
+    void UnloadTexture(TextureHandle texture);
+    
+    // Binds a streamed texture (or INVALID_TEXTURE) to a material. The
+    // material's bindless slot follows the texture as its residency changes.
+    void SetMaterialTexture(uint32_t material, MaterialTexture slot, TextureHandle texture);
+    const TextureStreamer& GetTextureStreamer() const { return m_textureStreamer; }
+    
+    // Buffer and image owners push destruction here instead of idling the
+    // device; see DeletionQueue
+    DeletionQueue& GetDeletionQueue() { return m_deletionQueue; }
+    
     // Getters for debugging/inspection
     uint32_t GetCurrentFrame() const { return m_currentFrame; }
     VkExtent2D GetSwapChainExtent() const { return m_swapChainExtent; }
+    const RenderGraph& GetRenderGraph() const { return m_renderGraph; }
     
 private:
     // Core Vulkan objects
@@ -92,27 +339,70 @@ private:
     VkFormat m_swapChainImageFormat;
     VkExtent2D m_swapChainExtent;
     std::vector<VkImageView> m_swapChainImageViews;
+    bool m_framebufferResized = false;
+    PresentMode m_presentMode = PresentMode::Fifo;
+
     
-    // Depth resources
-    VkImage m_depthImage = VK_NULL_HANDLE;
-    VkDeviceMemory m_depthImageMemory = VK_NULL_HANDLE;
-    VkImageView m_depthImageView = VK_NULL_HANDLE;
+    // Passes and the images between them (depth buffer, swap chain image,
+    // shadow atlas) are declared every frame; see RecordFrameGraph
+    RenderGraph m_renderGraph;
+    VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
     
-    // Render pass and pipeline
-    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    // Pipeline
     VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
-    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;        // Generic lighting variant
+    VkPipeline m_prepassGraphicsPipeline = VK_NULL_HANDLE; // Generic variant for use after the depth prepass
+    VkPipeline m_depthPrepassPipeline = VK_NULL_HANDLE;    // Vertex-only, lighting layout
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkShaderModule m_lightingVertModule = VK_NULL_HANDLE;
+    VkShaderModule m_lightingFragModule = VK_NULL_HANDLE;
+    
+    // Specialized lighting pipelines keyed by LightingVariant::Key. Builds
+    // run as jobs against the color format captured at launch.
+    struct PendingLightingPipeline {
+        VkFormat colorFormat;
+        JobHandle job;
+        std::shared_ptr<VkPipeline> pipeline; // Written by the job
+    };
+    std::unordered_map<uint32_t, VkPipeline> m_lightingPipelines;
+    std::unordered_map<uint32_t, PendingLightingPipeline> m_pendingLightingPipelines;
+    LightingVariant m_lightingVariant;
+    VkPipeline m_activeLightingPipeline = VK_NULL_HANDLE;
+    bool m_depthPrepass = false;
     
-    // Framebuffers and command buffers
-    std::vector<VkFramebuffer> m_swapChainFramebuffers;
+    // Deferred path. The G-buffer images are render graph transients; set 2
+    // samples them and is rewritten each frame once the graph has placed them.
+    RenderPath m_renderPath = RenderPath::Forward;
+    VkPipeline m_gbufferPipeline = VK_NULL_HANDLE;          // Lighting layout
+    VkPipeline m_deferredLightingPipeline = VK_NULL_HANDLE; // Deferred layout, additive
+    VkPipeline m_tonemapPipeline = VK_NULL_HANDLE;          // Deferred layout
+    VkPipelineLayout m_deferredPipelineLayout = VK_NULL_HANDLE;
+    VkShaderModule m_gbufferFragModule = VK_NULL_HANDLE;
+    VkShaderModule m_deferredVertModule = VK_NULL_HANDLE;
+    VkShaderModule m_deferredLightFragModule = VK_NULL_HANDLE;
+    VkShaderModule m_tonemapFragModule = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_gbufferSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_gbufferPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_gbufferSets;
+    VkSampler m_gbufferSampler = VK_NULL_HANDLE;
+    struct GBufferTargets {
+        RenderResource albedo = INVALID_RENDER_RESOURCE;
+        RenderResource normal = INVALID_RENDER_RESOURCE;
+        RenderResource material = INVALID_RENDER_RESOURCE;
+        RenderResource depth = INVALID_RENDER_RESOURCE;
+        RenderResource lighting = INVALID_RENDER_RESOURCE; // HDR accumulation
+    } m_gbufferTargets;
+    
+    // Command buffers
     VkCommandPool m_commandPool = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> m_commandBuffers;
     
-    // Synchronization
+    // Synchronization. Binary semaphores per slot order acquire, render and
+    // present; the pacer's timeline tracks which frames the GPU finished.
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
-    std::vector<VkFence> m_inFlightFences;
+    FramePacer m_framePacer;
     
     // Vertex data
     VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
@@ -130,16 +420,81 @@ private:
     std::vector<VkDeviceMemory> m_lightBuffersMemory;
     std::vector<void*> m_lightBuffersMapped;
     
+    // Shadow atlas, kept across frames so unchanged tiles are never redrawn
+    uint32_t m_shadowAtlasSize = 4096;
+    VkFormat m_shadowFormat = VK_FORMAT_UNDEFINED;
+    VkImage m_shadowAtlasImage = VK_NULL_HANDLE;
+    VkDeviceMemory m_shadowAtlasMemory = VK_NULL_HANDLE;
+    VkImageView m_shadowAtlasView = VK_NULL_HANDLE;
+    VkSampler m_shadowSampler = VK_NULL_HANDLE;
+    VkPipelineLayout m_shadowPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_shadowPipeline = VK_NULL_HANDLE;
+    
+    // Shadow uniform buffers
+    std::vector<VkBuffer> m_shadowBuffers;
+    std::vector<VkDeviceMemory> m_shadowBuffersMemory;
+    std::vector<void*> m_shadowBuffersMapped;
+    ShadowUniforms m_shadowUniforms{};
+    std::vector<ShadowRenderView> m_pendingShadowViews;
+    
+    // Runtime shader compilation with an on-disk SPIR-V cache
+    ShaderCompiler m_shaderCompiler;
+    
     // Descriptor sets
     VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
     std::vector<VkDescriptorSet> m_descriptorSets;
     
+    // Bindless set: one update-after-bind set shared by every frame
+    VkDescriptorSetLayout m_bindlessSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_bindlessPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_bindlessSet = VK_NULL_HANDLE;
+    std::vector<uint32_t> m_freeTextureSlots;
+    std::vector<bool> m_textureSlotLive; // Registered and not yet released
+    uint32_t m_textureSlotCount = 0;  // High-water mark
+    std::vector<DrawCommand> m_drawQueue;
+    
+    // Material table: edited here, copied to a frame's buffer when that
+    // frame's copy is older than m_materialVersion
+    std::vector<MaterialData> m_materials;
+    std::vector<std::array<TextureHandle, MATERIAL_TEXTURE_COUNT>> m_materialTextures;
+    std::vector<uint32_t> m_freeMaterialSlots;
+    std::vector<bool> m_materialLive; // Created and not yet destroyed
+    uint64_t m_materialVersion = 1;
+    std::vector<uint64_t> m_uploadedMaterialVersions;
+    std::vector<VkBuffer> m_materialBuffers;
+    std::vector<VkDeviceMemory> m_materialBuffersMemory;
+    std::vector<void*> m_materialBuffersMapped;
+    
+    // Streamed textures: one image per texture holding just its resident
+    // levels, replaced whenever the residency changes
+    struct TextureImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t slot = INVALID_BINDLESS_INDEX;
+    };
+    TextureStreamer m_textureStreamer;
+    std::vector<TextureImage> m_textureImages; // Indexed by TextureHandle
+    VkSampler m_textureSampler = VK_NULL_HANDLE;
+    
+    // Per-frame staging for streamed levels, grown on demand
+    std::vector<VkBuffer> m_stagingBuffers;
+    std::vector<VkDeviceMemory> m_stagingBuffersMemory;
+    std::vector<void*> m_stagingBuffersMapped;
+    std::vector<VkDeviceSize> m_stagingCapacities;
+    
+    // Objects released while frames may still use them
+    DeletionQueue m_deletionQueue;
+    
     // Current frame tracking
     uint32_t m_currentFrame = 0;
+    bool m_frameStarted = false;
+    bool m_imageAcquired = false; // m_imageIndex is acquired but not yet presented
     uint32_t m_imageIndex = 0;
     
     // Window reference
     GLFWwindow* m_window = nullptr;
+    JobSystem* m_jobs = nullptr;
     
     // Sample geometry
     std::vector<Vertex> m_vertices;
@@ -150,22 +505,45 @@ private:
     void SetupDebugMessenger();
     bool PickPhysicalDevice();
     bool CreateLogicalDevice();
-    bool CreateSwapChain();
+    bool CreateSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
     bool CreateImageViews();
-    bool CreateRenderPass();
     bool CreateDescriptorSetLayout();
     bool CreateGraphicsPipeline();
-    bool CreateDepthResources();
-    bool CreateFramebuffers();
+    VkPipeline CreateLightingPipeline(const LightingVariant& variant, VkFormat colorFormat) const;
+    VkPipeline CreateDepthPrepassPipeline() const;
+    VkPipeline GetGenericLightingPipeline() const { return m_depthPrepass ? m_prepassGraphicsPipeline : m_graphicsPipeline; }
+    void CollectLightingPipelines(bool wait);
+    void DestroyLightingPipelines();
+    void CreateDeferredPipelines();
+    VkPipeline CreateGBufferPipeline() const;
+    VkPipeline CreateFullscreenPipeline(VkShaderModule fragModule, VkFormat colorFormat, bool additive) const;
     bool CreateCommandPool();
     bool CreateVertexBuffer();
     bool CreateIndexBuffer();
     bool CreateUniformBuffers();
     bool CreateLightBuffers();
+    bool CreateShadowResources();
+    bool CreateShadowPipeline();
     bool CreateDescriptorPool();
     bool CreateDescriptorSets();
+    bool CreateMaterialBuffers();
+    bool CreateBindlessResources();
+    bool CreateTextureResources();
+    bool CreateDeferredResources();
+    void RecordDraws(VkCommandBuffer commandBuffer);
+    void UploadMaterials();
+    void ApplyMaterialTextures(uint32_t material);
+    
+    // Texture streaming
+    void RecordTextureStreaming(VkCommandBuffer commandBuffer);
+    void ApplyResidencyChange(VkCommandBuffer commandBuffer, const TextureResidencyChange& change,
+                              VkDeviceSize& stagingOffset);
+    void EnsureStagingCapacity(VkDeviceSize size);
+    void RetireTextureImage(TextureImage& texture);
+    void RefreshMaterialTextures(TextureHandle texture);
     bool CreateCommandBuffers();
     bool CreateSyncObjects();
+    bool AcquireNextImage();
     
     // Helper functions
     std::vector<const char*> GetRequiredExtensions();
@@ -177,7 +555,7 @@ private:
     VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
     VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-    VkShaderModule CreateShaderModule(const std::vector<char>& code);
+    VkShaderModule CreateShaderModule(const std::vector<uint32_t>& code) const;
     VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkFormat FindDepthFormat();
     bool HasStencilComponent(VkFormat format);
@@ -190,6 +568,19 @@ private:
     VkCommandBuffer BeginSingleTimeCommands();
     void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
     
+    // Frame recording
+    void RecordFrameGraph(VkCommandBuffer commandBuffer);
+    void RecordShadowPass(VkCommandBuffer commandBuffer);
+    void RecordDepthPrepass(VkCommandBuffer commandBuffer);
+    void RecordLightingPass(VkCommandBuffer commandBuffer);
+    void BindGeometry(VkCommandBuffer commandBuffer);
+    void AddDeferredPasses(RenderResource backBuffer, RenderResource depth, RenderResource shadowAtlas);
+    void RecordGBufferPass(VkCommandBuffer commandBuffer);
+    void RecordDeferredLighting(VkCommandBuffer commandBuffer);
+    void RecordTonemap(VkCommandBuffer commandBuffer);
+    void UpdateGBufferDescriptors();
+    void BindGBuffer(VkCommandBuffer commandBuffer);
+    
     // Geometry generation
     void CreateTestGeometry();
     
@@ -6,6 +6,9 @@
 #include <stdexcept>
 #include <iostream>
 #include <functional>
+#include <limits>
+#include <deque>
+#include <mutex>
 #include <glm/glm.hpp>
 
 // Forward declarations
@@ -24,8 +27,10 @@ extern const std::vector<const char*> deviceExtensions;
     constexpr bool enableValidationLayers = true;
 #endif
 
-// Maximum number of frames in flight for double/triple buffering
-constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+// Per-frame resources exist for MAX_FRAMES_IN_FLIGHT slots; how many of
+// them are used is chosen at runtime (see FramePacer)
+constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+constexpr int DEFAULT_FRAMES_IN_FLIGHT = 2;
 constexpr int MAX_LIGHTS = 32;
 
 // =============================================================================
@@ -94,6 +99,9 @@ bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<cons
 
 // Device feature checking
 bool CheckDeviceFeatureSupport(VkPhysicalDevice device);
+bool CheckDescriptorIndexingSupport(VkPhysicalDevice device); // Vulkan 1.2 bindless features
+bool CheckDynamicRenderingSupport(VkPhysicalDevice device);   // VK_KHR_dynamic_rendering, used by the render graph
+bool CheckTimelineSemaphoreSupport(VkPhysicalDevice device);  // Vulkan 1.2 timeline semaphores, used for frame pacing
 bool IsDeviceDiscrete(VkPhysicalDevice device);
 uint32_t RateDeviceSuitability(VkPhysicalDevice device, VkSurfaceKHR surface);
 
@@ -331,6 +339,7 @@ namespace VulkanLimits {
 
 // Math utilities for Vulkan coordinate systems
 glm::mat4 CreateProjectionMatrix(float fov, float aspectRatio, float nearPlane, float farPlane);
+glm::mat4 CreateOrthographicMatrix(float width, float height, float nearPlane, float farPlane);
 glm::mat4 CreateViewMatrix(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up);
 glm::mat4 CreateModelMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale);
 
@@ -381,6 +390,47 @@ VkSurfaceKHR CreateGLFWSurface(VkInstance instance, GLFWwindow* window);
 // RESOURCE LIFETIME MANAGEMENT
 // =============================================================================
 
+// Defers destruction of GPU objects until no frame in flight can still use
+// them. Work pushed while frame N is current runs once the GPU has finished
+// frame N, i.e. once the frame timeline has reached N + 1. Safe to push from
+// any thread.
+class DeletionQueue {
+public:
+    void Push(std::function<void()> destroy);
+
+    // Runs work pushed during frames the GPU has finished; completedFrames
+    // is the frame timeline's current value
+    void Collect(uint64_t completedFrames);
+
+    // Call once the frame using the current slot has been submitted
+    void NextFrame();
+
+    // Runs everything immediately; only valid after vkDeviceWaitIdle
+    void Flush();
+
+    uint64_t GetFrame() const;
+    size_t GetPendingCount() const;
+
+private:
+    struct Entry {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    mutable std::mutex m_mutex;
+    std::deque<Entry> m_entries; // Ordered by frame
+    uint64_t m_frame = 0;
+};
+
+// SafeDestroy counterpart for objects that may still be in use by the GPU
+template<typename T>
+void DeferDestroy(DeletionQueue& queue, T& handle, std::function<void(T)> destroyFunc) {
+    if (handle != VK_NULL_HANDLE) {
+        queue.Push([handle, destroyFunc = std::move(destroyFunc)]() { destroyFunc(handle); });
+        handle = VK_NULL_HANDLE;
+    }
+}
+
 // RAII wrapper for Vulkan resources
 template<typename VkHandle, typename Deleter>
 class VulkanResource {
@@ -426,6 +476,15 @@ public:
         }
     }
     
+    // Releases ownership to the queue, which destroys the handle once the
+    // frames in flight are done with it
+    void retire(DeletionQueue& queue) {
+        if (m_handle != VK_NULL_HANDLE) {
+            queue.Push([handle = m_handle, deleter = std::move(m_deleter)]() { deleter(handle); });
+            m_handle = VK_NULL_HANDLE;
+        }
+    }
+    
 private:
     VkHandle m_handle = VK_NULL_HANDLE;
     Deleter m_deleter;
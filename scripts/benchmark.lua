@@ -0,0 +1,99 @@
+-- Script Backend Benchmark
+-- Times the light updates the shipped scripts perform, through the vec3
+-- bindings (Light) and the plain-number bindings (LightFFI). Build once with
+-- ENGINE_USE_LUAJIT=OFF and once with ON, load this script, and compare the
+-- logged times. Sandboxed scripts are kept out of the JIT, so load this one
+-- with the jit capability (ScriptCapabilities) for the LuaJIT run. Each
+-- round runs in its own update so it stays within the script's instruction
+-- quota.
+print("Loading benchmark...")
+
+local LIGHT_COUNT = 64
+local ITERATIONS = 200 -- Per round
+local ROUNDS = 10
+
+local lights = {}
+
+local function createLights()
+    for i = 1, LIGHT_COUNT do
+        lights[i] = Light.create({
+            type = LightType.Point,
+            position = vec3(0, 2, 0),
+            color = vec3(1, 1, 1),
+            intensity = 1.0
+        })
+    end
+end
+
+-- lighting_demo.lua's orbit and pulse, applied to every light
+local function orbitBindings(t)
+    for i = 1, LIGHT_COUNT do
+        local angle = t + i * 0.1
+        Light.setPosition(lights[i], vec3(math.cos(angle) * 3, 2 + math.sin(angle * 2) * 0.5, math.sin(angle) * 3))
+        Light.setIntensity(lights[i], 2.0 + math.sin(angle * 4) * 1.5)
+    end
+end
+
+local function orbitFFI(t)
+    local setPosition, setIntensity = LightFFI.setPosition, LightFFI.setIntensity
+    for i = 1, LIGHT_COUNT do
+        local angle = t + i * 0.1
+        setPosition(lights[i], math.cos(angle) * 3, 2 + math.sin(angle * 2) * 0.5, math.sin(angle) * 3)
+        setIntensity(lights[i], 2.0 + math.sin(angle * 4) * 1.5)
+    end
+end
+
+-- day_night_cycle.lua's sun update, applied to every light
+local function sunBindings(hour)
+    for i = 1, LIGHT_COUNT do
+        local sunAngle = ((hour + i) / 24.0) * 2 * math.pi - math.pi / 2
+        local sunHeight = math.sin(sunAngle)
+        local warmth = math.max(0, 1.0 - sunHeight)
+        Light.setPosition(lights[i], vec3(math.cos(sunAngle), -sunHeight, 0.2))
+        Light.setIntensity(lights[i], math.max(0, sunHeight * 3.0))
+        Light.setColor(lights[i], vec3(1.0, 0.95 - warmth * 0.3, 0.8 - warmth * 0.5))
+    end
+end
+
+local function sunFFI(hour)
+    local setPosition, setIntensity, setColor = LightFFI.setPosition, LightFFI.setIntensity, LightFFI.setColor
+    for i = 1, LIGHT_COUNT do
+        local sunAngle = ((hour + i) / 24.0) * 2 * math.pi - math.pi / 2
+        local sunHeight = math.sin(sunAngle)
+        local warmth = math.max(0, 1.0 - sunHeight)
+        setPosition(lights[i], math.cos(sunAngle), -sunHeight, 0.2)
+        setIntensity(lights[i], math.max(0, sunHeight * 3.0))
+        setColor(lights[i], 1.0, 0.95 - warmth * 0.3, 0.8 - warmth * 0.5)
+    end
+end
+
+local workloads = {
+    { name = "orbit (Light)", run = orbitBindings },
+    { name = "orbit (LightFFI)", run = orbitFFI },
+    { name = "day/night (Light)", run = sunBindings },
+    { name = "day/night (LightFFI)", run = sunFFI }
+}
+
+Engine.async(function()
+    createLights()
+    Engine.log("Benchmark backend: " .. Engine.getScriptBackend())
+
+    for _, workload in ipairs(workloads) do
+        local total = 0
+        for round = 1, ROUNDS do
+            Engine.nextFrame():await()
+            local start = os.clock()
+            for iteration = 1, ITERATIONS do
+                workload.run(iteration * 0.01)
+            end
+            total = total + (os.clock() - start)
+        end
+        local calls = ROUNDS * ITERATIONS * LIGHT_COUNT
+        Engine.log(string.format("%-22s %8.3f ms total, %6.1f ns per light", workload.name,
+            total * 1000, total * 1e9 / calls))
+    end
+
+    for i = 1, LIGHT_COUNT do
+        Light.remove(lights[i])
+    end
+end)
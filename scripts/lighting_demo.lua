@@ -2,7 +2,6 @@
 print("Loading lighting demo...")
 
 -- Global variables
-local time = 0
 local lights = {}
 local cameraAngle = 0
 
@@ -33,25 +32,33 @@ function init()
         color = vec3(1, 1, 0.8),
         intensity = 8.0
     })
+    
+    -- Animations are evaluated natively every frame
+    Light.animate(lights.rotating, {
+        type = "orbit",
+        center = vec3(0, 2, 0),
+        radius = 3.0,
+        speed = 1.0,
+        bobAmplitude = 0.5,
+        bobSpeed = 2.0
+    })
+    
+    Light.animate(lights.pulsing, {
+        type = "pulse",
+        base = 2.0,
+        amplitude = 1.5,
+        speed = 4.0,
+        minimum = 0.1
+    })
+    
+    Light.animate(lights.spot, {
+        type = "colorCycle",
+        speed = vec3(0.5, 0.7, 0.3)
+    })
 end
 
 -- Update function called every frame
 function update(deltaTime)
-    time = time + deltaTime
-    
-    -- Rotate the orange light around the center
-    local radius = 3.0
-    local rotatingPos = vec3(
-        math.cos(time) * radius,
-        2.0 + math.sin(time * 2) * 0.5,
-        math.sin(time) * radius
-    )
-    Light.setPosition(lights.rotating, rotatingPos)
-    
-    -- Pulse the blue light
-    local pulseIntensity = 2.0 + math.sin(time * 4) * 1.5
-    Light.setIntensity(lights.pulsing, math.max(0.1, pulseIntensity))
-    
     -- Move camera in a circle
     cameraAngle = cameraAngle + deltaTime * 0.3
     local cameraPos = vec3(
@@ -61,12 +68,6 @@ function update(deltaTime)
     )
     Scene.setCameraPosition(cameraPos)
     Scene.setCameraTarget(vec3(0, 0, 0))
-    
-    -- Color cycling for the spotlight
-    local r = (math.sin(time * 0.5) + 1) * 0.5
-    local g = (math.sin(time * 0.7) + 1) * 0.5
-    local b = (math.sin(time * 0.3) + 1) * 0.5
-    Light.setColor(lights.spot, vec3(r, g, b))
 end
 
 -- Initialize when script loads
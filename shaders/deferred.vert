@@ -0,0 +1,64 @@
+#version 450
+
+#include "lights.glsl"
+
+#include "gpu_frame.glsl"
+
+// Must match DeferredPushConstants
+layout(push_constant) uniform DeferredConstants {
+    uint mode;
+} deferred;
+
+const uint MODE_FULLSCREEN = 0u;    // One triangle covering the screen (3 vertices)
+const uint MODE_LIGHT_VOLUMES = 1u; // A quad per light instance (6 vertices each)
+
+layout(location = 0) flat out uint lightIndex;
+layout(location = 1) flat out vec3 viewPos;
+layout(location = 2) flat out mat4 inverseViewProjection;
+
+// Corners of a quad as two triangles, bit 0 = x and bit 1 = y
+const uint QUAD_CORNERS[6] = uint[](0u, 1u, 2u, 2u, 1u, 3u);
+
+void main() {
+    mat4 viewProjection = ubo.proj * ubo.view;
+    inverseViewProjection = inverse(viewProjection);
+    viewPos = ubo.viewPos;
+    lightIndex = uint(gl_InstanceIndex);
+
+    if (deferred.mode == MODE_FULLSCREEN) {
+        vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+        gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+        return;
+    }
+
+    // Directional lights and unused slots are lit by the fullscreen pass;
+    // collapse their quads so nothing is rasterized
+    Light light = lightBuffer.lights[lightIndex];
+    if (lightIndex >= min(lightBuffer.lightCount, MAX_LIGHTS) || light.type == LIGHT_DIRECTIONAL) {
+        gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+        return;
+    }
+
+    // Screen rectangle bounding the light's sphere of influence. When the
+    // camera is inside or behind part of it, or the light is unbounded,
+    // shade the whole screen.
+    float radius = light.range;
+    vec2 lo = vec2(radius > 0.0 ? 1.0 : -1.0);
+    vec2 hi = vec2(radius > 0.0 ? -1.0 : 1.0);
+    for (int i = 0; radius > 0.0 && i < 8; ++i) {
+        vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(light.position + offset * radius, 1.0);
+        if (clip.w <= 0.0) {
+            lo = vec2(-1.0);
+            hi = vec2(1.0);
+            break;
+        }
+        lo = min(lo, clip.xy / clip.w);
+        hi = max(hi, clip.xy / clip.w);
+    }
+    lo = clamp(lo, vec2(-1.0), vec2(1.0));
+    hi = clamp(hi, vec2(-1.0), vec2(1.0));
+
+    uint corner = QUAD_CORNERS[gl_VertexIndex % 6];
+    gl_Position = vec4(mix(lo, hi, vec2(corner & 1u, corner >> 1)), 0.0, 1.0);
+}
@@ -0,0 +1,70 @@
+#version 450
+
+#include "pbr.glsl"
+
+// G-buffer written by gbuffer.frag plus depth (set 2)
+layout(set = 2, binding = 0) uniform sampler2D gbufferAlbedo;
+layout(set = 2, binding = 1) uniform sampler2D gbufferNormal;
+layout(set = 2, binding = 2) uniform sampler2D gbufferMaterial;
+layout(set = 2, binding = 3) uniform sampler2D gbufferDepth;
+
+// Must match DeferredPushConstants
+layout(push_constant) uniform DeferredConstants {
+    uint mode;
+} deferred;
+
+const uint MODE_FULLSCREEN = 0u;
+const uint MODE_LIGHT_VOLUMES = 1u;
+
+layout(location = 0) flat in uint lightIndex;
+layout(location = 1) flat in vec3 viewPos;
+layout(location = 2) flat in mat4 inverseViewProjection;
+
+// Accumulated with additive blending, tonemapped by tonemap.frag
+layout(location = 0) out vec4 outRadiance;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, texel, 0).r;
+    if (depth >= 1.0) {
+        discard; // Nothing was drawn here
+    }
+
+    vec2 ndc = (vec2(texel) + 0.5) / vec2(textureSize(gbufferDepth, 0)) * 2.0 - 1.0;
+    vec4 world = inverseViewProjection * vec4(ndc, depth, 1.0);
+
+    vec4 albedo = texelFetch(gbufferAlbedo, texel, 0);
+    vec2 material = texelFetch(gbufferMaterial, texel, 0).rg;
+
+    Surface surface;
+    surface.position = world.xyz / world.w;
+    surface.normal = normalize(texelFetch(gbufferNormal, texel, 0).xyz * 2.0 - 1.0);
+    surface.albedo = albedo.rgb;
+    surface.metallic = material.g;
+    surface.roughness = material.r;
+    surface.ao = albedo.a;
+
+    vec3 V = normalize(viewPos - surface.position);
+    vec3 F0 = SurfaceF0(surface);
+
+    vec3 radiance = vec3(0.0);
+    if (deferred.mode == MODE_FULLSCREEN) {
+        // Everything without a bounded volume: directional lights, the sun
+        // and ambient
+        uint lightCount = min(lightBuffer.lightCount, MAX_LIGHTS);
+        for (uint i = 0u; i < lightCount; ++i) {
+            if (lightBuffer.lights[i].type == LIGHT_DIRECTIONAL) {
+                radiance += ShadeLight(surface, V, F0, i, true);
+            }
+        }
+        radiance += ShadeSun(surface, V, F0) + Ambient(surface);
+    } else {
+        Light light = lightBuffer.lights[lightIndex];
+        if (light.range > 0.0 && distance(light.position, surface.position) > light.range) {
+            discard;
+        }
+        radiance = ShadeLight(surface, V, F0, lightIndex, false);
+    }
+
+    outRadiance = vec4(radiance, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "materials.glsl"
+
+// Deferred path: writes the surface attributes lighting needs. Position is
+// reconstructed from depth, so it is not stored. Formats must match the
+// G-buffer images RecordFrameGraph declares.
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    uint materialIndex;
+} draw;
+
+layout(location = 0) in vec3 fragPos;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) in vec3 viewPos;
+
+layout(location = 0) out vec4 outAlbedo;   // rgb albedo, a ambient occlusion
+layout(location = 1) out vec4 outNormal;   // xyz world normal * 0.5 + 0.5
+layout(location = 2) out vec2 outMaterial; // r roughness, g metallic
+
+void main() {
+    MaterialSample material = LoadMaterial(draw.materialIndex, fragTexCoord);
+
+    outAlbedo = vec4(material.albedo, material.ao);
+    outNormal = vec4(normalize(fragNormal) * 0.5 + 0.5, 0.0);
+    outMaterial = vec2(material.roughness, material.metallic);
+}
@@ -1,16 +1,22 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-struct Light {
-    vec3 position;
-    vec3 color;
-    float intensity;
-    int type; // 0=directional, 1=point, 2=spot
-};
+#include "pbr.glsl"
+#include "materials.glsl"
 
-layout(binding = 1) uniform LightBuffer {
-    uint lightCount;
-    Light lights[32];
-} lightBuffer;
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    uint materialIndex;
+} draw;
+
+// Pipeline variants chosen per frame from the light mix (see
+// VulkanRenderer::SetLightMix); the defaults describe the generic pipeline
+layout(constant_id = 0) const int LIGHT_TYPE_MASK = 7;   // Bit per light type present
+layout(constant_id = 1) const int FIXED_LIGHT_COUNT = 0; // 0 = read lightCount from the buffer
+layout(constant_id = 2) const bool SUN_ENABLED = true;
+
+const bool HAS_DIRECTIONAL = (LIGHT_TYPE_MASK & 1) != 0;
+const bool ONLY_DIRECTIONAL = LIGHT_TYPE_MASK == 1;
 
 layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragNormal;
@@ -19,107 +25,33 @@ layout(location = 3) in vec3 viewPos;
 
 layout(location = 0) out vec4 outColor;
 
-// Material properties (could be uniforms or textures)
-const vec3 albedo = vec3(0.8, 0.8, 0.8);
-const float metallic = 0.0;
-const float roughness = 0.5;
-const float ao = 1.0;
-
-// PBR lighting calculations
-vec3 getNormalFromMap() {
-    // For now, just use the vertex normal
-    return normalize(fragNormal);
-}
-
-float DistributionGGX(vec3 N, vec3 H, float roughness) {
-    float a = roughness * roughness;
-    float a2 = a * a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH * NdotH;
-    
-    float num = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = 3.14159265 * denom * denom;
-    
-    return num / denom;
-}
-
-float GeometrySchlickGGX(float NdotV, float roughness) {
-    float r = (roughness + 1.0);
-    float k = (r * r) / 8.0;
-    
-    float num = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-    
-    return num / denom;
-}
-
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
-    
-    return ggx1 * ggx2;
-}
+void main() {
+    MaterialSample material = LoadMaterial(draw.materialIndex, fragTexCoord);
 
-vec3 fresnelSchlick(float cosTheta, vec3 F0) {
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
-}
+    Surface surface;
+    surface.position = fragPos;
+    surface.normal = normalize(fragNormal); // For now, just use the vertex normal
+    surface.albedo = material.albedo;
+    surface.metallic = material.metallic;
+    surface.roughness = material.roughness;
+    surface.ao = material.ao;
 
-void main() {
-    vec3 N = getNormalFromMap();
     vec3 V = normalize(viewPos - fragPos);
-    
-    // Calculate reflectance at normal incidence
-    vec3 F0 = vec3(0.04);
-    F0 = mix(F0, albedo, metallic);
+    vec3 F0 = SurfaceF0(surface);
     
     vec3 Lo = vec3(0.0);
     
-    // Calculate lighting for each light
-    for(uint i = 0u; i < lightBuffer.lightCount && i < 32u; ++i) {
-        Light light = lightBuffer.lights[i];
-        
-        vec3 L;
-        float attenuation = 1.0;
-        
-        if(light.type == 0) { // Directional light
-            L = normalize(-light.position); // Position stores direction for directional lights
-        } else { // Point or spot light
-            L = normalize(light.position - fragPos);
-            float distance = length(light.position - fragPos);
-            attenuation = 1.0 / (distance * distance);
-        }
-        
-        vec3 H = normalize(V + L);
-        vec3 radiance = light.color * light.intensity * attenuation;
-        
-        // Cook-Torrance BRDF
-        float NDF = DistributionGGX(N, H, roughness);
-        float G = GeometrySmith(N, V, L, roughness);
-        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-        
-        vec3 kS = F;
-        vec3 kD = vec3(1.0) - kS;
-        kD *= 1.0 - metallic;
-        
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
-        vec3 specular = numerator / denominator;
-        
-        float NdotL = max(dot(N, L), 0.0);
-        Lo += (kD * albedo / 3.14159265 + specular) * radiance * NdotL;
+    // Calculate lighting for each light. With a fixed count the loop is
+    // unrolled, and type checks the variant rules out are compiled away.
+    uint lightCount = FIXED_LIGHT_COUNT > 0 ? uint(FIXED_LIGHT_COUNT) : min(lightBuffer.lightCount, MAX_LIGHTS);
+    for(uint i = 0u; LIGHT_TYPE_MASK != 0 && i < lightCount; ++i) {
+        bool directional = ONLY_DIRECTIONAL || (HAS_DIRECTIONAL && lightBuffer.lights[i].type == LIGHT_DIRECTIONAL);
+        Lo += ShadeLight(surface, V, F0, i, directional);
+    }
+
+    if (SUN_ENABLED) {
+        Lo += ShadeSun(surface, V, F0);
     }
     
-    // Ambient lighting
-    vec3 ambient = vec3(0.03) * albedo * ao;
-    vec3 color = ambient + Lo;
-    
-    // HDR tonemapping
-    color = color / (color + vec3(1.0));
-    // Gamma correction
-    color = pow(color, vec3(1.0/2.2));
-    
-    outColor = vec4(color, 1.0);
-}
\ No newline at end of file
+    outColor = vec4(Tonemap(Ambient(surface) + Lo), 1.0);
+}
@@ -1,12 +1,12 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
+#include "gpu_frame.glsl"
+
+// Per-draw data; must match DrawPushConstants
+layout(push_constant) uniform DrawConstants {
     mat4 model;
-    mat4 view;
-    mat4 proj;
-    vec3 viewPos;
-    float time;
-} ubo;
+    uint materialIndex;
+} draw;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -17,9 +17,13 @@ layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out vec3 viewPos;
 
+// The depth prepass runs this shader in another pipeline; the lighting
+// pass tests EQUAL against its depth, so positions must match exactly
+invariant gl_Position;
+
 void main() {
-    fragPos = vec3(ubo.model * vec4(inPosition, 1.0));
-    fragNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
+    fragPos = vec3(draw.model * vec4(inPosition, 1.0));
+    fragNormal = mat3(transpose(inverse(draw.model))) * inNormal;
     fragTexCoord = inTexCoord;
     viewPos = ubo.viewPos;
     
@@ -0,0 +1,33 @@
+// Light buffer shared by the forward and deferred lighting shaders. The
+// Light struct, the buffer block and the type constants are generated from
+// LightData; see VulkanRenderer.h.
+
+#include "gpu_lights.glsl"
+
+// Inverse of EncodeUnitVector (octahedral mapping)
+vec3 DecodeUnitVector(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// Smoothly reaches zero at the light's range so its influence is bounded
+float RangeAttenuation(Light light, float distance) {
+    if (light.range <= 0.0) {
+        return 1.0;
+    }
+    float ratio = distance / light.range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
+
+// L points from the surface towards the light
+float SpotAttenuation(Light light, vec3 L) {
+    if (light.type != LIGHT_SPOT) {
+        return 1.0;
+    }
+    float cosAngle = dot(-L, DecodeUnitVector(light.direction));
+    float t = clamp((cosAngle - light.cosOuterCone) / max(light.cosInnerCone - light.cosOuterCone, 1e-4), 0.0, 1.0);
+    return t * t;
+}
@@ -0,0 +1,42 @@
+// Material table and bindless textures (sets 0 and 1), shared by the
+// forward lighting and G-buffer shaders. Requires GL_EXT_nonuniform_qualifier.
+
+// Material table indexed by the push constant; texture fields are slots
+// in the bindless array (set 1). The struct is generated from MaterialData.
+#include "gpu_materials.glsl"
+
+layout(std430, binding = 4) readonly buffer MaterialBuffer {
+    Material materials[];
+} materialBuffer;
+
+layout(set = 1, binding = 0) uniform sampler2D bindlessTextures[];
+
+const uint INVALID_BINDLESS_INDEX = 0xFFFFFFFFu;
+
+struct MaterialSample {
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+};
+
+MaterialSample LoadMaterial(uint materialIndex, vec2 texCoord) {
+    Material material = materialBuffer.materials[materialIndex];
+    MaterialSample result;
+    result.albedo = material.albedo.rgb;
+    result.metallic = material.metallic;
+    result.roughness = material.roughness;
+    result.ao = material.ao;
+
+    // Slots are uniform per draw today; nonuniformEXT keeps this correct
+    // once draws are merged
+    if (material.albedoTexture != INVALID_BINDLESS_INDEX) {
+        result.albedo *= texture(bindlessTextures[nonuniformEXT(material.albedoTexture)], texCoord).rgb;
+    }
+    if (material.metallicRoughnessTexture != INVALID_BINDLESS_INDEX) {
+        vec4 texel = texture(bindlessTextures[nonuniformEXT(material.metallicRoughnessTexture)], texCoord);
+        result.roughness *= texel.g;
+        result.metallic *= texel.b;
+    }
+    return result;
+}
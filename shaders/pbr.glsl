@@ -0,0 +1,188 @@
+// Shadowing and Cook-Torrance shading shared by the forward and deferred
+// lighting shaders
+
+#include "lights.glsl"
+
+// Shadow atlas: sun cascades plus spot (one tile) and point (six tiles) maps.
+// Rects are UV offset (xy) and scale (zw); must match ShadowUniforms.
+layout(binding = 2) uniform sampler2DShadow shadowAtlas;
+
+layout(binding = 3) uniform ShadowBuffer {
+    mat4 cascadeViewProjection[4];
+    vec4 cascadeRects[4];
+    vec4 sunDirection; // w = 1 when the sun casts shadows
+    vec4 sunColor;
+    ivec4 lightTiles[32]; // x = first tile, y = tile count
+    mat4 tileViewProjection[64];
+    vec4 tileRects[64];
+} shadows;
+
+// Everything shading needs about one visible point, whether it comes from
+// the rasterizer (forward) or the G-buffer (deferred)
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ao;
+};
+
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+    
+    float num = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = 3.14159265 * denom * denom;
+    
+    return num / denom;
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+    float r = (roughness + 1.0);
+    float k = (r * r) / 8.0;
+    
+    float num = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+    
+    return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+    
+    return ggx1 * ggx2;
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+// Returns -1 when the position falls outside the map so callers can try another
+float SampleShadowTile(mat4 viewProjection, vec4 rect, vec3 worldPos) {
+    vec4 clip = viewProjection * vec4(worldPos, 1.0);
+    if (clip.w <= 0.0) {
+        return -1.0;
+    }
+    vec3 ndc = clip.xyz / clip.w;
+    vec2 uv = ndc.xy * 0.5 + 0.5;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))) || ndc.z > 1.0) {
+        return -1.0;
+    }
+
+    // Stay half a texel inside the tile so filtering never reads a neighbour
+    vec2 halfTexel = 0.5 / vec2(textureSize(shadowAtlas, 0));
+    vec2 atlasUV = clamp(rect.xy + uv * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+    return texture(shadowAtlas, vec3(atlasUV, ndc.z - 0.0005));
+}
+
+float SunShadow(Surface surface) {
+    if (shadows.sunDirection.w < 0.5) {
+        return 1.0;
+    }
+
+    // Cascades are ordered near to far; use the first that contains the point
+    vec3 N = surface.normal;
+    vec3 L = -shadows.sunDirection.xyz;
+    vec3 offsetPos = surface.position + N * 0.02 * (1.0 - max(dot(N, L), 0.0));
+    for (int i = 0; i < 4; ++i) {
+        float shadow = SampleShadowTile(shadows.cascadeViewProjection[i], shadows.cascadeRects[i], offsetPos);
+        if (shadow >= 0.0) {
+            return shadow;
+        }
+    }
+    return 1.0;
+}
+
+float LightShadow(uint lightIndex, vec3 lightPos, vec3 worldPos) {
+    ivec4 tiles = shadows.lightTiles[lightIndex];
+    if (tiles.y == 0) {
+        return 1.0;
+    }
+
+    int tile = tiles.x;
+    if (tiles.y == 6) {
+        // Cube faces in +X, -X, +Y, -Y, +Z, -Z order; pick the major axis
+        vec3 d = worldPos - lightPos;
+        vec3 a = abs(d);
+        if (a.x >= a.y && a.x >= a.z) {
+            tile += d.x >= 0.0 ? 0 : 1;
+        } else if (a.y >= a.z) {
+            tile += d.y >= 0.0 ? 2 : 3;
+        } else {
+            tile += d.z >= 0.0 ? 4 : 5;
+        }
+    }
+
+    float shadow = SampleShadowTile(shadows.tileViewProjection[tile], shadows.tileRects[tile], worldPos);
+    return shadow >= 0.0 ? shadow : 1.0;
+}
+
+// Cook-Torrance BRDF times the cosine term, for unit radiance
+vec3 EvaluateBRDF(Surface surface, vec3 V, vec3 L, vec3 F0) {
+    vec3 N = surface.normal;
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, surface.roughness);
+    float G = GeometrySmith(N, V, L, surface.roughness);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - surface.metallic;
+
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
+    vec3 specular = numerator / denominator;
+
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * surface.albedo / 3.14159265 + specular) * NdotL;
+}
+
+// Reflectance at normal incidence
+vec3 SurfaceF0(Surface surface) {
+    return mix(vec3(0.04), surface.albedo, surface.metallic);
+}
+
+// Light i's contribution
+vec3 ShadeLight(Surface surface, vec3 V, vec3 F0, uint lightIndex, bool directional) {
+    Light light = lightBuffer.lights[lightIndex];
+
+    vec3 L;
+    float attenuation = 1.0;
+    float shadow = 1.0;
+
+    if (directional) {
+        L = -DecodeUnitVector(light.direction);
+    } else { // Point or spot light
+        vec3 toLight = light.position - surface.position;
+        float distance = length(toLight);
+        L = toLight / distance;
+        attenuation = RangeAttenuation(light, distance) * SpotAttenuation(light, L) / (distance * distance);
+        shadow = LightShadow(lightIndex, light.position, surface.position);
+    }
+
+    vec3 radiance = light.color * attenuation;
+    return EvaluateBRDF(surface, V, L, F0) * radiance * shadow;
+}
+
+vec3 ShadeSun(Surface surface, vec3 V, vec3 F0) {
+    vec3 sunL = normalize(-shadows.sunDirection.xyz);
+    return EvaluateBRDF(surface, V, sunL, F0) * shadows.sunColor.rgb * SunShadow(surface);
+}
+
+vec3 Ambient(Surface surface) {
+    return vec3(0.03) * surface.albedo * surface.ao;
+}
+
+// HDR tonemapping and gamma correction
+vec3 Tonemap(vec3 color) {
+    color = color / (color + vec3(1.0));
+    return pow(color, vec3(1.0/2.2));
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(push_constant) uniform ShadowPushConstants {
+    mat4 viewProjection;
+} pushConstants;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = pushConstants.viewProjection * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 450
+
+#include "pbr.glsl"
+
+// Lighting accumulated by the deferred passes (set 2)
+layout(set = 2, binding = 4) uniform sampler2D lightAccumulation;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 color = texelFetch(lightAccumulation, ivec2(gl_FragCoord.xy), 0).rgb;
+    outColor = vec4(Tonemap(color), 1.0);
+}
@@ -0,0 +1,242 @@
+#include "BVH.h"
+#include <cassert>
+#include <cstdlib>
+
+BVH::BVH(float margin) : m_margin(margin) {}
+
+int32_t BVH::AllocateNode() {
+    if (m_freeList == NULL_NODE) {
+        // Grow the pool and thread the new nodes onto the free list
+        int32_t oldCapacity = static_cast<int32_t>(m_nodes.size());
+        int32_t newCapacity = std::max(16, oldCapacity * 2);
+        m_nodes.resize(newCapacity);
+        for (int32_t i = oldCapacity; i < newCapacity - 1; i++) {
+            m_nodes[i].parent = i + 1;
+            m_nodes[i].height = -1;
+        }
+        m_nodes[newCapacity - 1].parent = NULL_NODE;
+        m_nodes[newCapacity - 1].height = -1;
+        m_freeList = oldCapacity;
+    }
+
+    int32_t nodeId = m_freeList;
+    Node& node = m_nodes[nodeId];
+    m_freeList = node.parent;
+
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    node.userData = 0;
+    return nodeId;
+}
+
+void BVH::FreeNode(int32_t nodeId) {
+    m_nodes[nodeId].parent = m_freeList;
+    m_nodes[nodeId].height = -1;
+    m_freeList = nodeId;
+}
+
+int32_t BVH::CreateProxy(const AABB& bounds, uint32_t userData) {
+    int32_t proxy = AllocateNode();
+    m_nodes[proxy].bounds = bounds.Expanded(m_margin);
+    m_nodes[proxy].userData = userData;
+
+    InsertLeaf(proxy);
+    m_proxyCount++;
+    return proxy;
+}
+
+void BVH::DestroyProxy(int32_t proxy) {
+    assert(proxy >= 0 && proxy < static_cast<int32_t>(m_nodes.size()) && m_nodes[proxy].IsLeaf());
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    m_proxyCount--;
+}
+
+bool BVH::MoveProxy(int32_t proxy, const AABB& bounds) {
+    // Still inside the fat box: nothing to refit
+    if (m_nodes[proxy].bounds.Contains(bounds)) {
+        return false;
+    }
+
+    RemoveLeaf(proxy);
+    m_nodes[proxy].bounds = bounds.Expanded(m_margin);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void BVH::InsertLeaf(int32_t leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling with the lowest surface-area cost
+    AABB leafBounds = m_nodes[leaf].bounds;
+    int32_t index = m_root;
+    while (!m_nodes[index].IsLeaf()) {
+        const Node& node = m_nodes[index];
+        float area = node.bounds.SurfaceArea();
+        float combinedArea = AABB::Union(node.bounds, leafBounds).SurfaceArea();
+
+        // Cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto childCost = [&](int32_t child) {
+            AABB merged = AABB::Union(leafBounds, m_nodes[child].bounds);
+            if (m_nodes[child].IsLeaf()) {
+                return merged.SurfaceArea() + inheritanceCost;
+            }
+            return merged.SurfaceArea() - m_nodes[child].bounds.SurfaceArea() + inheritanceCost;
+        };
+
+        float cost1 = childCost(node.child1);
+        float cost2 = childCost(node.child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    int32_t sibling = index;
+
+    // Create a new parent joining the sibling and the leaf
+    int32_t oldParent = m_nodes[sibling].parent;
+    int32_t newParent = AllocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].bounds = AABB::Union(leafBounds, m_nodes[sibling].bounds);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent != NULL_NODE) {
+        if (m_nodes[oldParent].child1 == sibling) {
+            m_nodes[oldParent].child1 = newParent;
+        } else {
+            m_nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        m_root = newParent;
+    }
+
+    RefitAncestors(m_nodes[leaf].parent);
+}
+
+void BVH::RemoveLeaf(int32_t leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    int32_t parent = m_nodes[leaf].parent;
+    int32_t grandParent = m_nodes[parent].parent;
+    int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    if (grandParent != NULL_NODE) {
+        // Replace the parent with the sibling and refit upwards
+        if (m_nodes[grandParent].child1 == parent) {
+            m_nodes[grandParent].child1 = sibling;
+        } else {
+            m_nodes[grandParent].child2 = sibling;
+        }
+        m_nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+        RefitAncestors(grandParent);
+    } else {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+    }
+}
+
+void BVH::RefitAncestors(int32_t index) {
+    while (index != NULL_NODE) {
+        index = Balance(index);
+
+        Node& node = m_nodes[index];
+        const Node& child1 = m_nodes[node.child1];
+        const Node& child2 = m_nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.bounds = AABB::Union(child1.bounds, child2.bounds);
+
+        index = node.parent;
+    }
+}
+
+// Performs a left or right rotation if node A is imbalanced and returns the
+// new root of the subtree
+int32_t BVH::Balance(int32_t iA) {
+    Node* A = &m_nodes[iA];
+    if (A->IsLeaf() || A->height < 2) {
+        return iA;
+    }
+
+    int32_t iB = A->child1;
+    int32_t iC = A->child2;
+    Node* B = &m_nodes[iB];
+    Node* C = &m_nodes[iC];
+
+    int32_t balance = C->height - B->height;
+
+    auto rotate = [&](int32_t iUp, Node* up, int32_t iOther, Node* other, bool upIsChild2) {
+        int32_t iF = up->child1;
+        int32_t iG = up->child2;
+        Node* F = &m_nodes[iF];
+        Node* G = &m_nodes[iG];
+
+        // Swap A and the raised child
+        up->child1 = iA;
+        up->parent = A->parent;
+        A->parent = iUp;
+
+        if (up->parent != NULL_NODE) {
+            if (m_nodes[up->parent].child1 == iA) {
+                m_nodes[up->parent].child1 = iUp;
+            } else {
+                m_nodes[up->parent].child2 = iUp;
+            }
+        } else {
+            m_root = iUp;
+        }
+
+        // Keep the taller grandchild under the raised node
+        int32_t iKeep = F->height > G->height ? iF : iG;
+        int32_t iMove = F->height > G->height ? iG : iF;
+        Node* keep = &m_nodes[iKeep];
+        Node* move = &m_nodes[iMove];
+
+        up->child2 = iKeep;
+        if (upIsChild2) {
+            A->child2 = iMove;
+        } else {
+            A->child1 = iMove;
+        }
+        move->parent = iA;
+
+        A->bounds = AABB::Union(other->bounds, move->bounds);
+        up->bounds = AABB::Union(A->bounds, keep->bounds);
+        A->height = 1 + std::max(other->height, move->height);
+        up->height = 1 + std::max(A->height, keep->height);
+        return iUp;
+    };
+
+    // Rotate C up
+    if (balance > 1) {
+        return rotate(iC, C, iB, B, true);
+    }
+
+    // Rotate B up
+    if (balance < -1) {
+        return rotate(iB, B, iC, C, false);
+    }
+
+    return iA;
+}
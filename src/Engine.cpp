@@ -3,8 +3,20 @@
 #include "LuaManager.h"
 #include "LightingSystem.h"
 #include "Scene.h"
+#include "ShadowSystem.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "VulkanRendererHelpers.h"
+#include "Snapshot.h"
+#include "TextureStreamer.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <span>
+#include <string_view>
 
 Engine::Engine() = default;
 Engine::~Engine() = default;
@@ -17,7 +29,7 @@ bool Engine::Initialize() {
     }
     
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
     
     GLFWwindow* window = glfwCreateWindow(1280, 720, "Vulkan Lua Engine", nullptr, nullptr);
     if (!window) {
@@ -27,13 +39,36 @@ bool Engine::Initialize() {
     }
     
     // Initialize subsystems
+    m_jobSystem = std::make_unique<JobSystem>();
     m_renderer = std::make_unique<VulkanRenderer>();
-    if (!m_renderer->Initialize(window)) {
+    if (!m_renderer->Initialize(window, m_jobSystem.get())) {
         return false;
     }
     
-    m_lightingSystem = std::make_unique<LightingSystem>();
+    m_window = window;
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int, int) {
+        auto* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        engine->m_renderer->NotifyFramebufferResized();
+    });
+    glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int, int action, int mods) {
+        auto* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        // During playback keys come from the log instead
+        if (engine->m_replay.GetMode() == ReplayMode::Playback) {
+            return;
+        }
+        engine->m_replay.RecordKey({key, action, mods});
+        engine->HandleKey(key, action, mods);
+    });
+    
     m_scene = std::make_unique<Scene>();
+    m_scene->GetRegistry().SetJobSystem(m_jobSystem.get());
+    m_lightingSystem = std::make_unique<LightingSystem>(m_scene->GetRegistry());
+    
+    ShadowSettings shadowSettings;
+    shadowSettings.atlasSize = m_renderer->GetShadowAtlasSize();
+    m_shadowSystem = std::make_unique<ShadowSystem>(shadowSettings);
+    m_frameAllocator = std::make_unique<FrameAllocator>(MAX_FRAMES_IN_FLIGHT);
     
     m_luaManager = std::make_unique<LuaManager>();
     if (!m_luaManager->Initialize(this)) {
@@ -43,55 +78,185 @@ bool Engine::Initialize() {
     // Load initial Lua scripts
     m_luaManager->LoadScript("scripts/lighting_demo.lua");
     
+    // Capture hooks for automated performance runs: ENGINE_RECORD=<log>
+    // records the session, ENGINE_REPLAY=<log> plays one back and quits when
+    // it ends (as fast as possible with ENGINE_REPLAY_SPEED=max)
+    if (const char* replayPath = std::getenv("ENGINE_REPLAY")) {
+        const char* speed = std::getenv("ENGINE_REPLAY_SPEED");
+        bool maxSpeed = speed && std::string_view(speed) == "max";
+        StartReplay(replayPath, maxSpeed ? ReplaySpeed::Maximum : ReplaySpeed::Recorded, true);
+    } else if (const char* recordPath = std::getenv("ENGINE_RECORD")) {
+        StartRecording(recordPath);
+    }
+    
     m_isRunning = true;
+    m_elapsedTime = 0.0f;
     m_lastFrameTime = std::chrono::high_resolution_clock::now();
     
     return true;
 }
 
 void Engine::Run() {
-    GLFWwindow* window = glfwGetCurrentContext();
+    // Vulkan windows have no GL context, so the handle is kept rather than
+    // taken from glfwGetCurrentContext
+    GLFWwindow* window = m_window;
     
     while (m_isRunning && !glfwWindowShouldClose(window)) {
+        // Nothing can be presented while minimized; sleep until restored.
+        // Checked before the frame wait, which in LowLatency mode acquires
+        // a swap chain image that skipping the frame would never present.
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        if (width == 0 || height == 0) {
+            glfwWaitEvents();
+            m_lastFrameTime = std::chrono::high_resolution_clock::now();
+            continue;
+        }
+        
+        // Wait for the frame slot before polling, so the input this frame
+        // simulates is as recent as the pacing mode allows
+        m_renderer->WaitForNextFrame();
         glfwPollEvents();
         
+        ApplyReplayRequests();
+        
         auto currentTime = std::chrono::high_resolution_clock::now();
-        float deltaTime = std::chrono::duration<float>(currentTime - m_lastFrameTime).count();
+        VkExtent2D extent = m_renderer->GetSwapChainExtent();
+        ReplayFrame frame;
+        frame.deltaTime = std::chrono::duration<float>(currentTime - m_lastFrameTime).count();
+        frame.width = extent.width;
+        frame.height = extent.height;
         m_lastFrameTime = currentTime;
         
-        Update(deltaTime);
+        // A replayed frame takes its delta, aspect ratio and keys from the log
+        if (m_replay.GetMode() == ReplayMode::Playback) {
+            if (m_replay.NextFrame(frame, m_replayKeys)) {
+                for (const ReplayKeyEvent& event : m_replayKeys) {
+                    HandleKey(event.key, event.action, event.mods);
+                }
+            } else if (m_quitAfterReplay) {
+                m_isRunning = false;
+                break;
+            }
+        } else {
+            m_replay.RecordFrame(frame);
+        }
+        m_scene->SetTargetAspectRatio(CalculateAspectRatio(frame.width, frame.height));
+        
+        // Update and render both draw transient data from this frame's arena
+        m_frameAllocator->BeginFrame(m_renderer->GetCurrentFrame());
+        uint64_t allocationsBefore = GetHeapAllocationCount();
+        auto updateStart = std::chrono::high_resolution_clock::now();
+        Update(frame.deltaTime);
+        
+        // Checking shader timestamps every frame would stat files for nothing
+        m_shaderReloadTimer += frame.deltaTime;
+        if (m_shaderReloadTimer >= SHADER_RELOAD_INTERVAL) {
+            m_shaderReloadTimer = 0.0f;
+            m_renderer->ReloadChangedShaders();
+        }
+        
+        auto renderStart = std::chrono::high_resolution_clock::now();
         Render();
+        auto renderEnd = std::chrono::high_resolution_clock::now();
+        m_frameHeapAllocations = GetHeapAllocationCount() - allocationsBefore;
+        
+        m_replay.ReportFrameTiming(std::chrono::duration<float, std::milli>(renderStart - updateStart).count(),
+                                   std::chrono::duration<float, std::milli>(renderEnd - renderStart).count());
+    }
+}
+
+void Engine::SetFullscreen(bool fullscreen) {
+    GLFWwindow* window = m_window;
+    if (fullscreen == IsFullscreen()) {
+        return;
+    }
+    
+    if (fullscreen) {
+        glfwGetWindowPos(window, &m_windowedX, &m_windowedY);
+        glfwGetWindowSize(window, &m_windowedWidth, &m_windowedHeight);
+        
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+    } else {
+        glfwSetWindowMonitor(window, nullptr, m_windowedX, m_windowedY,
+                             m_windowedWidth, m_windowedHeight, GLFW_DONT_CARE);
+    }
+    
+    // The framebuffer size callback flags the swap chain for recreation
+}
+
+bool Engine::IsFullscreen() const {
+    return glfwGetWindowMonitor(m_window) != nullptr;
+}
+
+void Engine::HandleKey(int key, int action, int mods) {
+    bool altEnter = key == GLFW_KEY_ENTER && (mods & GLFW_MOD_ALT);
+    if (action == GLFW_PRESS && (key == GLFW_KEY_F11 || altEnter)) {
+        SetFullscreen(!IsFullscreen());
     }
 }
 
 void Engine::Update(float deltaTime) {
+    ApplyPendingSnapshot();
+    
     // Update lighting system
     m_lightingSystem->Update(deltaTime);
     
     // Call Lua update callbacks
     m_luaManager->CallUpdate(deltaTime);
     
-    // Update scene
-    // m_scene->Update(deltaTime);
+    // Update scene (rebuilds camera matrices that scripts changed this frame)
+    m_elapsedTime += deltaTime;
+    m_scene->Update(deltaTime);
 }
 
 void Engine::Render() {
-    m_renderer->BeginFrame();
+    // Light lists only live for this frame, so they come from its arena
+    std::pmr::memory_resource* frameMemory = m_frameAllocator->GetResource();
+    std::pmr::vector<Light> lights = m_lightingSystem->GetActiveLights(frameMemory);
+    
+    // Plan shadow maps before the frame is recorded; only tiles whose
+    // matrix changed or that a moved caster touches are redrawn
+    if (const Camera* camera = m_scene->GetActiveCameraComponent()) {
+        VkExtent2D extent = m_renderer->GetSwapChainExtent();
+        m_shadowSystem->Update(*camera, lights, *m_lightingSystem, m_scene->GetChangedBounds(), extent.height);
+        m_renderer->UpdateShadows(m_shadowSystem->GetUniforms(), m_shadowSystem->GetRenderViews());
+    }
+    m_scene->ClearChangedBounds();
     
-    // Update uniforms
+    m_renderer->SetLightMix(m_lightingSystem->GetLightMix());
+    if (!m_renderer->BeginFrame()) {
+        return; // Swap chain was out of date; retry next frame
+    }
+    
+    // Update uniforms from the active camera's cached matrices
     UniformBufferObject ubo{};
-    // Fill UBO with current camera and world data...
+    ubo.model = glm::mat4(1.0f);
+    if (const Camera* camera = m_scene->GetActiveCameraComponent()) {
+        ubo.view = camera->view;
+        ubo.proj = camera->projection;
+        ubo.viewPos = camera->position;
+    }
+    ubo.time = m_elapsedTime;
+    ubo.ambientLight = m_lightingSystem->GetAmbientLight();
+    ubo.numLights = static_cast<int>(std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS)));
     m_renderer->UpdateUniforms(ubo);
     
-    // Update lighting data
-    auto lights = m_lightingSystem->GetActiveLights();
-    std::vector<LightData> lightData;
-    for (const auto& light : lights) {
+    // The renderer keeps the first MAX_LIGHTS, so only those are packed
+    std::pmr::vector<LightData> lightData(frameMemory);
+    size_t packedCount = static_cast<size_t>(ubo.numLights);
+    lightData.reserve(packedCount);
+    for (const auto& light : std::span(lights).first(packedCount)) {
         LightData data{};
         data.position = light.position;
-        data.color = light.color;
-        data.intensity = light.intensity;
-        data.type = static_cast<int>(light.type);
+        data.range = light.type == LightType::Directional ? 0.0f : light.range;
+        data.color = light.color * light.intensity;
+        data.type = static_cast<uint32_t>(light.type);
+        data.direction = EncodeUnitVector(light.direction);
+        data.cosInnerCone = std::cos(glm::radians(light.innerCone));
+        data.cosOuterCone = std::cos(glm::radians(light.outerCone));
         lightData.push_back(data);
     }
     m_renderer->UpdateLights(lightData);
@@ -99,7 +264,158 @@ void Engine::Render() {
     m_renderer->EndFrame();
 }
 
+bool Engine::CaptureSnapshot(std::vector<std::byte>& snapshot) {
+    try {
+        SnapshotWriter writer;
+        m_lightingSystem->WriteSnapshot(writer);
+        m_luaManager->WriteSnapshot(writer);
+        snapshot = writer.Finish();
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to capture snapshot: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool Engine::RestoreSnapshot(std::span<const std::byte> snapshot) {
+    std::vector<std::byte> backup;
+    try {
+        // Open verifies the checksum, so a damaged snapshot is rejected
+        // before any state is touched
+        SnapshotReader reader = SnapshotReader::Open(snapshot);
+        
+        // Lighting is applied before the scripts, so a script section that
+        // fails would otherwise leave the two out of step
+        if (!CaptureSnapshot(backup)) {
+            return false;
+        }
+        m_lightingSystem->ReadSnapshot(reader);
+        m_luaManager->ReadSnapshot(reader);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to restore snapshot: " << e.what() << std::endl;
+    }
+    
+    if (!backup.empty()) {
+        try {
+            SnapshotReader reader = SnapshotReader::Open(backup);
+            m_lightingSystem->ReadSnapshot(reader);
+            m_luaManager->ReadSnapshot(reader);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to roll back snapshot restore: " << e.what() << std::endl;
+        }
+    }
+    return false;
+}
+
+bool Engine::SaveSnapshot(const std::string& path) {
+    std::vector<std::byte> snapshot;
+    return CaptureSnapshot(snapshot) && WriteSnapshotFile(path, snapshot);
+}
+
+bool Engine::LoadSnapshot(const std::string& path) {
+    try {
+        MappedFile file(path);
+        return RestoreSnapshot(std::span(reinterpret_cast<const std::byte*>(file.GetData()), file.GetSize()));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to load snapshot: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void Engine::RequestSnapshotRestore(std::shared_ptr<const std::vector<std::byte>> snapshot) {
+    m_pendingSnapshot = std::move(snapshot);
+    m_pendingSnapshotPath.clear();
+}
+
+void Engine::RequestSnapshotLoad(const std::string& path) {
+    m_pendingSnapshotPath = path;
+    m_pendingSnapshot.reset();
+}
+
+void Engine::ApplyPendingSnapshot() {
+    if (m_pendingSnapshot) {
+        std::shared_ptr<const std::vector<std::byte>> snapshot = std::move(m_pendingSnapshot);
+        RestoreSnapshot(*snapshot);
+    } else if (!m_pendingSnapshotPath.empty()) {
+        std::string path = std::move(m_pendingSnapshotPath);
+        m_pendingSnapshotPath.clear();
+        LoadSnapshot(path);
+    }
+}
+
+void Engine::StartRecording(const std::string& path) {
+    m_pendingRecordPath = path;
+    m_pendingReplayPath.clear();
+}
+
+void Engine::StartReplay(const std::string& path, ReplaySpeed speed, bool quitWhenDone) {
+    m_pendingReplayPath = path;
+    m_pendingReplaySpeed = speed;
+    m_quitAfterReplay = quitWhenDone;
+    m_pendingRecordPath.clear();
+}
+
+void Engine::StopReplay() {
+    m_stopReplayRequested = true;
+    m_pendingRecordPath.clear();
+    m_pendingReplayPath.clear();
+}
+
+void Engine::ApplyReplayRequests() {
+    if (m_stopReplayRequested) {
+        m_stopReplayRequested = false;
+        m_replay.Stop();
+    }
+    
+    if (!m_pendingRecordPath.empty()) {
+        std::string path = std::move(m_pendingRecordPath);
+        m_pendingRecordPath.clear();
+        
+        // A restore still pending would change the state after the
+        // recording's start snapshot was taken
+        ApplyPendingSnapshot();
+        
+        // Suspended coroutines are not in the snapshot, so a replay could
+        // not resume them where the recording did
+        if (m_luaManager->HasPendingAsync()) {
+            std::cerr << "Cannot record " << path << ": scripts have Engine.async work pending" << std::endl;
+            return;
+        }
+        std::vector<std::byte> snapshot;
+        uint32_t seed = std::random_device{}();
+        if (CaptureSnapshot(snapshot) && m_replay.StartRecording(path, snapshot, seed)) {
+            m_luaManager->SeedRandom(seed);
+        }
+    } else if (!m_pendingReplayPath.empty()) {
+        std::string path = std::move(m_pendingReplayPath);
+        m_pendingReplayPath.clear();
+        
+        bool started = m_replay.StartPlayback(path, m_pendingReplaySpeed);
+        if (started) {
+            // Recordings start with no async work pending (see above)
+            m_pendingSnapshot.reset();
+            m_pendingSnapshotPath.clear();
+            m_luaManager->CancelAsync("replay started");
+            if (RestoreSnapshot(m_replay.GetStartSnapshot())) {
+                m_luaManager->SeedRandom(m_replay.GetSeed());
+            } else {
+                m_replay.Stop();
+                started = false;
+            }
+        }
+        if (!started && m_quitAfterReplay) {
+            m_isRunning = false;
+        }
+    }
+}
+
 void Engine::Shutdown() {
+    m_replay.Stop();
     m_luaManager.reset();
     m_renderer->Cleanup();
     m_renderer.reset();
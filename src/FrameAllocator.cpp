@@ -0,0 +1,139 @@
+#include "FrameAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// =============================================================================
+// FRAME ARENA
+// =============================================================================
+
+FrameArena::FrameArena(size_t capacity)
+    : m_block(std::make_unique<std::byte[]>(capacity)), m_capacity(capacity) {
+}
+
+void FrameArena::Reset() {
+    if (!m_overflow.empty()) {
+        // Grow to the peak with headroom so this frame's size never spills again
+        m_overflow.clear();
+        m_capacity = std::max(m_capacity * 2, m_peak + m_peak / 2);
+        m_block = std::make_unique<std::byte[]>(m_capacity);
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+    // Usage includes alignment padding, so the peak is what a block needs
+    // to hold the whole frame
+    void* pointer = m_block.get() + m_offset;
+    size_t space = m_capacity - m_offset;
+    if (std::align(alignment, bytes, pointer, space)) {
+        size_t end = m_capacity - space + bytes;
+        m_used += end - m_offset;
+        m_peak = std::max(m_peak, m_used);
+        m_offset = end;
+        return pointer;
+    }
+
+    // Out of room: this allocation gets a block of its own until Reset,
+    // counted with the worst-case padding it may need in the grown block
+    m_used += bytes + alignment - 1;
+    m_peak = std::max(m_peak, m_used);
+    size_t size = bytes + alignment;
+    m_overflow.push_back(std::make_unique<std::byte[]>(size));
+    pointer = m_overflow.back().get();
+    space = size;
+    return std::align(alignment, bytes, pointer, space);
+}
+
+// =============================================================================
+// FRAME ALLOCATOR
+// =============================================================================
+
+FrameAllocator::FrameAllocator(uint32_t frameCount, size_t capacityPerFrame) {
+    for (uint32_t i = 0; i < frameCount; i++) {
+        m_arenas.push_back(std::make_unique<FrameArena>(capacityPerFrame));
+    }
+    m_current = m_arenas.front().get();
+}
+
+void FrameAllocator::BeginFrame(uint32_t frameIndex) {
+    m_current = m_arenas[frameIndex % m_arenas.size()].get();
+    m_current->Reset();
+}
+
+// =============================================================================
+// HEAP ALLOCATION COUNTER
+// =============================================================================
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+namespace {
+    std::atomic<uint64_t> g_heapAllocations{0};
+}
+
+// The array and nothrow forms forward to these by default
+void* operator new(size_t size) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size != 0 ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    size_t rounded = (std::max<size_t>(size, 1) + align - 1) / align * align;
+#ifdef _WIN32
+    void* pointer = _aligned_malloc(rounded, align);
+#else
+    void* pointer = std::aligned_alloc(align, rounded);
+#endif
+    if (pointer) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+// Sized forms are replaced too, since some runtimes do not forward them
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
+
+void CountHeapAllocation() {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t GetHeapAllocationCount() {
+    return g_heapAllocations.load(std::memory_order_relaxed);
+}
+
+bool IsHeapAllocationCountingEnabled() {
+    return true;
+}
+#else
+uint64_t GetHeapAllocationCount() {
+    return 0;
+}
+
+bool IsHeapAllocationCountingEnabled() {
+    return false;
+}
+#endif
@@ -0,0 +1,72 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <chrono>
+
+void FramePacer::Initialize(VkDevice device) {
+    m_device = device;
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.pNext = &typeInfo;
+
+    ThrowIfFailed(vkCreateSemaphore(m_device, &createInfo, nullptr, &m_timeline),
+                  "Failed to create frame timeline semaphore!");
+}
+
+void FramePacer::Destroy() {
+    SafeDestroy<VkSemaphore>(m_timeline, [this](VkSemaphore semaphore) { vkDestroySemaphore(m_device, semaphore, nullptr); });
+}
+
+void FramePacer::SetFramesInFlight(uint32_t count) {
+    m_framesInFlight = std::clamp(count, 1u, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+}
+
+void FramePacer::WaitForFrame() {
+    if (m_waited) {
+        return;
+    }
+    m_waited = true;
+
+    // The slot's previous frame must be done before its buffers are reused,
+    // and at most framesInFlight frames (this one included) may be queued
+    uint64_t target = m_slotFrames[m_slot];
+    if (m_latencyMode == LatencyMode::LowLatency) {
+        target = std::max(target, m_frameNumber);
+    } else if (m_frameNumber >= m_framesInFlight) {
+        target = std::max(target, m_frameNumber + 1 - m_framesInFlight);
+    }
+
+    if (GetCompletedFrames() >= target) {
+        m_lastWaitMs = 0.0f;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_timeline;
+    waitInfo.pValues = &target;
+    ThrowIfFailed(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX), "Failed to wait for frame timeline!");
+
+    m_lastWaitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FramePacer::FrameSubmitted() {
+    m_frameNumber++;
+    m_slotFrames[m_slot] = m_frameNumber;
+    m_slot = (m_slot + 1) % m_framesInFlight;
+    m_waited = false;
+}
+
+uint64_t FramePacer::GetCompletedFrames() const {
+    uint64_t value = 0;
+    ThrowIfFailed(vkGetSemaphoreCounterValue(m_device, m_timeline, &value), "Failed to read frame timeline!");
+    return value;
+}
@@ -0,0 +1,38 @@
+#include "GpuLayout.h"
+#include <cmath>
+
+void GpuDetail::AppendMembers(std::string& out, std::span<const GpuField> fields, const char* indent) {
+    for (const GpuField& field : fields) {
+        out += indent;
+        out += field.glslType;
+        out += ' ';
+        out += field.name;
+        if (field.arrayCount > 0) {
+            out += '[';
+            out += std::to_string(field.arrayCount);
+            out += ']';
+        }
+        out += ';';
+        if (field.comment && *field.comment) {
+            out += " // ";
+            out += field.comment;
+        }
+        out += '\n';
+    }
+}
+
+glm::vec2 EncodeUnitVector(const glm::vec3& direction) {
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length == 0.0f) {
+        return glm::vec2(0.0f, 0.0f); // Decodes to +Z
+    }
+
+    glm::vec3 n = direction / length;
+    glm::vec2 encoded(n.x, n.y);
+    if (n.z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        encoded = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                            (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return encoded;
+}
@@ -0,0 +1,283 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace {
+    // Which job system, if any, the current thread works for
+    thread_local const JobSystem* t_owner = nullptr;
+    thread_local uint32_t t_queue = 0;
+
+    constexpr uint32_t EXTERNAL_THREAD = ~0u;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+    uint32_t threadCount = workerCount + 1;
+    m_queues.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    t_owner = this;
+    t_queue = 0;
+
+    m_workers.reserve(workerCount);
+    for (uint32_t i = 1; i < threadCount; i++) {
+        m_workers.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    // Without workers nobody else would drain the queues
+    while (TryRunOne(CurrentQueue())) {
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+
+    if (t_owner == this) {
+        t_owner = nullptr;
+    }
+}
+
+uint32_t JobSystem::DefaultWorkerCount() {
+    return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+// =============================================================================
+// SUBMISSION
+// =============================================================================
+
+JobHandle JobSystem::Schedule(const char* name, std::function<void()> job,
+                              std::span<const JobHandle> dependencies) {
+    auto counter = std::make_shared<JobDetail::Counter>(1);
+    std::vector<Job> jobs;
+    jobs.push_back(Job{std::move(job), name ? name : "job", counter});
+
+    if (dependencies.empty()) {
+        Enqueue(jobs);
+    } else {
+        WhenDone(dependencies, [this, jobs]() mutable { Enqueue(jobs); });
+    }
+    return JobHandle(std::move(counter));
+}
+
+JobHandle JobSystem::ParallelForAsync(const char* name, size_t count, size_t grainSize,
+                                      std::function<void(size_t, size_t)> fn,
+                                      std::span<const JobHandle> dependencies) {
+    if (count == 0) {
+        return JobHandle();
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    auto counter = std::make_shared<JobDetail::Counter>(static_cast<uint32_t>(chunkCount));
+    auto body = std::make_shared<std::function<void(size_t, size_t)>>(std::move(fn));
+
+    std::vector<Job> jobs;
+    jobs.reserve(chunkCount);
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        size_t begin = chunk * grainSize;
+        size_t end = std::min(begin + grainSize, count);
+        jobs.push_back(Job{[body, begin, end]() { (*body)(begin, end); }, name ? name : "parallel_for", counter});
+    }
+
+    if (dependencies.empty()) {
+        Enqueue(jobs);
+    } else {
+        WhenDone(dependencies, [this, jobs]() mutable { Enqueue(jobs); });
+    }
+    return JobHandle(std::move(counter));
+}
+
+void JobSystem::Wait(const JobHandle& handle) {
+    if (!handle.m_counter) {
+        return;
+    }
+
+    uint32_t self = CurrentQueue();
+    while (!handle.IsDone()) {
+        if (!TryRunOne(self)) {
+            std::this_thread::yield();
+        }
+    }
+
+    JobDetail::Counter& counter = *handle.m_counter;
+    std::lock_guard<std::mutex> lock(counter.mutex);
+    if (counter.error) {
+        std::rethrow_exception(counter.error);
+    }
+}
+
+void JobSystem::Enqueue(std::vector<Job>& jobs) {
+    uint32_t self = CurrentQueue();
+    if (self == EXTERNAL_THREAD) {
+        self = m_nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    }
+
+    WorkerQueue& queue = *m_queues[self];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (Job& job : jobs) {
+            queue.jobs.push_back(std::move(job));
+        }
+    }
+
+    // Paired with the sleeper count in WorkerMain: either the sleeper sees
+    // the new jobs before it waits or this sees the sleeper and wakes it
+    m_queuedJobs.fetch_add(static_cast<int64_t>(jobs.size()));
+    if (m_sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+        if (jobs.size() > 1) {
+            m_wake.notify_all();
+        } else {
+            m_wake.notify_one();
+        }
+    }
+}
+
+void JobSystem::WhenDone(std::span<const JobHandle> dependencies, std::function<void()> continuation) {
+    struct Gate {
+        std::atomic<size_t> remaining;
+        std::function<void()> continuation;
+    };
+
+    // The extra count keeps the gate shut until every dependency is hooked
+    auto gate = std::make_shared<Gate>();
+    gate->remaining.store(dependencies.size() + 1);
+    gate->continuation = std::move(continuation);
+    auto release = [gate]() {
+        if (gate->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            gate->continuation();
+        }
+    };
+
+    for (const JobHandle& dependency : dependencies) {
+        bool pending = false;
+        if (dependency.m_counter) {
+            std::lock_guard<std::mutex> lock(dependency.m_counter->mutex);
+            if (!dependency.m_counter->done) {
+                dependency.m_counter->continuations.push_back(release);
+                pending = true;
+            }
+        }
+        if (!pending) {
+            release();
+        }
+    }
+    release();
+}
+
+// =============================================================================
+// EXECUTION
+// =============================================================================
+
+uint32_t JobSystem::CurrentQueue() const {
+    return t_owner == this ? t_queue : EXTERNAL_THREAD;
+}
+
+bool JobSystem::PopOrSteal(uint32_t self, Job& job) {
+    uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+
+    // Newest own job first: its data is most likely still in cache
+    if (self != EXTERNAL_THREAD) {
+        WorkerQueue& own = *m_queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Oldest job of someone else: usually the largest piece of work left
+    uint32_t start = self == EXTERNAL_THREAD ? 0 : self + 1;
+    for (uint32_t i = 0; i < queueCount; i++) {
+        uint32_t victim = (start + i) % queueCount;
+        if (victim == self) continue;
+
+        WorkerQueue& queue = *m_queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            m_queuedJobs.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::TryRunOne(uint32_t self) {
+    Job job;
+    if (!PopOrSteal(self, job)) {
+        return false;
+    }
+    Execute(job, self);
+    return true;
+}
+
+void JobSystem::Execute(Job& job, uint32_t self) {
+    JobProfileEvent event;
+    if (m_profiler) {
+        event.start = std::chrono::steady_clock::now();
+    }
+
+    try {
+        job.fn();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job.counter->mutex);
+        if (!job.counter->error) {
+            job.counter->error = std::current_exception();
+        }
+    }
+
+    if (m_profiler) {
+        event.end = std::chrono::steady_clock::now();
+        event.name = job.name;
+        event.worker = self;
+        m_profiler(event);
+    }
+
+    Complete(*job.counter);
+}
+
+void JobSystem::Complete(JobDetail::Counter& counter) {
+    if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    std::vector<std::function<void()>> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        counter.done = true;
+        continuations.swap(counter.continuations);
+    }
+    for (auto& continuation : continuations) {
+        continuation();
+    }
+}
+
+void JobSystem::WorkerMain(uint32_t self) {
+    t_owner = this;
+    t_queue = self;
+
+    while (true) {
+        if (TryRunOne(self)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepers.fetch_add(1);
+        m_wake.wait(lock, [this]() { return m_stopping || m_queuedJobs.load() > 0; });
+        m_sleepers.fetch_sub(1);
+        if (m_stopping && m_queuedJobs.load() <= 0) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,369 @@
+#include "LightAnimation.h"
+#include "LightingSystem.h"
+#include "SimdMath.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    using SimdMath::FastSin;
+    using SimdMath::TWO_PI;
+
+    // Noise positions wrap well inside the exactly representable integers
+    constexpr float NOISE_PERIOD = 65536.0f;
+
+    // Below this many tracks the passes finish before a worker could pick
+    // them up
+    constexpr size_t PARALLEL_TRACK_THRESHOLD = 4096;
+
+    inline float WrapAngle(float angle) {
+        return angle - TWO_PI * SimdMath::FloorToInt(angle * SimdMath::INV_TWO_PI);
+    }
+
+    void AdvanceAngles(float* angle, const float* speed, size_t count, float deltaTime) {
+        for (size_t i = 0; i < count; i++) {
+            angle[i] = WrapAngle(angle[i] + speed[i] * deltaTime);
+        }
+    }
+
+    // Swap-removes element i from every listed array
+    template<typename... Vectors>
+    void SwapRemove(size_t i, Vectors&... vectors) {
+        ((vectors[i] = vectors.back(), vectors.pop_back()), ...);
+    }
+
+    // Columns are stored as an element count followed by the raw elements
+    template<typename T>
+    void WriteColumn(SnapshotWriter& out, const std::vector<T>& column) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.Write(static_cast<uint32_t>(column.size()));
+        out.WriteBytes(column.data(), column.size() * sizeof(T));
+    }
+
+    template<typename T>
+    void ReadColumn(SnapshotReader& in, std::vector<T>& column) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint32_t count = in.Read<uint32_t>();
+        std::span<const std::byte> bytes = in.ReadBytes(static_cast<size_t>(count) * sizeof(T));
+        column.resize(count);
+        std::memcpy(column.data(), bytes.data(), bytes.size());
+    }
+
+    template<typename Tracks>
+    void WriteTracks(SnapshotWriter& out, const Tracks& tracks) {
+        std::apply([&](const auto&... columns) { (WriteColumn(out, columns), ...); }, Tracks::Columns(tracks));
+    }
+
+    template<typename Tracks>
+    void ReadTracks(SnapshotReader& in, Tracks& tracks) {
+        std::apply([&](auto&... columns) { (ReadColumn(in, columns), ...); }, Tracks::Columns(tracks));
+        size_t count = tracks.targets.size();
+        bool consistent = std::apply([count](const auto&... columns) {
+            return ((columns.size() == count) && ...);
+        }, Tracks::Columns(tracks));
+        if (!consistent) {
+            throw std::runtime_error("Snapshot animation tracks have mismatched columns");
+        }
+    }
+
+    float SampleKeyframes(const KeyframeAnimation& animation, double time) {
+        const auto& keys = animation.keys;
+        if (keys.empty()) return 0.0f;
+        if (keys.size() == 1) return keys.front().value;
+
+        float duration = keys.back().time;
+        float t = static_cast<float>(animation.loop && duration > 0.0f ? std::fmod(time, static_cast<double>(duration)) : time);
+
+        if (t <= keys.front().time) return keys.front().value;
+        if (t >= keys.back().time) return keys.back().value;
+
+        auto next = std::upper_bound(keys.begin(), keys.end(), t,
+                                     [](float value, const Keyframe& key) { return value < key.time; });
+        auto prev = next - 1;
+
+        float span = next->time - prev->time;
+        float alpha = span > 0.0f ? (t - prev->time) / span : 1.0f;
+
+        switch (animation.interpolation) {
+            case KeyframeInterpolation::Step:
+                alpha = 0.0f;
+                break;
+            case KeyframeInterpolation::Smooth:
+                alpha = alpha * alpha * (3.0f - 2.0f * alpha);
+                break;
+            default:
+                break;
+        }
+        return prev->value + (next->value - prev->value) * alpha;
+    }
+}
+
+void LightAnimator::AddPulse(Entity light, const PulseAnimation& animation) {
+    m_pulses.targets.push_back(light);
+    m_pulses.base.push_back(animation.base);
+    m_pulses.amplitude.push_back(animation.amplitude);
+    m_pulses.speed.push_back(animation.speed);
+    m_pulses.minimum.push_back(animation.minimum);
+    m_pulses.angle.push_back(WrapAngle(animation.phase));
+    m_pulses.result.push_back(animation.base);
+}
+
+void LightAnimator::AddOrbit(Entity light, const OrbitAnimation& animation) {
+    m_orbits.targets.push_back(light);
+    m_orbits.centerX.push_back(animation.center.x);
+    m_orbits.centerY.push_back(animation.center.y);
+    m_orbits.centerZ.push_back(animation.center.z);
+    m_orbits.radius.push_back(animation.radius);
+    m_orbits.speed.push_back(animation.speed);
+    m_orbits.bobAmplitude.push_back(animation.bobAmplitude);
+    m_orbits.bobSpeed.push_back(animation.bobSpeed);
+    m_orbits.angle.push_back(WrapAngle(animation.phase));
+    m_orbits.bobAngle.push_back(0.0f);
+    m_orbits.resultX.push_back(animation.center.x);
+    m_orbits.resultY.push_back(animation.center.y);
+    m_orbits.resultZ.push_back(animation.center.z);
+}
+
+void LightAnimator::AddFlicker(Entity light, const FlickerAnimation& animation) {
+    m_flickers.targets.push_back(light);
+    m_flickers.base.push_back(animation.base);
+    m_flickers.amount.push_back(glm::clamp(animation.amount, 0.0f, 1.0f));
+    m_flickers.speed.push_back(animation.speed);
+    // Seeds pick a different stretch of the noise so lights flicker apart
+    m_flickers.position.push_back(std::fmod(std::fabs(animation.seed) * 97.0f, NOISE_PERIOD));
+    m_flickers.result.push_back(animation.base);
+}
+
+void LightAnimator::AddColorCycle(Entity light, const ColorCycleAnimation& animation) {
+    m_colorCycles.targets.push_back(light);
+    m_colorCycles.speedR.push_back(animation.speed.x);
+    m_colorCycles.speedG.push_back(animation.speed.y);
+    m_colorCycles.speedB.push_back(animation.speed.z);
+    m_colorCycles.brightness.push_back(animation.brightness);
+    m_colorCycles.angleR.push_back(WrapAngle(animation.phase.x));
+    m_colorCycles.angleG.push_back(WrapAngle(animation.phase.y));
+    m_colorCycles.angleB.push_back(WrapAngle(animation.phase.z));
+    m_colorCycles.resultR.push_back(0.0f);
+    m_colorCycles.resultG.push_back(0.0f);
+    m_colorCycles.resultB.push_back(0.0f);
+}
+
+void LightAnimator::AddKeyframes(Entity light, const KeyframeAnimation& animation) {
+    KeyframeAnimation sorted = animation;
+    std::sort(sorted.keys.begin(), sorted.keys.end(),
+              [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+
+    m_keyframes.targets.push_back(light);
+    m_keyframes.animations.push_back(std::move(sorted));
+    m_keyframes.startTime.push_back(m_time);
+}
+
+void LightAnimator::Stop(Entity light) {
+    auto stop = [light]<typename Tracks>(Tracks& tracks) {
+        for (size_t i = tracks.targets.size(); i-- > 0;) {
+            if (tracks.targets[i] != light) continue;
+            std::apply([i](auto&... columns) { SwapRemove(i, columns...); }, Tracks::Columns(tracks));
+        }
+    };
+    stop(m_pulses);
+    stop(m_orbits);
+    stop(m_flickers);
+    stop(m_colorCycles);
+    stop(m_keyframes);
+}
+
+void LightAnimator::Clear() {
+    m_pulses = {};
+    m_orbits = {};
+    m_flickers = {};
+    m_colorCycles = {};
+    m_keyframes = {};
+}
+
+size_t LightAnimator::GetTrackCount() const {
+    return m_pulses.targets.size() + m_orbits.targets.size() + m_flickers.targets.size() +
+           m_colorCycles.targets.size() + m_keyframes.targets.size();
+}
+
+void LightAnimator::WriteSnapshot(SnapshotWriter& out) const {
+    out.Write(m_time);
+    WriteTracks(out, m_pulses);
+    WriteTracks(out, m_orbits);
+    WriteTracks(out, m_flickers);
+    WriteTracks(out, m_colorCycles);
+
+    // Keyframe animations own their key lists, so they are written one by one
+    WriteColumn(out, m_keyframes.targets);
+    WriteColumn(out, m_keyframes.startTime);
+    for (const KeyframeAnimation& animation : m_keyframes.animations) {
+        out.Write(animation.property);
+        out.Write(animation.interpolation);
+        out.Write(static_cast<uint8_t>(animation.loop));
+        WriteColumn(out, animation.keys);
+    }
+}
+
+void LightAnimator::ReadSnapshot(SnapshotReader& in) {
+    LightAnimator restored;
+    restored.m_time = in.Read<double>();
+    ReadTracks(in, restored.m_pulses);
+    ReadTracks(in, restored.m_orbits);
+    ReadTracks(in, restored.m_flickers);
+    ReadTracks(in, restored.m_colorCycles);
+
+    KeyframeTracks& keyframes = restored.m_keyframes;
+    ReadColumn(in, keyframes.targets);
+    ReadColumn(in, keyframes.startTime);
+    if (keyframes.startTime.size() != keyframes.targets.size()) {
+        throw std::runtime_error("Snapshot animation tracks have mismatched columns");
+    }
+    keyframes.animations.resize(keyframes.targets.size());
+    for (KeyframeAnimation& animation : keyframes.animations) {
+        animation.property = in.Read<KeyframeProperty>();
+        animation.interpolation = in.Read<KeyframeInterpolation>();
+        animation.loop = in.Read<uint8_t>() != 0;
+        ReadColumn(in, animation.keys);
+    }
+
+    *this = std::move(restored);
+}
+
+// The Evaluate* passes read and write only float arrays, one element per
+// track with no branches or calls, so each loop vectorizes across tracks
+
+void LightAnimator::EvaluatePulses(float deltaTime) {
+    size_t count = m_pulses.targets.size();
+    const float* base = m_pulses.base.data();
+    const float* amplitude = m_pulses.amplitude.data();
+    const float* speed = m_pulses.speed.data();
+    const float* minimum = m_pulses.minimum.data();
+    float* result = m_pulses.result.data();
+
+    AdvanceAngles(m_pulses.angle.data(), speed, count, deltaTime);
+    const float* angle = m_pulses.angle.data();
+    for (size_t i = 0; i < count; i++) {
+        result[i] = std::max(minimum[i], base[i] + amplitude[i] * FastSin(angle[i]));
+    }
+}
+
+void LightAnimator::EvaluateOrbits(float deltaTime) {
+    size_t count = m_orbits.targets.size();
+    AdvanceAngles(m_orbits.angle.data(), m_orbits.speed.data(), count, deltaTime);
+    AdvanceAngles(m_orbits.bobAngle.data(), m_orbits.bobSpeed.data(), count, deltaTime);
+    
+    // Split per axis to keep each loop's pointer count small enough for the
+    // vectorizer's alias checks
+    const float* angle = m_orbits.angle.data();
+    const float* radius = m_orbits.radius.data();
+    const float* centerX = m_orbits.centerX.data();
+    const float* centerZ = m_orbits.centerZ.data();
+    float* resultX = m_orbits.resultX.data();
+    float* resultZ = m_orbits.resultZ.data();
+    for (size_t i = 0; i < count; i++) {
+        resultX[i] = centerX[i] + radius[i] * SimdMath::FastCos(angle[i]);
+        resultZ[i] = centerZ[i] + radius[i] * FastSin(angle[i]);
+    }
+    
+    const float* bobAngle = m_orbits.bobAngle.data();
+    const float* bobAmplitude = m_orbits.bobAmplitude.data();
+    const float* centerY = m_orbits.centerY.data();
+    float* resultY = m_orbits.resultY.data();
+    for (size_t i = 0; i < count; i++) {
+        resultY[i] = centerY[i] + bobAmplitude[i] * FastSin(bobAngle[i]);
+    }
+}
+
+void LightAnimator::EvaluateFlickers(float deltaTime) {
+    size_t count = m_flickers.targets.size();
+    const float* base = m_flickers.base.data();
+    const float* amount = m_flickers.amount.data();
+    const float* speed = m_flickers.speed.data();
+    float* position = m_flickers.position.data();
+    float* result = m_flickers.result.data();
+
+    for (size_t i = 0; i < count; i++) {
+        float next = position[i] + speed[i] * deltaTime;
+        position[i] = next >= NOISE_PERIOD ? next - NOISE_PERIOD : next;
+        result[i] = base[i] * (1.0f - amount[i] * SimdMath::ValueNoise(position[i]));
+    }
+}
+
+void LightAnimator::EvaluateColorCycles(float deltaTime) {
+    size_t count = m_colorCycles.targets.size();
+    const float* brightness = m_colorCycles.brightness.data();
+    
+    auto evaluateChannel = [&](std::vector<float>& angles, const std::vector<float>& speeds, std::vector<float>& results) {
+        AdvanceAngles(angles.data(), speeds.data(), count, deltaTime);
+        const float* angle = angles.data();
+        float* result = results.data();
+        for (size_t i = 0; i < count; i++) {
+            result[i] = (FastSin(angle[i]) + 1.0f) * 0.5f * brightness[i];
+        }
+    };
+    
+    evaluateChannel(m_colorCycles.angleR, m_colorCycles.speedR, m_colorCycles.resultR);
+    evaluateChannel(m_colorCycles.angleG, m_colorCycles.speedG, m_colorCycles.resultG);
+    evaluateChannel(m_colorCycles.angleB, m_colorCycles.speedB, m_colorCycles.resultB);
+}
+
+void LightAnimator::Update(float deltaTime, Registry& registry) {
+    m_time += deltaTime;
+
+    // The passes write disjoint arrays, so large sets run side by side
+    JobSystem* jobs = registry.GetJobSystem();
+    if (jobs && GetTrackCount() >= PARALLEL_TRACK_THRESHOLD) {
+        JobHandle passes[] = {
+            jobs->Schedule("EvaluatePulses", [this, deltaTime]() { EvaluatePulses(deltaTime); }),
+            jobs->Schedule("EvaluateOrbits", [this, deltaTime]() { EvaluateOrbits(deltaTime); }),
+            jobs->Schedule("EvaluateFlickers", [this, deltaTime]() { EvaluateFlickers(deltaTime); }),
+            jobs->Schedule("EvaluateColorCycles", [this, deltaTime]() { EvaluateColorCycles(deltaTime); }),
+        };
+        for (const JobHandle& pass : passes) {
+            jobs->Wait(pass);
+        }
+    } else {
+        EvaluatePulses(deltaTime);
+        EvaluateOrbits(deltaTime);
+        EvaluateFlickers(deltaTime);
+        EvaluateColorCycles(deltaTime);
+    }
+
+    // Scatter results into the light components. Tracks whose light has
+    // been removed are skipped here and dropped by Stop().
+    auto& lights = registry.Pool<Light>();
+
+    for (size_t i = 0; i < m_pulses.targets.size(); i++) {
+        if (Light* light = lights.TryGet(m_pulses.targets[i])) {
+            light->intensity = m_pulses.result[i];
+        }
+    }
+    for (size_t i = 0; i < m_orbits.targets.size(); i++) {
+        if (Light* light = lights.TryGet(m_orbits.targets[i])) {
+            light->position = glm::vec3(m_orbits.resultX[i], m_orbits.resultY[i], m_orbits.resultZ[i]);
+        }
+    }
+    for (size_t i = 0; i < m_flickers.targets.size(); i++) {
+        if (Light* light = lights.TryGet(m_flickers.targets[i])) {
+            light->intensity = m_flickers.result[i];
+        }
+    }
+    for (size_t i = 0; i < m_colorCycles.targets.size(); i++) {
+        if (Light* light = lights.TryGet(m_colorCycles.targets[i])) {
+            light->color = glm::vec3(m_colorCycles.resultR[i], m_colorCycles.resultG[i], m_colorCycles.resultB[i]);
+        }
+    }
+    for (size_t i = 0; i < m_keyframes.targets.size(); i++) {
+        Light* light = lights.TryGet(m_keyframes.targets[i]);
+        if (!light) continue;
+
+        const KeyframeAnimation& animation = m_keyframes.animations[i];
+        float value = SampleKeyframes(animation, m_time - m_keyframes.startTime[i]);
+        if (animation.property == KeyframeProperty::Intensity) {
+            light->intensity = std::max(0.0f, value);
+        } else {
+            light->range = std::max(0.1f, value);
+        }
+    }
+}
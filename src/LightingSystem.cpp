@@ -1,42 +1,116 @@
 #include "LightingSystem.h"
+#include "Snapshot.h"
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
 
-LightingSystem::LightingSystem() = default;
+namespace {
+    // Below this many lights the compaction finishes before a worker could
+    // pick up a chunk
+    constexpr size_t PARALLEL_LIGHT_THRESHOLD = 8192;
+    constexpr size_t LIGHT_CHUNK_SIZE = 2048;
+    
+    template<typename T>
+    T ReadLightField(const std::byte* light, size_t offset) {
+        T value;
+        std::memcpy(&value, light + offset, sizeof(T));
+        return value;
+    }
+    
+    bool IsFinite(const glm::vec3& v) {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+    
+    // Snapshot bytes are not trusted: each field is decoded on its own,
+    // checked and held to LightLimits, and the id is the owning entity.
+    // Throws std::runtime_error for values no setter could have produced.
+    Light DecodeLight(const std::byte* bytes, Entity entity) {
+        int type = ReadLightField<int>(bytes, offsetof(Light, type));
+        if (!LightLimits::IsValidType(type)) {
+            throw std::runtime_error("Snapshot light has an unknown type");
+        }
+        
+        Light light;
+        light.id = static_cast<int>(entity);
+        light.type = static_cast<LightType>(type);
+        light.position = ReadLightField<glm::vec3>(bytes, offsetof(Light, position));
+        light.direction = ReadLightField<glm::vec3>(bytes, offsetof(Light, direction));
+        light.color = ReadLightField<glm::vec3>(bytes, offsetof(Light, color));
+        light.intensity = ReadLightField<float>(bytes, offsetof(Light, intensity));
+        light.range = ReadLightField<float>(bytes, offsetof(Light, range));
+        light.innerCone = ReadLightField<float>(bytes, offsetof(Light, innerCone));
+        light.outerCone = ReadLightField<float>(bytes, offsetof(Light, outerCone));
+        if (!IsFinite(light.position) || !IsFinite(light.color) || !std::isfinite(light.intensity) ||
+            !std::isfinite(light.range) || !std::isfinite(light.innerCone) || !std::isfinite(light.outerCone)) {
+            throw std::runtime_error("Snapshot light has a non-finite value");
+        }
+        
+        light.direction = LightLimits::Direction(light.direction);
+        light.intensity = LightLimits::Intensity(light.intensity);
+        light.range = LightLimits::Range(light.range);
+        light.innerCone = LightLimits::InnerCone(light.innerCone);
+        light.outerCone = LightLimits::OuterCone(light.outerCone, light.innerCone);
+        light.enabled = ReadLightField<uint8_t>(bytes, offsetof(Light, enabled)) != 0;
+        light.castShadows = ReadLightField<uint8_t>(bytes, offsetof(Light, castShadows)) != 0;
+        return light;
+    }
+}
+
+LightingSystem::LightingSystem(Registry& registry) : m_registry(registry) {
+    m_registry.AddDestroyListener([this](Entity entity) {
+        DestroyProxy(entity);
+        m_animator.Stop(entity);
+    });
+}
 LightingSystem::~LightingSystem() = default;
 
 int LightingSystem::CreateLight(LightType type) {
-    int id = m_nextLightId++;
-    auto light = std::make_unique<Light>();
-    light->id = id;
-    light->type = type;
-    
-    m_lights[id] = std::move(light);
-    return id;
+    return AddLight(m_registry.Create(), type);
+}
+
+int LightingSystem::AddLight(Entity entity, LightType type) {
+    Light& light = m_registry.Emplace<Light>(entity);
+    light.id = static_cast<int>(entity);
+    light.type = type;
+    return light.id;
 }
 
 bool LightingSystem::RemoveLight(int lightId) {
-    auto it = m_lights.find(lightId);
-    if (it != m_lights.end()) {
-        m_lights.erase(it);
-        return true;
+    Entity entity = static_cast<Entity>(lightId);
+    if (!m_registry.Has<Light>(entity)) {
+        return false;
     }
-    return false;
+
+    // Entities created only to carry a light go away with it
+    DestroyProxy(entity);
+    m_animator.Stop(entity);
+    m_registry.Remove<Light>(entity);
+    if (!m_registry.HasAnyComponent(entity)) {
+        m_registry.Destroy(entity);
+    }
+    return true;
 }
 
 Light* LightingSystem::GetLight(int lightId) {
-    auto it = m_lights.find(lightId);
-    return (it != m_lights.end()) ? it->second.get() : nullptr;
+    return m_registry.TryGet<Light>(static_cast<Entity>(lightId));
 }
 
 void LightingSystem::SetLightPosition(int lightId, const glm::vec3& position) {
     if (auto light = GetLight(lightId)) {
         light->position = position;
+        m_spatialDirty = true;
     }
 }
 
 void LightingSystem::SetLightDirection(int lightId, const glm::vec3& direction) {
     if (auto light = GetLight(lightId)) {
-        light->direction = glm::normalize(direction);
+        light->direction = LightLimits::Direction(direction);
     }
 }
 
@@ -48,42 +122,248 @@ void LightingSystem::SetLightColor(int lightId, const glm::vec3& color) {
 
 void LightingSystem::SetLightIntensity(int lightId, float intensity) {
     if (auto light = GetLight(lightId)) {
-        light->intensity = std::max(0.0f, intensity);
+        light->intensity = LightLimits::Intensity(intensity);
     }
 }
 
 void LightingSystem::SetLightRange(int lightId, float range) {
     if (auto light = GetLight(lightId)) {
-        light->range = std::max(0.1f, range);
+        light->range = LightLimits::Range(range);
+        m_spatialDirty = true;
     }
 }
 
 void LightingSystem::SetLightCone(int lightId, float innerCone, float outerCone) {
     if (auto light = GetLight(lightId)) {
-        light->innerCone = glm::clamp(innerCone, 0.0f, 89.0f);
-        light->outerCone = glm::clamp(outerCone, light->innerCone, 90.0f);
+        light->innerCone = LightLimits::InnerCone(innerCone);
+        light->outerCone = LightLimits::OuterCone(outerCone, light->innerCone);
     }
 }
 
 void LightingSystem::SetLightEnabled(int lightId, bool enabled) {
     if (auto light = GetLight(lightId)) {
         light->enabled = enabled;
+        m_spatialDirty = true;
+    }
+}
+
+void LightingSystem::SetLightCastShadows(int lightId, bool castShadows) {
+    if (auto light = GetLight(lightId)) {
+        light->castShadows = castShadows;
     }
 }
 
 void LightingSystem::Update(float deltaTime) {
-    // Update dynamic lighting effects here
-    // This could include light animations, flickering, etc.
+    // Animations write straight into the Light components
+    m_animator.Update(deltaTime, m_registry);
+    
+    // Lights may also have been moved through component views, which skip
+    // the setters, so the index is refreshed every frame
+    SyncSpatialIndex();
+}
+
+void LightingSystem::SyncSpatialIndex() {
+    m_registry.Pool<LightBoundsProxy>();
+    m_registry.Each<Light>([this](Entity entity, Light& light) {
+        LightBoundsProxy* proxy = m_registry.TryGet<LightBoundsProxy>(entity);
+        bool indexed = light.enabled && light.type != LightType::Directional;
+        
+        if (!indexed) {
+            if (proxy) DestroyProxy(entity);
+            return;
+        }
+        
+        AABB bounds = AABB::FromSphere(light.position, light.range);
+        if (!proxy) {
+            m_registry.Emplace<LightBoundsProxy>(entity, m_spatialIndex.CreateProxy(bounds, entity));
+        } else {
+            m_spatialIndex.MoveProxy(proxy->proxy, bounds);
+        }
+    });
+    m_spatialDirty = false;
+}
+
+void LightingSystem::DestroyProxy(Entity entity) {
+    if (LightBoundsProxy* proxy = m_registry.TryGet<LightBoundsProxy>(entity)) {
+        m_spatialIndex.DestroyProxy(proxy->proxy);
+        m_registry.Remove<LightBoundsProxy>(entity);
+    }
+}
+
+void LightingSystem::QueryRadius(const glm::vec3& center, float radius, std::pmr::vector<int>& results) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    m_spatialIndex.QuerySphere(center, radius, [&](int32_t proxy) {
+        Entity entity = m_spatialIndex.GetUserData(proxy);
+        const Light* light = m_registry.TryGet<Light>(entity);
+        float reach = radius + light->range;
+        glm::vec3 delta = light->position - center;
+        if (glm::dot(delta, delta) <= reach * reach) {
+            results.push_back(light->id);
+        }
+        return true;
+    });
+}
+
+void LightingSystem::QueryAffecting(const AABB& bounds, std::vector<int>& results) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    m_spatialIndex.Query(bounds, [&](int32_t proxy) {
+        const Light* light = m_registry.TryGet<Light>(m_spatialIndex.GetUserData(proxy));
+        if (bounds.IntersectsSphere(light->position, light->range)) {
+            results.push_back(light->id);
+        }
+        return true;
+    });
+    
+    m_registry.Each<Light>([&](Entity, const Light& light) {
+        if (light.enabled && light.type == LightType::Directional) {
+            results.push_back(light.id);
+        }
+    });
+}
+
+void LightingSystem::QueryFrustum(const Frustum& frustum, std::vector<int>& results) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    m_spatialIndex.QueryFrustum(frustum, [&](int32_t proxy) {
+        const Light* light = m_registry.TryGet<Light>(m_spatialIndex.GetUserData(proxy));
+        if (frustum.IntersectsSphere(light->position, light->range)) {
+            results.push_back(light->id);
+        }
+        return true;
+    });
 }
 
-std::vector<Light> LightingSystem::GetActiveLights() const {
-    std::vector<Light> activeLights;
+std::pmr::vector<Light> LightingSystem::GetActiveLights(std::pmr::memory_resource* resource) const {
+    std::pmr::vector<Light> activeLights(resource);
+    
+    const auto& pool = m_registry.Pool<Light>();
+    const Light* lights = pool.Components();
+    size_t count = pool.Size();
     
-    for (const auto& [id, light] : m_lights) {
-        if (light->enabled) {
-            activeLights.push_back(*light);
+    if (!m_registry.GetJobSystem() || count < PARALLEL_LIGHT_THRESHOLD) {
+        activeLights.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            if (lights[i].enabled) {
+                activeLights.push_back(lights[i]);
+            }
         }
+        return activeLights;
     }
     
+    // Two passes over the same chunks: count each chunk's enabled lights,
+    // then copy them to the chunk's prefix offset, which keeps pool order
+    size_t chunkCount = (count + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
+    std::pmr::vector<size_t> offsets(chunkCount + 1, 0, resource);
+    m_registry.ParallelEachChunk<Light>(LIGHT_CHUNK_SIZE, [&](const Entity*, const Light* chunk, size_t size) {
+        size_t enabled = 0;
+        for (size_t i = 0; i < size; i++) {
+            enabled += chunk[i].enabled ? 1 : 0;
+        }
+        offsets[(chunk - lights) / LIGHT_CHUNK_SIZE + 1] = enabled;
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    
+    activeLights.resize(offsets.back());
+    m_registry.ParallelEachChunk<Light>(LIGHT_CHUNK_SIZE, [&](const Entity*, const Light* chunk, size_t size) {
+        Light* out = activeLights.data() + offsets[(chunk - lights) / LIGHT_CHUNK_SIZE];
+        for (size_t i = 0; i < size; i++) {
+            if (chunk[i].enabled) {
+                *out++ = chunk[i];
+            }
+        }
+    });
     return activeLights;
-}
\ No newline at end of file
+}
+
+LightMix LightingSystem::GetLightMix() const {
+    LightMix mix;
+    mix.sun = m_sunIntensity > 0.0f;
+    
+    const auto& pool = m_registry.Pool<Light>();
+    const Light* lights = pool.Components();
+    for (size_t i = 0; i < pool.Size(); i++) {
+        if (!lights[i].enabled) continue;
+        switch (lights[i].type) {
+            case LightType::Directional: mix.directional++; break;
+            case LightType::Point: mix.point++; break;
+            case LightType::Spot: mix.spot++; break;
+        }
+    }
+    
+    return mix;
+}
+
+void LightingSystem::WriteSnapshot(SnapshotWriter& out) {
+    static_assert(std::is_trivially_copyable_v<Light>);
+    
+    ComponentPool<Light>& pool = m_registry.Pool<Light>();
+    uint32_t count = static_cast<uint32_t>(pool.Size());
+    out.Write(static_cast<uint32_t>(sizeof(Light)));
+    out.Write(count);
+    out.WriteBytes(pool.Entities(), count * sizeof(Entity));
+    out.WriteBytes(pool.Components(), count * sizeof(Light));
+    
+    out.Write(m_ambientLight);
+    out.Write(m_sunDirection);
+    out.Write(m_sunColor);
+    out.Write(m_sunIntensity);
+    m_animator.WriteSnapshot(out);
+}
+
+void LightingSystem::ReadSnapshot(SnapshotReader& in) {
+    if (in.Read<uint32_t>() != sizeof(Light)) {
+        throw std::runtime_error("Snapshot was written with a different Light layout");
+    }
+    uint32_t count = in.Read<uint32_t>();
+    std::span<const std::byte> entities = in.ReadBytes(static_cast<size_t>(count) * sizeof(Entity));
+    std::span<const std::byte> lights = in.ReadBytes(static_cast<size_t>(count) * sizeof(Light));
+    glm::vec3 ambientLight = in.Read<glm::vec3>();
+    glm::vec3 sunDirection = in.Read<glm::vec3>();
+    glm::vec3 sunColor = in.Read<glm::vec3>();
+    float sunIntensity = in.Read<float>();
+    LightAnimator animator;
+    animator.ReadSnapshot(in);
+    
+    // Every light is decoded and checked before the scene is touched, so a
+    // bad snapshot is rejected whole
+    std::vector<std::pair<Entity, Light>> restored;
+    restored.reserve(count);
+    std::unordered_set<Entity> kept;
+    kept.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Entity entity;
+        std::memcpy(&entity, entities.data() + i * sizeof(Entity), sizeof(Entity));
+        restored.emplace_back(entity, DecodeLight(lights.data() + i * sizeof(Light), entity));
+        kept.insert(entity);
+    }
+    
+    // Collected first: removal swaps components around the dense array
+    std::vector<Entity> removed;
+    ComponentPool<Light>& pool = m_registry.Pool<Light>();
+    for (size_t i = 0; i < pool.Size(); i++) {
+        if (!kept.count(pool.Entities()[i])) {
+            removed.push_back(pool.Entities()[i]);
+        }
+    }
+    for (Entity entity : removed) {
+        RemoveLight(static_cast<int>(entity));
+    }
+    
+    for (const auto& [entity, light] : restored) {
+        if (!m_registry.Revive(entity)) {
+            std::cerr << "Snapshot light " << entity << " not restored: its entity slot was reused" << std::endl;
+            animator.Stop(entity);
+            continue;
+        }
+        m_registry.Emplace<Light>(entity, light);
+    }
+    
+    m_ambientLight = ambientLight;
+    m_sunDirection = sunDirection;
+    m_sunColor = sunColor;
+    m_sunIntensity = sunIntensity;
+    m_animator = std::move(animator);
+    m_spatialDirty = true;
+}
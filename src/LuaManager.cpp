@@ -2,23 +2,679 @@
 #include "Engine.h"
 #include "LightingSystem.h"
 #include "Scene.h"
+#include "FrameAllocator.h"
+#include "VulkanRenderer.h"
+#include "ScriptBuffers.h"
+#include "SimdMath.h"
+#include "ScriptFFI.h"
+#include "ScriptSnapshot.h"
+#include "ScriptReflection.h"
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <limits>
+#include <cstring>
+#include <unordered_set>
+#include <filesystem>
+#include <string_view>
 
-LuaManager::LuaManager() = default;
-LuaManager::~LuaManager() = default;
+namespace {
+    // The count hook fires every HOOK_INSTRUCTION_STEP VM instructions
+    constexpr int HOOK_INSTRUCTION_STEP = 1000;
+
+    // Globals copied into every script environment. Library tables are copied
+    // per script and engine tables are reached through read-only proxies (see
+    // SANDBOX_PRELUDE), so one script cannot patch functions another calls.
+    const char* const SANDBOX_FUNCTIONS[] = {
+        "assert", "error", "ipairs", "next", "pairs", "pcall", "print", "select",
+        "tonumber", "tostring", "type", "unpack", "xpcall", "rawequal", "rawget",
+        "rawlen", "rawset", "setmetatable"
+    };
+    const char* const SANDBOX_LIBRARIES[] = {
+        "math", "string", "table", "coroutine", "utf8"
+    };
+    const char* const SANDBOX_OS_FUNCTIONS[] = {
+        "clock", "time", "date", "difftime"
+    };
+
+    // Returns the sandbox getmetatable and a factory of read-only proxies
+    // for the shared engine tables. getmetatable only answers for tables:
+    // the string metatable and usertype metatables are shared by every
+    // script, and their __index tables would otherwise be writable.
+    const char* const SANDBOX_PRELUDE = R"lua(
+        local getmetatable, setmetatable, type, tostring, next, error = ...
+        local function sandboxGetmetatable(value)
+            if type(value) ~= "table" then
+                return nil
+            end
+            return getmetatable(value)
+        end
+        local function readOnly(source)
+            return setmetatable({}, {
+                __index = source,
+                __newindex = function(_, key)
+                    error("engine table field '" .. tostring(key) .. "' is read-only", 2)
+                end,
+                __call = function(_, ...) return source(...) end,
+                __pairs = function() return next, source, nil end,
+                __metatable = false
+            })
+        end
+        return sandboxGetmetatable, readOnly
+    )lua";
+
+    // Routes the os clock reads through the replay session (see
+    // RegisterReplayAPI). Conversions of a given time stay as they are.
+    const char* const REPLAY_CLOCK_PRELUDE = R"lua(
+        local os, sample = ...
+        local clock, time, date = os.clock, os.time, os.date
+        local tointeger = math.tointeger or function(value) return value end
+        local function now()
+            return tointeger(sample(time()))
+        end
+        os.clock = function()
+            return sample(clock())
+        end
+        os.time = function(fields)
+            if fields ~= nil then
+                return time(fields)
+            end
+            return now()
+        end
+        os.date = function(format, t)
+            return date(format, t == nil and now() or t)
+        end
+    )lua";
+
+    bool CheckLightType(int type) {
+        if (type < static_cast<int>(LightType::Directional) || type > static_cast<int>(LightType::Spot)) {
+            std::cerr << "Unknown light type: " << type << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Range checks for the enum fields views expose, chosen by field type
+    bool CheckEnumField(LightType, int value) {
+        return CheckLightType(value);
+    }
+    
+    // Stores a script-written value into a component, applying whatever
+    // limits the field has; null assigns the value as is
+    template<typename T, typename Field>
+    using FieldAssign = void (*)(T&, Field);
+    
+    // Writes from light views hold the same limits as the LightingSystem setters
+    void AssignLightDirection(Light& light, glm::vec3 direction) {
+        light.direction = LightLimits::Direction(direction);
+    }
+    
+    void AssignLightIntensity(Light& light, float intensity) {
+        light.intensity = LightLimits::Intensity(intensity);
+    }
+    
+    void AssignLightRange(Light& light, float range) {
+        light.range = LightLimits::Range(range);
+    }
+    
+    void AssignLightInnerCone(Light& light, float innerCone) {
+        light.innerCone = LightLimits::InnerCone(innerCone);
+        light.outerCone = LightLimits::OuterCone(light.outerCone, light.innerCone);
+    }
+    
+    void AssignLightOuterCone(Light& light, float outerCone) {
+        light.outerCone = LightLimits::OuterCone(outerCone, light.innerCone);
+    }
+    
+    // Binds a getter `name(i)` and setter `setName(i, ...)` for one component
+    // field on a view usertype. Indices are 1-based like Lua arrays. Enum
+    // setters return false for values outside the enum.
+    template<typename T, typename Field>
+    void BindViewField(sol::usertype<ComponentView<T>>& type, const std::string& name, Field T::* member,
+                       FieldAssign<T, Field> assign = nullptr) {
+        std::string setter = "set" + name;
+        setter[3] = static_cast<char>(std::toupper(static_cast<unsigned char>(setter[3])));
+        
+        if constexpr (std::is_same_v<Field, glm::vec3>) {
+            type[name] = [member](const ComponentView<T>& view, size_t index) {
+                const glm::vec3& value = view.At(index - 1).*member;
+                return std::make_tuple(value.x, value.y, value.z);
+            };
+            type[setter] = [member, assign](const ComponentView<T>& view, size_t index, float x, float y, float z) {
+                if (assign) {
+                    assign(view.At(index - 1), glm::vec3(x, y, z));
+                } else {
+                    view.At(index - 1).*member = glm::vec3(x, y, z);
+                }
+            };
+        } else if constexpr (std::is_enum_v<Field>) {
+            type[name] = [member](const ComponentView<T>& view, size_t index) {
+                return static_cast<int>(view.At(index - 1).*member);
+            };
+            type[setter] = [member](const ComponentView<T>& view, size_t index, int value) {
+                if (!CheckEnumField(Field{}, value)) {
+                    return false;
+                }
+                view.At(index - 1).*member = static_cast<Field>(value);
+                return true;
+            };
+        } else {
+            type[name] = [member](const ComponentView<T>& view, size_t index) {
+                return view.At(index - 1).*member;
+            };
+            type[setter] = [member, assign](const ComponentView<T>& view, size_t index, Field value) {
+                if (assign) {
+                    assign(view.At(index - 1), value);
+                } else {
+                    view.At(index - 1).*member = value;
+                }
+            };
+        }
+    }
+    
+    // Binds `readName(buffer)` and `writeName(buffer)`, which copy a whole
+    // component column into or out of a script buffer (Vec3Array for vec3
+    // fields, FloatBuffer otherwise) in one call. Both copy the first
+    // min(view size, buffer size) components and return that count.
+    template<typename T, typename Field>
+    void BindViewColumn(sol::usertype<ComponentView<T>>& type, const std::string& name, Field T::* member,
+                        FieldAssign<T, Field> assign = nullptr) {
+        if constexpr (std::is_same_v<Field, glm::vec3>) {
+            type["read" + name] = [member](const ComponentView<T>& view, const Vec3Array& out) {
+                size_t count = std::min(view.Size(), out.Size());
+                for (size_t i = 0; i < count; i++) {
+                    const glm::vec3& value = view.pool->Components()[i].*member;
+                    out.X()[i] = value.x;
+                    out.Y()[i] = value.y;
+                    out.Z()[i] = value.z;
+                }
+                return count;
+            };
+            type["write" + name] = [member, assign](const ComponentView<T>& view, const Vec3Array& values) {
+                size_t count = std::min(view.Size(), values.Size());
+                for (size_t i = 0; i < count; i++) {
+                    glm::vec3 value(values.X()[i], values.Y()[i], values.Z()[i]);
+                    if (assign) {
+                        assign(view.pool->Components()[i], value);
+                    } else {
+                        view.pool->Components()[i].*member = value;
+                    }
+                }
+                return count;
+            };
+        } else {
+            type["read" + name] = [member](const ComponentView<T>& view, const FloatBuffer& out) {
+                size_t count = std::min(view.Size(), out.Size());
+                for (size_t i = 0; i < count; i++) {
+                    out.Data()[i] = view.pool->Components()[i].*member;
+                }
+                return count;
+            };
+            type["write" + name] = [member, assign](const ComponentView<T>& view, const FloatBuffer& values) {
+                size_t count = std::min(view.Size(), values.Size());
+                for (size_t i = 0; i < count; i++) {
+                    if (assign) {
+                        assign(view.pool->Components()[i], values.Data()[i]);
+                    } else {
+                        view.pool->Components()[i].*member = values.Data()[i];
+                    }
+                }
+                return count;
+            };
+        }
+    }
+    
+    bool CheckBufferSize(int64_t size) {
+        if (size < 0 || size > std::numeric_limits<int32_t>::max()) {
+            std::cerr << "Invalid buffer size: " << size << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    bool CheckSameSize(size_t a, size_t b, const char* operation) {
+        if (a != b) {
+            std::cerr << operation << ": buffer sizes differ (" << a << " and " << b << ")" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Adds one animation described by a Lua table such as
+    // { type = "pulse", base = 2, amplitude = 1.5, speed = 4 }
+    bool AddLightAnimation(LightAnimator& animator, Entity light, const sol::table& spec) {
+        std::string type = spec.get_or<std::string>("type", "");
+        
+        if (type == "pulse") {
+            PulseAnimation pulse;
+            pulse.base = spec.get_or<float>("base", pulse.base);
+            pulse.amplitude = spec.get_or<float>("amplitude", pulse.amplitude);
+            pulse.speed = spec.get_or<float>("speed", pulse.speed);
+            pulse.phase = spec.get_or<float>("phase", pulse.phase);
+            pulse.minimum = spec.get_or<float>("minimum", pulse.minimum);
+            animator.AddPulse(light, pulse);
+        } else if (type == "orbit") {
+            OrbitAnimation orbit;
+            orbit.center = spec.get_or<glm::vec3>("center", orbit.center);
+            orbit.radius = spec.get_or<float>("radius", orbit.radius);
+            orbit.speed = spec.get_or<float>("speed", orbit.speed);
+            orbit.phase = spec.get_or<float>("phase", orbit.phase);
+            orbit.bobAmplitude = spec.get_or<float>("bobAmplitude", orbit.bobAmplitude);
+            orbit.bobSpeed = spec.get_or<float>("bobSpeed", orbit.bobSpeed);
+            animator.AddOrbit(light, orbit);
+        } else if (type == "flicker") {
+            FlickerAnimation flicker;
+            flicker.base = spec.get_or<float>("base", flicker.base);
+            flicker.amount = spec.get_or<float>("amount", flicker.amount);
+            flicker.speed = spec.get_or<float>("speed", flicker.speed);
+            flicker.seed = spec.get_or<float>("seed", static_cast<float>(light & ENTITY_INDEX_MASK));
+            animator.AddFlicker(light, flicker);
+        } else if (type == "colorCycle") {
+            ColorCycleAnimation cycle;
+            cycle.speed = spec.get_or<glm::vec3>("speed", cycle.speed);
+            cycle.phase = spec.get_or<glm::vec3>("phase", cycle.phase);
+            cycle.brightness = spec.get_or<float>("brightness", cycle.brightness);
+            animator.AddColorCycle(light, cycle);
+        } else if (type == "keyframes") {
+            // keys = { {time, value}, ... }
+            KeyframeAnimation keyframes;
+            std::string property = spec.get_or<std::string>("property", "intensity");
+            std::string interpolation = spec.get_or<std::string>("interpolation", "linear");
+            keyframes.property = property == "range" ? KeyframeProperty::Range : KeyframeProperty::Intensity;
+            keyframes.interpolation = interpolation == "step"   ? KeyframeInterpolation::Step
+                                    : interpolation == "smooth" ? KeyframeInterpolation::Smooth
+                                                                : KeyframeInterpolation::Linear;
+            keyframes.loop = spec.get_or<bool>("loop", keyframes.loop);
+            
+            if (sol::optional<sol::table> keys = spec["keys"]) {
+                for (size_t i = 1; i <= keys->size(); i++) {
+                    sol::table key = (*keys)[i].get<sol::table>();
+                    keyframes.keys.push_back(Keyframe{key.get_or(1, 0.0f), key.get_or(2, 0.0f)});
+                }
+            }
+            animator.AddKeyframes(light, keyframes);
+        } else {
+            std::cerr << "Unknown light animation type: '" << type << "'" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Engine API tables every script reaches through a read-only proxy
+    const char* const SANDBOX_ENGINE_TABLES[] = {
+        "vec3", "mat4", "FloatBuffer", "Vec3Array", "Engine", "RenderPath", "PresentMode", "LatencyMode", "LightType", "Light", "LightFFI", "Scene"
+    };
+    
+    bool CheckPresentMode(int mode) {
+        if (mode < static_cast<int>(PresentMode::Fifo) || mode > static_cast<int>(PresentMode::Immediate)) {
+            std::cerr << "Unknown present mode: " << mode << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    bool CheckLatencyMode(int mode) {
+        if (mode != static_cast<int>(LatencyMode::Throughput) && mode != static_cast<int>(LatencyMode::LowLatency)) {
+            std::cerr << "Unknown latency mode: " << mode << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    bool CheckFramesInFlight(int count) {
+        if (count < 1 || count > MAX_FRAMES_IN_FLIGHT) {
+            std::cerr << "Frames in flight must be between 1 and " << MAX_FRAMES_IN_FLIGHT << ", got " << count << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    sol::object ToLuaValue(lua_State* L, const ScriptTask::Value& value) {
+        return std::visit([L](const auto& v) -> sol::object {
+            if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::monostate>) {
+                return sol::make_object(L, sol::lua_nil);
+            } else {
+                return sol::make_object(L, v);
+            }
+        }, value);
+    }
+    
+    // Tables, functions and userdata belong to the state that made them, so
+    // only plain values cross from a finished coroutine into its task
+    ScriptTask::Value FromLuaValue(const sol::object& object) {
+        switch (object.get_type()) {
+            case sol::type::boolean: return object.as<bool>();
+            case sol::type::number: return object.as<double>();
+            case sol::type::string: return object.as<std::string>();
+            default: return {};
+        }
+    }
+    
+    // What await and Task:result return: (value, nil) or (nil, error)
+    std::tuple<sol::object, sol::object> TaskResults(lua_State* L, const ScriptTask& task) {
+        if (task.Failed()) {
+            return {sol::make_object(L, sol::lua_nil), sol::make_object(L, task.GetError())};
+        }
+        return {ToLuaValue(L, task.GetValue()), sol::make_object(L, sol::lua_nil)};
+    }
+    
+    // Lua 5.4 stand-ins for the FFI light state: tables with the same fields
+    // as the ScriptLightState cdata, so scripts run unchanged on either backend
+    sol::table Vec3Table(sol::state& lua, const ScriptVec3& v) {
+        return lua.create_table_with("x", v.x, "y", v.y, "z", v.z);
+    }
+    
+    ScriptVec3 ReadVec3Table(const sol::table& table, const char* field) {
+        sol::table v = table[field];
+        return {v.get_or("x", 0.0f), v.get_or("y", 0.0f), v.get_or("z", 0.0f)};
+    }
+    
+    void WriteLightStateTable(sol::state& lua, sol::table& table, const ScriptLightState& state) {
+        table["type"] = state.type;
+        table["position"] = Vec3Table(lua, state.position);
+        table["direction"] = Vec3Table(lua, state.direction);
+        table["color"] = Vec3Table(lua, state.color);
+        table["intensity"] = state.intensity;
+        table["range"] = state.range;
+        table["innerCone"] = state.innerCone;
+        table["outerCone"] = state.outerCone;
+        table["enabled"] = state.enabled;
+        table["castShadows"] = state.castShadows;
+    }
+    
+    ScriptLightState ReadLightStateTable(const sol::table& table) {
+        ScriptLightState state{};
+        state.position = ReadVec3Table(table, "position");
+        state.direction = ReadVec3Table(table, "direction");
+        state.color = ReadVec3Table(table, "color");
+        state.intensity = table.get_or("intensity", 1.0f);
+        state.range = table.get_or("range", 10.0f);
+        state.innerCone = table.get_or("innerCone", 30.0f);
+        state.outerCone = table.get_or("outerCone", 45.0f);
+        state.enabled = table.get_or("enabled", true);
+        state.castShadows = table.get_or("castShadows", true);
+        return state;
+    }
+    
+    // Files scripts name (Scene.loadAsync, snapshots) resolve against the
+    // working directory like LoadScript, but may not reach outside it
+    bool CheckRelativePath(const std::string& path) {
+        if (path.empty() || path.front() == '/' || path.front() == '\\' ||
+            path.find(':') != std::string::npos || path.find("..") != std::string::npos) {
+            std::cerr << "Path must be relative and inside the working directory: '" << path << "'" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Files scripts write are confined to one directory per kind and carry
+    // that kind's extension, so no script can overwrite sources or shaders
+    constexpr std::string_view SNAPSHOT_DIRECTORY = "snapshots/";
+    constexpr std::string_view SNAPSHOT_EXTENSION = ".snap";
+    constexpr std::string_view RECORDING_DIRECTORY = "recordings/";
+    constexpr std::string_view RECORDING_EXTENSION = ".replay";
+    
+    bool CheckDataPath(const std::string& path, std::string_view directory, std::string_view extension) {
+        if (!CheckRelativePath(path)) {
+            return false;
+        }
+        if (!path.starts_with(directory) || !path.ends_with(extension) ||
+            path.size() <= directory.size() + extension.size() ||
+            path.find_first_of("/\\", directory.size()) != std::string::npos) {
+            std::cerr << "Path must name a " << extension << " file directly inside " << directory
+                      << ": '" << path << "'" << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Tables a sandbox environment shares with the engine or copied from
+    // the standard libraries; snapshots leave them alone
+    std::unordered_set<const void*> SandboxTables(const sol::environment& env) {
+        std::unordered_set<const void*> tables;
+        auto add = [&](const char* name) {
+            sol::object value = env.raw_get<sol::object>(name);
+            if (value.get_type() == sol::type::table) {
+                tables.insert(value.pointer());
+            }
+        };
+        for (const char* name : SANDBOX_LIBRARIES) add(name);
+        for (const char* name : SANDBOX_ENGINE_TABLES) add(name);
+        add("os");
+        return tables;
+    }
+    
+    // Restores the Lua stack height when a snapshot step throws
+    struct StackGuard {
+        lua_State* L;
+        int top;
+        explicit StackGuard(lua_State* state) : L(state), top(lua_gettop(state)) {}
+        ~StackGuard() { lua_settop(L, top); }
+    };
+    
+    // Native memory a script keeps alive, counted against its memory quota
+    // until the last reference is collected
+    class ScriptMemoryCharge {
+    public:
+        ScriptMemoryCharge(ScriptSandbox& sandbox, size_t bytes) : m_sandbox(sandbox), m_bytes(bytes) {
+            m_sandbox.memoryUsed += m_bytes;
+        }
+        ~ScriptMemoryCharge() {
+            m_sandbox.memoryUsed -= std::min(m_sandbox.memoryUsed, m_bytes);
+        }
+        
+        ScriptMemoryCharge(const ScriptMemoryCharge&) = delete;
+        ScriptMemoryCharge& operator=(const ScriptMemoryCharge&) = delete;
+        
+    private:
+        ScriptSandbox& m_sandbox;
+        size_t m_bytes;
+    };
+    
+    // Handle of an in-memory snapshot (Engine.captureSnapshot)
+    struct SnapshotHandle {
+        std::shared_ptr<const std::vector<std::byte>> data;
+        std::shared_ptr<ScriptMemoryCharge> charge; // Null when captured by engine code
+    };
+}
+
+// =============================================================================
+// BINDING DESCRIPTIONS
+// =============================================================================
+
+// Generated parts of the Light and Scene tables (see ScriptReflection.h)
+namespace ScriptReflection {
+    template<>
+    struct Reflect<LightingSystem> {
+        using Component = Light;
+        static Light* Find(LightingSystem& lighting, int lightId) { return lighting.GetLight(lightId); }
+        
+        // Cone angles are set together through setCone, which keeps inner <= outer
+        static constexpr auto fields = std::make_tuple(
+            Field<&Light::type>{"type"},
+            Field<&Light::position, &LightingSystem::SetLightPosition>{"position"},
+            Field<&Light::direction, &LightingSystem::SetLightDirection>{"direction"},
+            Field<&Light::color, &LightingSystem::SetLightColor>{"color"},
+            Field<&Light::intensity, &LightingSystem::SetLightIntensity>{"intensity"},
+            Field<&Light::range, &LightingSystem::SetLightRange>{"range"},
+            Field<&Light::innerCone>{"innerCone"},
+            Field<&Light::outerCone>{"outerCone"},
+            Field<&Light::enabled, &LightingSystem::SetLightEnabled>{"enabled"},
+            Field<&Light::castShadows, &LightingSystem::SetLightCastShadows>{"castShadows"}
+        );
+        
+        static constexpr auto methods = std::make_tuple(
+            Method<&LightingSystem::SetLightCone>{"setCone"},
+            Method<&LightingSystem::RemoveLight>{"remove"}
+        );
+    };
+    
+    template<>
+    struct Reflect<Scene> {
+        static constexpr auto methods = std::make_tuple(
+            Method<&Scene::DestroyEntity>{"destroyEntity"},
+            Method<&Scene::SetPosition>{"setPosition"},
+            Method<&Scene::GetPosition>{"getPosition"},
+            Method<&Scene::SetBounds>{"setBounds"},
+            Method<&Scene::SetActiveCamera>{"setActiveCamera"},
+            Method<&Scene::GetActiveCamera>{"getActiveCamera"}
+        );
+    };
+}
+
+// =============================================================================
+// SCRIPT TASKS
+// =============================================================================
+
+void ScriptTask::Resolve(Value value) {
+    if (m_claimed.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    m_value = std::move(value);
+    m_done.store(true, std::memory_order_release);
+}
+
+void ScriptTask::Fail(std::string error) {
+    if (m_claimed.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    m_failed = true;
+    m_error = std::move(error);
+    m_done.store(true, std::memory_order_release);
+}
+
+// =============================================================================
+// LUA MANAGER
+// =============================================================================
+
+LuaManager::LuaManager()
+    : m_lua(sol::default_at_panic, &LuaManager::Allocate, this) {}
+
+LuaManager::~LuaManager() {
+    Shutdown();
+}
+
+void* LuaManager::Allocate(void* userData, void* ptr, size_t oldSize, size_t newSize) {
+    auto* manager = static_cast<LuaManager*>(userData);
+
+    // Every block carries a header naming the script that allocated it, so
+    // memory freed later by the collector is credited back to its owner
+    // regardless of which script happens to be running at the time
+    AllocationHeader* header = ptr ? static_cast<AllocationHeader*>(ptr) - 1 : nullptr;
+
+    // When ptr is null, oldSize encodes the object type rather than a size
+    size_t previous = ptr ? oldSize : 0;
+    uint32_t owner = header ? header->owner : manager->m_activeSandboxIndex;
+    ScriptSandbox* sandbox = manager->GetSandboxByIndex(owner);
+
+    if (newSize == 0) {
+        std::free(header);
+        manager->m_totalMemory -= previous;
+        if (sandbox) {
+            sandbox->memoryUsed -= std::min(sandbox->memoryUsed, previous);
+        }
+        return nullptr;
+    }
+
+    // Refuse growth past the quota of the running script. Returning null
+    // makes Lua raise a memory error inside that script.
+    if (sandbox && sandbox == manager->m_activeSandbox && newSize > previous &&
+        sandbox->memoryUsed + (newSize - previous) > sandbox->quota.memoryBytes) {
+        sandbox->overQuota = true;
+        return nullptr;
+    }
+
+    CountHeapAllocation();
+    auto* block = static_cast<AllocationHeader*>(std::realloc(header, sizeof(AllocationHeader) + newSize));
+    if (!block) {
+        return nullptr;
+    }
+    block->owner = owner;
+
+    manager->m_totalMemory = manager->m_totalMemory - previous + newSize;
+    if (sandbox) {
+        if (newSize > previous) {
+            sandbox->memoryUsed += newSize - previous;
+        } else {
+            sandbox->memoryUsed -= std::min(sandbox->memoryUsed, previous - newSize);
+        }
+    }
+    return block + 1;
+}
+
+ScriptSandbox* LuaManager::GetSandboxByIndex(uint32_t index) {
+    // Index 0 is the engine itself; scripts are numbered from 1
+    if (index == 0 || index > m_scripts.size()) {
+        return nullptr;
+    }
+    return m_scripts[index - 1].get();
+}
+
+void LuaManager::InstructionHook(lua_State* L, lua_Debug* ar) {
+    void* userData = nullptr;
+    lua_getallocf(L, &userData);
+    auto* manager = static_cast<LuaManager*>(userData);
+
+    ScriptSandbox* sandbox = manager->m_activeSandbox;
+    if (!sandbox) {
+        return;
+    }
+
+    sandbox->instructionsUsed += HOOK_INSTRUCTION_STEP;
+    if (sandbox->instructionsUsed > sandbox->quota.instructionsPerCall) {
+        sandbox->overQuota = true;
+    }
+    if (sandbox->overQuota) {
+        // pcall, xpcall and coroutine.resume catch the error, so from now on
+        // it is raised on every instruction until it reaches the engine
+        lua_sethook(L, &LuaManager::InstructionHook, LUA_MASKCOUNT, 1);
+        if (sandbox->instructionsUsed > sandbox->quota.instructionsPerCall) {
+            luaL_error(L, "instruction quota exceeded (%llu instructions)",
+                       static_cast<unsigned long long>(sandbox->quota.instructionsPerCall));
+        }
+        luaL_error(L, "memory quota exceeded (%llu bytes)",
+                   static_cast<unsigned long long>(sandbox->quota.memoryBytes));
+    }
+}
 
 bool LuaManager::Initialize(Engine* engine) {
     m_engine = engine;
     
     try {
-        m_lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string, 
-                            sol::lib::table, sol::lib::io, sol::lib::package);
+        // io and package are never opened; scripts only see what
+        // CreateSandboxEnvironment copies into their environment
+        m_lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string,
+                            sol::lib::table, sol::lib::coroutine, sol::lib::utf8,
+                            sol::lib::os);
+#ifdef ENGINE_LUAJIT
+        // Only the LightFFI prelude uses these; scripts never see them
+        m_lua.open_libraries(sol::lib::ffi, sol::lib::jit);
+#endif
+        
+        sol::protected_function prelude = m_lua.load(SANDBOX_PRELUDE, "=Sandbox");
+        sol::protected_function_result sandboxResult = prelude(
+            m_lua["getmetatable"], m_lua["setmetatable"], m_lua["type"], m_lua["tostring"], m_lua["next"], m_lua["error"]);
+        if (!sandboxResult.valid()) {
+            sol::error err = sandboxResult;
+            throw err;
+        }
+        m_sandboxGetmetatable = sandboxResult.get<sol::function>(0);
+        m_readOnlyProxy = sandboxResult.get<sol::function>(1);
         
         RegisterMathTypes();
+        RegisterBufferTypes();
         RegisterEngineAPI();
         RegisterLightingAPI();
+        RegisterFFIBindings();
         RegisterSceneAPI();
+        RegisterAsyncAPI();
+        RegisterSnapshotAPI();
+        RegisterReplayAPI();
         RegisterUtilityFunctions();
         
         return true;
@@ -54,6 +710,131 @@ void LuaManager::RegisterMathTypes() {
     );
 }
 
+void LuaManager::RegisterBufferTypes() {
+    // Storage comes from the state's allocator, so buffers count against
+    // the creating script's memory quota like its tables do
+    BufferAllocator allocator{&LuaManager::Allocate, this};
+    
+    // Indices are 1-based. Element-wise kernels run natively over the whole
+    // buffer; operations on two buffers need equal sizes and return false
+    // otherwise.
+    m_lua.new_usertype<FloatBuffer>("FloatBuffer", sol::no_constructor,
+        "new", [allocator](int64_t size, sol::optional<float> value) -> sol::optional<FloatBuffer> {
+            if (!CheckBufferSize(size)) {
+                return sol::nullopt;
+            }
+            FloatBuffer buffer(static_cast<size_t>(size), allocator);
+            if (value) {
+                FloatKernels::Fill(buffer.Data(), buffer.Size(), *value);
+            }
+            return buffer;
+        },
+        "size", &FloatBuffer::Size,
+        sol::meta_function::length, &FloatBuffer::Size,
+        "get", [](const FloatBuffer& buffer, size_t index) { return buffer.Get(index - 1); },
+        "set", [](const FloatBuffer& buffer, size_t index, float value) { buffer.Set(index - 1, value); },
+        "fill", [](const FloatBuffer& buffer, float value) {
+            FloatKernels::Fill(buffer.Data(), buffer.Size(), value);
+        },
+        "scale", [](const FloatBuffer& buffer, float scale) {
+            FloatKernels::Scale(buffer.Data(), buffer.Size(), scale);
+        },
+        "offset", [](const FloatBuffer& buffer, float offset) {
+            FloatKernels::Offset(buffer.Data(), buffer.Size(), offset);
+        },
+        "clamp", [](const FloatBuffer& buffer, float minimum, float maximum) {
+            FloatKernels::Clamp(buffer.Data(), buffer.Size(), minimum, maximum);
+        },
+        "copy", [](const FloatBuffer& buffer, const FloatBuffer& source) {
+            if (!CheckSameSize(buffer.Size(), source.Size(), "FloatBuffer.copy")) return false;
+            std::copy_n(source.Data(), source.Size(), buffer.Data());
+            return true;
+        },
+        // buffer += a * x
+        "axpy", [](const FloatBuffer& buffer, float a, const FloatBuffer& x) {
+            if (!CheckSameSize(buffer.Size(), x.Size(), "FloatBuffer.axpy")) return false;
+            FloatKernels::Axpy(buffer.Data(), x.Data(), buffer.Size(), a);
+            return true;
+        },
+        // buffer += (target - buffer) * t
+        "lerp", [](const FloatBuffer& buffer, const FloatBuffer& target, float t) {
+            if (!CheckSameSize(buffer.Size(), target.Size(), "FloatBuffer.lerp")) return false;
+            FloatKernels::Lerp(buffer.Data(), target.Data(), buffer.Size(), t);
+            return true;
+        },
+        // buffer[i] = amplitude * sin(start + (i - 1) * step)
+        "fillSin", [](const FloatBuffer& buffer, float start, float step, sol::optional<float> amplitude) {
+            FloatKernels::FillSin(buffer.Data(), buffer.Size(), start, step, amplitude.value_or(1.0f));
+        },
+        "fillCos", [](const FloatBuffer& buffer, float start, float step, sol::optional<float> amplitude) {
+            FloatKernels::FillSin(buffer.Data(), buffer.Size(), start + SimdMath::HALF_PI, step, amplitude.value_or(1.0f));
+        },
+        // buffer[i] = amplitude * sin(angles[i] * frequency + phase)
+        "sin", [](const FloatBuffer& buffer, const FloatBuffer& angles, sol::optional<float> amplitude,
+                  sol::optional<float> frequency, sol::optional<float> phase) {
+            if (!CheckSameSize(buffer.Size(), angles.Size(), "FloatBuffer.sin")) return false;
+            FloatKernels::Sin(buffer.Data(), angles.Data(), buffer.Size(), amplitude.value_or(1.0f),
+                              frequency.value_or(1.0f), phase.value_or(0.0f));
+            return true;
+        },
+        "cos", [](const FloatBuffer& buffer, const FloatBuffer& angles, sol::optional<float> amplitude,
+                  sol::optional<float> frequency, sol::optional<float> phase) {
+            if (!CheckSameSize(buffer.Size(), angles.Size(), "FloatBuffer.cos")) return false;
+            FloatKernels::Sin(buffer.Data(), angles.Data(), buffer.Size(), amplitude.value_or(1.0f),
+                              frequency.value_or(1.0f), phase.value_or(0.0f) + SimdMath::HALF_PI);
+            return true;
+        }
+    );
+    
+    // x(), y() and z() return FloatBuffers over one component and flat()
+    // one over all three; they write through to the array, so any
+    // FloatBuffer kernel applies per component without copying
+    m_lua.new_usertype<Vec3Array>("Vec3Array", sol::no_constructor,
+        "new", [allocator](int64_t size) -> sol::optional<Vec3Array> {
+            if (!CheckBufferSize(size)) {
+                return sol::nullopt;
+            }
+            return Vec3Array(static_cast<size_t>(size), allocator);
+        },
+        "size", &Vec3Array::Size,
+        sol::meta_function::length, &Vec3Array::Size,
+        "get", [](const Vec3Array& array, size_t index) {
+            glm::vec3 value = array.Get(index - 1);
+            return std::make_tuple(value.x, value.y, value.z);
+        },
+        "set", [](const Vec3Array& array, size_t index, float x, float y, float z) {
+            array.Set(index - 1, glm::vec3(x, y, z));
+        },
+        "x", [](const Vec3Array& array) { return array.Component(0); },
+        "y", [](const Vec3Array& array) { return array.Component(1); },
+        "z", [](const Vec3Array& array) { return array.Component(2); },
+        "flat", &Vec3Array::Flat,
+        "fill", [](const Vec3Array& array, float x, float y, float z) {
+            FloatKernels::Fill(array.X(), array.Size(), x);
+            FloatKernels::Fill(array.Y(), array.Size(), y);
+            FloatKernels::Fill(array.Z(), array.Size(), z);
+        },
+        "scale", [](const Vec3Array& array, float scale) {
+            FloatKernels::Scale(array.X(), 3 * array.Size(), scale);
+        },
+        "copy", [](const Vec3Array& array, const Vec3Array& source) {
+            if (!CheckSameSize(array.Size(), source.Size(), "Vec3Array.copy")) return false;
+            std::copy_n(source.X(), 3 * source.Size(), array.X());
+            return true;
+        },
+        "axpy", [](const Vec3Array& array, float a, const Vec3Array& x) {
+            if (!CheckSameSize(array.Size(), x.Size(), "Vec3Array.axpy")) return false;
+            FloatKernels::Axpy(array.X(), x.X(), 3 * array.Size(), a);
+            return true;
+        },
+        "lerp", [](const Vec3Array& array, const Vec3Array& target, float t) {
+            if (!CheckSameSize(array.Size(), target.Size(), "Vec3Array.lerp")) return false;
+            FloatKernels::Lerp(array.X(), target.X(), 3 * array.Size(), t);
+            return true;
+        }
+    );
+}
+
 void LuaManager::RegisterLightingAPI() {
     // Light types enum
     m_lua["LightType"] = m_lua.create_table_with(
@@ -62,44 +843,83 @@ void LuaManager::RegisterLightingAPI() {
         "Spot", 2
     );
     
-    // Light creation and management
+    // Light creation and management. Field accessors, setCone and remove
+    // are generated from Reflect<LightingSystem>.
     m_lua["Light"] = m_lua.create_table_with(
-        "create", [this](sol::table config) -> int {
-            // Extract light parameters from Lua table
-            glm::vec3 position = config.get_or("position", glm::vec3(0.0f));
-            glm::vec3 color = config.get_or("color", glm::vec3(1.0f));
-            float intensity = config.get_or("intensity", 1.0f);
+        // Any settable field may be given, e.g.
+        // Light.create{ type = LightType.Spot, position = vec3(0, 5, 0), range = 20 }
+        // nil if the type is not a LightType
+        "create", [this](sol::table config) -> sol::optional<int> {
+            LightingSystem* lighting = m_engine->GetLightingSystem();
             int type = config.get_or("type", 1); // Default to point light
-            
-            // Create light through lighting system
-            // Return light ID for future reference
-            return 0; // Placeholder
-        },
-        
-        "setPosition", [this](int lightId, glm::vec3 position) {
-            // Update light position
+            if (!CheckLightType(type)) {
+                return sol::nullopt;
+            }
+            int lightId = lighting->CreateLight(static_cast<LightType>(type));
+            ScriptReflection::ApplyFields(*lighting, lightId, config);
+            return lightId;
         },
         
-        "setColor", [this](int lightId, glm::vec3 color) {
-            // Update light color
+        // Attaches one animation table, or a list of them, evaluated natively
+        // every frame; see AddLightAnimation for the accepted fields
+        "animate", [this](int lightId, sol::table spec) -> bool {
+            LightingSystem* lighting = m_engine->GetLightingSystem();
+            if (!lighting->GetLight(lightId)) {
+                return false;
+            }
+            
+            LightAnimator& animator = lighting->GetAnimator();
+            Entity light = static_cast<Entity>(lightId);
+            if (spec["type"].valid()) {
+                return AddLightAnimation(animator, light, spec);
+            }
+            
+            bool added = true;
+            for (size_t i = 1; i <= spec.size(); i++) {
+                added = AddLightAnimation(animator, light, spec[i].get<sol::table>()) && added;
+            }
+            return added;
         },
         
-        "setIntensity", [this](int lightId, float intensity) {
-            // Update light intensity
+        "stopAnimation", [this](int lightId) {
+            m_engine->GetLightingSystem()->GetAnimator().Stop(static_cast<Entity>(lightId));
         },
         
-        "remove", [this](int lightId) {
-            // Remove light
+        // Ids of point and spot lights whose range reaches the sphere
+        "queryRadius", [this](glm::vec3 center, float radius) {
+            std::pmr::vector<int> results(m_engine->GetFrameAllocator()->GetResource());
+            m_engine->GetLightingSystem()->QueryRadius(center, radius, results);
+            return sol::as_table(std::move(results));
         }
     );
+    
+    sol::table light = m_lua["Light"];
+    ScriptReflection::Bind(light, *m_engine->GetLightingSystem());
 }
 
 void LuaManager::RegisterEngineAPI() {
+    // Render path enum; values match RenderPath
+    m_lua["RenderPath"] = m_lua.create_table_with(
+        "Forward", 0,
+        "Deferred", 1
+    );
+    
+    // Frame pacing enums; values match PresentMode and LatencyMode
+    m_lua["PresentMode"] = m_lua.create_table_with(
+        "Fifo", 0,
+        "Mailbox", 1,
+        "Immediate", 2
+    );
+    m_lua["LatencyMode"] = m_lua.create_table_with(
+        "Throughput", 0,
+        "LowLatency", 1
+    );
+    
     m_lua["Engine"] = m_lua.create_table_with(
-        "getTime", []() -> float {
+        "getTime", [this]() -> float {
             static auto start = std::chrono::high_resolution_clock::now();
             auto now = std::chrono::high_resolution_clock::now();
-            return std::chrono::duration<float>(now - start).count();
+            return static_cast<float>(m_engine->GetReplay().Sample(std::chrono::duration<double>(now - start).count()));
         },
         
         "log", [](const std::string& message) {
@@ -108,38 +928,997 @@ void LuaManager::RegisterEngineAPI() {
         
         "quit", [this]() {
             // Signal engine to quit
+        },
+        
+        "setFullscreen", [this](bool fullscreen) {
+            m_engine->SetFullscreen(fullscreen);
+        },
+        
+        "isFullscreen", [this]() {
+            return m_engine->IsFullscreen();
+        },
+        
+        // "LuaJIT 2.1.x" or "Lua 5.4.x", for benchmarks and feature checks
+        "getScriptBackend", []() -> std::string {
+#ifdef ENGINE_LUAJIT
+            return LUAJIT_VERSION;
+#else
+            return LUA_RELEASE;
+#endif
+        },
+        
+        // Depth-only pass before lighting; worth it when overdraw is high
+        "setDepthPrepass", [this](bool enabled) {
+            m_engine->GetRenderer()->SetDepthPrepass(enabled);
+        },
+        
+        "isDepthPrepassEnabled", [this]() {
+            return m_engine->GetRenderer()->IsDepthPrepassEnabled();
+        },
+        
+        // Deferred shading pays off with many point and spot lights
+        "setRenderPath", [this](int path) -> bool {
+            if (path != static_cast<int>(RenderPath::Forward) && path != static_cast<int>(RenderPath::Deferred)) {
+                std::cerr << "Unknown render path: " << path << std::endl;
+                return false;
+            }
+            m_engine->GetRenderer()->SetRenderPath(static_cast<RenderPath>(path));
+            return true;
+        },
+        
+        "getRenderPath", [this]() {
+            return static_cast<int>(m_engine->GetRenderer()->GetRenderPath());
+        },
+        
+        "setPresentMode", [this](int mode) -> bool {
+            if (!CheckPresentMode(mode)) {
+                return false;
+            }
+            m_engine->GetRenderer()->SetPresentMode(static_cast<PresentMode>(mode));
+            return true;
+        },
+        
+        "getPresentMode", [this]() {
+            return static_cast<int>(m_engine->GetRenderer()->GetPresentMode());
+        },
+        
+        "setFramesInFlight", [this](int count) -> bool {
+            if (!CheckFramesInFlight(count)) {
+                return false;
+            }
+            m_engine->GetRenderer()->SetFramesInFlight(static_cast<uint32_t>(count));
+            return true;
+        },
+        
+        "getFramesInFlight", [this]() {
+            return m_engine->GetRenderer()->GetFramesInFlight();
+        },
+        
+        // LowLatency trades CPU/GPU overlap for a frame less input lag
+        "setLatencyMode", [this](int mode) -> bool {
+            if (!CheckLatencyMode(mode)) {
+                return false;
+            }
+            m_engine->GetRenderer()->SetLatencyMode(static_cast<LatencyMode>(mode));
+            return true;
+        },
+        
+        "getLatencyMode", [this]() {
+            return static_cast<int>(m_engine->GetRenderer()->GetLatencyMode());
+        },
+        
+        // All pacing settings at once, e.g. from a startup script:
+        // Engine.configureFramePacing{ presentMode = PresentMode.Mailbox,
+        //                              framesInFlight = 3, latencyMode = LatencyMode.Throughput }
+        // Nothing is applied unless every given setting is valid.
+        "configureFramePacing", [this](sol::table config) -> bool {
+            sol::optional<int> presentMode = config["presentMode"];
+            sol::optional<int> framesInFlight = config["framesInFlight"];
+            sol::optional<int> latencyMode = config["latencyMode"];
+            if ((presentMode && !CheckPresentMode(*presentMode)) ||
+                (framesInFlight && !CheckFramesInFlight(*framesInFlight)) ||
+                (latencyMode && !CheckLatencyMode(*latencyMode))) {
+                return false;
+            }
+            
+            VulkanRenderer* renderer = m_engine->GetRenderer();
+            if (presentMode) renderer->SetPresentMode(static_cast<PresentMode>(*presentMode));
+            if (framesInFlight) renderer->SetFramesInFlight(static_cast<uint32_t>(*framesInFlight));
+            if (latencyMode) renderer->SetLatencyMode(static_cast<LatencyMode>(*latencyMode));
+            return true;
+        },
+        
+        // Frames submitted and finished by the GPU, and how long the last
+        // frame waited for its slot
+        "getFramePacingStats", [this]() {
+            const FramePacer& pacer = m_engine->GetRenderer()->GetFramePacer();
+            ReplaySession& replay = m_engine->GetReplay();
+            return m_lua.create_table_with(
+                "framesInFlight", pacer.GetFramesInFlight(),
+                "submittedFrames", static_cast<uint64_t>(replay.Sample(static_cast<double>(pacer.GetSubmittedFrames()))),
+                "completedFrames", static_cast<uint64_t>(replay.Sample(static_cast<double>(pacer.GetCompletedFrames()))),
+                "waitMs", replay.Sample(pacer.GetLastWaitMs())
+            );
+        },
+        
+        // Heap allocations of the previous frame, for spotting per-frame
+        // churn; nil when the build does not count them
+        "getFrameAllocations", [this]() -> sol::optional<uint64_t> {
+            if (!IsHeapAllocationCountingEnabled()) {
+                return sol::nullopt;
+            }
+            return static_cast<uint64_t>(m_engine->GetReplay().Sample(
+                static_cast<double>(m_engine->GetFrameHeapAllocations())));
+        }
+    );
+}
+
+void LuaManager::RegisterFFIBindings() {
+    // LightFFI takes plain numbers instead of vec3 userdata. With LuaJIT its
+    // functions call ScriptFFI's C entry points through FFI function pointers,
+    // which traces compile to direct calls; on Lua 5.4 they are ordinary
+    // bindings with the same signatures.
+    LightingSystem* lighting = m_engine->GetLightingSystem();
+    
+#ifdef ENGINE_LUAJIT
+    m_ffiApi = ScriptFFI::MakeApi(*lighting);
+    sol::protected_function prelude = m_lua.load(ScriptFFI::PRELUDE, "=LightFFI");
+    sol::protected_function_result result = prelude(m_lua.get<sol::object>("ffi"), ScriptFFI::CDEF, static_cast<void*>(&m_ffiApi));
+    if (!result.valid()) {
+        sol::error err = result;
+        throw err;
+    }
+    m_lua["LightFFI"] = result.get<sol::table>();
+#else
+    m_lua["LightFFI"] = m_lua.create_table_with(
+        "setPosition", [lighting](int lightId, float x, float y, float z) {
+            lighting->SetLightPosition(lightId, glm::vec3(x, y, z));
+        },
+        "setDirection", [lighting](int lightId, float x, float y, float z) {
+            lighting->SetLightDirection(lightId, glm::vec3(x, y, z));
+        },
+        "setColor", [lighting](int lightId, float r, float g, float b) {
+            lighting->SetLightColor(lightId, glm::vec3(r, g, b));
+        },
+        "setIntensity", [lighting](int lightId, float intensity) {
+            lighting->SetLightIntensity(lightId, intensity);
+        },
+        "setRange", [lighting](int lightId, float range) {
+            lighting->SetLightRange(lightId, range);
+        },
+        "setCone", [lighting](int lightId, float innerCone, float outerCone) {
+            lighting->SetLightCone(lightId, innerCone, outerCone);
+        },
+        "setEnabled", [lighting](int lightId, bool enabled) {
+            lighting->SetLightEnabled(lightId, enabled);
+        },
+        "getPosition", [lighting](int lightId) -> std::tuple<sol::optional<float>, sol::optional<float>, sol::optional<float>> {
+            const Light* light = lighting->GetLight(lightId);
+            if (!light) {
+                return {sol::nullopt, sol::nullopt, sol::nullopt};
+            }
+            return {light->position.x, light->position.y, light->position.z};
+        },
+        "newState", [this]() {
+            sol::table table = m_lua.create_table();
+            WriteLightStateTable(m_lua, table, ScriptLightState{});
+            return table;
+        },
+        "getState", [this, lighting](int lightId, sol::table table) {
+            ScriptLightState state{};
+            if (!ScriptFFI::ReadLightState(*lighting, lightId, state)) {
+                return false;
+            }
+            WriteLightStateTable(m_lua, table, state);
+            return true;
+        },
+        "setState", [lighting](int lightId, sol::table table) {
+            ScriptFFI::ApplyLightState(*lighting, lightId, ReadLightStateTable(table));
         }
     );
+#endif
 }
 
 void LuaManager::RegisterSceneAPI() {
+    RegisterComponentViews();
+    
     m_lua["Scene"] = m_lua.create_table_with(
-        "setCameraPosition", [this](glm::vec3 position) {
-            // Update camera position
+        "createEntity", [this](sol::optional<glm::vec3> position) -> Entity {
+            Scene* scene = m_engine->GetScene();
+            return position ? scene->CreateEntity(*position) : scene->CreateEntity();
+        },
+        
+        // Returns the closest entity hit and its distance, or nil
+        "raycast", [this](glm::vec3 origin, glm::vec3 direction, sol::optional<float> maxDistance)
+            -> std::tuple<sol::optional<Entity>, sol::optional<float>> {
+            auto hit = m_engine->GetScene()->Raycast(origin, direction, maxDistance.value_or(1000.0f));
+            if (!hit) {
+                return {sol::nullopt, sol::nullopt};
+            }
+            return {hit->entity, hit->distance};
+        },
+        
+        "queryRadius", [this](glm::vec3 center, float radius) {
+            std::pmr::vector<Entity> results(m_engine->GetFrameAllocator()->GetResource());
+            m_engine->GetScene()->QuerySphere(center, radius, results);
+            return sol::as_table(std::move(results));
+        },
+        
+        // Returns a view over every component of the named type
+        "view", [this](const std::string& component, sol::this_state state) -> sol::object {
+            Registry& registry = m_engine->GetScene()->GetRegistry();
+            if (component == "Light") {
+                return sol::make_object(state, registry.View<Light>());
+            }
+            if (component == "Transform") {
+                return sol::make_object(state, registry.View<Transform>());
+            }
+            return sol::make_object(state, sol::lua_nil);
+        },
+        
+        // Camera functions act on the active camera unless given an entity
+        "createCamera", [this](sol::optional<sol::table> config) -> Entity {
+            Scene* scene = m_engine->GetScene();
+            Entity camera = scene->CreateCamera();
+            if (config) {
+                sol::table settings = *config;
+                Camera* component = scene->GetCamera(camera);
+                scene->SetCameraPosition(camera, settings.get_or("position", component->position));
+                scene->SetCameraTarget(camera, settings.get_or("target", component->target));
+                scene->SetCameraPerspective(camera, settings.get_or("fov", component->fov),
+                                            settings.get_or("near", component->nearPlane),
+                                            settings.get_or("far", component->farPlane));
+                if (sol::optional<sol::table> viewport = settings["viewport"]) {
+                    sol::table rect = *viewport;
+                    scene->SetCameraViewport(camera, glm::vec4(rect.get_or(1, 0.0f), rect.get_or(2, 0.0f),
+                                                               rect.get_or(3, 1.0f), rect.get_or(4, 1.0f)));
+                }
+            }
+            return camera;
         },
         
-        "setCameraTarget", [this](glm::vec3 target) {
-            // Update camera target
+        "setCameraPosition", [this](glm::vec3 position, sol::optional<Entity> camera) {
+            Scene* scene = m_engine->GetScene();
+            scene->SetCameraPosition(camera.value_or(scene->GetActiveCamera()), position);
         },
         
-        "getCameraPosition", [this]() -> glm::vec3 {
-            // Return camera position
-            return glm::vec3(0.0f);
+        "setCameraTarget", [this](glm::vec3 target, sol::optional<Entity> camera) {
+            Scene* scene = m_engine->GetScene();
+            scene->SetCameraTarget(camera.value_or(scene->GetActiveCamera()), target);
+        },
+        
+        "setCameraFov", [this](float fov, sol::optional<Entity> camera) {
+            Scene* scene = m_engine->GetScene();
+            Entity entity = camera.value_or(scene->GetActiveCamera());
+            if (Camera* component = scene->GetCamera(entity)) {
+                scene->SetCameraPerspective(entity, fov, component->nearPlane, component->farPlane);
+            }
+        },
+        
+        "getCameraPosition", [this](sol::optional<Entity> camera) -> glm::vec3 {
+            Scene* scene = m_engine->GetScene();
+            Camera* component = scene->GetCamera(camera.value_or(scene->GetActiveCamera()));
+            return component ? component->position : glm::vec3(0.0f);
         }
     );
+    
+    // destroyEntity, position, bounds and active camera calls are generated
+    // from Reflect<Scene>
+    sol::table scene = m_lua["Scene"];
+    ScriptReflection::Bind(scene, *m_engine->GetScene());
 }
 
-bool LuaManager::LoadScript(const std::string& filename) {
-    try {
-        m_lua.script_file(filename);
+void LuaManager::RegisterComponentViews() {
+    // Views index components 1..size() and read vec3 fields as three numbers,
+    // so walking a column never allocates per entity
+    auto lightView = m_lua.new_usertype<ComponentView<Light>>("LightView", sol::no_constructor,
+        "size", &ComponentView<Light>::Size,
+        "entity", [](const ComponentView<Light>& view, size_t index) { return view.EntityAt(index - 1); },
+        sol::meta_function::length, &ComponentView<Light>::Size
+    );
+    BindViewField(lightView, "type", &Light::type);
+    BindViewField(lightView, "position", &Light::position);
+    BindViewField(lightView, "direction", &Light::direction, AssignLightDirection);
+    BindViewField(lightView, "color", &Light::color);
+    BindViewField(lightView, "intensity", &Light::intensity, AssignLightIntensity);
+    BindViewField(lightView, "range", &Light::range, AssignLightRange);
+    BindViewField(lightView, "innerCone", &Light::innerCone, AssignLightInnerCone);
+    BindViewField(lightView, "outerCone", &Light::outerCone, AssignLightOuterCone);
+    BindViewField(lightView, "enabled", &Light::enabled);
+    BindViewField(lightView, "castShadows", &Light::castShadows);
+    BindViewColumn(lightView, "Positions", &Light::position);
+    BindViewColumn(lightView, "Directions", &Light::direction, AssignLightDirection);
+    BindViewColumn(lightView, "Colors", &Light::color);
+    BindViewColumn(lightView, "Intensities", &Light::intensity, AssignLightIntensity);
+    BindViewColumn(lightView, "Ranges", &Light::range, AssignLightRange);
+    
+    auto transformView = m_lua.new_usertype<ComponentView<Transform>>("TransformView", sol::no_constructor,
+        "size", &ComponentView<Transform>::Size,
+        "entity", [](const ComponentView<Transform>& view, size_t index) { return view.EntityAt(index - 1); },
+        sol::meta_function::length, &ComponentView<Transform>::Size
+    );
+    BindViewField(transformView, "position", &Transform::position);
+    BindViewField(transformView, "rotation", &Transform::rotation);
+    BindViewField(transformView, "scale", &Transform::scale);
+    BindViewColumn(transformView, "Positions", &Transform::position);
+    BindViewColumn(transformView, "Rotations", &Transform::rotation);
+    BindViewColumn(transformView, "Scales", &Transform::scale);
+}
+
+void LuaManager::RegisterAsyncAPI() {
+    // Awaitable handle; await() may only be called inside Engine.async and
+    // always suspends until a later update, even if the task is already done
+    m_lua.new_usertype<ScriptTask>("Task", sol::no_constructor,
+        "isDone", &ScriptTask::IsDone,
+        "await", sol::yielding([](std::shared_ptr<ScriptTask> task) { return task; }),
+        "result", [](sol::this_state L, const ScriptTask& task) -> std::tuple<sol::object, sol::object> {
+            if (!task.IsDone()) {
+                return {sol::make_object(L, sol::lua_nil), sol::make_object(L, sol::lua_nil)};
+            }
+            return TaskResults(L, task);
+        }
+    );
+    
+    sol::table engine = m_lua["Engine"];
+    
+    // Runs fn as a coroutine up to its first await; the returned task
+    // completes with fn's first return value, or fails with its error
+    engine["async"] = [this](const sol::function& function) {
+        return StartCoroutine(function);
+    };
+    
+    // Resolve after the given seconds of update time, and never before the
+    // next update
+    engine["wait"] = [this](double seconds) {
+        return CreateTimer(std::max(seconds, 0.0));
+    };
+    engine["nextFrame"] = [this]() {
+        return CreateTimer(0.0);
+    };
+    
+    // Reads the file on a worker thread, then runs it as a new sandboxed
+    // script on the main thread; resolves with true once it has run. The new
+    // script gets the caller's quota and capabilities, and each script may
+    // start at most ScriptQuota::maxSpawnedScripts loads, including those of
+    // the scripts it loaded.
+    sol::table scene = m_lua["Scene"];
+    scene["loadAsync"] = [this](const std::string& path) {
+        return LoadScriptAsync(path);
+    };
+}
+
+std::shared_ptr<ScriptTask> LuaManager::StartCoroutine(const sol::function& function) {
+    auto coroutine = std::make_unique<ScriptCoroutine>();
+    coroutine->thread = sol::thread::create(m_lua.lua_state());
+    coroutine->function = sol::coroutine(coroutine->thread.thread_state(), function);
+    coroutine->owner = m_activeSandboxIndex;
+    coroutine->completion = std::make_shared<ScriptTask>();
+    
+    // Hooks are per thread; a sandboxed coroutine counts its instructions
+    // against its owner whenever it is resumed
+    if (coroutine->owner != 0) {
+        lua_sethook(coroutine->thread.thread_state(), &LuaManager::InstructionHook, LUA_MASKCOUNT, HOOK_INSTRUCTION_STEP);
+    }
+    
+    // The first step runs inside the caller's budget
+    sol::protected_function_result result = StepCoroutine(*coroutine, nullptr);
+    if (!result.valid()) {
+        sol::error err = result;
+        ScriptSandbox* sandbox = GetSandboxByIndex(coroutine->owner);
+        if (sandbox && sandbox->overQuota) {
+            throw err; // Unwinds the calling script, which RunSandboxed then terminates
+        }
+        std::cerr << "Lua async error: " << err.what() << std::endl;
+    }
+    
+    std::shared_ptr<ScriptTask> completion = coroutine->completion;
+    if (coroutine->awaiting) {
+        m_coroutines.push_back(std::move(coroutine));
+    }
+    return completion;
+}
+
+sol::protected_function_result LuaManager::StepCoroutine(ScriptCoroutine& coroutine, const ScriptTask* resumeWith) {
+    lua_State* L = coroutine.thread.thread_state();
+    sol::protected_function_result result = resumeWith
+        ? std::apply(coroutine.function, TaskResults(L, *resumeWith))
+        : coroutine.function();
+    
+    switch (result.status()) {
+        case sol::call_status::yielded: {
+            // A bare coroutine.yield() waits one update
+            sol::optional<std::shared_ptr<ScriptTask>> task;
+            if (result.return_count() > 0) {
+                task = result.get<sol::optional<std::shared_ptr<ScriptTask>>>(0);
+            }
+            coroutine.awaiting = task && *task ? *task : CreateTimer(0.0);
+            break;
+        }
+        case sol::call_status::ok:
+            coroutine.awaiting = nullptr;
+            coroutine.completion->Resolve(result.return_count() > 0 ? FromLuaValue(result.get<sol::object>(0)) : ScriptTask::Value{});
+            break;
+        default: {
+            sol::error err = result;
+            coroutine.awaiting = nullptr;
+            coroutine.completion->Fail(err.what());
+            break;
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<ScriptTask> LuaManager::CreateTimer(double delay) {
+    auto task = std::make_shared<ScriptTask>();
+    m_timers.push_back({m_scriptTime + delay, m_scriptFrame + 1, task});
+    return task;
+}
+
+std::shared_ptr<ScriptTask> LuaManager::LoadScriptAsync(const std::string& filename) {
+    auto task = std::make_shared<ScriptTask>();
+    if (!CheckRelativePath(filename)) {
+        task->Fail("invalid script path '" + filename + "'");
+        return task;
+    }
+    
+    // A sandboxed caller's budget carries over to what it loads, so loading
+    // scripts cannot be used to multiply its quota without bound
+    ScriptSandbox* caller = m_activeSandbox;
+    uint32_t callerIndex = m_activeSandboxIndex;
+    ScriptQuota quota = caller ? caller->quota : ScriptQuota{};
+    ScriptCapabilities capabilities = caller ? caller->capabilities : ScriptCapabilities{};
+    uint32_t origin = 0;
+    if (caller) {
+        ScriptSandbox* root = GetSandboxByIndex(caller->origin);
+        if (root->spawnedScripts >= root->quota.maxSpawnedScripts) {
+            task->Fail("script '" + root->name + "' may not load more than " +
+                       std::to_string(root->quota.maxSpawnedScripts) + " scripts");
+            return task;
+        }
+        root->spawnedScripts++;
+        origin = root->index;
+    }
+    
+    // The worker only touches the shared read state, never the Lua state
+    auto source = std::make_shared<std::string>();
+    auto read = std::make_shared<ScriptTask>();
+    JobHandle job = m_engine->GetJobSystem()->Schedule("Read script", [filename, source, read]() {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            read->Fail("cannot open '" + filename + "'");
+            return;
+        }
+        source->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        read->Resolve();
+    });
+    
+    m_continuations.push_back({read, job, task, [this, filename, source, read, task,
+                                                 callerIndex, quota, capabilities, origin]() {
+        if (read->Failed()) {
+            task->Fail(read->GetError());
+            return;
+        }
+        ScriptSandbox* owner = GetSandboxByIndex(callerIndex);
+        if (owner && owner->terminated) {
+            task->Fail("script terminated");
+            return;
+        }
+        ScriptSandbox& script = CreateScript(filename, quota);
+        script.capabilities = capabilities;
+        if (origin != 0) {
+            script.origin = origin;
+        }
+        bool loaded = RunSandboxed(script, [this, &script, &source, &filename]() {
+            std::string chunkName = "@" + filename;
+            return RunLoadedChunk(script, luaL_loadbufferx(m_lua.lua_state(), source->data(), source->size(),
+                                                           chunkName.c_str(), nullptr));
+        });
+        if (loaded) {
+            task->Resolve(true);
+        } else {
+            task->Fail("failed to load '" + filename + "'");
+        }
+    }});
+    return task;
+}
+
+void LuaManager::UpdateAsync(float deltaTime) {
+    m_scriptTime += deltaTime;
+    m_scriptFrame++;
+    
+    for (ScriptTimer& timer : m_timers) {
+        if (timer.time <= m_scriptTime && timer.frame <= m_scriptFrame) {
+            timer.task->Resolve();
+        }
+    }
+    std::erase_if(m_timers, [](const ScriptTimer& timer) { return timer.task->IsDone(); });
+    
+    // Continuations may load scripts that queue further work, so the ready
+    // ones are taken out before any of them runs
+    bool replaying = m_engine->GetReplay().GetMode() != ReplayMode::Off;
+    std::vector<std::function<void()>> ready;
+    std::erase_if(m_continuations, [this, replaying, &ready](ScriptContinuation& continuation) {
+        if (replaying) {
+            m_engine->GetJobSystem()->Wait(continuation.job);
+        }
+        if (!continuation.after->IsDone()) {
+            return false;
+        }
+        ready.push_back(std::move(continuation.run));
         return true;
+    });
+    for (auto& run : ready) {
+        run();
     }
-    catch (const std::exception& e) {
-        std::cerr << "Failed to load Lua script '" << filename << "': " << e.what() << std::endl;
+    
+    // Each coroutine resumes at most once per update; ones started while
+    // resuming wait for the next update
+    size_t count = m_coroutines.size();
+    for (size_t i = 0; i < count; i++) {
+        ScriptCoroutine& coroutine = *m_coroutines[i];
+        ScriptSandbox* sandbox = GetSandboxByIndex(coroutine.owner);
+        if (sandbox && sandbox->terminated) {
+            coroutine.awaiting = nullptr;
+            coroutine.completion->Fail("script terminated");
+            continue;
+        }
+        if (!coroutine.awaiting->IsDone()) {
+            continue;
+        }
+        
+        std::shared_ptr<ScriptTask> awaited = std::move(coroutine.awaiting);
+        if (sandbox) {
+            RunSandboxed(*sandbox, [this, &coroutine, &awaited]() {
+                return StepCoroutine(coroutine, awaited.get());
+            });
+        } else {
+            sol::protected_function_result result = StepCoroutine(coroutine, awaited.get());
+            if (!result.valid()) {
+                sol::error err = result;
+                std::cerr << "Lua async error: " << err.what() << std::endl;
+            }
+        }
+    }
+    std::erase_if(m_coroutines, [](const std::unique_ptr<ScriptCoroutine>& coroutine) { return !coroutine->awaiting; });
+}
+
+bool LuaManager::HasPendingAsync() const {
+    return !m_coroutines.empty() || !m_timers.empty() || !m_continuations.empty();
+}
+
+void LuaManager::CancelAsync(const std::string& reason) {
+    for (ScriptContinuation& continuation : m_continuations) {
+        continuation.task->Fail(reason);
+    }
+    for (ScriptTimer& timer : m_timers) {
+        timer.task->Fail(reason);
+    }
+    for (auto& coroutine : m_coroutines) {
+        coroutine->completion->Fail(reason);
+    }
+    m_continuations.clear();
+    m_timers.clear();
+    m_coroutines.clear();
+}
+
+void LuaManager::RegisterSnapshotAPI() {
+    m_lua.new_usertype<SnapshotHandle>("Snapshot", sol::no_constructor,
+        "size", [](const SnapshotHandle& snapshot) { return snapshot.data->size(); }
+    );
+    
+    sol::table engine = m_lua["Engine"];
+    
+    // Snapshots cover every script, so sandboxed scripts need the snapshots
+    // capability (see ScriptCapabilities) to take or restore one.
+    
+    // Lights, lighting settings and every script's globals (see
+    // ScriptSnapshot for what is kept). nil if capturing failed or the
+    // snapshot does not fit the calling script's memory quota.
+    engine["captureSnapshot"] = [this]() -> sol::optional<SnapshotHandle> {
+        if (!HasCapability(&ScriptCapabilities::snapshots, "Engine.captureSnapshot")) {
+            return sol::nullopt;
+        }
+        auto data = std::make_shared<std::vector<std::byte>>();
+        if (!m_engine->CaptureSnapshot(*data)) {
+            return sol::nullopt;
+        }
+        
+        SnapshotHandle handle{std::move(data), nullptr};
+        if (ScriptSandbox* sandbox = m_activeSandbox) {
+            size_t bytes = handle.data->size();
+            if (sandbox->memoryUsed + bytes > sandbox->quota.memoryBytes) {
+                std::cerr << "Snapshot of " << bytes << " bytes exceeds the memory quota of script '"
+                          << sandbox->name << "'" << std::endl;
+                return sol::nullopt;
+            }
+            handle.charge = std::make_shared<ScriptMemoryCharge>(*sandbox, bytes);
+        }
+        return handle;
+    };
+    
+    // Restores take effect at the start of the next update
+    engine["restoreSnapshot"] = [this](const SnapshotHandle& snapshot) {
+        if (!HasCapability(&ScriptCapabilities::snapshots, "Engine.restoreSnapshot")) {
+            return false;
+        }
+        m_engine->RequestSnapshotRestore(snapshot.data);
+        return true;
+    };
+    
+    // Files live in snapshots/ and end in .snap
+    engine["saveSnapshot"] = [this](const std::string& path) {
+        if (!HasCapability(&ScriptCapabilities::snapshots, "Engine.saveSnapshot") ||
+            !CheckDataPath(path, SNAPSHOT_DIRECTORY, SNAPSHOT_EXTENSION)) {
+            return false;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(std::string(SNAPSHOT_DIRECTORY), error);
+        return m_engine->SaveSnapshot(path);
+    };
+    
+    engine["loadSnapshot"] = [this](const std::string& path) {
+        if (!HasCapability(&ScriptCapabilities::snapshots, "Engine.loadSnapshot") ||
+            !CheckDataPath(path, SNAPSHOT_DIRECTORY, SNAPSHOT_EXTENSION)) {
+            return false;
+        }
+        m_engine->RequestSnapshotLoad(path);
+        return true;
+    };
+}
+
+bool LuaManager::HasCapability(bool ScriptCapabilities::* capability, const char* function) const {
+    // Engine code runs outside any sandbox and may use everything
+    if (!m_activeSandbox || m_activeSandbox->capabilities.*capability) {
+        return true;
+    }
+    std::cerr << function << " is not available to script '" << m_activeSandbox->name << "'" << std::endl;
+    return false;
+}
+
+void LuaManager::RegisterReplayAPI() {
+    // Scripts copy the os functions when their sandbox is created, so the
+    // wrappers must be in place before the first script loads
+    auto sample = [this](double live) {
+        return m_engine->GetReplay().Sample(live);
+    };
+    sol::protected_function prelude = m_lua.load(REPLAY_CLOCK_PRELUDE, "=ReplayClock");
+    sol::protected_function_result result = prelude(m_lua.get<sol::table>("os"), sample);
+    if (!result.valid()) {
+        sol::error err = result;
+        throw err;
+    }
+    
+    sol::table engine = m_lua["Engine"];
+    
+    // Recording and playback begin at the next frame; a replay restores the
+    // state the recording started from. Logs live in recordings/ and end in
+    // .replay, and scripts need the replay capability. Pending Engine.async
+    // work cannot be reproduced, so recording refuses to start while any is
+    // outstanding and playback cancels what is pending.
+    engine["startRecording"] = [this](const std::string& path) {
+        if (!HasCapability(&ScriptCapabilities::replay, "Engine.startRecording") ||
+            !CheckDataPath(path, RECORDING_DIRECTORY, RECORDING_EXTENSION)) {
+            return false;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(std::string(RECORDING_DIRECTORY), error);
+        m_engine->StartRecording(path);
+        return true;
+    };
+    
+    // Replays at the recorded pace unless maxSpeed is true
+    engine["startReplay"] = [this](const std::string& path, sol::optional<bool> maxSpeed) {
+        if (!HasCapability(&ScriptCapabilities::replay, "Engine.startReplay") ||
+            !CheckDataPath(path, RECORDING_DIRECTORY, RECORDING_EXTENSION)) {
+            return false;
+        }
+        m_engine->StartReplay(path, maxSpeed.value_or(false) ? ReplaySpeed::Maximum : ReplaySpeed::Recorded);
+        return true;
+    };
+    
+    engine["stopReplay"] = [this]() {
+        if (HasCapability(&ScriptCapabilities::replay, "Engine.stopReplay")) {
+            m_engine->StopReplay();
+        }
+    };
+    
+    // "off", "recording" or "playback"
+    engine["getReplayMode"] = [this]() -> std::string {
+        switch (m_engine->GetReplay().GetMode()) {
+            case ReplayMode::Recording: return "recording";
+            case ReplayMode::Playback: return "playback";
+            default: return "off";
+        }
+    };
+}
+
+void LuaManager::SeedRandom(uint32_t seed) {
+    sol::table math = m_lua["math"];
+    sol::protected_function randomseed = math["randomseed"];
+    randomseed(seed);
+}
+
+void LuaManager::WriteSnapshot(SnapshotWriter& out) {
+    lua_State* L = m_lua.lua_state();
+    StackGuard guard(L);
+    
+    out.Write(m_scriptTime);
+    out.Write(m_scriptFrame);
+    out.Write(static_cast<uint32_t>(m_scripts.size()));
+    for (auto& script : m_scripts) {
+        out.WriteString(script->name);
+        out.Write(static_cast<uint8_t>(script->terminated));
+        size_t sizeOffset = out.Reserve<uint64_t>();
+        size_t start = out.Size();
+        
+        if (!script->terminated) {
+            ScriptSnapshot::Writer writer(L, out, SandboxTables(script->env));
+            script->env.push();
+            int env = lua_gettop(L);
+            writer.WriteValue(env);
+            
+            // Script-level locals live in the upvalues of the functions the
+            // script defines, so those are saved alongside the globals
+            size_t functionsOffset = out.Reserve<uint32_t>();
+            uint32_t functions = 0;
+            lua_pushnil(L);
+            while (lua_next(L, env)) {
+                int function = lua_gettop(L);
+                if (lua_type(L, function - 1) == LUA_TSTRING && lua_type(L, function) == LUA_TFUNCTION &&
+                    !lua_iscfunction(L, function)) {
+                    out.WriteString(lua_tostring(L, function - 1));
+                    size_t countOffset = out.Reserve<uint32_t>();
+                    uint32_t count = 0;
+                    for (int n = 1; const char* name = lua_getupvalue(L, function, n); n++) {
+                        if (std::strcmp(name, "_ENV") != 0) {
+                            out.Write(static_cast<uint32_t>(n));
+                            out.WriteString(name);
+                            writer.WriteValue(lua_gettop(L));
+                            count++;
+                        }
+                        lua_pop(L, 1);
+                    }
+                    out.Patch(countOffset, count);
+                    functions++;
+                }
+                lua_pop(L, 1);
+            }
+            out.Patch(functionsOffset, functions);
+            lua_settop(L, env - 1);
+        }
+        out.Patch(sizeOffset, static_cast<uint64_t>(out.Size() - start));
+    }
+}
+
+void LuaManager::ReadSnapshot(SnapshotReader& in) {
+    lua_State* L = m_lua.lua_state();
+    StackGuard guard(L);
+    
+    // Pending timers keep their remaining delay on the restored clock
+    double scriptTime = in.Read<double>();
+    uint64_t scriptFrame = in.Read<uint64_t>();
+    for (ScriptTimer& timer : m_timers) {
+        timer.time = scriptTime + (timer.time - m_scriptTime);
+        timer.frame = scriptFrame + (timer.frame > m_scriptFrame ? timer.frame - m_scriptFrame : 0);
+    }
+    m_scriptTime = scriptTime;
+    m_scriptFrame = scriptFrame;
+    
+    uint32_t count = in.Read<uint32_t>();
+    for (uint32_t i = 0; i < count; i++) {
+        std::string name(in.ReadString());
+        bool terminated = in.Read<uint8_t>() != 0;
+        uint64_t size = in.Read<uint64_t>();
+        
+        // Scripts are matched by load order and name
+        ScriptSandbox* script = i < m_scripts.size() ? m_scripts[i].get() : nullptr;
+        if (terminated || !script || script->terminated || script->name != name) {
+            if (!terminated) {
+                std::cerr << "Snapshot state of script '" << name << "' not restored: no matching running script" << std::endl;
+            }
+            in.Skip(size);
+            continue;
+        }
+        
+        // Tables and strings recreated here belong to the script's quota
+        uint32_t previousIndex = m_activeSandboxIndex;
+        m_activeSandboxIndex = script->index;
+        try {
+            ScriptSnapshot::Reader reader(L, in, SandboxTables(script->env));
+            script->env.push();
+            int env = lua_gettop(L);
+            reader.ReadValue(env); // Restores into the environment itself
+            lua_pop(L, 1);
+            
+            uint32_t functions = in.Read<uint32_t>();
+            for (uint32_t f = 0; f < functions; f++) {
+                std::string_view functionName = in.ReadString();
+                uint32_t upvalues = in.Read<uint32_t>();
+                
+                lua_pushlstring(L, functionName.data(), functionName.size());
+                lua_rawget(L, env);
+                int function = lua_gettop(L);
+                bool live = lua_type(L, function) == LUA_TFUNCTION && !lua_iscfunction(L, function);
+                
+                for (uint32_t u = 0; u < upvalues; u++) {
+                    int n = static_cast<int>(in.Read<uint32_t>());
+                    std::string_view upvalueName = in.ReadString();
+                    
+                    // The function may have been redefined since; only an
+                    // upvalue with the same slot and name is restored
+                    const char* current = live ? lua_getupvalue(L, function, n) : nullptr;
+                    bool match = current && upvalueName == current;
+                    reader.ReadValue(match ? lua_gettop(L) : 0);
+                    if (match) {
+                        lua_setupvalue(L, function, n);
+                    }
+                    lua_settop(L, function);
+                }
+                lua_settop(L, env);
+            }
+        } catch (...) {
+            m_activeSandboxIndex = previousIndex;
+            throw;
+        }
+        m_activeSandboxIndex = previousIndex;
+        lua_settop(L, guard.top);
+    }
+}
+
+void LuaManager::Shutdown() {
+    m_activeSandbox = nullptr;
+    m_activeSandboxIndex = 0;
+    m_coroutines.clear();
+    m_timers.clear();
+    m_continuations.clear();
+    for (auto& script : m_scripts) {
+        script->env = sol::environment();
+    }
+    m_lua.collect_garbage();
+    m_updateCallback = nullptr;
+}
+
+sol::environment LuaManager::CreateSandboxEnvironment() {
+    sol::environment env(m_lua, sol::create);
+    sol::table globals = m_lua.globals();
+
+    for (const char* name : SANDBOX_FUNCTIONS) {
+        env[name] = globals.get<sol::object>(name);
+    }
+
+    for (const char* name : SANDBOX_LIBRARIES) {
+        sol::optional<sol::table> library = globals[name];
+        if (!library) continue;
+
+        sol::table copy = m_lua.create_table();
+        for (const auto& [key, value] : *library) {
+            copy[key] = value;
+        }
+        env[name] = copy;
+    }
+
+    sol::table os = m_lua.create_table();
+    sol::table osLibrary = globals["os"];
+    for (const char* name : SANDBOX_OS_FUNCTIONS) {
+        os[name] = osLibrary.get<sol::object>(name);
+    }
+    env["os"] = os;
+
+    env["getmetatable"] = m_sandboxGetmetatable;
+    for (const char* name : SANDBOX_ENGINE_TABLES) {
+        sol::object table = globals.get<sol::object>(name);
+        if (table.get_type() == sol::type::table) {
+            env[name] = m_readOnlyProxy(table);
+        }
+    }
+
+    env["_G"] = env;
+    return env;
+}
+
+bool LuaManager::RunSandboxed(ScriptSandbox& sandbox, const std::function<sol::protected_function_result()>& body) {
+    if (sandbox.terminated) {
+        return false;
+    }
+
+    // Nested entries (a script calling back into itself through the engine)
+    // share the budget of the outermost call
+    ScriptSandbox* previous = m_activeSandbox;
+    uint32_t previousIndex = m_activeSandboxIndex;
+
+    m_activeSandbox = &sandbox;
+    m_activeSandboxIndex = sandbox.index;
+    if (!previous) {
+        sandbox.instructionsUsed = 0;
+        lua_sethook(m_lua.lua_state(), &LuaManager::InstructionHook, LUA_MASKCOUNT, HOOK_INSTRUCTION_STEP);
+    }
+
+    sol::protected_function_result result = body();
+
+    if (!previous) {
+        lua_sethook(m_lua.lua_state(), nullptr, 0, 0);
+    }
+    m_activeSandbox = previous;
+    m_activeSandboxIndex = previousIndex;
+
+    if (!result.valid()) {
+        sol::error err = result;
+        if (sandbox.overQuota) {
+            TerminateScript(sandbox, err.what());
+        } else {
+            std::cerr << "Lua script '" << sandbox.name << "' error: " << err.what() << std::endl;
+        }
         return false;
     }
+    return true;
+}
+
+void LuaManager::TerminateScript(ScriptSandbox& sandbox, const std::string& reason) {
+    sandbox.terminated = true;
+    std::cerr << "Lua script '" << sandbox.name << "' terminated: " << reason << std::endl;
+
+    // Drop the environment so its tables become collectable; the memory is
+    // credited back to the script when the collector frees it
+    sandbox.env = sol::environment();
+    m_lua.collect_garbage();
 }
 
+bool LuaManager::LoadScript(const std::string& filename) {
+    return LoadScript(filename, ScriptQuota{});
+}
+
+bool LuaManager::LoadScript(const std::string& filename, const ScriptQuota& quota, const ScriptCapabilities& capabilities) {
+    ScriptSandbox& script = CreateScript(filename, quota);
+    script.capabilities = capabilities;
+    return RunSandboxed(script, [this, &script, &filename]() {
+        return RunLoadedChunk(script, luaL_loadfilex(m_lua.lua_state(), filename.c_str(), nullptr));
+    });
+}
+
+ScriptSandbox& LuaManager::CreateScript(const std::string& name, const ScriptQuota& quota) {
+    m_scripts.push_back(std::make_unique<ScriptSandbox>());
+    ScriptSandbox& script = *m_scripts.back();
+    script.name = name;
+    script.quota = quota;
+    script.index = static_cast<uint32_t>(m_scripts.size());
+    script.origin = script.index;
+
+    // Build the environment while the sandbox is active so its tables are
+    // charged against the script's own memory quota
+    ScriptSandbox* previous = m_activeSandbox;
+    uint32_t previousIndex = m_activeSandboxIndex;
+    m_activeSandbox = &script;
+    m_activeSandboxIndex = script.index;
+    script.env = CreateSandboxEnvironment();
+    m_activeSandbox = previous;
+    m_activeSandboxIndex = previousIndex;
+    return script;
+}
+
+// Runs the chunk a luaL_load* call just pushed in the script's environment,
+// or returns the load error it pushed instead
+sol::protected_function_result LuaManager::RunLoadedChunk(ScriptSandbox& script, int loadStatus) {
+    lua_State* L = m_lua.lua_state();
+    if (loadStatus != LUA_OK) {
+        return sol::protected_function_result(L, lua_absindex(L, -1), 1, 1, static_cast<sol::call_status>(loadStatus));
+    }
+
+    sol::stack_aligned_protected_function chunk(L, -1);
+    sol::set_environment(script.env, chunk);
+#ifdef ENGINE_LUAJIT
+    // Instruction hooks never fire inside compiled traces, so a loop the
+    // JIT compiled could run forever. The flag is set on the chunk's
+    // prototypes, so every function the script defines stays interpreted.
+    if (!script.capabilities.jit) {
+        chunk.push();
+        luaJIT_setmode(L, -1, LUAJIT_MODE_ALLFUNC | LUAJIT_MODE_OFF);
+        lua_pop(L, 1);
+    }
+#endif
+    return chunk();
+}
+
+// Runs trusted engine-side code in the global state, outside any sandbox
 bool LuaManager::ExecuteString(const std::string& code) {
     try {
         m_lua.script(code);
@@ -156,6 +1935,8 @@ void LuaManager::SetUpdateCallback(std::function<void(float)> callback) {
 }
 
 void LuaManager::CallUpdate(float deltaTime) {
+    UpdateAsync(deltaTime);
+
     if (m_updateCallback) {
         try {
             m_updateCallback(deltaTime);
@@ -164,4 +1945,16 @@ void LuaManager::CallUpdate(float deltaTime) {
             std::cerr << "Lua update callback error: " << e.what() << std::endl;
         }
     }
+
+    // Each script's update() runs under its own quota
+    for (auto& script : m_scripts) {
+        if (script->terminated) continue;
+
+        sol::protected_function update = script->env["update"];
+        if (!update.valid()) continue;
+
+        RunSandboxed(*script, [&update, deltaTime]() {
+            return update(deltaTime);
+        });
+    }
 }
\ No newline at end of file
@@ -0,0 +1,676 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    constexpr uint32_t NO_PASS = 0xFFFFFFFFu;
+    constexpr uint32_t NO_IMAGE = 0xFFFFFFFFu;
+
+    constexpr VkAccessFlags WRITE_ACCESS =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+        VK_ACCESS_MEMORY_WRITE_BIT;
+
+    struct AccessInfo {
+        VkImageLayout layout;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageUsageFlags usage;
+    };
+
+    AccessInfo DescribeAccess(RenderAccess access, VkImageAspectFlags aspect) {
+        constexpr VkPipelineStageFlags DEPTH_TESTS =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+        // Sampled depth stays in the read-only depth layout so it can be
+        // tested against and sampled without another transition
+        bool depth = (aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+        VkImageLayout sampledLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                            : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        switch (access) {
+            case RenderAccess::ColorAttachment:
+                return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+            case RenderAccess::DepthAttachment:
+                return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DEPTH_TESTS,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+            case RenderAccess::DepthReadOnly:
+                return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, DEPTH_TESTS,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+            case RenderAccess::SampledFragment:
+                return {sampledLayout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_USAGE_SAMPLED_BIT};
+            case RenderAccess::SampledCompute:
+                return {sampledLayout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_IMAGE_USAGE_SAMPLED_BIT};
+            case RenderAccess::StorageCompute:
+                return {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT};
+            case RenderAccess::TransferSource:
+                return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+            case RenderAccess::TransferDestination:
+                return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+        }
+        throw std::logic_error("Unknown render graph access");
+    }
+
+    VkImageAspectFlags AspectFor(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    // 64-bit FNV-1a over a value's bytes
+    template<typename T>
+    uint64_t HashValue(uint64_t hash, const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+}
+
+// =============================================================================
+// PASS BUILDER
+// =============================================================================
+
+void RenderPassBuilder::WriteColor(RenderResource image, VkAttachmentLoadOp loadOp, VkClearColorValue clear) {
+    RenderGraph::Attachment attachment;
+    attachment.resource = image;
+    attachment.loadOp = loadOp;
+    attachment.clear.color = clear;
+    m_graph.m_passes[m_pass].colorAttachments.push_back(attachment);
+    m_graph.AddAccess(m_pass, image, RenderAccess::ColorAttachment, true);
+}
+
+void RenderPassBuilder::WriteDepth(RenderResource image, VkAttachmentLoadOp loadOp, float clearDepth) {
+    RenderGraph::Attachment& attachment = m_graph.m_passes[m_pass].depthAttachment;
+    attachment.resource = image;
+    attachment.loadOp = loadOp;
+    attachment.clear.depthStencil = {clearDepth, 0};
+    attachment.readOnly = false;
+    m_graph.AddAccess(m_pass, image, RenderAccess::DepthAttachment, true);
+}
+
+void RenderPassBuilder::ReadDepth(RenderResource image) {
+    RenderGraph::Attachment& attachment = m_graph.m_passes[m_pass].depthAttachment;
+    attachment.resource = image;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.readOnly = true;
+    m_graph.AddAccess(m_pass, image, RenderAccess::DepthReadOnly, false);
+}
+
+void RenderPassBuilder::Read(RenderResource image, RenderAccess access) {
+    m_graph.AddAccess(m_pass, image, access, false);
+}
+
+void RenderPassBuilder::Write(RenderResource image, RenderAccess access) {
+    m_graph.AddAccess(m_pass, image, access, true);
+}
+
+void RenderPassBuilder::SetSideEffect() {
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+// =============================================================================
+// DECLARATION
+// =============================================================================
+
+void RenderGraph::Initialize(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue) {
+    m_device = device;
+    m_physicalDevice = physicalDevice;
+    m_deletionQueue = &deletionQueue;
+
+    m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+    m_cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+    if (!m_cmdBeginRendering || !m_cmdEndRendering) {
+        throw std::runtime_error("VK_KHR_dynamic_rendering is not enabled!");
+    }
+}
+
+void RenderGraph::Destroy() {
+    for (PhysicalImage& physical : m_physicalImages) {
+        SafeDestroy<VkImageView>(physical.view, [this](VkImageView view) { vkDestroyImageView(m_device, view, nullptr); });
+        SafeDestroy<VkImageView>(physical.sampledView, [this](VkImageView view) { vkDestroyImageView(m_device, view, nullptr); });
+        SafeDestroy<VkImage>(physical.image, [this](VkImage image) { vkDestroyImage(m_device, image, nullptr); });
+    }
+    for (MemoryBlock& block : m_blocks) {
+        SafeDestroy<VkDeviceMemory>(block.memory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    }
+    m_physicalImages.clear();
+    m_blocks.clear();
+    m_transientSignature = 0;
+}
+
+void RenderGraph::Reset() {
+    m_resources.clear();
+    for (uint32_t i = 0; i < m_passCount; i++) {
+        Pass& pass = m_passes[i];
+        pass.execute = nullptr;
+        pass.accesses.clear();
+        pass.colorAttachments.clear();
+    }
+    m_passCount = 0;
+    m_culledPassCount = 0;
+    m_compiled = false;
+}
+
+RenderResource RenderGraph::ImportImage(const char* name, VkImage image, VkImageView view, VkFormat format,
+                                        VkExtent2D extent, const RenderImageState& initial, VkImageLayout finalLayout) {
+    Resource resource;
+    resource.name = name;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = AspectFor(format);
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.initial = initial;
+    resource.finalLayout = finalLayout;
+    m_resources.push_back(resource);
+    return static_cast<RenderResource>(m_resources.size() - 1);
+}
+
+RenderResource RenderGraph::CreateImage(const char* name, const RenderImageDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.format = desc.format;
+    resource.extent = desc.extent;
+    resource.aspect = AspectFor(desc.format);
+    resource.usage = desc.extraUsage;
+    m_resources.push_back(resource);
+    return static_cast<RenderResource>(m_resources.size() - 1);
+}
+
+void RenderGraph::AddPass(const char* name, const std::function<void(RenderPassBuilder&)>& setup,
+                          std::function<void(VkCommandBuffer)> execute) {
+    if (m_passCount == m_passes.size()) {
+        m_passes.emplace_back();
+    }
+    uint32_t index = m_passCount++;
+    Pass& pass = m_passes[index];
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.depthAttachment = Attachment{};
+    pass.sideEffect = false;
+    pass.culled = false;
+
+    RenderPassBuilder builder(*this, index);
+    setup(builder);
+}
+
+void RenderGraph::AddAccess(uint32_t pass, RenderResource resource, RenderAccess access, bool write) {
+    if (resource >= m_resources.size()) {
+        throw std::runtime_error(std::string("Render pass ") + m_passes[pass].name + " uses an undeclared image");
+    }
+    m_passes[pass].accesses.push_back(Access{resource, access, write});
+}
+
+VkImage RenderGraph::GetImage(RenderResource resource) const {
+    const Resource& entry = m_resources[resource];
+    if (entry.imported) return entry.image;
+    return entry.physical != NO_IMAGE ? m_physicalImages[entry.physical].image : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::GetImageView(RenderResource resource) const {
+    const Resource& entry = m_resources[resource];
+    if (entry.imported) return entry.view;
+    return entry.physical != NO_IMAGE ? m_physicalImages[entry.physical].view : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::GetSampledView(RenderResource resource) const {
+    const Resource& entry = m_resources[resource];
+    if (entry.imported || entry.physical == NO_IMAGE) return GetImageView(resource);
+    const PhysicalImage& physical = m_physicalImages[entry.physical];
+    return physical.sampledView != VK_NULL_HANDLE ? physical.sampledView : physical.view;
+}
+
+// =============================================================================
+// COMPILATION
+// =============================================================================
+
+void RenderGraph::Compile() {
+    CullPasses();
+
+    for (Resource& resource : m_resources) {
+        resource.firstPass = NO_PASS;
+        resource.lastPass = 0;
+        resource.physical = NO_IMAGE;
+    }
+    for (uint32_t i = 0; i < m_passCount; i++) {
+        const Pass& pass = m_passes[i];
+        if (pass.culled) continue;
+        for (const Access& access : pass.accesses) {
+            Resource& resource = m_resources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, i);
+            resource.lastPass = std::max(resource.lastPass, i);
+            if (!resource.imported) {
+                resource.usage |= DescribeAccess(access.access, resource.aspect).usage;
+            }
+        }
+    }
+
+    // Physical images are numbered in declaration order, so an unchanged
+    // graph maps every transient to the same image as last frame
+    uint32_t transientCount = 0;
+    for (Resource& resource : m_resources) {
+        if (!resource.imported && resource.firstPass != NO_PASS) {
+            resource.physical = transientCount++;
+        }
+    }
+
+    uint64_t signature = TransientSignature();
+    if (signature != m_transientSignature || m_physicalImages.size() != transientCount) {
+        ReleaseTransients();
+        AllocateTransients();
+        m_transientSignature = signature;
+    }
+    m_compiled = true;
+}
+
+void RenderGraph::CullPasses() {
+    // Walk backwards keeping passes that write something a kept pass reads,
+    // an imported image, or that were marked as having side effects
+    m_needed.assign(m_resources.size(), false);
+    m_culledPassCount = 0;
+
+    for (uint32_t i = m_passCount; i-- > 0;) {
+        Pass& pass = m_passes[i];
+        bool alive = pass.sideEffect;
+        for (const Access& access : pass.accesses) {
+            if (access.write && (m_resources[access.resource].imported || m_needed[access.resource])) {
+                alive = true;
+            }
+        }
+
+        pass.culled = !alive;
+        if (!alive) {
+            m_culledPassCount++;
+            continue;
+        }
+
+        for (const Access& access : pass.accesses) {
+            if (!access.write) {
+                m_needed[access.resource] = true;
+            }
+        }
+        // Loading an attachment reads what earlier passes left in it
+        for (const Attachment& attachment : pass.colorAttachments) {
+            if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+                m_needed[attachment.resource] = true;
+            }
+        }
+        if (pass.depthAttachment.resource != INVALID_RENDER_RESOURCE &&
+            pass.depthAttachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+            m_needed[pass.depthAttachment.resource] = true;
+        }
+    }
+}
+
+uint64_t RenderGraph::TransientSignature() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const Resource& resource : m_resources) {
+        if (resource.imported || resource.physical == NO_IMAGE) continue;
+        hash = HashValue(hash, resource.format);
+        hash = HashValue(hash, resource.extent.width);
+        hash = HashValue(hash, resource.extent.height);
+        hash = HashValue(hash, resource.usage);
+        hash = HashValue(hash, resource.firstPass);
+        hash = HashValue(hash, resource.lastPass);
+    }
+    return hash;
+}
+
+void RenderGraph::AllocateTransients() {
+    struct Placement {
+        RenderResource resource;
+        VkMemoryRequirements requirements;
+    };
+    std::vector<Placement> placements;
+
+    for (RenderResource i = 0; i < m_resources.size(); i++) {
+        const Resource& resource = m_resources[i];
+        if (resource.imported || resource.physical == NO_IMAGE) continue;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.format;
+        imageInfo.extent = {resource.extent.width, resource.extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = resource.usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (m_physicalImages.size() <= resource.physical) {
+            m_physicalImages.resize(resource.physical + 1);
+        }
+        PhysicalImage& physical = m_physicalImages[resource.physical];
+        ThrowIfFailed(vkCreateImage(m_device, &imageInfo, nullptr, &physical.image),
+                      std::string("Failed to create render graph image ") + resource.name + "!");
+
+        Placement placement{i, {}};
+        vkGetImageMemoryRequirements(m_device, physical.image, &placement.requirements);
+        placements.push_back(placement);
+    }
+
+    // Largest first, so every later image fits a block some earlier one
+    // opened whenever their lifetimes allow sharing it
+    std::sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b) {
+        return a.requirements.size > b.requirements.size;
+    });
+
+    m_transientImageBytes = 0;
+    for (const Placement& placement : placements) {
+        const Resource& resource = m_resources[placement.resource];
+        const VkMemoryRequirements& requirements = placement.requirements;
+        m_transientImageBytes += requirements.size;
+
+        uint32_t blockIndex = NO_IMAGE;
+        for (uint32_t b = 0; b < m_blocks.size() && blockIndex == NO_IMAGE; b++) {
+            const MemoryBlock& block = m_blocks[b];
+            if (block.size < requirements.size || !(requirements.memoryTypeBits & (1u << block.memoryType))) {
+                continue;
+            }
+            bool overlaps = std::any_of(block.lifetimes.begin(), block.lifetimes.end(), [&](const auto& lifetime) {
+                return resource.firstPass <= lifetime.second && lifetime.first <= resource.lastPass;
+            });
+            if (!overlaps) {
+                blockIndex = b;
+            }
+        }
+
+        if (blockIndex == NO_IMAGE) {
+            MemoryBlock block;
+            block.size = requirements.size;
+            block.memoryType = FindMemoryType(m_physicalDevice, requirements.memoryTypeBits,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = block.size;
+            allocInfo.memoryTypeIndex = block.memoryType;
+            ThrowIfFailed(vkAllocateMemory(m_device, &allocInfo, nullptr, &block.memory),
+                          "Failed to allocate render graph memory!");
+
+            blockIndex = static_cast<uint32_t>(m_blocks.size());
+            m_blocks.push_back(std::move(block));
+        }
+
+        MemoryBlock& block = m_blocks[blockIndex];
+        block.lifetimes.emplace_back(resource.firstPass, resource.lastPass);
+
+        // Every occupant starts at offset 0: the block is as large as its
+        // first (largest) image, whose alignment satisfies the rest
+        PhysicalImage& physical = m_physicalImages[resource.physical];
+        physical.block = blockIndex;
+        ThrowIfFailed(vkBindImageMemory(m_device, physical.image, block.memory, 0),
+                      "Failed to bind render graph memory!");
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = physical.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.format;
+        viewInfo.subresourceRange.aspectMask = resource.aspect;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.layerCount = 1;
+        ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, nullptr, &physical.view),
+                      "Failed to create render graph image view!");
+
+        // Attachments of combined formats need both aspects, samplers only one
+        if ((resource.usage & VK_IMAGE_USAGE_SAMPLED_BIT) && (resource.aspect & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, nullptr, &physical.sampledView),
+                          "Failed to create render graph image view!");
+        }
+    }
+
+    m_transientMemoryBytes = 0;
+    for (const MemoryBlock& block : m_blocks) {
+        m_transientMemoryBytes += block.size;
+    }
+}
+
+void RenderGraph::ReleaseTransients() {
+    // Frames in flight may still render into these
+    for (PhysicalImage& physical : m_physicalImages) {
+        DeferDestroy<VkImageView>(*m_deletionQueue, physical.view, [device = m_device](VkImageView view) { vkDestroyImageView(device, view, nullptr); });
+        DeferDestroy<VkImageView>(*m_deletionQueue, physical.sampledView, [device = m_device](VkImageView view) { vkDestroyImageView(device, view, nullptr); });
+        DeferDestroy<VkImage>(*m_deletionQueue, physical.image, [device = m_device](VkImage image) { vkDestroyImage(device, image, nullptr); });
+    }
+    for (MemoryBlock& block : m_blocks) {
+        DeferDestroy<VkDeviceMemory>(*m_deletionQueue, block.memory, [device = m_device](VkDeviceMemory memory) { vkFreeMemory(device, memory, nullptr); });
+    }
+    m_physicalImages.clear();
+    m_blocks.clear();
+}
+
+// =============================================================================
+// EXECUTION
+// =============================================================================
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer) {
+    if (!m_compiled) {
+        Compile();
+    }
+
+    m_blockStates.resize(m_blocks.size());
+    for (size_t b = 0; b < m_blocks.size(); b++) {
+        m_blockStates[b] = {VK_IMAGE_LAYOUT_UNDEFINED, m_blocks[b].lastStages, m_blocks[b].lastAccess};
+    }
+    m_states.resize(m_resources.size());
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        const Resource& resource = m_resources[r];
+        m_states[r] = resource.imported
+            ? ImageState{resource.initial.layout, resource.initial.stages, resource.initial.access}
+            : ImageState{};
+    }
+
+    for (uint32_t i = 0; i < m_passCount; i++) {
+        Pass& pass = m_passes[i];
+        if (pass.culled) continue;
+
+        RecordBarriers(commandBuffer, i);
+
+        bool rendering = !pass.colorAttachments.empty() || pass.depthAttachment.resource != INVALID_RENDER_RESOURCE;
+        if (rendering) {
+            BeginRendering(commandBuffer, i);
+        }
+        if (pass.execute) {
+            pass.execute(commandBuffer);
+        }
+        if (rendering) {
+            m_cmdEndRendering(commandBuffer);
+        }
+
+        for (const Access& access : pass.accesses) {
+            const Resource& resource = m_resources[access.resource];
+            if (!resource.imported) {
+                m_blockStates[m_physicalImages[resource.physical].block] = m_states[access.resource];
+            }
+        }
+    }
+
+    // Hand imported images back in the layout their owners expect
+    m_barriers.clear();
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        const Resource& resource = m_resources[r];
+        ImageState& state = m_states[r];
+        if (!resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || state.layout == resource.finalLayout) {
+            continue;
+        }
+
+        // Presentation is ordered by the render-finished semaphore; anything
+        // else may be read by whatever the owner records next
+        bool present = resource.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        barrier.subresourceRange.aspectMask = resource.aspect;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = state.access & WRITE_ACCESS;
+        barrier.dstAccessMask = present ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        m_barriers.push_back(barrier);
+
+        srcStages |= state.stages;
+        dstStages |= present ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        state.layout = resource.finalLayout;
+    }
+    if (!m_barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(m_barriers.size()), m_barriers.data());
+    }
+
+    for (size_t b = 0; b < m_blocks.size(); b++) {
+        m_blocks[b].lastStages = m_blockStates[b].stages;
+        m_blocks[b].lastAccess = m_blockStates[b].access;
+    }
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, uint32_t passIndex) {
+    const Pass& pass = m_passes[passIndex];
+    m_barriers.clear();
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+
+    for (const Access& access : pass.accesses) {
+        const Resource& resource = m_resources[access.resource];
+        AccessInfo info = DescribeAccess(access.access, resource.aspect);
+        ImageState& state = m_states[access.resource];
+
+        // A transient's first use discards the contents but must still wait
+        // for whatever last used its memory, in this frame or an earlier one
+        if (!resource.imported && resource.firstPass == passIndex && state.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            const ImageState& block = m_blockStates[m_physicalImages[resource.physical].block];
+            state.stages = block.stages;
+            state.access = block.access;
+        }
+
+        bool layoutChange = state.layout != info.layout;
+        bool hazard = (state.access & WRITE_ACCESS) != 0 || (access.write && state.access != 0);
+        if (!layoutChange && !hazard) {
+            // Reads after reads only need to be waited for by the next writer
+            state.stages |= info.stages;
+            state.access |= info.access;
+            continue;
+        }
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = info.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = GetImage(access.resource);
+        barrier.subresourceRange.aspectMask = resource.aspect;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = state.access & WRITE_ACCESS;
+        barrier.dstAccessMask = info.access;
+        m_barriers.push_back(barrier);
+
+        srcStages |= state.stages;
+        dstStages |= info.stages;
+        state = {info.layout, info.stages, info.access};
+    }
+
+    if (!m_barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             dstStages, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(m_barriers.size()), m_barriers.data());
+    }
+}
+
+void RenderGraph::BeginRendering(VkCommandBuffer commandBuffer, uint32_t passIndex) {
+    const Pass& pass = m_passes[passIndex];
+
+    // Contents only need writing back if a later pass or the owner of an
+    // imported image will look at them
+    auto storeOp = [&](RenderResource resource) {
+        const Resource& entry = m_resources[resource];
+        return entry.imported || entry.lastPass > passIndex ? VK_ATTACHMENT_STORE_OP_STORE
+                                                            : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    };
+
+    VkExtent2D extent = {0, 0};
+    m_colorInfos.clear();
+    for (const Attachment& attachment : pass.colorAttachments) {
+        VkRenderingAttachmentInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        info.imageView = GetImageView(attachment.resource);
+        info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        info.loadOp = attachment.loadOp;
+        info.storeOp = storeOp(attachment.resource);
+        info.clearValue = attachment.clear;
+        m_colorInfos.push_back(info);
+        extent = m_resources[attachment.resource].extent;
+    }
+
+    VkRenderingAttachmentInfoKHR depthInfo{};
+    const Attachment& depth = pass.depthAttachment;
+    if (depth.resource != INVALID_RENDER_RESOURCE) {
+        depthInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depthInfo.imageView = GetImageView(depth.resource);
+        depthInfo.imageLayout = depth.readOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                               : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthInfo.loadOp = depth.loadOp;
+        depthInfo.storeOp = storeOp(depth.resource);
+        depthInfo.clearValue = depth.clear;
+        extent = m_resources[depth.resource].extent;
+    }
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = {{0, 0}, extent};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(m_colorInfos.size());
+    renderingInfo.pColorAttachments = m_colorInfos.data();
+    if (depth.resource != INVALID_RENDER_RESOURCE) {
+        renderingInfo.pDepthAttachment = &depthInfo;
+        if (m_resources[depth.resource].aspect & VK_IMAGE_ASPECT_STENCIL_BIT) {
+            renderingInfo.pStencilAttachment = &depthInfo;
+        }
+    }
+    m_cmdBeginRendering(commandBuffer, &renderingInfo);
+
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{{0, 0}, extent};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
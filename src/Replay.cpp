@@ -0,0 +1,246 @@
+#include "Replay.h"
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+    constexpr char REPLAY_MAGIC[4] = {'V', 'L', 'R', 'C'};
+    constexpr uint32_t REPLAY_VERSION = 1;
+
+    struct ReplayHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t seed;
+        uint32_t reserved;
+        uint64_t snapshotSize; // The start snapshot follows the header
+    };
+
+    // Each record is a tag followed by its payload
+    enum class RecordTag : uint8_t {
+        Frame = 1, // ReplayFrame
+        Key = 2,   // ReplayKeyEvent, logged before the frame that handles it
+        Value = 3  // double returned by Sample
+    };
+}
+
+ReplaySession::ReplaySession() = default;
+
+ReplaySession::~ReplaySession() {
+    Stop();
+}
+
+template<typename T>
+bool ReplaySession::ReadRecord(T& value) {
+    if (sizeof(T) > m_log->GetSize() - m_offset) {
+        return false;
+    }
+    std::memcpy(&value, m_log->GetData() + m_offset, sizeof(T));
+    m_offset += sizeof(T);
+    return true;
+}
+
+// =============================================================================
+// RECORDING
+// =============================================================================
+
+bool ReplaySession::StartRecording(const std::string& path, std::span<const std::byte> snapshot, uint32_t seed) {
+    Stop();
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        std::cerr << "Failed to open replay log for writing: " << path << std::endl;
+        return false;
+    }
+
+    ReplayHeader header{};
+    std::memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    header.version = REPLAY_VERSION;
+    header.seed = seed;
+    header.snapshotSize = snapshot.size();
+    WriteRecord(header);
+    m_file.write(reinterpret_cast<const char*>(snapshot.data()), static_cast<std::streamsize>(snapshot.size()));
+
+    m_mode = ReplayMode::Recording;
+    m_path = path;
+    m_frame = 0;
+    m_seed = seed;
+    std::cout << "Recording session to " << path << std::endl;
+    return true;
+}
+
+void ReplaySession::RecordKey(const ReplayKeyEvent& event) {
+    if (m_mode != ReplayMode::Recording) return;
+    WriteRecord(RecordTag::Key);
+    WriteRecord(event);
+}
+
+void ReplaySession::RecordFrame(const ReplayFrame& frame) {
+    if (m_mode != ReplayMode::Recording) return;
+    WriteRecord(RecordTag::Frame);
+    WriteRecord(frame);
+    m_frame++;
+}
+
+double ReplaySession::Sample(double live) {
+    switch (m_mode) {
+        case ReplayMode::Recording:
+            WriteRecord(RecordTag::Value);
+            WriteRecord(live);
+            return live;
+        case ReplayMode::Playback: {
+            RecordTag tag{};
+            double value = 0.0;
+            if (ReadRecord(tag) && tag == RecordTag::Value && ReadRecord(value)) {
+                return value;
+            }
+            EndPlayback("diverged (a script read a value the recording does not have)");
+            return live;
+        }
+        default:
+            return live;
+    }
+}
+
+// =============================================================================
+// PLAYBACK
+// =============================================================================
+
+bool ReplaySession::StartPlayback(const std::string& path, ReplaySpeed speed) {
+    Stop();
+
+    try {
+        m_log = std::make_unique<MappedFile>(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to open replay log: " << e.what() << std::endl;
+        return false;
+    }
+
+    m_offset = 0;
+    ReplayHeader header{};
+    if (!ReadRecord(header) || std::memcmp(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+        header.version != REPLAY_VERSION || header.snapshotSize > m_log->GetSize() - m_offset) {
+        std::cerr << "Not a replay log this build can play: " << path << std::endl;
+        m_log.reset();
+        return false;
+    }
+
+    m_startSnapshot = std::span(reinterpret_cast<const std::byte*>(m_log->GetData()) + m_offset, header.snapshotSize);
+    m_offset += header.snapshotSize;
+
+    m_mode = ReplayMode::Playback;
+    m_speed = speed;
+    m_path = path;
+    m_frame = 0;
+    m_seed = header.seed;
+    m_timings.clear();
+    m_lastFrameStart = std::chrono::steady_clock::now();
+    std::cout << "Replaying session from " << path << std::endl;
+    return true;
+}
+
+bool ReplaySession::NextFrame(ReplayFrame& frame, std::vector<ReplayKeyEvent>& keys) {
+    if (m_mode != ReplayMode::Playback) {
+        return false;
+    }
+
+    keys.clear();
+    for (;;) {
+        RecordTag tag{};
+        if (!ReadRecord(tag)) {
+            EndPlayback("end of recording");
+            return false;
+        }
+        if (tag == RecordTag::Key) {
+            ReplayKeyEvent event;
+            if (!ReadRecord(event)) {
+                EndPlayback("truncated recording");
+                return false;
+            }
+            keys.push_back(event);
+            continue;
+        }
+        if (tag == RecordTag::Frame && ReadRecord(frame)) {
+            break;
+        }
+        EndPlayback(tag == RecordTag::Value ? "diverged (the recording has values no script read)" : "corrupt recording");
+        return false;
+    }
+
+    if (m_speed == ReplaySpeed::Recorded) {
+        auto delta = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<float>(frame.deltaTime));
+        std::this_thread::sleep_until(m_lastFrameStart + delta);
+    }
+
+    // The previous frame's total time is only known once this one starts
+    auto now = std::chrono::steady_clock::now();
+    if (!m_timings.empty()) {
+        m_timings.back().frameMs = std::chrono::duration<float, std::milli>(now - m_lastFrameStart).count();
+    }
+    m_lastFrameStart = now;
+    m_currentFrame = frame;
+    m_frame++;
+    return true;
+}
+
+void ReplaySession::ReportFrameTiming(float updateMs, float renderMs) {
+    if (m_mode != ReplayMode::Playback) return;
+    m_timings.push_back({m_currentFrame.deltaTime, updateMs, renderMs, 0.0f});
+}
+
+void ReplaySession::Stop() {
+    if (m_mode == ReplayMode::Recording) {
+        m_file.close();
+        m_mode = ReplayMode::Off;
+        std::cout << "Recorded " << m_frame << " frames to " << m_path << std::endl;
+    } else if (m_mode == ReplayMode::Playback) {
+        EndPlayback("stopped");
+    }
+}
+
+void ReplaySession::EndPlayback(const char* reason) {
+    std::cout << "Replay of " << m_path << " ended after " << m_frame << " frames: " << reason << std::endl;
+    WriteTimingReport();
+
+    m_mode = ReplayMode::Off;
+    m_startSnapshot = {};
+    m_log.reset();
+    m_timings.clear();
+}
+
+void ReplaySession::WriteTimingReport() {
+    if (m_timings.empty()) return;
+
+    std::string reportPath = m_path + ".timings.csv";
+    std::ofstream report(reportPath);
+    if (!report) {
+        std::cerr << "Failed to write replay timings: " << reportPath << std::endl;
+        return;
+    }
+
+    report << "frame,deltaMs,updateMs,renderMs,frameMs\n";
+    std::vector<float> frameTimes;
+    frameTimes.reserve(m_timings.size());
+    for (size_t i = 0; i < m_timings.size(); i++) {
+        const FrameTiming& timing = m_timings[i];
+        // The last frame never saw a successor; its update and render stand in
+        float frameMs = timing.frameMs > 0.0f ? timing.frameMs : timing.updateMs + timing.renderMs;
+        report << i << ',' << timing.deltaTime * 1000.0f << ',' << timing.updateMs << ','
+               << timing.renderMs << ',' << frameMs << '\n';
+        frameTimes.push_back(frameMs);
+    }
+
+    size_t worst = static_cast<size_t>(std::max_element(frameTimes.begin(), frameTimes.end()) - frameTimes.begin());
+    float worstMs = frameTimes[worst];
+    double total = 0.0;
+    for (float ms : frameTimes) total += ms;
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    size_t n = frameTimes.size();
+    std::cout << "Replay timings: " << n << " frames, average " << total / n << " ms, p50 "
+              << frameTimes[n / 2] << " ms, p99 " << frameTimes[std::min(n - 1, n * 99 / 100)]
+              << " ms, worst " << worstMs << " ms (frame " << worst << "); per-frame times in "
+              << reportPath << std::endl;
+}
@@ -0,0 +1,242 @@
+#include "Scene.h"
+#include "VulkanRendererHelpers.h"
+#include <algorithm>
+
+Scene::Scene() {
+    m_registry.AddDestroyListener([this](Entity entity) { ClearBounds(entity); });
+    
+    // Every scene starts with a main camera so rendering always has a view
+    m_activeCamera = CreateCamera();
+}
+
+Scene::~Scene() = default;
+
+void Scene::Update(float deltaTime) {
+    UpdateCameras();
+    SyncSpatialIndex();
+}
+
+void Scene::SyncSpatialIndex() {
+    // Moves that stay inside a proxy's fat box cost one containment test
+    m_registry.Each<Bounds>([this](Entity entity, Bounds& bounds) {
+        AABB box = GetWorldBounds(entity);
+        if (bounds.proxy == BVH::NULL_NODE) {
+            bounds.proxy = m_spatialIndex.CreateProxy(box, entity);
+            m_changedBounds.push_back(box);
+        } else if (box.min != bounds.indexed.min || box.max != bounds.indexed.max) {
+            m_spatialIndex.MoveProxy(bounds.proxy, box);
+            m_changedBounds.push_back(bounds.indexed);
+            m_changedBounds.push_back(box);
+        }
+        bounds.indexed = box;
+    });
+    m_spatialDirty = false;
+}
+
+void Scene::UpdateCameras() {
+    m_registry.Each<Camera>([](Entity, Camera& camera) {
+        if (!camera.viewDirty && !camera.projectionDirty) {
+            return;
+        }
+        
+        if (camera.viewDirty) {
+            camera.view = CreateViewMatrix(camera.position, camera.target, camera.up);
+        }
+        
+        if (camera.projectionDirty) {
+            if (camera.projectionType == CameraProjection::Perspective) {
+                camera.projection = CreateProjectionMatrix(camera.fov, camera.aspectRatio,
+                                                           camera.nearPlane, camera.farPlane);
+            } else {
+                camera.projection = CreateOrthographicMatrix(camera.orthoHeight * camera.aspectRatio,
+                                                             camera.orthoHeight,
+                                                             camera.nearPlane, camera.farPlane);
+            }
+        }
+        
+        camera.viewProjection = camera.projection * camera.view;
+        camera.frustum = Frustum::FromMatrix(camera.viewProjection);
+        camera.viewDirty = false;
+        camera.projectionDirty = false;
+        camera.version++;
+    });
+}
+
+Entity Scene::CreateCamera() {
+    Entity entity = m_registry.Create();
+    Camera& camera = m_registry.Emplace<Camera>(entity);
+    camera.aspectRatio = m_targetAspectRatio;
+    return entity;
+}
+
+void Scene::SetActiveCamera(Entity camera) {
+    if (m_registry.Has<Camera>(camera)) {
+        m_activeCamera = camera;
+    }
+}
+
+void Scene::SetCameraPosition(Entity camera, const glm::vec3& position) {
+    if (auto component = GetCamera(camera); component && component->position != position) {
+        component->position = position;
+        component->viewDirty = true;
+    }
+}
+
+void Scene::SetCameraTarget(Entity camera, const glm::vec3& target) {
+    if (auto component = GetCamera(camera); component && component->target != target) {
+        component->target = target;
+        component->viewDirty = true;
+    }
+}
+
+void Scene::SetCameraPerspective(Entity camera, float fov, float nearPlane, float farPlane) {
+    if (auto component = GetCamera(camera)) {
+        component->projectionType = CameraProjection::Perspective;
+        component->fov = glm::clamp(fov, 1.0f, 179.0f);
+        component->nearPlane = std::max(0.001f, nearPlane);
+        component->farPlane = std::max(component->nearPlane + 0.001f, farPlane);
+        component->projectionDirty = true;
+    }
+}
+
+void Scene::SetCameraOrthographic(Entity camera, float height, float nearPlane, float farPlane) {
+    if (auto component = GetCamera(camera)) {
+        component->projectionType = CameraProjection::Orthographic;
+        component->orthoHeight = std::max(0.001f, height);
+        component->nearPlane = nearPlane;
+        component->farPlane = std::max(nearPlane + 0.001f, farPlane);
+        component->projectionDirty = true;
+    }
+}
+
+void Scene::SetCameraViewport(Entity camera, const glm::vec4& viewport) {
+    if (auto component = GetCamera(camera)) {
+        component->viewport = viewport;
+        float aspectRatio = m_targetAspectRatio * (viewport.z / std::max(viewport.w, 0.0001f));
+        if (component->aspectRatio != aspectRatio) {
+            component->aspectRatio = aspectRatio;
+            component->projectionDirty = true;
+        }
+    }
+}
+
+void Scene::SetTargetAspectRatio(float aspectRatio) {
+    if (aspectRatio == m_targetAspectRatio) {
+        return;
+    }
+    
+    m_targetAspectRatio = aspectRatio;
+    m_registry.Each<Camera>([aspectRatio](Entity, Camera& camera) {
+        camera.aspectRatio = aspectRatio * (camera.viewport.z / std::max(camera.viewport.w, 0.0001f));
+        camera.projectionDirty = true;
+    });
+}
+
+Entity Scene::CreateEntity() {
+    return m_registry.Create();
+}
+
+Entity Scene::CreateEntity(const glm::vec3& position) {
+    Entity entity = m_registry.Create();
+    m_registry.Emplace<Transform>(entity).position = position;
+    return entity;
+}
+
+void Scene::DestroyEntity(Entity entity) {
+    m_registry.Destroy(entity);
+}
+
+void Scene::SetPosition(Entity entity, const glm::vec3& position) {
+    if (!m_registry.Valid(entity)) return;
+
+    if (auto transform = m_registry.TryGet<Transform>(entity)) {
+        transform->position = position;
+    } else {
+        m_registry.Emplace<Transform>(entity).position = position;
+    }
+    m_spatialDirty = true;
+}
+
+glm::vec3 Scene::GetPosition(Entity entity) {
+    if (auto transform = m_registry.TryGet<Transform>(entity)) {
+        return transform->position;
+    }
+    return glm::vec3(0.0f);
+}
+
+void Scene::SetBounds(Entity entity, const glm::vec3& halfExtents) {
+    if (!m_registry.Valid(entity)) return;
+
+    if (auto bounds = m_registry.TryGet<Bounds>(entity)) {
+        bounds->halfExtents = glm::abs(halfExtents);
+    } else {
+        m_registry.Emplace<Bounds>(entity).halfExtents = glm::abs(halfExtents);
+    }
+    m_spatialDirty = true;
+}
+
+void Scene::ClearBounds(Entity entity) {
+    if (auto bounds = m_registry.TryGet<Bounds>(entity)) {
+        if (bounds->proxy != BVH::NULL_NODE) {
+            m_spatialIndex.DestroyProxy(bounds->proxy);
+            m_changedBounds.push_back(bounds->indexed);
+        }
+        m_registry.Remove<Bounds>(entity);
+    }
+}
+
+AABB Scene::GetWorldBounds(Entity entity) {
+    glm::vec3 center(0.0f);
+    glm::vec3 halfExtents(0.0f);
+    
+    if (auto bounds = m_registry.TryGet<Bounds>(entity)) {
+        halfExtents = bounds->halfExtents;
+    }
+    if (auto transform = m_registry.TryGet<Transform>(entity)) {
+        center = transform->position;
+        halfExtents = halfExtents * glm::abs(transform->scale);
+    }
+    return AABB{center - halfExtents, center + halfExtents};
+}
+
+std::optional<RayHit> Scene::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    Ray ray{origin, glm::normalize(direction)};
+    std::optional<RayHit> closest;
+    
+    m_spatialIndex.RayCast(ray, maxDistance, [&](int32_t proxy, float currentMax) {
+        Entity entity = m_spatialIndex.GetUserData(proxy);
+        float distance = ray.IntersectAABB(GetWorldBounds(entity), currentMax);
+        if (distance < 0.0f) {
+            return currentMax;
+        }
+        closest = RayHit{entity, distance};
+        return distance;
+    });
+    return closest;
+}
+
+void Scene::QuerySphere(const glm::vec3& center, float radius, std::pmr::vector<Entity>& results) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    m_spatialIndex.QuerySphere(center, radius, [&](int32_t proxy) {
+        Entity entity = m_spatialIndex.GetUserData(proxy);
+        if (GetWorldBounds(entity).IntersectsSphere(center, radius)) {
+            results.push_back(entity);
+        }
+        return true;
+    });
+}
+
+void Scene::QueryFrustum(const Frustum& frustum, std::vector<Entity>& results) {
+    if (m_spatialDirty) SyncSpatialIndex();
+    
+    m_spatialIndex.QueryFrustum(frustum, [&](int32_t proxy) {
+        Entity entity = m_spatialIndex.GetUserData(proxy);
+        if (frustum.IntersectsAABB(GetWorldBounds(entity))) {
+            results.push_back(entity);
+        }
+        return true;
+    });
+}
@@ -0,0 +1,135 @@
+#include "ScriptBuffers.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+// =============================================================================
+// STORAGE
+// =============================================================================
+
+FloatStorage::FloatStorage(size_t count, const BufferAllocator& allocator)
+    : m_count(count), m_allocator(allocator) {
+    if (count > SIZE_MAX / sizeof(float)) {
+        throw std::bad_alloc();
+    }
+    if (count > 0) {
+        m_data = static_cast<float*>(m_allocator.allocate(m_allocator.userData, nullptr, 0, count * sizeof(float)));
+        if (!m_data) {
+            throw std::bad_alloc();
+        }
+        std::memset(m_data, 0, count * sizeof(float));
+    }
+}
+
+FloatStorage::~FloatStorage() {
+    if (m_data) {
+        m_allocator.allocate(m_allocator.userData, m_data, m_count * sizeof(float), 0);
+    }
+}
+
+FloatBuffer::FloatBuffer(size_t size, const BufferAllocator& allocator)
+    : m_storage(std::make_shared<FloatStorage>(size, allocator)), m_data(m_storage->Data()), m_size(size) {}
+
+FloatBuffer::FloatBuffer(std::shared_ptr<FloatStorage> storage, size_t offset, size_t size)
+    : m_storage(std::move(storage)), m_data(m_storage->Data() + offset), m_size(size) {}
+
+float FloatBuffer::Get(size_t index) const {
+    if (index >= m_size) {
+        throw std::out_of_range("FloatBuffer index out of range");
+    }
+    return m_data[index];
+}
+
+void FloatBuffer::Set(size_t index, float value) const {
+    if (index >= m_size) {
+        throw std::out_of_range("FloatBuffer index out of range");
+    }
+    m_data[index] = value;
+}
+
+Vec3Array::Vec3Array(size_t size, const BufferAllocator& allocator)
+    : m_storage(std::make_shared<FloatStorage>(size > SIZE_MAX / 3 ? SIZE_MAX : size * 3, allocator)), m_size(size) {}
+
+FloatBuffer Vec3Array::Component(uint32_t axis) const {
+    if (axis > 2) {
+        throw std::out_of_range("Vec3Array component must be 0, 1 or 2");
+    }
+    return FloatBuffer(m_storage, axis * m_size, m_size);
+}
+
+FloatBuffer Vec3Array::Flat() const {
+    return FloatBuffer(m_storage, 0, 3 * m_size);
+}
+
+glm::vec3 Vec3Array::Get(size_t index) const {
+    if (index >= m_size) {
+        throw std::out_of_range("Vec3Array index out of range");
+    }
+    return glm::vec3(X()[index], Y()[index], Z()[index]);
+}
+
+void Vec3Array::Set(size_t index, const glm::vec3& value) const {
+    if (index >= m_size) {
+        throw std::out_of_range("Vec3Array index out of range");
+    }
+    X()[index] = value.x;
+    Y()[index] = value.y;
+    Z()[index] = value.z;
+}
+
+// =============================================================================
+// KERNELS
+// =============================================================================
+
+void FloatKernels::Fill(float* out, size_t count, float value) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = value;
+    }
+}
+
+void FloatKernels::Scale(float* out, size_t count, float scale) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] *= scale;
+    }
+}
+
+void FloatKernels::Offset(float* out, size_t count, float offset) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] += offset;
+    }
+}
+
+void FloatKernels::Axpy(float* y, const float* x, size_t count, float a) {
+    for (size_t i = 0; i < count; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+void FloatKernels::Lerp(float* out, const float* target, size_t count, float t) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] += (target[i] - out[i]) * t;
+    }
+}
+
+void FloatKernels::Clamp(float* out, size_t count, float minimum, float maximum) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::min(std::max(out[i], minimum), maximum);
+    }
+}
+
+void FloatKernels::FillSin(float* out, size_t count, float start, float step, float amplitude) {
+    // The index is converted through int32 so the loop stays vectorizable;
+    // buffers past 2^31 elements wrap, far beyond any script's quota
+    for (size_t i = 0; i < count; i++) {
+        float angle = start + step * static_cast<float>(static_cast<int32_t>(i));
+        out[i] = amplitude * SimdMath::FastSin(angle);
+    }
+}
+
+void FloatKernels::Sin(float* out, const float* angles, size_t count, float amplitude, float frequency, float phase) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = amplitude * SimdMath::FastSin(angles[i] * frequency + phase);
+    }
+}
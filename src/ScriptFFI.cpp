@@ -0,0 +1,160 @@
+#include "ScriptFFI.h"
+#include "LightingSystem.h"
+#include <cstddef>
+
+// ScriptFFI::CDEF spells these layouts out for LuaJIT
+static_assert(sizeof(ScriptVec3) == 12);
+static_assert(offsetof(ScriptLightState, position) == 4);
+static_assert(offsetof(ScriptLightState, intensity) == 40);
+static_assert(offsetof(ScriptLightState, enabled) == 56);
+static_assert(sizeof(ScriptLightState) == 60);
+static_assert(sizeof(bool) == 1);
+
+namespace {
+    glm::vec3 ToVec3(const ScriptVec3& v) { return glm::vec3(v.x, v.y, v.z); }
+    ScriptVec3 FromVec3(const glm::vec3& v) { return {v.x, v.y, v.z}; }
+
+    void SetLightPosition(LightingSystem* lighting, int32_t lightId, float x, float y, float z) {
+        lighting->SetLightPosition(lightId, glm::vec3(x, y, z));
+    }
+
+    void SetLightDirection(LightingSystem* lighting, int32_t lightId, float x, float y, float z) {
+        lighting->SetLightDirection(lightId, glm::vec3(x, y, z));
+    }
+
+    void SetLightColor(LightingSystem* lighting, int32_t lightId, float r, float g, float b) {
+        lighting->SetLightColor(lightId, glm::vec3(r, g, b));
+    }
+
+    void SetLightIntensity(LightingSystem* lighting, int32_t lightId, float intensity) {
+        lighting->SetLightIntensity(lightId, intensity);
+    }
+
+    void SetLightRange(LightingSystem* lighting, int32_t lightId, float range) {
+        lighting->SetLightRange(lightId, range);
+    }
+
+    void SetLightCone(LightingSystem* lighting, int32_t lightId, float innerCone, float outerCone) {
+        lighting->SetLightCone(lightId, innerCone, outerCone);
+    }
+
+    void SetLightEnabled(LightingSystem* lighting, int32_t lightId, bool enabled) {
+        lighting->SetLightEnabled(lightId, enabled);
+    }
+
+    int32_t GetLightState(LightingSystem* lighting, int32_t lightId, ScriptLightState* state) {
+        return ScriptFFI::ReadLightState(*lighting, lightId, *state) ? 1 : 0;
+    }
+
+    void SetLightState(LightingSystem* lighting, int32_t lightId, const ScriptLightState* state) {
+        ScriptFFI::ApplyLightState(*lighting, lightId, *state);
+    }
+}
+
+ScriptFFIApi ScriptFFI::MakeApi(LightingSystem& lighting) {
+    return ScriptFFIApi{
+        &lighting,
+        &SetLightPosition,
+        &SetLightDirection,
+        &SetLightColor,
+        &SetLightIntensity,
+        &SetLightRange,
+        &SetLightCone,
+        &SetLightEnabled,
+        &GetLightState,
+        &SetLightState
+    };
+}
+
+bool ScriptFFI::ReadLightState(LightingSystem& lighting, int32_t lightId, ScriptLightState& state) {
+    const Light* light = lighting.GetLight(lightId);
+    if (!light) {
+        return false;
+    }
+    state.type = static_cast<int32_t>(light->type);
+    state.position = FromVec3(light->position);
+    state.direction = FromVec3(light->direction);
+    state.color = FromVec3(light->color);
+    state.intensity = light->intensity;
+    state.range = light->range;
+    state.innerCone = light->innerCone;
+    state.outerCone = light->outerCone;
+    state.enabled = light->enabled;
+    state.castShadows = light->castShadows;
+    return true;
+}
+
+void ScriptFFI::ApplyLightState(LightingSystem& lighting, int32_t lightId, const ScriptLightState& state) {
+    // Through the setters, so clamping and spatial index updates still apply
+    if (!lighting.GetLight(lightId)) {
+        return;
+    }
+    lighting.SetLightPosition(lightId, ToVec3(state.position));
+    lighting.SetLightDirection(lightId, ToVec3(state.direction));
+    lighting.SetLightColor(lightId, ToVec3(state.color));
+    lighting.SetLightIntensity(lightId, state.intensity);
+    lighting.SetLightRange(lightId, state.range);
+    lighting.SetLightCone(lightId, state.innerCone, state.outerCone);
+    lighting.SetLightEnabled(lightId, state.enabled);
+    lighting.SetLightCastShadows(lightId, state.castShadows);
+}
+
+const char* const ScriptFFI::CDEF = R"(
+typedef struct LightingSystem LightingSystem;
+typedef struct ScriptVec3 { float x, y, z; } ScriptVec3;
+typedef struct ScriptLightState {
+    int32_t type;
+    ScriptVec3 position;
+    ScriptVec3 direction;
+    ScriptVec3 color;
+    float intensity;
+    float range;
+    float innerCone;
+    float outerCone;
+    bool enabled;
+    bool castShadows;
+} ScriptLightState;
+typedef struct ScriptFFIApi {
+    LightingSystem* lighting;
+    void (*setLightPosition)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightDirection)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightColor)(LightingSystem*, int32_t, float, float, float);
+    void (*setLightIntensity)(LightingSystem*, int32_t, float);
+    void (*setLightRange)(LightingSystem*, int32_t, float);
+    void (*setLightCone)(LightingSystem*, int32_t, float, float);
+    void (*setLightEnabled)(LightingSystem*, int32_t, bool);
+    int32_t (*getLightState)(LightingSystem*, int32_t, ScriptLightState*);
+    void (*setLightState)(LightingSystem*, int32_t, const ScriptLightState*);
+} ScriptFFIApi;
+)";
+
+// Scripts only receive the returned table: ffi itself stays out of their
+// environments, since ffi.C and ffi.cast would bypass the sandbox
+const char* const ScriptFFI::PRELUDE = R"(
+local ffi, cdef, pointer = ...
+ffi.cdef(cdef)
+
+local api = ffi.cast("const ScriptFFIApi*", pointer)
+local lighting = api.lighting
+local setPosition, setDirection, setColor = api.setLightPosition, api.setLightDirection, api.setLightColor
+local setIntensity, setRange, setCone = api.setLightIntensity, api.setLightRange, api.setLightCone
+local setEnabled, getState, setState = api.setLightEnabled, api.getLightState, api.setLightState
+local scratch = ffi.new("ScriptLightState")
+
+return {
+    setPosition = function(id, x, y, z) setPosition(lighting, id, x, y, z) end,
+    setDirection = function(id, x, y, z) setDirection(lighting, id, x, y, z) end,
+    setColor = function(id, r, g, b) setColor(lighting, id, r, g, b) end,
+    setIntensity = function(id, intensity) setIntensity(lighting, id, intensity) end,
+    setRange = function(id, range) setRange(lighting, id, range) end,
+    setCone = function(id, inner, outer) setCone(lighting, id, inner, outer) end,
+    setEnabled = function(id, enabled) setEnabled(lighting, id, enabled) end,
+    getPosition = function(id)
+        if getState(lighting, id, scratch) == 0 then return nil end
+        return scratch.position.x, scratch.position.y, scratch.position.z
+    end,
+    newState = function() return ffi.new("ScriptLightState") end,
+    getState = function(id, state) return getState(lighting, id, state) ~= 0 end,
+    setState = function(id, state) setState(lighting, id, state) end
+}
+)";
@@ -0,0 +1,290 @@
+#include "ScriptSnapshot.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    enum class ValueTag : uint8_t {
+        Nil = 0,
+        False = 1,
+        True = 2,
+        Integer = 3,
+        Number = 4,
+        String = 5,
+        Vec3 = 6,
+        Table = 7,    // id, entry count, then key/value pairs
+        TableRef = 8, // id of a table written earlier
+        Keep = 9      // Not restorable; the destination keeps its value
+    };
+
+    bool IsSnapshotKey(int type) {
+        return type == LUA_TBOOLEAN || type == LUA_TNUMBER || type == LUA_TSTRING;
+    }
+
+    // Each table entry takes at least a tag byte for its key and its value
+    constexpr size_t MIN_ENTRY_SIZE = 2;
+    // Preallocation for a restored table; larger ones grow as entries arrive
+    constexpr uint32_t MAX_TABLE_SIZE_HINT = 1 << 16;
+
+    void CheckStack(lua_State* L, int slots) {
+        if (!lua_checkstack(L, slots)) {
+            throw std::runtime_error("Lua stack overflow while processing snapshot");
+        }
+    }
+}
+
+namespace ScriptSnapshot {
+
+// =============================================================================
+// WRITER
+// =============================================================================
+
+Writer::Writer(lua_State* L, SnapshotWriter& out, std::unordered_set<const void*> opaque)
+    : m_L(L), m_out(out), m_opaque(std::move(opaque)) {}
+
+void Writer::WriteValue(int index) {
+    WriteValue(index, 0);
+}
+
+void Writer::WriteValue(int index, uint32_t depth) {
+    switch (lua_type(m_L, index)) {
+        case LUA_TNIL:
+            m_out.Write(ValueTag::Nil);
+            break;
+        case LUA_TBOOLEAN:
+            m_out.Write(lua_toboolean(m_L, index) ? ValueTag::True : ValueTag::False);
+            break;
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(m_L, index)) {
+                m_out.Write(ValueTag::Integer);
+                m_out.Write(static_cast<int64_t>(lua_tointeger(m_L, index)));
+                break;
+            }
+#endif
+            m_out.Write(ValueTag::Number);
+            m_out.Write(static_cast<double>(lua_tonumber(m_L, index)));
+            break;
+        case LUA_TSTRING: {
+            size_t length = 0;
+            const char* text = lua_tolstring(m_L, index, &length);
+            m_out.Write(ValueTag::String);
+            m_out.WriteString(std::string_view(text, length));
+            break;
+        }
+        case LUA_TTABLE:
+            WriteTable(index, depth);
+            break;
+        case LUA_TUSERDATA:
+            if (sol::stack::check<glm::vec3>(m_L, index)) {
+                glm::vec3 value = sol::stack::get<glm::vec3>(m_L, index);
+                m_out.Write(ValueTag::Vec3);
+                m_out.Write(value.x);
+                m_out.Write(value.y);
+                m_out.Write(value.z);
+                break;
+            }
+            m_out.Write(ValueTag::Keep);
+            break;
+        default:
+            m_out.Write(ValueTag::Keep);
+            break;
+    }
+}
+
+void Writer::WriteTable(int index, uint32_t depth) {
+    if (depth >= MAX_DEPTH) {
+        throw std::runtime_error("Script tables nest too deeply to snapshot");
+    }
+
+    const void* pointer = lua_topointer(m_L, index);
+    if (m_opaque.count(pointer)) {
+        m_out.Write(ValueTag::Keep);
+        return;
+    }
+
+    auto [entry, added] = m_tables.emplace(pointer, static_cast<uint32_t>(m_tables.size()));
+    if (!added) {
+        m_out.Write(ValueTag::TableRef);
+        m_out.Write(entry->second);
+        return;
+    }
+
+    m_out.Write(ValueTag::Table);
+    m_out.Write(entry->second);
+    size_t countOffset = m_out.Reserve<uint32_t>();
+    uint32_t count = 0;
+
+    // Raw traversal: __pairs and __index must not run while snapshotting.
+    // Entries keyed by tables or functions cannot be matched up on restore
+    // and are left out.
+    CheckStack(m_L, 3);
+    lua_pushnil(m_L);
+    while (lua_next(m_L, index)) {
+        int key = lua_gettop(m_L) - 1;
+        if (IsSnapshotKey(lua_type(m_L, key))) {
+            WriteValue(key, depth + 1);
+            WriteValue(key + 1, depth + 1);
+            count++;
+        }
+        lua_pop(m_L, 1);
+    }
+    m_out.Patch(countOffset, count);
+}
+
+// =============================================================================
+// READER
+// =============================================================================
+
+Reader::Reader(lua_State* L, SnapshotReader& in, std::unordered_set<const void*> opaque)
+    : m_L(L), m_in(in), m_opaque(std::move(opaque)) {
+    lua_newtable(m_L);
+    m_tables = luaL_ref(m_L, LUA_REGISTRYINDEX);
+}
+
+Reader::~Reader() {
+    luaL_unref(m_L, LUA_REGISTRYINDEX, m_tables);
+}
+
+void Reader::ReadValue(int current) {
+    ReadValue(current, 0);
+}
+
+void Reader::ReadValue(int current, uint32_t depth) {
+    CheckStack(m_L, 8);
+
+    switch (m_in.Read<ValueTag>()) {
+        case ValueTag::Nil:
+            lua_pushnil(m_L);
+            break;
+        case ValueTag::False:
+            lua_pushboolean(m_L, 0);
+            break;
+        case ValueTag::True:
+            lua_pushboolean(m_L, 1);
+            break;
+        case ValueTag::Integer: {
+            int64_t value = m_in.Read<int64_t>();
+#if LUA_VERSION_NUM >= 503
+            lua_pushinteger(m_L, static_cast<lua_Integer>(value));
+#else
+            lua_pushnumber(m_L, static_cast<lua_Number>(value));
+#endif
+            break;
+        }
+        case ValueTag::Number:
+            lua_pushnumber(m_L, static_cast<lua_Number>(m_in.Read<double>()));
+            break;
+        case ValueTag::String: {
+            std::string_view text = m_in.ReadString();
+            lua_pushlstring(m_L, text.data(), text.size());
+            break;
+        }
+        case ValueTag::Vec3: {
+            float x = m_in.Read<float>();
+            float y = m_in.Read<float>();
+            float z = m_in.Read<float>();
+            sol::stack::push(m_L, glm::vec3(x, y, z));
+            break;
+        }
+        case ValueTag::Table:
+            ReadTable(current, depth);
+            break;
+        case ValueTag::TableRef: {
+            uint32_t id = m_in.Read<uint32_t>();
+            lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_tables);
+            lua_rawgeti(m_L, -1, static_cast<lua_Integer>(id) + 1);
+            lua_remove(m_L, -2);
+            if (lua_isnil(m_L, -1)) {
+                throw std::runtime_error("Snapshot refers to an unknown table");
+            }
+            break;
+        }
+        case ValueTag::Keep:
+            if (current != 0) {
+                lua_pushvalue(m_L, current);
+            } else {
+                lua_pushnil(m_L);
+            }
+            break;
+        default:
+            throw std::runtime_error("Unknown value in snapshot");
+    }
+}
+
+void Reader::ReadTable(int current, uint32_t depth) {
+    if (depth >= MAX_DEPTH) {
+        throw std::runtime_error("Snapshot tables nest too deeply");
+    }
+    uint32_t id = m_in.Read<uint32_t>();
+    uint32_t count = m_in.Read<uint32_t>();
+    if (count > m_in.Remaining() / MIN_ENTRY_SIZE) {
+        throw std::runtime_error("Snapshot table has more entries than its data holds");
+    }
+    bool reuse = current != 0 && lua_type(m_L, current) == LUA_TTABLE &&
+                 !m_opaque.count(lua_topointer(m_L, current)) &&
+                 m_claimed.insert(lua_topointer(m_L, current)).second;
+    if (reuse) {
+        lua_pushvalue(m_L, current);
+    } else {
+        lua_createtable(m_L, 0, static_cast<int>(std::min(count, MAX_TABLE_SIZE_HINT)));
+    }
+    int table = lua_gettop(m_L);
+
+    lua_rawgeti(m_L, LUA_REGISTRYINDEX, m_tables);
+    lua_pushvalue(m_L, table);
+    lua_rawseti(m_L, -2, static_cast<lua_Integer>(id) + 1);
+    lua_pop(m_L, 1);
+
+    // Keys written from the snapshot, so stale entries can be found after
+    lua_newtable(m_L);
+    int written = lua_gettop(m_L);
+
+    for (uint32_t i = 0; i < count; i++) {
+        ReadValue(0, depth + 1);
+        int key = lua_gettop(m_L);
+        if (lua_isnil(m_L, key)) {
+            throw std::runtime_error("Snapshot table has a nil key");
+        }
+
+        lua_pushvalue(m_L, key);
+        lua_rawget(m_L, table);
+        ReadValue(key + 1, depth + 1);
+
+        lua_pushvalue(m_L, key);
+        lua_pushvalue(m_L, key + 2);
+        lua_rawset(m_L, table);
+        lua_pushvalue(m_L, key);
+        lua_pushboolean(m_L, 1);
+        lua_rawset(m_L, written);
+        lua_settop(m_L, written);
+    }
+
+    if (reuse) {
+        // Clearing existing fields during traversal is allowed by lua_next
+        lua_pushnil(m_L);
+        while (lua_next(m_L, table)) {
+            int value = lua_gettop(m_L);
+            int type = lua_type(m_L, value);
+            bool data = type == LUA_TBOOLEAN || type == LUA_TNUMBER || type == LUA_TSTRING ||
+                        (type == LUA_TTABLE && !m_opaque.count(lua_topointer(m_L, value))) ||
+                        (type == LUA_TUSERDATA && sol::stack::check<glm::vec3>(m_L, value));
+            lua_pop(m_L, 1);
+
+            if (data && IsSnapshotKey(lua_type(m_L, -1))) {
+                lua_pushvalue(m_L, -1);
+                lua_rawget(m_L, written);
+                bool restored = !lua_isnil(m_L, -1);
+                lua_pop(m_L, 1);
+                if (!restored) {
+                    lua_pushvalue(m_L, -1);
+                    lua_pushnil(m_L);
+                    lua_rawset(m_L, table);
+                }
+            }
+        }
+    }
+    lua_settop(m_L, table);
+}
+
+}
@@ -0,0 +1,300 @@
+#include "ShaderCompiler.h"
+#include "JobSystem.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef ENGINE_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace {
+    // Bump when compile options change so stale cache entries are ignored
+    constexpr uint32_t CACHE_VERSION = 2;
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203u;
+    constexpr int MAX_INCLUDE_DEPTH = 16;
+
+    // 64-bit FNV-1a
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    uint64_t HashString(uint64_t hash, const std::string& text) {
+        // Length prefix keeps ("ab", "c") and ("a", "bc") apart
+        uint64_t length = text.size();
+        hash = HashBytes(hash, &length, sizeof(length));
+        return HashBytes(hash, text.data(), text.size());
+    }
+
+    const char* StageName(ShaderStage stage) {
+        switch (stage) {
+            case ShaderStage::Vertex: return "vert";
+            case ShaderStage::Fragment: return "frag";
+            case ShaderStage::Compute: return "comp";
+        }
+        return "unknown";
+    }
+
+    std::string ReadText(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open shader source: " + path.string());
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    std::filesystem::file_time_type LastWriteTime(const std::filesystem::path& path) {
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(path, error);
+        return error ? std::filesystem::file_time_type::min() : time;
+    }
+
+    using GeneratedIncludes = std::unordered_map<std::string, std::string>;
+
+    void ExpandInto(const std::filesystem::path& path, int depth, std::string& out,
+                    std::vector<std::filesystem::path>& dependencies, const GeneratedIncludes& generated) {
+        if (depth > MAX_INCLUDE_DEPTH) {
+            throw std::runtime_error("Shader include depth exceeded in " + path.string());
+        }
+        dependencies.push_back(path);
+
+        std::istringstream source(ReadText(path));
+        std::string line;
+        while (std::getline(source, line)) {
+            // Only the quoted form is supported: #include "file.glsl",
+            // resolved against the generated includes and then relative to
+            // the including file
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+                size_t open = line.find('"', start + 8);
+                size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+                if (close == std::string::npos) {
+                    throw std::runtime_error("Malformed #include in " + path.string() + ": " + line);
+                }
+                std::string name = line.substr(open + 1, close - open - 1);
+                auto source = generated.find(name);
+                if (source != generated.end()) {
+                    out += source->second;
+                } else {
+                    ExpandInto(path.parent_path() / name, depth + 1, out, dependencies, generated);
+                }
+                continue;
+            }
+            out += line;
+            out += '\n';
+        }
+    }
+}
+
+ShaderCompiler::ShaderCompiler(std::filesystem::path cacheDirectory)
+    : m_cacheDirectory(std::move(cacheDirectory)) {
+    std::error_code error;
+    std::filesystem::create_directories(m_cacheDirectory, error);
+    if (error) {
+        std::cerr << "Shader cache disabled, cannot create " << m_cacheDirectory.string()
+                  << ": " << error.message() << std::endl;
+    }
+}
+
+bool ShaderCompiler::IsRuntimeCompilationAvailable() {
+#ifdef ENGINE_HAS_SHADERC
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<uint32_t> ShaderCompiler::Load(const ShaderVariant& variant) {
+    ExpandedSource source = ExpandIncludes(variant.path);
+    uint64_t key = HashVariant(source.text, variant);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_memoryCache.find(key);
+        if (it != m_memoryCache.end()) {
+            return it->second;
+        }
+    }
+
+    std::vector<uint32_t> spirv;
+    std::filesystem::path cachePath = CachePath(variant, key);
+    if (!ReadCache(cachePath, spirv)) {
+        if (IsRuntimeCompilationAvailable()) {
+            spirv = CompileSource(source.text, variant);
+            WriteCache(cachePath, spirv);
+        } else if (!variant.precompiledPath.empty()) {
+            std::string binary = ReadText(variant.precompiledPath);
+            if (binary.empty() || binary.size() % sizeof(uint32_t) != 0) {
+                throw std::runtime_error("Invalid SPIR-V file: " + variant.precompiledPath);
+            }
+            spirv.resize(binary.size() / sizeof(uint32_t));
+            memcpy(spirv.data(), binary.data(), binary.size());
+        } else {
+            throw std::runtime_error("No cached SPIR-V for " + variant.path +
+                                     " and the engine was built without runtime shader compilation");
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryCache[key] = spirv;
+    Watch(source.dependencies);
+    return spirv;
+}
+
+void ShaderCompiler::LoadAll(const std::vector<ShaderVariant>& variants, JobSystem& jobs) {
+    // One variant per job; the wait covers every job before rethrowing, so
+    // none outlives the variants
+    jobs.ParallelFor("Compile shaders", variants.size(), 1, [this, &variants](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Load(variants[i]);
+        }
+    });
+}
+
+std::vector<std::string> ShaderCompiler::PollChangedSources() {
+    std::vector<std::string> changed;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [path, lastWrite] : m_watchedFiles) {
+        auto current = LastWriteTime(path);
+        if (current != lastWrite) {
+            lastWrite = current;
+            changed.push_back(path);
+        }
+    }
+    return changed;
+}
+
+void ShaderCompiler::SetGeneratedInclude(const std::string& name, std::string source) {
+    m_generatedIncludes[name] = std::move(source);
+}
+
+void ShaderCompiler::ClearMemoryCache() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryCache.clear();
+}
+
+ShaderCompiler::ExpandedSource ShaderCompiler::ExpandIncludes(const std::filesystem::path& path) const {
+    ExpandedSource source;
+    ExpandInto(path, 0, source.text, source.dependencies, m_generatedIncludes);
+    return source;
+}
+
+uint64_t ShaderCompiler::HashVariant(const std::string& source, const ShaderVariant& variant) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = HashBytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    hash = HashString(hash, source);
+
+    int stage = static_cast<int>(variant.stage);
+    hash = HashBytes(hash, &stage, sizeof(stage));
+
+    // Defines are hashed in the order given; callers that build the same
+    // permutation should list them consistently
+    for (const ShaderDefine& define : variant.defines) {
+        hash = HashString(hash, define.name);
+        hash = HashString(hash, define.value);
+    }
+    return hash;
+}
+
+std::vector<uint32_t> ShaderCompiler::CompileSource(const std::string& source, const ShaderVariant& variant) {
+#ifdef ENGINE_HAS_SHADERC
+    shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+    switch (variant.stage) {
+        case ShaderStage::Vertex: kind = shaderc_glsl_vertex_shader; break;
+        case ShaderStage::Fragment: kind = shaderc_glsl_fragment_shader; break;
+        case ShaderStage::Compute: kind = shaderc_glsl_compute_shader; break;
+    }
+
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    for (const ShaderDefine& define : variant.defines) {
+        options.AddMacroDefinition(define.name, define.value);
+    }
+
+    // One compiler per call keeps parallel LoadAll workers independent
+    shaderc::Compiler compiler;
+    shaderc::SpvCompilationResult result =
+        compiler.CompileGlslToSpv(source, kind, variant.path.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        throw std::runtime_error("Failed to compile " + variant.path + ":\n" + result.GetErrorMessage());
+    }
+    return std::vector<uint32_t>(result.cbegin(), result.cend());
+#else
+    (void)source;
+    throw std::runtime_error("Runtime shader compilation unavailable for " + variant.path);
+#endif
+}
+
+std::filesystem::path ShaderCompiler::CachePath(const ShaderVariant& variant, uint64_t key) const {
+    std::ostringstream name;
+    name << std::filesystem::path(variant.path).stem().string() << '.' << StageName(variant.stage) << '.'
+         << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+    return m_cacheDirectory / name.str();
+}
+
+bool ShaderCompiler::ReadCache(const std::filesystem::path& path, std::vector<uint32_t>& spirv) const {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(file.tellg());
+    if (size == 0 || size % sizeof(uint32_t) != 0) {
+        return false;
+    }
+
+    spirv.resize(size / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(spirv.data()), size);
+
+    // A truncated or foreign file is treated as a miss and overwritten
+    return file.good() && spirv[0] == SPIRV_MAGIC;
+}
+
+void ShaderCompiler::WriteCache(const std::filesystem::path& path, const std::vector<uint32_t>& spirv) const {
+    // Write beside the target and rename, so a crash or a concurrent
+    // writer never leaves a partial entry behind
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(temporary);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+void ShaderCompiler::Watch(const std::vector<std::filesystem::path>& dependencies) {
+    for (const auto& dependency : dependencies) {
+        // Keep the recorded time of already watched files so a change made
+        // between load and poll is still reported
+        m_watchedFiles.try_emplace(dependency.string(), LastWriteTime(dependency));
+    }
+}
@@ -0,0 +1,454 @@
+#include "ShadowSystem.h"
+#include "LightingSystem.h"
+#include "Scene.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+    glm::vec4 RectToUV(const AtlasRect& rect, uint32_t atlasSize) {
+        float scale = 1.0f / static_cast<float>(atlasSize);
+        return glm::vec4(rect.x * scale, rect.y * scale, rect.size * scale, rect.size * scale);
+    }
+
+    // Any up vector not parallel to direction
+    glm::vec3 PerpendicularUp(const glm::vec3& direction) {
+        return std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    glm::mat4 SpotViewProjection(const Light& light) {
+        glm::vec3 direction = glm::length(light.direction) > 0.0f ? glm::normalize(light.direction)
+                                                                  : glm::vec3(0.0f, -1.0f, 0.0f);
+        float fov = std::min(2.0f * light.outerCone, 170.0f);
+        float nearPlane = std::max(0.05f, light.range * 0.01f);
+        return CreateProjectionMatrix(fov, 1.0f, nearPlane, light.range) *
+               CreateViewMatrix(light.position, light.position + direction, PerpendicularUp(direction));
+    }
+
+    // Faces in +X, -X, +Y, -Y, +Z, -Z order; lighting.frag picks the face
+    // from the major axis of the light-to-fragment vector
+    glm::mat4 PointFaceViewProjection(const Light& light, uint32_t face) {
+        static const glm::vec3 directions[POINT_SHADOW_FACES] = {
+            { 1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+            { 0.0f, 1.0f, 0.0f}, { 0.0f, -1.0f, 0.0f},
+            { 0.0f, 0.0f, 1.0f}, { 0.0f, 0.0f, -1.0f}
+        };
+        static const glm::vec3 ups[POINT_SHADOW_FACES] = {
+            {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f},  {0.0f, 0.0f, -1.0f},
+            {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}
+        };
+        float nearPlane = std::max(0.05f, light.range * 0.01f);
+        return CreateProjectionMatrix(90.0f, 1.0f, nearPlane, light.range) *
+               CreateViewMatrix(light.position, light.position + directions[face], ups[face]);
+    }
+
+    // Fraction of the screen height covered by the light's range
+    float ScreenCoverage(const Camera& camera, const Light& light) {
+        float distance = glm::length(light.position - camera.position);
+        if (distance <= light.range) {
+            return 1.0f;
+        }
+        float halfHeight = camera.projectionType == CameraProjection::Perspective
+            ? distance * std::tan(glm::radians(camera.fov) * 0.5f)
+            : camera.orthoHeight * 0.5f;
+        return std::min(1.0f, light.range / std::max(halfHeight, 0.0001f));
+    }
+}
+
+// =============================================================================
+// SHADOW ATLAS
+// =============================================================================
+
+ShadowAtlas::ShadowAtlas(uint32_t size, uint32_t minTileSize)
+    : m_size(std::bit_floor(std::max(size, 1u))),
+      m_minTileSize(std::clamp(std::bit_floor(std::max(minTileSize, 1u)), 1u, m_size)) {
+    Reset();
+}
+
+void ShadowAtlas::Reset() {
+    m_freeLists.assign(LevelOf(m_minTileSize) + 1, {});
+    m_freeLists[0].insert(Key(0, 0));
+}
+
+uint32_t ShadowAtlas::LevelOf(uint32_t size) const {
+    return static_cast<uint32_t>(std::countr_zero(m_size / size));
+}
+
+uint32_t ShadowAtlas::ClampTileSize(uint32_t size) const {
+    return std::clamp(std::bit_ceil(std::max(size, 1u)), m_minTileSize, m_size);
+}
+
+std::optional<AtlasRect> ShadowAtlas::Allocate(uint32_t size) {
+    size = ClampTileSize(size);
+    uint32_t target = LevelOf(size);
+
+    // Take the smallest free square that fits, then split it down
+    int32_t level = static_cast<int32_t>(target);
+    while (level >= 0 && m_freeLists[level].empty()) {
+        level--;
+    }
+    if (level < 0) {
+        return std::nullopt;
+    }
+
+    uint32_t key = *m_freeLists[level].begin();
+    m_freeLists[level].erase(m_freeLists[level].begin());
+
+    uint32_t x = key & 0xFFFFu;
+    uint32_t y = key >> 16;
+    uint32_t squareSize = m_size >> level;
+
+    while (static_cast<uint32_t>(level) < target) {
+        squareSize /= 2;
+        level++;
+        m_freeLists[level].insert(Key(x + squareSize, y));
+        m_freeLists[level].insert(Key(x, y + squareSize));
+        m_freeLists[level].insert(Key(x + squareSize, y + squareSize));
+    }
+
+    return AtlasRect{x, y, size};
+}
+
+void ShadowAtlas::Free(const AtlasRect& rect) {
+    uint32_t level = LevelOf(rect.size);
+    uint32_t x = rect.x;
+    uint32_t y = rect.y;
+    uint32_t size = rect.size;
+
+    // Merge with the three siblings while they are all free
+    while (level > 0) {
+        uint32_t parentSize = size * 2;
+        uint32_t parentX = x & ~(parentSize - 1);
+        uint32_t parentY = y & ~(parentSize - 1);
+
+        uint32_t siblings[4] = {
+            Key(parentX, parentY), Key(parentX + size, parentY),
+            Key(parentX, parentY + size), Key(parentX + size, parentY + size)
+        };
+
+        auto& freeList = m_freeLists[level];
+        bool allFree = true;
+        for (uint32_t sibling : siblings) {
+            if (sibling != Key(x, y) && !freeList.count(sibling)) {
+                allFree = false;
+                break;
+            }
+        }
+        if (!allFree) {
+            break;
+        }
+
+        for (uint32_t sibling : siblings) {
+            freeList.erase(sibling);
+        }
+        x = parentX;
+        y = parentY;
+        size = parentSize;
+        level--;
+    }
+
+    m_freeLists[level].insert(Key(x, y));
+}
+
+// =============================================================================
+// SHADOW SYSTEM
+// =============================================================================
+
+ShadowSystem::ShadowSystem(const ShadowSettings& settings)
+    : m_settings(settings), m_atlas(settings.atlasSize, settings.minTileSize) {
+    // Cascades keep fixed tiles for the lifetime of the system
+    for (Cascade& cascade : m_cascades) {
+        if (auto rect = m_atlas.Allocate(m_settings.cascadeSize)) {
+            cascade.tile.rect = *rect;
+        }
+    }
+}
+
+void ShadowSystem::Update(const Camera& camera, std::span<const Light> lights, const LightingSystem& lighting,
+                          const std::vector<AABB>& changedCasters, uint32_t screenHeight) {
+    m_frame++;
+    m_changedCasters = &changedCasters;
+    m_renderViews.clear();
+    m_uniforms = ShadowUniforms{};
+
+    bool sunShadows = lighting.GetSunIntensity() > 0.0f && m_cascades.back().tile.rect.size > 0;
+    if (sunShadows) {
+        UpdateCascades(camera, lighting.GetSunDirection());
+    } else {
+        for (Cascade& cascade : m_cascades) {
+            cascade.tile.valid = false;
+        }
+    }
+    m_uniforms.sunDirection = glm::vec4(lighting.GetSunDirection(), sunShadows ? 1.0f : 0.0f);
+    m_uniforms.sunColor = glm::vec4(lighting.GetSunColor() * lighting.GetSunIntensity(), 0.0f);
+
+    UpdateLightTiles(camera, lights, screenHeight);
+    EvictStaleLights();
+
+    m_changedCasters = nullptr;
+}
+
+void ShadowSystem::UpdateCascades(const Camera& camera, const glm::vec3& sunDirection) {
+    glm::vec3 direction = glm::normalize(sunDirection);
+    glm::vec3 lightRight = glm::normalize(glm::cross(direction, PerpendicularUp(direction)));
+    glm::vec3 lightUp = glm::cross(lightRight, direction);
+
+    glm::vec3 forward = camera.target - camera.position;
+    forward = glm::length(forward) > 0.0f ? glm::normalize(forward) : glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 right = glm::normalize(glm::cross(forward, camera.up));
+    glm::vec3 up = glm::cross(right, forward);
+
+    bool perspective = camera.projectionType == CameraProjection::Perspective;
+    float tanHalfY = std::tan(glm::radians(camera.fov) * 0.5f);
+    float tanHalfX = tanHalfY * camera.aspectRatio;
+    float nearPlane = camera.nearPlane;
+    float farPlane = std::max(std::min(camera.farPlane, m_settings.shadowDistance), nearPlane + 0.01f);
+
+    float splitNear = nearPlane;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        float t = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+        float splitFar = glm::mix(uniformSplit, logSplit, m_settings.cascadeSplitLambda);
+
+        // Bounding sphere of the frustum slice. Its radius depends only on
+        // the projection, so the cascade's size never changes as the camera
+        // moves or turns.
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (uint32_t c = 0; c < 8; c++) {
+            float depth = (c & 4) ? splitFar : splitNear;
+            float halfY = perspective ? depth * tanHalfY : camera.orthoHeight * 0.5f;
+            float halfX = perspective ? depth * tanHalfX : halfY * camera.aspectRatio;
+            float x = (c & 1) ? halfX : -halfX;
+            float y = (c & 2) ? halfY : -halfY;
+            corners[c] = camera.position + right * x + up * y + forward * depth;
+            center += corners[c];
+        }
+        center /= 8.0f;
+
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // Only re-center once the slice could leave the cached map's margin
+        Cascade& cascade = m_cascades[i];
+        float extent = radius * (1.0f + m_settings.cascadeMargin);
+        bool refit = !cascade.tile.valid || cascade.direction != direction || cascade.radius != radius ||
+                     glm::length(center - cascade.center) > radius * m_settings.cascadeMargin;
+
+        if (refit) {
+            // Snap the center to whole texels so re-centering does not shimmer
+            float texel = 2.0f * extent / static_cast<float>(cascade.tile.rect.size);
+            float x = std::floor(glm::dot(center, lightRight) / texel) * texel;
+            float y = std::floor(glm::dot(center, lightUp) / texel) * texel;
+            float z = glm::dot(center, direction);
+
+            cascade.center = lightRight * x + lightUp * y + direction * z;
+            cascade.direction = direction;
+            cascade.radius = radius;
+        }
+
+        glm::vec3 eye = cascade.center - direction * (extent + m_settings.casterDistance);
+        glm::mat4 view = CreateViewMatrix(eye, cascade.center, lightUp);
+        glm::mat4 projection = CreateOrthographicMatrix(2.0f * extent, 2.0f * extent, 0.0f,
+                                                        2.0f * extent + m_settings.casterDistance);
+        RefreshTile(cascade.tile, projection * view);
+
+        m_uniforms.cascadeViewProjection[i] = cascade.tile.viewProjection;
+        m_uniforms.cascadeRects[i] = RectToUV(cascade.tile.rect, m_atlas.GetSize());
+        splitNear = splitFar;
+    }
+}
+
+void ShadowSystem::UpdateLightTiles(const Camera& camera, std::span<const Light> lights, uint32_t screenHeight) {
+    std::vector<Candidate>& candidates = m_candidates;
+    candidates.clear();
+    uint32_t lightCount = static_cast<uint32_t>(std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS)));
+    for (uint32_t i = 0; i < lightCount; i++) {
+        const Light& light = lights[i];
+        if (light.type == LightType::Directional || !light.castShadows) continue;
+        if (!camera.frustum.IntersectsSphere(light.position, light.range)) continue;
+        candidates.push_back({i, ScreenCoverage(camera, light)});
+    }
+
+    // Lights covering more of the screen claim atlas space first
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.coverage > b.coverage; });
+
+    // Visible lights keep their cached tiles when an earlier candidate
+    // evicts under atlas pressure
+    for (const Candidate& candidate : candidates) {
+        auto it = m_lightShadows.find(lights[candidate.index].id);
+        if (it != m_lightShadows.end()) {
+            it->second.candidateFrame = m_frame;
+        }
+    }
+
+    uint32_t nextTile = 0;
+    for (const Candidate& candidate : candidates) {
+        const Light& light = lights[candidate.index];
+        bool point = light.type == LightType::Point;
+        uint32_t tileCount = point ? POINT_SHADOW_FACES : 1;
+        if (nextTile + tileCount > MAX_SHADOW_TILES) continue;
+
+        // Cube faces each cover a quarter of the light's extent
+        float ideal = candidate.coverage * static_cast<float>(screenHeight) * m_settings.resolutionScale;
+        if (point) ideal *= 0.5f;
+
+        uint32_t requested = std::clamp(m_atlas.ClampTileSize(static_cast<uint32_t>(ideal)),
+                                        m_settings.minTileSize, m_settings.maxTileSize);
+
+        LightShadow& shadow = m_lightShadows[light.id];
+        shadow.lastUsedFrame = m_frame;
+
+        // Hysteresis keeps a light hovering near a size boundary from
+        // reallocating (and re-rendering) every frame
+        uint32_t current = shadow.tileSize;
+        if (current > 0) {
+            if (requested > current && ideal < current * 1.25f) requested = current;
+            if (requested < current && ideal > current * 0.4f) requested = current;
+        }
+
+        if (requested != current || shadow.tiles.size() != tileCount) {
+            ReleaseTiles(shadow);
+            if (!AllocateTiles(shadow, requested, tileCount)) {
+                continue;
+            }
+            // A smaller fallback size is kept until the request itself changes
+            shadow.tileSize = requested;
+        }
+
+        for (uint32_t face = 0; face < tileCount; face++) {
+            CachedTile& tile = shadow.tiles[face];
+            RefreshTile(tile, point ? PointFaceViewProjection(light, face) : SpotViewProjection(light));
+            m_uniforms.tileViewProjection[nextTile + face] = tile.viewProjection;
+            m_uniforms.tileRects[nextTile + face] = RectToUV(tile.rect, m_atlas.GetSize());
+        }
+        m_uniforms.lightTiles[candidate.index] = glm::ivec4(nextTile, tileCount, 0, 0);
+        nextTile += tileCount;
+    }
+}
+
+bool ShadowSystem::AllocateTiles(LightShadow& shadow, uint32_t tileSize, uint32_t tileCount) {
+    bool evicted = false;
+    while (tileSize >= m_settings.minTileSize) {
+        std::vector<AtlasRect> rects;
+        for (uint32_t i = 0; i < tileCount; i++) {
+            auto rect = m_atlas.Allocate(tileSize);
+            if (!rect) break;
+            rects.push_back(*rect);
+        }
+
+        if (rects.size() == tileCount) {
+            shadow.tiles.resize(tileCount);
+            for (uint32_t i = 0; i < tileCount; i++) {
+                shadow.tiles[i] = CachedTile{};
+                shadow.tiles[i].rect = rects[i];
+            }
+            return true;
+        }
+
+        for (const AtlasRect& rect : rects) {
+            m_atlas.Free(rect);
+        }
+
+        // Under pressure, lights not visible this frame give up their tiles
+        // before anyone settles for a smaller map
+        if (!evicted) {
+            for (auto it = m_lightShadows.begin(); it != m_lightShadows.end();) {
+                if (it->second.candidateFrame != m_frame && it->second.lastUsedFrame != m_frame) {
+                    ReleaseTiles(it->second);
+                    it = m_lightShadows.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            evicted = true;
+            continue;
+        }
+        tileSize /= 2;
+    }
+    return false;
+}
+
+void ShadowSystem::ReleaseTiles(LightShadow& shadow) {
+    for (const CachedTile& tile : shadow.tiles) {
+        m_atlas.Free(tile.rect);
+    }
+    shadow.tiles.clear();
+    shadow.tileSize = 0;
+}
+
+void ShadowSystem::EvictStaleLights() {
+    for (auto it = m_lightShadows.begin(); it != m_lightShadows.end();) {
+        LightShadow& shadow = it->second;
+        if (shadow.lastUsedFrame == m_frame) {
+            ++it;
+            continue;
+        }
+
+        if (m_frame - shadow.lastUsedFrame > m_settings.retainFrames) {
+            ReleaseTiles(shadow);
+            it = m_lightShadows.erase(it);
+            continue;
+        }
+
+        // Retained tiles were not refreshed this frame, so casters that moved
+        // through them now must still invalidate them
+        for (CachedTile& tile : shadow.tiles) {
+            for (const AABB& box : *m_changedCasters) {
+                if (tile.valid && tile.frustum.IntersectsAABB(box)) {
+                    tile.valid = false;
+                }
+            }
+        }
+        ++it;
+    }
+}
+
+void ShadowSystem::RefreshTile(CachedTile& tile, const glm::mat4& viewProjection) {
+    bool dirty = !tile.valid || tile.viewProjection != viewProjection;
+    if (!dirty && m_changedCasters) {
+        for (const AABB& box : *m_changedCasters) {
+            if (tile.frustum.IntersectsAABB(box)) {
+                dirty = true;
+                break;
+            }
+        }
+    }
+
+    if (dirty) {
+        tile.viewProjection = viewProjection;
+        tile.frustum = Frustum::FromMatrix(viewProjection);
+        tile.valid = true;
+        m_renderViews.push_back(ShadowRenderView{viewProjection, tile.rect});
+    }
+}
+
+void ShadowSystem::InvalidateAll() {
+    for (Cascade& cascade : m_cascades) {
+        cascade.tile.valid = false;
+    }
+    for (auto& [id, shadow] : m_lightShadows) {
+        for (CachedTile& tile : shadow.tiles) {
+            tile.valid = false;
+        }
+    }
+}
+
+size_t ShadowSystem::GetCachedTileCount() const {
+    size_t count = 0;
+    for (const Cascade& cascade : m_cascades) {
+        count += cascade.tile.valid ? 1 : 0;
+    }
+    for (const auto& [id, shadow] : m_lightShadows) {
+        for (const CachedTile& tile : shadow.tiles) {
+            count += tile.valid ? 1 : 0;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,112 @@
+#include "Snapshot.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    constexpr char SNAPSHOT_MAGIC[4] = {'V', 'L', 'S', 'N'};
+    constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+    struct SnapshotHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t payloadSize;
+        uint64_t checksum;
+    };
+
+    // FNV-1a; snapshots are small enough that a byte loop costs well under
+    // a millisecond
+    uint64_t Checksum(std::span<const std::byte> data) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (std::byte b : data) {
+            hash = (hash ^ static_cast<uint64_t>(b)) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+}
+
+SnapshotWriter::SnapshotWriter() {
+    m_data.reserve(64 * 1024);
+    m_data.resize(sizeof(SnapshotHeader));
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    const auto* bytes = static_cast<const std::byte*>(data);
+    m_data.insert(m_data.end(), bytes, bytes + size);
+}
+
+void SnapshotWriter::WriteString(std::string_view text) {
+    if (text.size() > UINT32_MAX) {
+        throw std::length_error("String too long for a snapshot");
+    }
+    Write(static_cast<uint32_t>(text.size()));
+    WriteBytes(text.data(), text.size());
+}
+
+std::vector<std::byte> SnapshotWriter::Finish() {
+    std::span<const std::byte> payload(m_data.data() + sizeof(SnapshotHeader), m_data.size() - sizeof(SnapshotHeader));
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.payloadSize = payload.size();
+    header.checksum = Checksum(payload);
+    Patch(0, header);
+
+    std::vector<std::byte> data = std::move(m_data);
+    m_data.clear();
+    return data;
+}
+
+SnapshotReader SnapshotReader::Open(std::span<const std::byte> snapshot) {
+    SnapshotHeader header;
+    if (snapshot.size() < sizeof(header)) {
+        throw std::runtime_error("Not a snapshot (too short)");
+    }
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("Not a snapshot");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version));
+    }
+
+    std::span<const std::byte> payload = snapshot.subspan(sizeof(header));
+    if (header.payloadSize != payload.size()) {
+        throw std::runtime_error("Truncated snapshot");
+    }
+    if (header.checksum != Checksum(payload)) {
+        throw std::runtime_error("Snapshot checksum mismatch");
+    }
+    return SnapshotReader(payload);
+}
+
+std::span<const std::byte> SnapshotReader::ReadBytes(size_t size) {
+    if (size > m_data.size() - m_offset) {
+        throw std::runtime_error("Snapshot section overruns the data");
+    }
+    std::span<const std::byte> bytes = m_data.subspan(m_offset, size);
+    m_offset += size;
+    return bytes;
+}
+
+std::string_view SnapshotReader::ReadString() {
+    uint32_t length = Read<uint32_t>();
+    std::span<const std::byte> bytes = ReadBytes(length);
+    return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+bool WriteSnapshotFile(const std::string& path, std::span<const std::byte> snapshot) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to open snapshot file for writing: " << path << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(snapshot.data()), static_cast<std::streamsize>(snapshot.size()));
+    if (!file) {
+        std::cerr << "Failed to write snapshot file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,354 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint8_t KTX2_IDENTIFIER[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+    };
+    constexpr size_t KTX2_HEADER_SIZE = 80;     // Identifier, header and section index
+    constexpr size_t KTX2_LEVEL_ENTRY_SIZE = 24; // byteOffset, byteLength, uncompressedByteLength
+
+    // KTX2 is little-endian and fields are not necessarily aligned
+    template<typename T>
+    T ReadField(const uint8_t* data, size_t offset) {
+        T value;
+        memcpy(&value, data + offset, sizeof(T));
+        return value;
+    }
+}
+
+// =============================================================================
+// TEXTURE FILES
+// =============================================================================
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+        CloseHandle(m_file);
+        throw std::runtime_error("Empty or unreadable file: " + path);
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_data = m_mapping ? static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!m_data) {
+        if (m_mapping) CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Empty or unreadable file: " + path);
+    }
+    m_size = static_cast<size_t>(status.st_size);
+
+    // The mapping keeps its own reference to the file
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    m_data = static_cast<const uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+#endif
+
+TextureFileInfo ParseKtx2(const uint8_t* data, size_t size) {
+    if (size < KTX2_HEADER_SIZE || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("Not a KTX2 file");
+    }
+
+    TextureFileInfo info;
+    info.format = ReadField<uint32_t>(data, 12);
+    info.width = ReadField<uint32_t>(data, 20);
+    info.height = ReadField<uint32_t>(data, 24);
+    uint32_t depth = ReadField<uint32_t>(data, 28);
+    uint32_t layerCount = ReadField<uint32_t>(data, 32);
+    uint32_t faceCount = ReadField<uint32_t>(data, 36);
+    uint32_t levelCount = std::max(ReadField<uint32_t>(data, 40), 1u);
+    uint32_t supercompression = ReadField<uint32_t>(data, 44);
+
+    // Format 0 means Basis Universal or other data that needs transcoding
+    if (info.format == 0) {
+        throw std::runtime_error("KTX2 texture needs transcoding (VK_FORMAT_UNDEFINED)");
+    }
+    if (supercompression != 0) {
+        throw std::runtime_error("KTX2 supercompression is not supported");
+    }
+    if (info.width == 0 || info.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+        throw std::runtime_error("Only single 2D KTX2 images are supported");
+    }
+    if (levelCount > 32 || KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_ENTRY_SIZE > size) {
+        throw std::runtime_error("Truncated KTX2 level index");
+    }
+
+    info.levels.resize(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_ENTRY_SIZE;
+        TextureLevel& level = info.levels[i];
+        level.offset = ReadField<uint64_t>(data, entry);
+        level.size = ReadField<uint64_t>(data, entry + 8);
+        level.width = std::max(info.width >> i, 1u);
+        level.height = std::max(info.height >> i, 1u);
+
+        if (level.size == 0 || level.offset > size || level.size > size - level.offset) {
+            throw std::runtime_error("KTX2 level " + std::to_string(i) + " lies outside the file");
+        }
+    }
+    return info;
+}
+
+// =============================================================================
+// STREAMER
+// =============================================================================
+
+TextureStreamer::TextureStreamer(const TextureStreamingSettings& settings)
+    : m_settings(settings) {
+}
+
+TextureHandle TextureStreamer::Load(const std::string& path) {
+    auto file = std::make_unique<MappedFile>(path);
+    TextureFileInfo info;
+    try {
+        info = ParseKtx2(file->GetData(), file->GetSize());
+    } catch (const std::exception& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+
+    TextureHandle handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = static_cast<TextureHandle>(m_textures.size());
+        m_textures.emplace_back();
+    }
+
+    StreamedTexture& texture = m_textures[handle];
+    texture = StreamedTexture{};
+    texture.file = std::move(file);
+    texture.info = std::move(info);
+    texture.live = true;
+    texture.lastUsedFrame = m_frame;
+
+    uint32_t levelCount = static_cast<uint32_t>(texture.info.levels.size());
+    texture.bytesFrom.assign(levelCount + 1, 0);
+    for (uint32_t mip = levelCount; mip-- > 0;) {
+        texture.bytesFrom[mip] = texture.bytesFrom[mip + 1] + texture.info.levels[mip].size;
+    }
+
+    // The tail starts at the first level small enough; a file without
+    // small levels keeps just its last one resident
+    texture.tailMip = levelCount - 1;
+    for (uint32_t mip = 0; mip < levelCount; mip++) {
+        const TextureLevel& level = texture.info.levels[mip];
+        if (std::max(level.width, level.height) <= m_settings.tailSize) {
+            texture.tailMip = mip;
+            break;
+        }
+    }
+    texture.residentMip = levelCount;
+    texture.targetMip = texture.tailMip;
+
+    return handle;
+}
+
+void TextureStreamer::Unload(TextureHandle texture) {
+    if (!IsValid(texture)) {
+        return;
+    }
+    StreamedTexture& entry = m_textures[texture];
+    m_residentBytes -= entry.bytesFrom[entry.residentMip];
+    entry = StreamedTexture{};
+    m_freeHandles.push_back(texture);
+}
+
+bool TextureStreamer::IsValid(TextureHandle texture) const {
+    return texture < m_textures.size() && m_textures[texture].live;
+}
+
+void TextureStreamer::RequestUsage(TextureHandle texture, float screenPixels) {
+    if (IsValid(texture)) {
+        StreamedTexture& entry = m_textures[texture];
+        entry.screenPixels = std::max(entry.screenPixels, screenPixels);
+    }
+}
+
+uint32_t TextureStreamer::DesiredMip(const StreamedTexture& texture) const {
+    if (texture.screenPixels > 0.0f) {
+        // Finest level that still has at least one texel per pixel
+        float texels = static_cast<float>(std::max(texture.info.width, texture.info.height));
+        float mip = std::log2(std::max(texels / texture.screenPixels, 1.0f)) + m_settings.mipBias;
+        return std::min(static_cast<uint32_t>(std::max(mip, 0.0f)), texture.tailMip);
+    }
+
+    // Recently seen textures hold what they have; unless memory is short
+    // they are not worth a reload when they come back into view
+    if (m_frame - texture.lastUsedFrame <= m_settings.retainFrames) {
+        return std::min(texture.residentMip, texture.tailMip);
+    }
+    return texture.tailMip;
+}
+
+void TextureStreamer::PlanTargets(const std::vector<TextureHandle>& order) {
+    // Tails are resident no matter what; detail shares what is left
+    uint64_t tailBytes = 0;
+    for (TextureHandle handle : order) {
+        const StreamedTexture& texture = m_textures[handle];
+        tailBytes += texture.bytesFrom[texture.tailMip];
+    }
+    uint64_t remaining = m_settings.memoryBudget > tailBytes ? m_settings.memoryBudget - tailBytes : 0;
+
+    for (TextureHandle handle : order) {
+        StreamedTexture& texture = m_textures[handle];
+        uint64_t tail = texture.bytesFrom[texture.tailMip];
+
+        texture.targetMip = texture.tailMip;
+        for (uint32_t mip = DesiredMip(texture); mip < texture.tailMip; mip++) {
+            if (texture.bytesFrom[mip] - tail <= remaining) {
+                texture.targetMip = mip;
+                break;
+            }
+        }
+        remaining -= texture.bytesFrom[texture.targetMip] - tail;
+    }
+}
+
+const std::vector<TextureResidencyChange>& TextureStreamer::Update() {
+    m_frame++;
+
+    std::vector<TextureHandle>& order = m_order;
+    order.clear();
+    for (TextureHandle handle = 0; handle < m_textures.size(); handle++) {
+        StreamedTexture& texture = m_textures[handle];
+        if (!texture.live) {
+            continue;
+        }
+        if (texture.screenPixels > 0.0f) {
+            texture.lastUsedFrame = m_frame;
+        }
+        texture.priority = texture.screenPixels;
+        order.push_back(handle);
+    }
+
+    // Largest on screen first; ties keep load order so plans are stable
+    std::stable_sort(order.begin(), order.end(), [this](TextureHandle a, TextureHandle b) {
+        return m_textures[a].priority > m_textures[b].priority;
+    });
+
+    PlanTargets(order);
+
+    std::vector<TextureResidencyChange>& changes = m_changes;
+    changes.clear();
+
+    // Evictions first, least important first, so the memory they free is
+    // available before anything new is uploaded
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        StreamedTexture& texture = m_textures[*it];
+        uint32_t levelCount = static_cast<uint32_t>(texture.info.levels.size());
+        if (texture.residentMip < levelCount && texture.targetMip > texture.residentMip) {
+            changes.push_back({*it, texture.residentMip, texture.targetMip});
+            m_residentBytes -= texture.bytesFrom[texture.residentMip] - texture.bytesFrom[texture.targetMip];
+            texture.residentMip = texture.targetMip;
+        }
+    }
+
+    // New textures get their whole tail at once so they are never unbound
+    uint64_t uploadBytes = 0;
+    for (TextureHandle handle : order) {
+        StreamedTexture& texture = m_textures[handle];
+        uint32_t levelCount = static_cast<uint32_t>(texture.info.levels.size());
+        if (texture.residentMip == levelCount) {
+            changes.push_back({handle, levelCount, texture.tailMip});
+            uploadBytes += texture.bytesFrom[texture.tailMip];
+            m_residentBytes += texture.bytesFrom[texture.tailMip];
+            texture.residentMip = texture.tailMip;
+        }
+    }
+
+    // Then one finer level per texture, most important first, until the
+    // frame's upload allowance is spent. A level larger than the whole
+    // allowance still goes through when it is the first upload of a frame.
+    for (TextureHandle handle : order) {
+        StreamedTexture& texture = m_textures[handle];
+        if (texture.targetMip >= texture.residentMip) {
+            continue;
+        }
+        uint32_t next = texture.residentMip - 1;
+        uint64_t bytes = texture.info.levels[next].size;
+        if (uploadBytes > 0 && uploadBytes + bytes > m_settings.uploadBytesPerFrame) {
+            continue;
+        }
+        changes.push_back({handle, texture.residentMip, next});
+        uploadBytes += bytes;
+        m_residentBytes += bytes;
+        texture.residentMip = next;
+    }
+
+    for (TextureHandle handle : order) {
+        m_textures[handle].screenPixels = 0.0f;
+    }
+    return changes;
+}
+
+const TextureFileInfo& TextureStreamer::GetInfo(TextureHandle texture) const {
+    return m_textures.at(texture).info;
+}
+
+const uint8_t* TextureStreamer::GetLevelData(TextureHandle texture, uint32_t mip) const {
+    const StreamedTexture& entry = m_textures.at(texture);
+    return entry.file->GetData() + entry.info.levels.at(mip).offset;
+}
+
+uint32_t TextureStreamer::GetResidentMip(TextureHandle texture) const {
+    return m_textures.at(texture).residentMip;
+}
+
+uint32_t TextureStreamer::GetTailMip(TextureHandle texture) const {
+    return m_textures.at(texture).tailMip;
+}
+
+uint64_t TextureStreamer::GetLevelRangeBytes(TextureHandle texture, uint32_t firstMip) const {
+    const StreamedTexture& entry = m_textures.at(texture);
+    return entry.bytesFrom.at(std::min<size_t>(firstMip, entry.bytesFrom.size() - 1));
+}
@@ -1,5 +1,6 @@
 #include "VulkanRenderer.h"
 #include "VulkanRendererHelpers.h"
+#include "LightingSystem.h"
 #include <stdexcept>
 #include <iostream>
 #include <set>
@@ -9,6 +10,58 @@
 #include <cstring>
 #include <limits>
 #include <chrono>
+#include <cstddef>
+
+namespace {
+    // Prebuilt SPIR-V is only read when the engine is built without shaderc
+    const ShaderVariant LIGHTING_VERTEX_SHADER{"shaders/lighting.vert", ShaderStage::Vertex, {}, "shaders/vert.spv"};
+    const ShaderVariant LIGHTING_FRAGMENT_SHADER{"shaders/lighting.frag", ShaderStage::Fragment, {}, "shaders/frag.spv"};
+    const ShaderVariant SHADOW_VERTEX_SHADER{"shaders/shadow.vert", ShaderStage::Vertex, {}, "shaders/shadow_vert.spv"};
+    const ShaderVariant GBUFFER_FRAGMENT_SHADER{"shaders/gbuffer.frag", ShaderStage::Fragment, {}, "shaders/gbuffer_frag.spv"};
+    const ShaderVariant DEFERRED_VERTEX_SHADER{"shaders/deferred.vert", ShaderStage::Vertex, {}, "shaders/deferred_vert.spv"};
+    const ShaderVariant DEFERRED_LIGHT_FRAGMENT_SHADER{"shaders/deferred_light.frag", ShaderStage::Fragment, {}, "shaders/deferred_light_frag.spv"};
+    const ShaderVariant TONEMAP_FRAGMENT_SHADER{"shaders/tonemap.frag", ShaderStage::Fragment, {}, "shaders/tonemap_frag.spv"};
+
+    const std::vector<ShaderVariant> ALL_SHADERS = {
+        LIGHTING_VERTEX_SHADER, LIGHTING_FRAGMENT_SHADER, SHADOW_VERTEX_SHADER,
+        GBUFFER_FRAGMENT_SHADER, DEFERRED_VERTEX_SHADER, DEFERRED_LIGHT_FRAGMENT_SHADER, TONEMAP_FRAGMENT_SHADER
+    };
+
+    // G-buffer layout written by gbuffer.frag. Normals get 10 bits per axis;
+    // position is not stored but reconstructed from depth.
+    constexpr VkFormat GBUFFER_ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;         // rgb albedo, a ambient occlusion
+    constexpr VkFormat GBUFFER_NORMAL_FORMAT = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    constexpr VkFormat GBUFFER_MATERIAL_FORMAT = VK_FORMAT_R8G8_UNORM;           // r roughness, g metallic
+    constexpr VkFormat LIGHT_ACCUMULATION_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    // Set 2 bindings; must match deferred_light.frag and tonemap.frag
+    constexpr uint32_t GBUFFER_BINDING_COUNT = 5;
+
+    // DeferredPushConstants::mode
+    constexpr uint32_t DEFERRED_MODE_FULLSCREEN = 0;
+    constexpr uint32_t DEFERRED_MODE_LIGHT_VOLUMES = 1;
+
+    // Shader includes generated from the C++ layouts in VulkanRenderer.h
+    std::string GenerateFrameGlsl() {
+        return GlslBlock<UniformBufferObject>("std140, binding = 0", "uniform", "ubo");
+    }
+
+    std::string GenerateLightGlsl() {
+        std::string glsl = "const uint MAX_LIGHTS = " + std::to_string(MAX_LIGHTS) + "u;\n";
+        glsl += "const uint LIGHT_DIRECTIONAL = " + std::to_string(static_cast<int>(LightType::Directional)) + "u;\n";
+        glsl += "const uint LIGHT_POINT = " + std::to_string(static_cast<int>(LightType::Point)) + "u;\n";
+        glsl += "const uint LIGHT_SPOT = " + std::to_string(static_cast<int>(LightType::Spot)) + "u;\n";
+        glsl += GlslStruct<LightData>();
+        glsl += GlslBlock<LightBufferData>("std430, binding = 1", "readonly buffer", "lightBuffer");
+        return glsl;
+    }
+
+    // Buffer-to-image copies need offsets aligned to the texel block size,
+    // which is at most 16 bytes for the formats streamed textures use
+    VkDeviceSize AlignStagingOffset(VkDeviceSize offset) {
+        return (offset + 15) & ~VkDeviceSize(15);
+    }
+}
 
 VulkanRenderer::VulkanRenderer() = default;
 
@@ -16,8 +69,9 @@ VulkanRenderer::~VulkanRenderer() {
     Cleanup();
 }
 
-bool VulkanRenderer::Initialize(GLFWwindow* window) {
+bool VulkanRenderer::Initialize(GLFWwindow* window, JobSystem* jobs) {
     m_window = window;
+    m_jobs = jobs;
     
     try {
         if (!CreateInstance()) return false;
@@ -31,11 +85,19 @@ bool VulkanRenderer::Initialize(GLFWwindow* window) {
         if (!CreateLogicalDevice()) return false;
         if (!CreateSwapChain()) return false;
         if (!CreateImageViews()) return false;
-        if (!CreateRenderPass()) return false;
+        m_depthFormat = FindDepthFormat();
+        m_renderGraph.Initialize(m_device, m_physicalDevice, m_deletionQueue);
         if (!CreateDescriptorSetLayout()) return false;
+        
+        m_shaderCompiler.SetGeneratedInclude("gpu_frame.glsl", GenerateFrameGlsl());
+        m_shaderCompiler.SetGeneratedInclude("gpu_lights.glsl", GenerateLightGlsl());
+        m_shaderCompiler.SetGeneratedInclude("gpu_materials.glsl", GlslStruct<MaterialData>());
+        
+        // Build every shader in parallel up front; the pipeline functions
+        // below then hit the memory cache
+        m_shaderCompiler.LoadAll(ALL_SHADERS, *m_jobs);
+        
         if (!CreateGraphicsPipeline()) return false;
-        if (!CreateDepthResources()) return false;
-        if (!CreateFramebuffers()) return false;
         if (!CreateCommandPool()) return false;
         
         CreateTestGeometry();
@@ -44,10 +106,17 @@ bool VulkanRenderer::Initialize(GLFWwindow* window) {
         if (!CreateIndexBuffer()) return false;
         if (!CreateUniformBuffers()) return false;
         if (!CreateLightBuffers()) return false;
+        if (!CreateShadowResources()) return false;
+        if (!CreateShadowPipeline()) return false;
+        if (!CreateMaterialBuffers()) return false;
         if (!CreateDescriptorPool()) return false;
         if (!CreateDescriptorSets()) return false;
+        if (!CreateBindlessResources()) return false;
+        if (!CreateTextureResources()) return false;
+        if (!CreateDeferredResources()) return false;
         if (!CreateCommandBuffers()) return false;
         if (!CreateSyncObjects()) return false;
+        m_framePacer.Initialize(m_device);
         
         LogVulkanInfo(m_instance, m_physicalDevice);
         
@@ -70,7 +139,7 @@ bool VulkanRenderer::CreateInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "Custom Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2; // Descriptor indexing for the bindless tables
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -123,7 +192,8 @@ bool VulkanRenderer::PickPhysicalDevice() {
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
     for (const auto& device : devices) {
-        if (IsDeviceSuitable(device)) {
+        if (IsDeviceSuitable(device) && CheckDescriptorIndexingSupport(device) && CheckDynamicRenderingSupport(device) &&
+            CheckTimelineSemaphoreSupport(device)) {
             m_physicalDevice = device;
             break;
         }
@@ -156,8 +226,26 @@ bool VulkanRenderer::CreateLogicalDevice() {
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.fillModeNonSolid = VK_TRUE;
 
+    // Bindless: runtime-sized texture arrays written while frames are in flight
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.descriptorIndexing = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features12.timelineSemaphore = VK_TRUE; // Frame pacing
+
+    // Render graph passes begin rendering on image views directly
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+    dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRendering.dynamicRendering = VK_TRUE;
+    features12.pNext = &dynamicRendering;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &features12;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -180,7 +268,7 @@ bool VulkanRenderer::CreateLogicalDevice() {
     return true;
 }
 
-bool VulkanRenderer::CreateSwapChain() {
+bool VulkanRenderer::CreateSwapChain(VkSwapchainKHR oldSwapChain) {
     SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(m_physicalDevice);
 
     VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -217,7 +305,7 @@ bool VulkanRenderer::CreateSwapChain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapChain; // Lets the driver hand over images without a gap
 
     ThrowIfFailed(vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain), 
                   "Failed to create swap chain!");
@@ -232,6 +320,21 @@ bool VulkanRenderer::CreateSwapChain() {
     return true;
 }
 
+VkPresentModeKHR VulkanRenderer::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+    VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+    switch (m_presentMode) {
+        case PresentMode::Fifo: requested = VK_PRESENT_MODE_FIFO_KHR; break;
+        case PresentMode::Mailbox: requested = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case PresentMode::Immediate: requested = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+    }
+
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), requested) != availablePresentModes.end()) {
+        return requested;
+    }
+    std::cerr << "Present mode " << static_cast<int>(m_presentMode) << " not supported by the surface, using FIFO" << std::endl;
+    return VK_PRESENT_MODE_FIFO_KHR; // Required to be available
+}
+
 bool VulkanRenderer::CreateImageViews() {
     m_swapChainImageViews.resize(m_swapChainImages.size());
 
@@ -242,65 +345,6 @@ bool VulkanRenderer::CreateImageViews() {
     return true;
 }
 
-bool VulkanRenderer::CreateRenderPass() {
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = m_swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = FindDepthFormat();
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef{};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    ThrowIfFailed(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass), 
-                  "Failed to create render pass!");
-
-    return true;
-}
-
 bool VulkanRenderer::CreateDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
@@ -314,9 +358,32 @@ bool VulkanRenderer::CreateDescriptorSetLayout() {
     lightLayoutBinding.descriptorCount = 1;
     lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     lightLayoutBinding.pImmutableSamplers = nullptr;
-    lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, lightLayoutBinding};
+    lightLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // Light volumes are placed in deferred.vert
+
+    VkDescriptorSetLayoutBinding shadowAtlasBinding{};
+    shadowAtlasBinding.binding = 2;
+    shadowAtlasBinding.descriptorCount = 1;
+    shadowAtlasBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    shadowAtlasBinding.pImmutableSamplers = nullptr;
+    shadowAtlasBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding shadowDataBinding{};
+    shadowDataBinding.binding = 3;
+    shadowDataBinding.descriptorCount = 1;
+    shadowDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    shadowDataBinding.pImmutableSamplers = nullptr;
+    shadowDataBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding materialBinding{};
+    materialBinding.binding = 4;
+    materialBinding.descriptorCount = 1;
+    materialBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    materialBinding.pImmutableSamplers = nullptr;
+    materialBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings = {
+        uboLayoutBinding, lightLayoutBinding, shadowAtlasBinding, shadowDataBinding, materialBinding
+    };
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -325,39 +392,154 @@ bool VulkanRenderer::CreateDescriptorSetLayout() {
     ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout), 
                   "Failed to create descriptor set layout!");
 
+    // Set 1: bindless texture array. Slots are written while earlier frames
+    // may still be executing, and unused slots are never written at all.
+    VkDescriptorSetLayoutBinding textureBinding{};
+    textureBinding.binding = 0;
+    textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureBinding.descriptorCount = MAX_BINDLESS_TEXTURES;
+    textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags textureBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &textureBindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo bindlessLayoutInfo{};
+    bindlessLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    bindlessLayoutInfo.pNext = &bindingFlagsInfo;
+    bindlessLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    bindlessLayoutInfo.bindingCount = 1;
+    bindlessLayoutInfo.pBindings = &textureBinding;
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &bindlessLayoutInfo, nullptr, &m_bindlessSetLayout),
+                  "Failed to create bindless descriptor set layout!");
+
+    // Set 2: the deferred path's G-buffer, depth and light accumulation,
+    // rewritten every frame since the render graph may move them
+    std::array<VkDescriptorSetLayoutBinding, GBUFFER_BINDING_COUNT> gbufferBindings{};
+    for (uint32_t binding = 0; binding < gbufferBindings.size(); binding++) {
+        gbufferBindings[binding].binding = binding;
+        gbufferBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        gbufferBindings[binding].descriptorCount = 1;
+        gbufferBindings[binding].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo gbufferLayoutInfo{};
+    gbufferLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    gbufferLayoutInfo.bindingCount = static_cast<uint32_t>(gbufferBindings.size());
+    gbufferLayoutInfo.pBindings = gbufferBindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &gbufferLayoutInfo, nullptr, &m_gbufferSetLayout),
+                  "Failed to create G-buffer descriptor set layout!");
+
     return true;
 }
 
 bool VulkanRenderer::CreateGraphicsPipeline() {
-    auto vertShaderCode = ReadFile("shaders/vert.spv");
-    auto fragShaderCode = ReadFile("shaders/frag.spv");
+    auto vertShaderCode = m_shaderCompiler.Load(LIGHTING_VERTEX_SHADER);
+    auto fragShaderCode = m_shaderCompiler.Load(LIGHTING_FRAGMENT_SHADER);
+
+    // Kept alive so lighting variants can be built later on worker threads
+    m_lightingVertModule = CreateShaderModule(vertShaderCode);
+    m_lightingFragModule = CreateShaderModule(fragShaderCode);
+
+    if (m_pipelineCache == VK_NULL_HANDLE) {
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        ThrowIfFailed(vkCreatePipelineCache(m_device, &cacheInfo, nullptr, &m_pipelineCache),
+                      "Failed to create pipeline cache!");
+    }
 
-    VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {m_descriptorSetLayout, m_bindlessSetLayout};
 
+    VkPushConstantRange drawRange{};
+    drawRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    drawRange.offset = 0;
+    drawRange.size = sizeof(DrawPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &drawRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout), 
+                  "Failed to create pipeline layout!");
+
+    // The generic variant handles any light mix and is used until a more
+    // specialized one has been built
+    m_graphicsPipeline = CreateLightingPipeline(LightingVariant{}, m_swapChainImageFormat);
+
+    // Both depth modes are kept ready so toggling the prepass never stalls
+    LightingVariant prepassVariant;
+    prepassVariant.depthPrepass = true;
+    m_prepassGraphicsPipeline = CreateLightingPipeline(prepassVariant, m_swapChainImageFormat);
+    m_depthPrepassPipeline = CreateDepthPrepassPipeline();
+
+    // Built alongside so switching render paths never stalls either
+    CreateDeferredPipelines();
+
+    return true;
+}
+
+void VulkanRenderer::CreateDeferredPipelines() {
+    m_gbufferFragModule = CreateShaderModule(m_shaderCompiler.Load(GBUFFER_FRAGMENT_SHADER));
+    m_deferredVertModule = CreateShaderModule(m_shaderCompiler.Load(DEFERRED_VERTEX_SHADER));
+    m_deferredLightFragModule = CreateShaderModule(m_shaderCompiler.Load(DEFERRED_LIGHT_FRAGMENT_SHADER));
+    m_tonemapFragModule = CreateShaderModule(m_shaderCompiler.Load(TONEMAP_FRAGMENT_SHADER));
+
+    // Sets 0 and 1 as in the lighting layout, plus the G-buffer
+    std::array<VkDescriptorSetLayout, 3> setLayouts = {m_descriptorSetLayout, m_bindlessSetLayout, m_gbufferSetLayout};
+
+    VkPushConstantRange modeRange{};
+    modeRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    modeRange.offset = 0;
+    modeRange.size = sizeof(DeferredPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &modeRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_deferredPipelineLayout),
+                  "Failed to create deferred pipeline layout!");
+
+    m_gbufferPipeline = CreateGBufferPipeline();
+    m_deferredLightingPipeline = CreateFullscreenPipeline(m_deferredLightFragModule, LIGHT_ACCUMULATION_FORMAT, true);
+    m_tonemapPipeline = CreateFullscreenPipeline(m_tonemapFragModule, m_swapChainImageFormat, false);
+}
+
+VkPipeline VulkanRenderer::CreateGBufferPipeline() const {
+    // The lighting vertex shader feeds gbuffer.frag, so draws are recorded
+    // exactly as in the forward path
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.module = m_lightingVertModule;
     vertShaderStageInfo.pName = "main";
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.module = m_gbufferFragModule;
     fragShaderStageInfo.pName = "main";
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
     auto bindingDescription = Vertex::getBindingDescription();
     auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -393,20 +575,17 @@ bool VulkanRenderer::CreateGraphicsPipeline() {
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.stencilTestEnable = VK_FALSE;
 
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
+    std::array<VkPipelineColorBlendAttachmentState, 3> colorBlendAttachments{};
+    for (auto& attachment : colorBlendAttachments) {
+        attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        attachment.blendEnable = VK_FALSE;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
 
     std::vector<VkDynamicState> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
@@ -417,16 +596,18 @@ bool VulkanRenderer::CreateGraphicsPipeline() {
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-
-    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout), 
-                  "Failed to create pipeline layout!");
+    // Attachment order of the render graph's G-buffer pass
+    std::array<VkFormat, 3> colorFormats = {GBUFFER_ALBEDO_FORMAT, GBUFFER_NORMAL_FORMAT, GBUFFER_MATERIAL_FORMAT};
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+    renderingInfo.pColorAttachmentFormats = colorFormats.data();
+    renderingInfo.depthAttachmentFormat = m_depthFormat;
+    renderingInfo.stencilAttachmentFormat = ::HasStencilComponent(m_depthFormat) ? m_depthFormat : VK_FORMAT_UNDEFINED;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -437,176 +618,1817 @@ bool VulkanRenderer::CreateGraphicsPipeline() {
     pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.layout = m_pipelineLayout;
-    pipelineInfo.renderPass = m_renderPass;
+    pipelineInfo.layout = m_pipelineLayout; // Same sets and push constants as the lighting pipelines
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline), 
-                  "Failed to create graphics pipeline!");
-
-    vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+    VkPipeline pipeline;
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
+                  "Failed to create G-buffer pipeline!");
 
-    return true;
+    return pipeline;
 }
 
-// Continue with the rest of the implementation...
-void VulkanRenderer::BeginFrame() {
-    vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
-
-    VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, 
-                                           m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &m_imageIndex);
+VkPipeline VulkanRenderer::CreateFullscreenPipeline(VkShaderModule fragModule, VkFormat colorFormat, bool additive) const {
+    // deferred.vert generates its vertices, so there is no vertex input, and
+    // nothing is depth tested: lighting reads depth as a texture instead
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = m_deferredVertModule;
+    vertShaderStageInfo.pName = "main";
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        RecreateSwapChain();
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("Failed to acquire swap chain image!");
-    }
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragModule;
+    fragShaderStageInfo.pName = "main";
 
-    vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    // Record command buffer
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    ThrowIfFailed(vkBeginCommandBuffer(m_commandBuffers[m_currentFrame], &beginInfo), 
-                  "Failed to begin recording command buffer!");
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapChainFramebuffers[m_imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = m_swapChainExtent;
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.depthBiasEnable = VK_FALSE;
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-    clearValues[1].depthStencil = {1.0f, 0};
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_FALSE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
 
-    vkCmdBeginRenderPass(m_commandBuffers[m_currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Light contributions are summed into the accumulation target
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = additive ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
-    vkCmdBindPipeline(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(m_swapChainExtent.width);
-    viewport.height = static_cast<float>(m_swapChainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(m_commandBuffers[m_currentFrame], 0, 1, &viewport);
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = m_swapChainExtent;
-    vkCmdSetScissor(m_commandBuffers[m_currentFrame], 0, 1, &scissor);
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
 
-    VkBuffer vertexBuffers[] = {m_vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(m_commandBuffers[m_currentFrame], 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(m_commandBuffers[m_currentFrame], m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_deferredPipelineLayout;
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    vkCmdBindDescriptorSets(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                           m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame], 0, nullptr);
+    VkPipeline pipeline;
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
+                  "Failed to create fullscreen pipeline!");
 
-    vkCmdDrawIndexed(m_commandBuffers[m_currentFrame], static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+    return pipeline;
 }
 
-void VulkanRenderer::EndFrame() {
-    vkCmdEndRenderPass(m_commandBuffers[m_currentFrame]);
-
-    ThrowIfFailed(vkEndCommandBuffer(m_commandBuffers[m_currentFrame]), 
-                  "Failed to record command buffer!");
+// Variants build on background threads, so the color format is passed in
+// rather than read from m_swapChainImageFormat, which RecreateSwapChain
+// may be changing meanwhile
+VkPipeline VulkanRenderer::CreateLightingPipeline(const LightingVariant& variant, VkFormat colorFormat) const {
+    // Must match the constant_id declarations in lighting.frag
+    struct SpecializationData {
+        int32_t lightTypeMask;
+        int32_t fixedLightCount;
+        VkBool32 sunEnabled;
+    } specializationData = {
+        static_cast<int32_t>(variant.lightTypeMask),
+        static_cast<int32_t>(variant.lightCount),
+        variant.sun ? VK_TRUE : VK_FALSE
+    };
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    std::array<VkSpecializationMapEntry, 3> specializationEntries{};
+    specializationEntries[0] = {0, offsetof(SpecializationData, lightTypeMask), sizeof(int32_t)};
+    specializationEntries[1] = {1, offsetof(SpecializationData, fixedLightCount), sizeof(int32_t)};
+    specializationEntries[2] = {2, offsetof(SpecializationData, sunEnabled), sizeof(VkBool32)};
 
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(specializationData);
+    specializationInfo.pData = &specializationData;
 
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = m_lightingVertModule;
+    vertShaderStageInfo.pName = "main";
 
-    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = m_lightingFragModule;
+    fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
-    ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]), 
-                  "Failed to submit draw command buffer!");
+    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    VkSwapchainKHR swapChains[] = {m_swapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &m_imageIndex;
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
-    VkResult result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        RecreateSwapChain();
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to present swap chain image!");
-    }
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-}
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
 
-void VulkanRenderer::UpdateUniforms(const UniformBufferObject& ubo) {
-    memcpy(m_uniformBuffersMapped[m_currentFrame], &ubo, sizeof(ubo));
-}
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
 
-void VulkanRenderer::UpdateLights(const std::vector<LightData>& lights) {
-    // Ensure we don't exceed max lights
-    size_t lightCount = std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS));
-    
-    // Copy light data
-    if (!lights.empty()) {
-        memcpy(m_lightBuffersMapped[m_currentFrame], lights.data(), lightCount * sizeof(LightData));
-    }
-}
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-void VulkanRenderer::Cleanup() {
-    if (m_device != VK_NULL_HANDLE) {
-        vkDeviceWaitIdle(m_device);
-    }
+    // After a prepass only the nearest surface passes, and depth is final
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = variant.depthPrepass ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = variant.depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
 
-    CleanupSwapChain();
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
 
-    // Cleanup in reverse order of creation
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        SafeDestroy(m_uniformBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
-        SafeDestroy(m_uniformBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
-        SafeDestroy(m_lightBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
-        SafeDestroy(m_lightBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.blendConstants[0] = 0.0f;
+    colorBlending.blendConstants[1] = 0.0f;
+    colorBlending.blendConstants[2] = 0.0f;
+    colorBlending.blendConstants[3] = 0.0f;
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // Attachment formats of the render graph's lighting pass
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = m_depthFormat;
+    renderingInfo.stencilAttachmentFormat = ::HasStencilComponent(m_depthFormat) ? m_depthFormat : VK_FORMAT_UNDEFINED;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = VK_NULL_HANDLE; // Dynamic rendering, see renderingInfo
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline pipeline;
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), 
+                  "Failed to create graphics pipeline!");
+
+    return pipeline;
+}
+
+VkPipeline VulkanRenderer::CreateDepthPrepassPipeline() const {
+    // Same vertex shader and inputs as the lighting pipelines: with gl_Position
+    // declared invariant both produce bit-identical depth for the EQUAL test
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = m_lightingVertModule;
+    vertShaderStageInfo.pName = "main";
+
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 0;
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // Depth only, matching the prepass in the render graph
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.depthAttachmentFormat = m_depthFormat;
+    renderingInfo.stencilAttachmentFormat = ::HasStencilComponent(m_depthFormat) ? m_depthFormat : VK_FORMAT_UNDEFINED;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_pipelineLayout; // Shares the lighting sets and push constants
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipeline pipeline;
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
+                  "Failed to create depth prepass pipeline!");
+
+    return pipeline;
+}
+
+VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<uint32_t>& code) const {
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    ThrowIfFailed(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule),
+                  "Failed to create shader module!");
+
+    return shaderModule;
+}
+
+void VulkanRenderer::ReloadChangedShaders() {
+    std::vector<std::string> changed = m_shaderCompiler.PollChangedSources();
+    if (changed.empty()) {
+        return;
+    }
+
+    for (const std::string& path : changed) {
+        std::cout << "Shader changed: " << path << std::endl;
+    }
+
+    // Compile before touching the live pipelines so a syntax error while
+    // editing leaves the last good version running
+    try {
+        m_shaderCompiler.LoadAll(ALL_SHADERS, *m_jobs);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Shader reload failed: " << e.what() << std::endl;
+        return;
+    }
+
+    // Old pipelines are released through the deletion queue, so frames in
+    // flight finish with them and the device never idles. Specialized
+    // variants are rebuilt lazily from the new modules.
+    DestroyLightingPipelines();
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_shadowPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipelineLayout>(m_deletionQueue, m_shadowPipelineLayout, [this](VkPipelineLayout layout) { vkDestroyPipelineLayout(m_device, layout, nullptr); });
+
+    CreateGraphicsPipeline();
+    CreateShadowPipeline();
+}
+
+void VulkanRenderer::SetLightMix(const LightMix& mix) {
+    LightingVariant variant;
+    variant.lightTypeMask = (mix.directional > 0 ? 1u << static_cast<int>(LightType::Directional) : 0u) |
+                            (mix.point > 0 ? 1u << static_cast<int>(LightType::Point) : 0u) |
+                            (mix.spot > 0 ? 1u << static_cast<int>(LightType::Spot) : 0u);
+    uint32_t lightCount = std::min<uint32_t>(mix.Total(), MAX_LIGHTS);
+    variant.lightCount = lightCount <= MAX_FIXED_LIGHT_COUNT ? lightCount : 0;
+    variant.sun = mix.sun;
+    variant.depthPrepass = m_depthPrepass;
+    m_lightingVariant = variant;
+
+    CollectLightingPipelines(false);
+
+    uint32_t key = variant.Key();
+    auto built = m_lightingPipelines.find(key);
+    if (built != m_lightingPipelines.end()) {
+        m_activeLightingPipeline = built->second != VK_NULL_HANDLE ? built->second : GetGenericLightingPipeline();
+        return;
+    }
+
+    LightingVariant generic;
+    generic.depthPrepass = m_depthPrepass;
+    if (key != generic.Key() && !m_pendingLightingPipelines.count(key)) {
+        VkFormat colorFormat = m_swapChainImageFormat;
+        auto pipeline = std::make_shared<VkPipeline>(VK_NULL_HANDLE);
+        JobHandle job = m_jobs->Schedule("Build lighting variant", [this, variant, colorFormat, pipeline]() {
+            *pipeline = CreateLightingPipeline(variant, colorFormat);
+        });
+        m_pendingLightingPipelines.emplace(key, PendingLightingPipeline{colorFormat, job, pipeline});
+    }
+    m_activeLightingPipeline = GetGenericLightingPipeline();
+}
+
+void VulkanRenderer::SetDepthPrepass(bool enabled) {
+    if (enabled == m_depthPrepass) {
+        return;
+    }
+    m_depthPrepass = enabled;
+
+    // The active variant was built for the other depth mode; the generic
+    // one covers until the next SetLightMix picks a matching variant
+    m_lightingVariant.depthPrepass = enabled;
+    m_activeLightingPipeline = VK_NULL_HANDLE;
+}
+
+void VulkanRenderer::SetPresentMode(PresentMode mode) {
+    if (mode == m_presentMode) {
+        return;
+    }
+    m_presentMode = mode;
+    m_framebufferResized = true; // Rebuilt at the next frame boundary like a resize
+}
+
+// Moves finished variant builds into m_lightingPipelines, waiting for the
+// ones still running when `wait` is set. A build made for a color format
+// the swap chain no longer has is destroyed and will be requested again.
+void VulkanRenderer::CollectLightingPipelines(bool wait) {
+    for (auto it = m_pendingLightingPipelines.begin(); it != m_pendingLightingPipelines.end();) {
+        PendingLightingPipeline& pending = it->second;
+        if (!wait && !pending.job.IsDone()) {
+            ++it;
+            continue;
+        }
+        try {
+            m_jobs->Wait(pending.job);
+            VkPipeline pipeline = *pending.pipeline;
+            if (pending.colorFormat == m_swapChainImageFormat) {
+                m_lightingPipelines[it->first] = pipeline;
+            } else {
+                DeferDestroy<VkPipeline>(m_deletionQueue, pipeline, [this](VkPipeline handle) { vkDestroyPipeline(m_device, handle, nullptr); });
+            }
+        }
+        catch (const std::exception& e) {
+            // Never retried; the generic pipeline keeps covering this mix
+            std::cerr << "Lighting variant build failed: " << e.what() << std::endl;
+            m_lightingPipelines[it->first] = VK_NULL_HANDLE;
+        }
+        it = m_pendingLightingPipelines.erase(it);
+    }
+}
+
+void VulkanRenderer::DestroyLightingPipelines() {
+    // Builds still running reference the shader modules below
+    for (auto& [key, pending] : m_pendingLightingPipelines) {
+        try {
+            m_jobs->Wait(pending.job);
+            DeferDestroy<VkPipeline>(m_deletionQueue, *pending.pipeline, [this](VkPipeline handle) { vkDestroyPipeline(m_device, handle, nullptr); });
+        }
+        catch (const std::exception&) {
+        }
+    }
+    m_pendingLightingPipelines.clear();
+
+    // Frames in flight may still be drawing with these
+    for (auto& [key, pipeline] : m_lightingPipelines) {
+        DeferDestroy<VkPipeline>(m_deletionQueue, pipeline, [this](VkPipeline handle) { vkDestroyPipeline(m_device, handle, nullptr); });
+    }
+    m_lightingPipelines.clear();
+    m_activeLightingPipeline = VK_NULL_HANDLE;
+
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_graphicsPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_prepassGraphicsPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_depthPrepassPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipelineLayout>(m_deletionQueue, m_pipelineLayout, [this](VkPipelineLayout layout) { vkDestroyPipelineLayout(m_device, layout, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_lightingVertModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_lightingFragModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_gbufferPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_deferredLightingPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipeline>(m_deletionQueue, m_tonemapPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    DeferDestroy<VkPipelineLayout>(m_deletionQueue, m_deferredPipelineLayout, [this](VkPipelineLayout layout) { vkDestroyPipelineLayout(m_device, layout, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_gbufferFragModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_deferredVertModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_deferredLightFragModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+    DeferDestroy<VkShaderModule>(m_deletionQueue, m_tonemapFragModule, [this](VkShaderModule module) { vkDestroyShaderModule(m_device, module, nullptr); });
+}
+
+// Continue with the rest of the implementation...
+void VulkanRenderer::WaitForNextFrame() {
+    if (m_framePacer.HasWaited()) {
+        return;
+    }
+    m_framePacer.WaitForFrame();
+    m_currentFrame = m_framePacer.GetSlot();
+    m_deletionQueue.Collect(m_framePacer.GetCompletedFrames());
+
+    // With FIFO the acquire blocks until a vertical blank frees an image;
+    // doing it here keeps that wait ahead of input as well
+    if (m_framePacer.GetLatencyMode() == LatencyMode::LowLatency) {
+        if (m_framebufferResized) {
+            RecreateSwapChain();
+        }
+        AcquireNextImage();
+    }
+}
+
+bool VulkanRenderer::AcquireNextImage() {
+    VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, 
+                                           m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &m_imageIndex);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        RecreateSwapChain();
+        return false;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("Failed to acquire swap chain image!");
+    }
+
+    m_imageAcquired = true;
+    return true;
+}
+
+bool VulkanRenderer::BeginFrame() {
+    m_frameStarted = false;
+    WaitForNextFrame();
+
+    // An acquired image belongs to the current chain, which must then be
+    // kept until it is presented
+    if (!m_imageAcquired) {
+        if (m_framebufferResized) {
+            RecreateSwapChain();
+        }
+        if (!AcquireNextImage()) {
+            m_drawQueue.clear();
+            return false;
+        }
+    }
+
+    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+
+    // Record command buffer
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    ThrowIfFailed(vkBeginCommandBuffer(m_commandBuffers[m_currentFrame], &beginInfo), 
+                  "Failed to begin recording command buffer!");
+
+    // Nothing queued: draw the test mesh once with the default material
+    if (m_drawQueue.empty()) {
+        QueueDraw(DrawCommand{});
+    }
+
+    // Residency changes may move material texture slots, so they go first
+    RecordTextureStreaming(m_commandBuffers[m_currentFrame]);
+    UploadMaterials();
+
+    // The pacer's wait guarantees this frame's shadow buffer is no longer read
+    memcpy(m_shadowBuffersMapped[m_currentFrame], &m_shadowUniforms, sizeof(m_shadowUniforms));
+    RecordFrameGraph(m_commandBuffers[m_currentFrame]);
+
+    m_frameStarted = true;
+    return true;
+}
+
+void VulkanRenderer::EndFrame() {
+    if (!m_frameStarted) {
+        return;
+    }
+    m_frameStarted = false;
+
+    ThrowIfFailed(vkEndCommandBuffer(m_commandBuffers[m_currentFrame]), 
+                  "Failed to record command buffer!");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+
+    // The binary semaphore gates presentation; the timeline value marks
+    // the frame finished for the pacer and the deletion queue
+    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame], m_framePacer.GetTimeline()};
+    uint64_t signalValues[] = {0, m_framePacer.GetSignalValue()}; // Binary semaphores ignore their value
+    submitInfo.signalSemaphoreCount = 2;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
+    ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE), 
+                  "Failed to submit draw command buffer!");
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &m_renderFinishedSemaphores[m_currentFrame];
+
+    VkSwapchainKHR swapChains[] = {m_swapChain};
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+    presentInfo.pImageIndices = &m_imageIndex;
+
+    VkResult result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    m_imageAcquired = false;
+    m_deletionQueue.NextFrame();
+    m_framePacer.FrameSubmitted();
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized) {
+        RecreateSwapChain();
+    } else if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to present swap chain image!");
+    }
+}
+
+void VulkanRenderer::RecreateSwapChain() {
+    // A minimized window has a zero-sized surface; keep the current chain
+    // and try again once it has an area
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    if (width == 0 || height == 0) {
+        return;
+    }
+    m_framebufferResized = false;
+
+    // Frames still in flight keep using the old chain, so it is handed to
+    // the new one as oldSwapchain and destroyed later instead of idling
+    VkSwapchainKHR oldSwapChain = m_swapChain;
+    for (VkImageView& imageView : m_swapChainImageViews) {
+        DeferDestroy<VkImageView>(m_deletionQueue, imageView, [this](VkImageView handle) { vkDestroyImageView(m_device, handle, nullptr); });
+    }
+    m_swapChainImageViews.clear();
+
+    // Variant builds in flight read the format they were launched with;
+    // finishing them first keeps CreateSwapChain from racing them
+    CollectLightingPipelines(true);
+    VkFormat oldFormat = m_swapChainImageFormat;
+    CreateSwapChain(oldSwapChain);
+    DeferDestroy<VkSwapchainKHR>(m_deletionQueue, oldSwapChain, [this](VkSwapchainKHR swapChain) { vkDestroySwapchainKHR(m_device, swapChain, nullptr); });
+
+    // Only a surface format change invalidates the pipelines built against
+    // it. The depth buffer follows the new extent through the render graph.
+    if (m_swapChainImageFormat != oldFormat) {
+        DestroyLightingPipelines();
+        CreateGraphicsPipeline();
+    }
+
+    CreateImageViews();
+}
+
+void VulkanRenderer::CleanupSwapChain() {
+    // Callers have idled the device, so deferred work can run now
+    m_deletionQueue.Flush();
+
+    for (VkImageView& imageView : m_swapChainImageViews) {
+        SafeDestroy(imageView, [this](VkImageView handle) { vkDestroyImageView(m_device, handle, nullptr); });
+    }
+    m_swapChainImageViews.clear();
+
+    SafeDestroy(m_swapChain, [this](VkSwapchainKHR swapChain) { vkDestroySwapchainKHR(m_device, swapChain, nullptr); });
+}
+
+void VulkanRenderer::UpdateUniforms(const UniformBufferObject& ubo) {
+    memcpy(m_uniformBuffersMapped[m_currentFrame], &ubo, sizeof(ubo));
+}
+
+void VulkanRenderer::UpdateLights(std::span<const LightData> lights) {
+    // Only the count and the lights in use are written; shaders never read
+    // past lightCount
+    uint32_t lightCount = static_cast<uint32_t>(std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS)));
+    auto* buffer = static_cast<std::byte*>(m_lightBuffersMapped[m_currentFrame]);
+    memcpy(buffer + offsetof(LightBufferData, lightCount), &lightCount, sizeof(lightCount));
+    if (lightCount > 0) {
+        memcpy(buffer + offsetof(LightBufferData, lights), lights.data(), lightCount * sizeof(LightData));
+    }
+}
+
+void VulkanRenderer::UpdateShadows(const ShadowUniforms& uniforms, const std::vector<ShadowRenderView>& views) {
+    m_shadowUniforms = uniforms;
+    m_pendingShadowViews.insert(m_pendingShadowViews.end(), views.begin(), views.end());
+}
+
+bool VulkanRenderer::CreateShadowResources() {
+    m_shadowFormat = FindSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+    CreateImage(m_shadowAtlasSize, m_shadowAtlasSize, m_shadowFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_shadowAtlasImage, m_shadowAtlasMemory);
+    m_shadowAtlasView = CreateImageView(m_shadowAtlasImage, m_shadowFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    // Start fully lit and in the layout the shadow pass expects between frames
+    VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_shadowAtlasImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkClearDepthStencilValue clearValue = {1.0f, 0};
+    vkCmdClearDepthStencilImage(commandBuffer, m_shadowAtlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &clearValue, 1, &barrier.subresourceRange);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    EndSingleTimeCommands(commandBuffer);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.maxLod = 0.0f;
+
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_shadowSampler),
+                  "Failed to create shadow sampler!");
+
+    VkDeviceSize bufferSize = sizeof(ShadowUniforms);
+    m_shadowBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_shadowBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_shadowBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     m_shadowBuffers[i], m_shadowBuffersMemory[i]);
+        vkMapMemory(m_device, m_shadowBuffersMemory[i], 0, bufferSize, 0, &m_shadowBuffersMapped[i]);
+        memcpy(m_shadowBuffersMapped[i], &m_shadowUniforms, sizeof(m_shadowUniforms));
+    }
+
+    return true;
+}
+
+bool VulkanRenderer::CreateShadowPipeline() {
+    auto vertShaderCode = m_shaderCompiler.Load(SHADOW_VERTEX_SHADER);
+    VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+
+    // Depth only: no fragment stage
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1; // Position only
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescriptions[0];
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    // Slope-scaled bias keeps lit surfaces from shadowing themselves
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = 1.25f;
+    rasterizer.depthBiasSlopeFactor = 1.75f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 0;
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(glm::mat4);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 0;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_shadowPipelineLayout),
+                  "Failed to create shadow pipeline layout!");
+
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.depthAttachmentFormat = m_shadowFormat;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = m_shadowPipelineLayout;
+    pipelineInfo.renderPass = VK_NULL_HANDLE;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_shadowPipeline),
+                  "Failed to create shadow pipeline!");
+
+    vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+
+    return true;
+}
+
+bool VulkanRenderer::CreateDescriptorPool() {
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2); // Frame and shadow uniforms
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * 2); // Lights and materials
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool),
+                  "Failed to create descriptor pool!");
+
+    return true;
+}
+
+bool VulkanRenderer::CreateDescriptorSets() {
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+                  "Failed to allocate descriptor sets!");
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        VkDescriptorBufferInfo uboInfo{};
+        uboInfo.buffer = m_uniformBuffers[i];
+        uboInfo.offset = 0;
+        uboInfo.range = sizeof(UniformBufferObject);
+
+        VkDescriptorBufferInfo lightInfo{};
+        lightInfo.buffer = m_lightBuffers[i];
+        lightInfo.offset = 0;
+        lightInfo.range = sizeof(LightBufferData);
+
+        VkDescriptorImageInfo shadowAtlasInfo{};
+        shadowAtlasInfo.sampler = m_shadowSampler;
+        shadowAtlasInfo.imageView = m_shadowAtlasView;
+        shadowAtlasInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+        VkDescriptorBufferInfo shadowInfo{};
+        shadowInfo.buffer = m_shadowBuffers[i];
+        shadowInfo.offset = 0;
+        shadowInfo.range = sizeof(ShadowUniforms);
+
+        VkDescriptorBufferInfo materialInfo{};
+        materialInfo.buffer = m_materialBuffers[i];
+        materialInfo.offset = 0;
+        materialInfo.range = sizeof(MaterialData) * MAX_MATERIALS;
+
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = m_descriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorCount = 1;
+        }
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].pBufferInfo = &uboInfo;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].pBufferInfo = &lightInfo;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[2].pImageInfo = &shadowAtlasInfo;
+        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[3].pBufferInfo = &shadowInfo;
+        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[4].pBufferInfo = &materialInfo;
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(), 0, nullptr);
+    }
+
+    return true;
+}
+
+bool VulkanRenderer::CreateMaterialBuffers() {
+    VkDeviceSize bufferSize = sizeof(MaterialData) * MAX_MATERIALS;
+
+    m_materialBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_materialBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_materialBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    m_uploadedMaterialVersions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     m_materialBuffers[i], m_materialBuffersMemory[i]);
+        ThrowIfFailed(vkMapMemory(m_device, m_materialBuffersMemory[i], 0, bufferSize, 0, &m_materialBuffersMapped[i]),
+                      "Failed to map material buffer!");
+    }
+
+    // Material 0 is what undecorated draws use
+    CreateMaterial(MaterialData{});
+
+    return true;
+}
+
+bool VulkanRenderer::CreateBindlessResources() {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = MAX_BINDLESS_TEXTURES;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_bindlessPool),
+                  "Failed to create bindless descriptor pool!");
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_bindlessPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_bindlessSetLayout;
+
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, &m_bindlessSet),
+                  "Failed to allocate bindless descriptor set!");
+
+    return true;
+}
+
+bool VulkanRenderer::CreateTextureResources() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    // Shared by every streamed texture; the view's level range decides
+    // which mips exist, so no LOD clamp is needed here
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.maxAnisotropy = std::min(16.0f, properties.limits.maxSamplerAnisotropy);
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_textureSampler),
+                  "Failed to create texture sampler!");
+
+    m_stagingBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    m_stagingBuffersMemory.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    m_stagingBuffersMapped.assign(MAX_FRAMES_IN_FLIGHT, nullptr);
+    m_stagingCapacities.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+    return true;
+}
+
+bool VulkanRenderer::CreateDeferredResources() {
+    // The G-buffer is read texel for texel; filtering would blend normals
+    // across edges
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, nullptr, &m_gbufferSampler),
+                  "Failed to create G-buffer sampler!");
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * GBUFFER_BINDING_COUNT);
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_gbufferPool),
+                  "Failed to create G-buffer descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_gbufferSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_gbufferPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_gbufferSets.resize(MAX_FRAMES_IN_FLIGHT);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_gbufferSets.data()),
+                  "Failed to allocate G-buffer descriptor sets!");
+
+    return true;
+}
+
+uint32_t VulkanRenderer::RegisterTexture(VkImageView view, VkSampler sampler) {
+    uint32_t index;
+    if (!m_freeTextureSlots.empty()) {
+        index = m_freeTextureSlots.back();
+        m_freeTextureSlots.pop_back();
+    } else if (m_textureSlotCount < MAX_BINDLESS_TEXTURES) {
+        index = m_textureSlotCount++;
+    } else {
+        throw std::runtime_error("Bindless texture table is full!");
+    }
+    if (index >= m_textureSlotLive.size()) {
+        m_textureSlotLive.resize(index + 1);
+    }
+    m_textureSlotLive[index] = true;
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // Update-after-bind: legal while submitted frames use other slots
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_bindlessSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+
+    return index;
+}
+
+void VulkanRenderer::ReleaseTexture(uint32_t index) {
+    if (index >= m_textureSlotCount || !m_textureSlotLive[index]) {
+        std::cerr << "Ignoring release of bindless texture slot " << index << ": not registered" << std::endl;
+        return;
+    }
+    // Cleared now, so a second release cannot queue the slot twice
+    m_textureSlotLive[index] = false;
+
+    // Frames in flight may still sample the slot; it becomes reusable once
+    // they retire. Until rewritten, partially bound lets it dangle unused.
+    m_deletionQueue.Push([this, index]() { m_freeTextureSlots.push_back(index); });
+}
+
+uint32_t VulkanRenderer::CreateMaterial(const MaterialData& material) {
+    uint32_t index;
+    if (!m_freeMaterialSlots.empty()) {
+        index = m_freeMaterialSlots.back();
+        m_freeMaterialSlots.pop_back();
+    } else if (m_materials.size() < MAX_MATERIALS) {
+        index = static_cast<uint32_t>(m_materials.size());
+        m_materials.emplace_back();
+        m_materialTextures.emplace_back();
+        m_materialLive.emplace_back();
+    } else {
+        throw std::runtime_error("Material table is full!");
+    }
+
+    m_materialLive[index] = true;
+    m_materials[index] = material;
+    m_materialTextures[index].fill(INVALID_TEXTURE);
+    m_materialVersion++;
+    return index;
+}
+
+void VulkanRenderer::UpdateMaterial(uint32_t index, const MaterialData& material) {
+    if (index >= m_materials.size() || !m_materialLive[index]) {
+        return;
+    }
+    // Frames already recorded keep reading their own copy of the table
+    m_materials[index] = material;
+    ApplyMaterialTextures(index);
+    m_materialVersion++;
+}
+
+void VulkanRenderer::DestroyMaterial(uint32_t index) {
+    if (index == 0 || index >= m_materials.size() || !m_materialLive[index]) {
+        std::cerr << "Ignoring destruction of material " << index << ": not a live material" << std::endl;
+        return;
+    }
+    // Cleared now, so a second destroy cannot queue the slot twice
+    m_materialLive[index] = false;
+    m_materialTextures[index].fill(INVALID_TEXTURE);
+    m_deletionQueue.Push([this, index]() { m_freeMaterialSlots.push_back(index); });
+}
+
+void VulkanRenderer::ApplyMaterialTextures(uint32_t material) {
+    MaterialData& data = m_materials[material];
+    std::array<uint32_t*, MATERIAL_TEXTURE_COUNT> slots = {&data.albedoTexture, &data.metallicRoughnessTexture};
+    for (size_t i = 0; i < MATERIAL_TEXTURE_COUNT; i++) {
+        TextureHandle texture = m_materialTextures[material][i];
+        if (texture != INVALID_TEXTURE) {
+            *slots[i] = m_textureImages[texture].slot;
+        }
+    }
+}
+
+void VulkanRenderer::UploadMaterials() {
+    if (m_uploadedMaterialVersions[m_currentFrame] == m_materialVersion) {
+        return;
+    }
+    memcpy(m_materialBuffersMapped[m_currentFrame], m_materials.data(), m_materials.size() * sizeof(MaterialData));
+    m_uploadedMaterialVersions[m_currentFrame] = m_materialVersion;
+}
+
+void VulkanRenderer::QueueDraw(const DrawCommand& draw) {
+    m_drawQueue.push_back(draw);
+
+    uint32_t material = draw.materialIndex < m_materials.size() ? draw.materialIndex : 0;
+    float screenSize = draw.screenSize > 0.0f ? draw.screenSize : static_cast<float>(m_swapChainExtent.height);
+    for (TextureHandle texture : m_materialTextures[material]) {
+        if (texture != INVALID_TEXTURE) {
+            m_textureStreamer.RequestUsage(texture, screenSize);
+        }
+    }
+}
+
+void VulkanRenderer::RecordDraws(VkCommandBuffer commandBuffer) {
+    // Sets stay bound for the whole pass; each draw only pushes its model
+    // matrix and material index
+    for (const DrawCommand& draw : m_drawQueue) {
+        DrawPushConstants constants{};
+        constants.model = draw.model;
+        constants.materialIndex = draw.materialIndex < m_materials.size() ? draw.materialIndex : 0;
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(constants), &constants);
+
+        uint32_t indexCount = draw.indexCount != 0 ? draw.indexCount : static_cast<uint32_t>(m_indices.size());
+        vkCmdDrawIndexed(commandBuffer, indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+    }
+}
+
+// =============================================================================
+// TEXTURE STREAMING
+// =============================================================================
+
+TextureHandle VulkanRenderer::LoadTexture(const std::string& path) {
+    TextureHandle texture = m_textureStreamer.Load(path);
+
+    VkFormat format = static_cast<VkFormat>(m_textureStreamer.GetInfo(texture).format);
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                    VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if ((properties.optimalTilingFeatures & required) != required) {
+        m_textureStreamer.Unload(texture);
+        throw std::runtime_error(path + ": texture format " + std::to_string(format) + " is not supported by this device");
+    }
+
+    if (texture >= m_textureImages.size()) {
+        m_textureImages.resize(texture + 1);
+    }
+    m_textureImages[texture] = TextureImage{};
+    return texture;
+}
+
+void VulkanRenderer::UnloadTexture(TextureHandle texture) {
+    if (!m_textureStreamer.IsValid(texture)) {
+        return;
+    }
+
+    for (uint32_t material = 0; material < m_materials.size(); material++) {
+        if (m_materialTextures[material][static_cast<size_t>(MaterialTexture::Albedo)] == texture) {
+            SetMaterialTexture(material, MaterialTexture::Albedo, INVALID_TEXTURE);
+        }
+        if (m_materialTextures[material][static_cast<size_t>(MaterialTexture::MetallicRoughness)] == texture) {
+            SetMaterialTexture(material, MaterialTexture::MetallicRoughness, INVALID_TEXTURE);
+        }
+    }
+
+    RetireTextureImage(m_textureImages[texture]);
+    m_textureStreamer.Unload(texture);
+}
+
+void VulkanRenderer::SetMaterialTexture(uint32_t material, MaterialTexture slot, TextureHandle texture) {
+    if (material >= m_materials.size() || !m_materialLive[material] ||
+        (texture != INVALID_TEXTURE && !m_textureStreamer.IsValid(texture))) {
+        return;
+    }
+
+    m_materialTextures[material][static_cast<size_t>(slot)] = texture;
+    uint32_t bindlessIndex = texture != INVALID_TEXTURE ? m_textureImages[texture].slot : INVALID_BINDLESS_INDEX;
+    if (slot == MaterialTexture::Albedo) {
+        m_materials[material].albedoTexture = bindlessIndex;
+    } else {
+        m_materials[material].metallicRoughnessTexture = bindlessIndex;
+    }
+    m_materialVersion++;
+}
+
+void VulkanRenderer::RefreshMaterialTextures(TextureHandle texture) {
+    for (uint32_t material = 0; material < m_materials.size(); material++) {
+        const auto& textures = m_materialTextures[material];
+        if (std::find(textures.begin(), textures.end(), texture) != textures.end()) {
+            ApplyMaterialTextures(material);
+            m_materialVersion++;
+        }
+    }
+}
+
+void VulkanRenderer::RetireTextureImage(TextureImage& texture) {
+    DeferDestroy<VkImageView>(m_deletionQueue, texture.view, [this](VkImageView view) { vkDestroyImageView(m_device, view, nullptr); });
+    DeferDestroy<VkImage>(m_deletionQueue, texture.image, [this](VkImage image) { vkDestroyImage(m_device, image, nullptr); });
+    DeferDestroy<VkDeviceMemory>(m_deletionQueue, texture.memory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    if (texture.slot != INVALID_BINDLESS_INDEX) {
+        ReleaseTexture(texture.slot);
+        texture.slot = INVALID_BINDLESS_INDEX;
+    }
+}
+
+void VulkanRenderer::EnsureStagingCapacity(VkDeviceSize size) {
+    if (m_stagingCapacities[m_currentFrame] >= size) {
+        return;
+    }
+
+    // This frame's fence has been waited on, so its old buffer is idle
+    SafeDestroy(m_stagingBuffers[m_currentFrame], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+    SafeDestroy(m_stagingBuffersMemory[m_currentFrame], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+
+    VkDeviceSize capacity = std::max<VkDeviceSize>(size, m_textureStreamer.GetSettings().uploadBytesPerFrame);
+    CreateBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 m_stagingBuffers[m_currentFrame], m_stagingBuffersMemory[m_currentFrame]);
+    ThrowIfFailed(vkMapMemory(m_device, m_stagingBuffersMemory[m_currentFrame], 0, capacity, 0,
+                              &m_stagingBuffersMapped[m_currentFrame]),
+                  "Failed to map texture staging buffer!");
+    m_stagingCapacities[m_currentFrame] = capacity;
+}
+
+void VulkanRenderer::RecordTextureStreaming(VkCommandBuffer commandBuffer) {
+    const std::vector<TextureResidencyChange>& changes = m_textureStreamer.Update();
+    if (changes.empty()) {
+        return;
+    }
+
+    VkDeviceSize stagingSize = 0;
+    for (const TextureResidencyChange& change : changes) {
+        const TextureFileInfo& info = m_textureStreamer.GetInfo(change.texture);
+        for (uint32_t mip = change.newFirstMip; mip < change.oldFirstMip; mip++) {
+            stagingSize += AlignStagingOffset(info.levels[mip].size);
+        }
+    }
+    EnsureStagingCapacity(stagingSize);
+
+    VkDeviceSize stagingOffset = 0;
+    for (const TextureResidencyChange& change : changes) {
+        ApplyResidencyChange(commandBuffer, change, stagingOffset);
+    }
+}
+
+void VulkanRenderer::ApplyResidencyChange(VkCommandBuffer commandBuffer, const TextureResidencyChange& change,
+                                          VkDeviceSize& stagingOffset) {
+    const TextureFileInfo& info = m_textureStreamer.GetInfo(change.texture);
+    VkFormat format = static_cast<VkFormat>(info.format);
+    uint32_t levelCount = static_cast<uint32_t>(info.levels.size());
+    uint32_t newLevelCount = levelCount - change.newFirstMip;
+    TextureImage& current = m_textureImages[change.texture];
+
+    // Images cannot gain or lose levels in place, so every change builds a
+    // new image holding exactly the resident range
+    TextureImage replacement{};
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = info.levels[change.newFirstMip].width;
+    imageInfo.extent.height = info.levels[change.newFirstMip].height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = newLevelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    ThrowIfFailed(vkCreateImage(m_device, &imageInfo, nullptr, &replacement.image),
+                  "Failed to create streamed texture image!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device, replacement.image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(m_physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    ThrowIfFailed(vkAllocateMemory(m_device, &allocInfo, nullptr, &replacement.memory),
+                  "Failed to allocate streamed texture memory!");
+    vkBindImageMemory(m_device, replacement.image, replacement.memory, 0);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.layerCount = 1;
+
+    barrier.image = replacement.image;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = newLevelCount;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // Levels the current image already holds are copied on the GPU; only
+    // levels new to the texture are read from the mapped file
+    uint32_t firstKept = std::max(change.newFirstMip, change.oldFirstMip);
+    if (current.image != VK_NULL_HANDLE && firstKept < levelCount) {
+        // Earlier frames may still sample the old image; the barrier orders
+        // the copy after them, and no later frame uses it again
+        barrier.image = current.image;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.subresourceRange.baseMipLevel = firstKept - change.oldFirstMip;
+        barrier.subresourceRange.levelCount = levelCount - firstKept;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkImageCopy> copies;
+        for (uint32_t mip = firstKept; mip < levelCount; mip++) {
+            VkImageCopy copy{};
+            copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - change.oldFirstMip, 0, 1};
+            copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - change.newFirstMip, 0, 1};
+            copy.extent = {info.levels[mip].width, info.levels[mip].height, 1};
+            copies.push_back(copy);
+        }
+        vkCmdCopyImage(commandBuffer, current.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       replacement.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       static_cast<uint32_t>(copies.size()), copies.data());
+    }
+
+    std::vector<VkBufferImageCopy> uploads;
+    uint8_t* staging = static_cast<uint8_t*>(m_stagingBuffersMapped[m_currentFrame]);
+    for (uint32_t mip = change.newFirstMip; mip < change.oldFirstMip; mip++) {
+        const TextureLevel& level = info.levels[mip];
+        memcpy(staging + stagingOffset, m_textureStreamer.GetLevelData(change.texture, mip), level.size);
+
+        VkBufferImageCopy upload{};
+        upload.bufferOffset = stagingOffset;
+        upload.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - change.newFirstMip, 0, 1};
+        upload.imageExtent = {level.width, level.height, 1};
+        uploads.push_back(upload);
+
+        stagingOffset += AlignStagingOffset(level.size);
+    }
+    if (!uploads.empty()) {
+        vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffers[m_currentFrame], replacement.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(uploads.size()), uploads.data());
+    }
+
+    barrier.image = replacement.image;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = newLevelCount;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = replacement.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = newLevelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, nullptr, &replacement.view),
+                  "Failed to create streamed texture view!");
+
+    // A fresh slot rather than rewriting the old one, which frames in
+    // flight may still be sampling
+    replacement.slot = RegisterTexture(replacement.view, m_textureSampler);
+
+    RetireTextureImage(current);
+    current = replacement;
+    RefreshMaterialTextures(change.texture);
+}
+
+void VulkanRenderer::RecordFrameGraph(VkCommandBuffer commandBuffer) {
+    m_renderGraph.Reset();
+
+    // The acquire semaphore is waited on at the color output stage, so the
+    // swap chain image's first barrier must start there
+    RenderImageState acquired{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0};
+    RenderResource backBuffer = m_renderGraph.ImportImage(
+        "Back buffer", m_swapChainImages[m_imageIndex], m_swapChainImageViews[m_imageIndex],
+        m_swapChainImageFormat, m_swapChainExtent, acquired, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    // The atlas rests in the read-only layout between frames, last sampled
+    // by an earlier frame's lighting pass
+    RenderImageState atlasState{VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0};
+    RenderResource shadowAtlas = m_renderGraph.ImportImage(
+        "Shadow atlas", m_shadowAtlasImage, m_shadowAtlasView, m_shadowFormat,
+        {m_shadowAtlasSize, m_shadowAtlasSize}, atlasState, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+    RenderImageDesc depthDesc;
+    depthDesc.format = m_depthFormat;
+    depthDesc.extent = m_swapChainExtent;
+    RenderResource depth = m_renderGraph.CreateImage("Depth", depthDesc);
+
+    // Tiles are cleared individually, so the pass loads the atlas and
+    // everything outside the redrawn tiles survives
+    if (!m_pendingShadowViews.empty()) {
+        m_renderGraph.AddPass("Shadows",
+            [shadowAtlas](RenderPassBuilder& pass) { pass.WriteDepth(shadowAtlas, VK_ATTACHMENT_LOAD_OP_LOAD); },
+            [this](VkCommandBuffer cmd) { RecordShadowPass(cmd); });
+    }
+
+    if (m_renderPath == RenderPath::Deferred) {
+        AddDeferredPasses(backBuffer, depth, shadowAtlas);
+        m_renderGraph.Compile();
+        UpdateGBufferDescriptors(); // Before any pass binds the set
+        m_renderGraph.Execute(commandBuffer);
+        m_drawQueue.clear();
+        return;
+    }
+
+    if (m_depthPrepass) {
+        m_renderGraph.AddPass("Depth prepass",
+            [depth](RenderPassBuilder& pass) { pass.WriteDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR); },
+            [this](VkCommandBuffer cmd) { RecordDepthPrepass(cmd); });
+    }
+
+    bool prepass = m_depthPrepass;
+    m_renderGraph.AddPass("Lighting",
+        [backBuffer, depth, shadowAtlas, prepass](RenderPassBuilder& pass) {
+            pass.WriteColor(backBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 1.0f}});
+            if (prepass) {
+                pass.ReadDepth(depth);
+            } else {
+                pass.WriteDepth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+            }
+            pass.Read(shadowAtlas, RenderAccess::SampledFragment);
+        },
+        [this](VkCommandBuffer cmd) { RecordLightingPass(cmd); });
+
+    m_renderGraph.Compile();
+    m_renderGraph.Execute(commandBuffer);
+    m_drawQueue.clear();
+}
+
+void VulkanRenderer::AddDeferredPasses(RenderResource backBuffer, RenderResource depth, RenderResource shadowAtlas) {
+    RenderImageDesc desc;
+    desc.extent = m_swapChainExtent;
+    desc.format = GBUFFER_ALBEDO_FORMAT;
+    m_gbufferTargets.albedo = m_renderGraph.CreateImage("G-buffer albedo", desc);
+    desc.format = GBUFFER_NORMAL_FORMAT;
+    m_gbufferTargets.normal = m_renderGraph.CreateImage("G-buffer normal", desc);
+    desc.format = GBUFFER_MATERIAL_FORMAT;
+    m_gbufferTargets.material = m_renderGraph.CreateImage("G-buffer material", desc);
+    desc.format = LIGHT_ACCUMULATION_FORMAT;
+    m_gbufferTargets.lighting = m_renderGraph.CreateImage("Light accumulation", desc);
+    m_gbufferTargets.depth = depth;
+
+    // Pixels no draw covers keep garbage, which lighting never reads since
+    // it skips everything at the far plane; only depth needs a clear
+    m_renderGraph.AddPass("G-buffer",
+        [this](RenderPassBuilder& pass) {
+            pass.WriteColor(m_gbufferTargets.albedo);
+            pass.WriteColor(m_gbufferTargets.normal);
+            pass.WriteColor(m_gbufferTargets.material);
+            pass.WriteDepth(m_gbufferTargets.depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+        },
+        [this](VkCommandBuffer cmd) { RecordGBufferPass(cmd); });
+
+    m_renderGraph.AddPass("Deferred lighting",
+        [this, shadowAtlas](RenderPassBuilder& pass) {
+            pass.WriteColor(m_gbufferTargets.lighting, VK_ATTACHMENT_LOAD_OP_CLEAR, {{0.0f, 0.0f, 0.0f, 0.0f}});
+            pass.Read(m_gbufferTargets.albedo, RenderAccess::SampledFragment);
+            pass.Read(m_gbufferTargets.normal, RenderAccess::SampledFragment);
+            pass.Read(m_gbufferTargets.material, RenderAccess::SampledFragment);
+            pass.Read(m_gbufferTargets.depth, RenderAccess::SampledFragment);
+            pass.Read(shadowAtlas, RenderAccess::SampledFragment);
+        },
+        [this](VkCommandBuffer cmd) { RecordDeferredLighting(cmd); });
+
+    // Every back buffer pixel is overwritten, so it is neither cleared nor loaded
+    m_renderGraph.AddPass("Tonemap",
+        [this, backBuffer](RenderPassBuilder& pass) {
+            pass.WriteColor(backBuffer);
+            pass.Read(m_gbufferTargets.lighting, RenderAccess::SampledFragment);
+        },
+        [this](VkCommandBuffer cmd) { RecordTonemap(cmd); });
+}
+
+void VulkanRenderer::RecordShadowPass(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_shadowPipeline);
+
+    VkBuffer vertexBuffers[] = {m_vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    for (const ShadowRenderView& view : m_pendingShadowViews) {
+        VkRect2D rect{};
+        rect.offset = {static_cast<int32_t>(view.rect.x), static_cast<int32_t>(view.rect.y)};
+        rect.extent = {view.rect.size, view.rect.size};
+
+        VkViewport viewport{};
+        viewport.x = static_cast<float>(view.rect.x);
+        viewport.y = static_cast<float>(view.rect.y);
+        viewport.width = static_cast<float>(view.rect.size);
+        viewport.height = static_cast<float>(view.rect.size);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &rect);
+
+        // The tile may hold another light's old map
+        VkClearAttachment clearAttachment{};
+        clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clearAttachment.clearValue.depthStencil = {1.0f, 0};
+        VkClearRect clearRect{};
+        clearRect.rect = rect;
+        clearRect.baseArrayLayer = 0;
+        clearRect.layerCount = 1;
+        vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, 1, &clearRect);
+
+        vkCmdPushConstants(commandBuffer, m_shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                           0, sizeof(glm::mat4), &view.viewProjection);
+        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0);
+    }
+
+    m_pendingShadowViews.clear();
+}
+
+void VulkanRenderer::RecordDepthPrepass(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline);
+    BindGeometry(commandBuffer);
+    RecordDraws(commandBuffer);
+}
+
+void VulkanRenderer::RecordLightingPass(VkCommandBuffer commandBuffer) {
+    VkPipeline lightingPipeline = m_activeLightingPipeline != VK_NULL_HANDLE ? m_activeLightingPipeline : GetGenericLightingPipeline();
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+    BindGeometry(commandBuffer);
+    RecordDraws(commandBuffer);
+}
+
+void VulkanRenderer::RecordGBufferPass(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_gbufferPipeline);
+    BindGeometry(commandBuffer);
+    RecordDraws(commandBuffer);
+}
+
+void VulkanRenderer::RecordDeferredLighting(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_deferredLightingPipeline);
+    BindGBuffer(commandBuffer);
+
+    // Directional lights, the sun and ambient reach every pixel
+    DeferredPushConstants constants{DEFERRED_MODE_FULLSCREEN};
+    vkCmdPushConstants(commandBuffer, m_deferredPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(constants), &constants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+    // Point and spot lights only cover their screen bounds. The light count
+    // is only known to the GPU, so unused slots are collapsed by the shader.
+    constants.mode = DEFERRED_MODE_LIGHT_VOLUMES;
+    vkCmdPushConstants(commandBuffer, m_deferredPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(constants), &constants);
+    vkCmdDraw(commandBuffer, 6, MAX_LIGHTS, 0, 0);
+}
+
+void VulkanRenderer::RecordTonemap(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_tonemapPipeline);
+    BindGBuffer(commandBuffer);
+
+    DeferredPushConstants constants{DEFERRED_MODE_FULLSCREEN};
+    vkCmdPushConstants(commandBuffer, m_deferredPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(constants), &constants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void VulkanRenderer::UpdateGBufferDescriptors() {
+    // The graph has placed this frame's images, and this frame's fence has
+    // retired the last commands that used the set
+    std::array<RenderResource, GBUFFER_BINDING_COUNT> images = {
+        m_gbufferTargets.albedo, m_gbufferTargets.normal, m_gbufferTargets.material,
+        m_gbufferTargets.depth, m_gbufferTargets.lighting
+    };
+    std::array<VkDescriptorImageInfo, GBUFFER_BINDING_COUNT> imageInfos{};
+    std::array<VkWriteDescriptorSet, GBUFFER_BINDING_COUNT> descriptorWrites{};
+    for (uint32_t binding = 0; binding < GBUFFER_BINDING_COUNT; binding++) {
+        imageInfos[binding].sampler = m_gbufferSampler;
+        imageInfos[binding].imageView = m_renderGraph.GetSampledView(images[binding]);
+        imageInfos[binding].imageLayout = images[binding] == m_gbufferTargets.depth
+            ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+            : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = m_gbufferSets[m_currentFrame];
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[binding].pImageInfo = &imageInfos[binding];
+    }
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
+}
+
+void VulkanRenderer::BindGBuffer(VkCommandBuffer commandBuffer) {
+    std::array<VkDescriptorSet, 3> descriptorSets = {m_descriptorSets[m_currentFrame], m_bindlessSet, m_gbufferSets[m_currentFrame]};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           m_deferredPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()),
+                           descriptorSets.data(), 0, nullptr);
+}
+
+void VulkanRenderer::BindGeometry(VkCommandBuffer commandBuffer) {
+    VkBuffer vertexBuffers[] = {m_vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    std::array<VkDescriptorSet, 2> descriptorSets = {m_descriptorSets[m_currentFrame], m_bindlessSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                           m_pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()),
+                           descriptorSets.data(), 0, nullptr);
+}
+
+void VulkanRenderer::Cleanup() {
+    if (m_device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(m_device);
+    }
+
+    CleanupSwapChain();
+
+    // Cleanup in reverse order of creation
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        SafeDestroy(m_uniformBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+        SafeDestroy(m_uniformBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+        SafeDestroy(m_lightBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+        SafeDestroy(m_lightBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+        SafeDestroy(m_shadowBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+        SafeDestroy(m_shadowBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
         SafeDestroy(m_renderFinishedSemaphores[i], [this](VkSemaphore semaphore) { vkDestroySemaphore(m_device, semaphore, nullptr); });
         SafeDestroy(m_imageAvailableSemaphores[i], [this](VkSemaphore semaphore) { vkDestroySemaphore(m_device, semaphore, nullptr); });
-        SafeDestroy(m_inFlightFences[i], [this](VkFence fence) { vkDestroyFence(m_device, fence, nullptr); });
     }
 
     SafeDestroy(m_indexBuffer, [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
     SafeDestroy(m_indexBufferMemory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
     SafeDestroy(m_vertexBuffer, [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
     SafeDestroy(m_vertexBufferMemory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    SafeDestroy(m_shadowPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
+    SafeDestroy(m_shadowPipelineLayout, [this](VkPipelineLayout layout) { vkDestroyPipelineLayout(m_device, layout, nullptr); });
+    SafeDestroy(m_shadowSampler, [this](VkSampler sampler) { vkDestroySampler(m_device, sampler, nullptr); });
+    SafeDestroy(m_shadowAtlasView, [this](VkImageView view) { vkDestroyImageView(m_device, view, nullptr); });
+    SafeDestroy(m_shadowAtlasImage, [this](VkImage image) { vkDestroyImage(m_device, image, nullptr); });
+    SafeDestroy(m_shadowAtlasMemory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
     SafeDestroy(m_descriptorPool, [this](VkDescriptorPool pool) { vkDestroyDescriptorPool(m_device, pool, nullptr); });
+    SafeDestroy(m_bindlessPool, [this](VkDescriptorPool pool) { vkDestroyDescriptorPool(m_device, pool, nullptr); });
+    SafeDestroy(m_gbufferPool, [this](VkDescriptorPool pool) { vkDestroyDescriptorPool(m_device, pool, nullptr); });
+    SafeDestroy(m_gbufferSampler, [this](VkSampler sampler) { vkDestroySampler(m_device, sampler, nullptr); });
+    for (TextureImage& texture : m_textureImages) {
+        SafeDestroy(texture.view, [this](VkImageView view) { vkDestroyImageView(m_device, view, nullptr); });
+        SafeDestroy(texture.image, [this](VkImage image) { vkDestroyImage(m_device, image, nullptr); });
+        SafeDestroy(texture.memory, [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    }
+    m_textureImages.clear();
+    SafeDestroy(m_textureSampler, [this](VkSampler sampler) { vkDestroySampler(m_device, sampler, nullptr); });
+    for (size_t i = 0; i < m_stagingBuffers.size(); i++) {
+        SafeDestroy(m_stagingBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+        SafeDestroy(m_stagingBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    }
+    for (size_t i = 0; i < m_materialBuffers.size(); i++) {
+        SafeDestroy(m_materialBuffers[i], [this](VkBuffer buffer) { vkDestroyBuffer(m_device, buffer, nullptr); });
+        SafeDestroy(m_materialBuffersMemory[i], [this](VkDeviceMemory memory) { vkFreeMemory(m_device, memory, nullptr); });
+    }
     SafeDestroy(m_commandPool, [this](VkCommandPool pool) { vkDestroyCommandPool(m_device, pool, nullptr); });
-    SafeDestroy(m_graphicsPipeline, [this](VkPipeline pipeline) { vkDestroyPipeline(m_device, pipeline, nullptr); });
-    SafeDestroy(m_pipelineLayout, [this](VkPipelineLayout layout) { vkDestroyPipelineLayout(m_device, layout, nullptr); });
+    if (m_device != VK_NULL_HANDLE) {
+        DestroyLightingPipelines();
+        m_renderGraph.Destroy();
+        m_framePacer.Destroy();
+        m_deletionQueue.Flush();
+    }
+    SafeDestroy(m_pipelineCache, [this](VkPipelineCache cache) { vkDestroyPipelineCache(m_device, cache, nullptr); });
     SafeDestroy(m_descriptorSetLayout, [this](VkDescriptorSetLayout layout) { vkDestroyDescriptorSetLayout(m_device, layout, nullptr); });
-    SafeDestroy(m_renderPass, [this](VkRenderPass renderPass) { vkDestroyRenderPass(m_device, renderPass, nullptr); });
+    SafeDestroy(m_bindlessSetLayout, [this](VkDescriptorSetLayout layout) { vkDestroyDescriptorSetLayout(m_device, layout, nullptr); });
+    SafeDestroy(m_gbufferSetLayout, [this](VkDescriptorSetLayout layout) { vkDestroyDescriptorSetLayout(m_device, layout, nullptr); });
     SafeDestroy(m_device, [](VkDevice device) { vkDestroyDevice(device, nullptr); });
 
     if (enableValidationLayers) {
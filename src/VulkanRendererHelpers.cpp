@@ -1,10 +1,12 @@
 #include "VulkanRendererHelpers.h"
+#include "ShaderCompiler.h"
 #include <stdexcept>
 #include <iostream>
 #include <set>
 #include <algorithm>
 #include <fstream>
 #include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
 
 // Constants
 const std::vector<const char*> validationLayers = {
@@ -12,7 +14,8 @@ const std::vector<const char*> validationLayers = {
 };
 
 const std::vector<const char*> deviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME // Render graph passes begin rendering without VkRenderPass objects
 };
 
 // Debug callback implementation
@@ -71,6 +74,28 @@ std::vector<char> ReadFile(const std::string& filename) {
     return buffer;
 }
 
+std::vector<uint32_t> CompileGLSLToSPIRV(const std::string& source, const std::string& filename, bool isVertexShader) {
+    ShaderVariant variant;
+    variant.path = filename;
+    variant.stage = isVertexShader ? ShaderStage::Vertex : ShaderStage::Fragment;
+    return ShaderCompiler::CompileSource(source, variant);
+}
+
+bool CompileShaderFromFile(const std::string& inputFile, const std::string& outputFile, bool isVertexShader) {
+    try {
+        std::vector<char> source = ReadFile(inputFile);
+        std::vector<uint32_t> spirv = CompileGLSLToSPIRV(std::string(source.begin(), source.end()), inputFile, isVertexShader);
+
+        std::ofstream file(outputFile, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        return file.good();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+}
+
 VkResult CreateDebugUtilsMessengerEXT(
     VkInstance instance,
     const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -128,6 +153,54 @@ bool CheckInstanceExtensionSupport(const std::vector<const char*>& requiredExten
     return true;
 }
 
+bool CheckDescriptorIndexingSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return features12.descriptorIndexing &&
+           features12.runtimeDescriptorArray &&
+           features12.descriptorBindingPartiallyBound &&
+           features12.descriptorBindingUpdateUnusedWhilePending &&
+           features12.descriptorBindingSampledImageUpdateAfterBind &&
+           features12.shaderSampledImageArrayNonUniformIndexing;
+}
+
+bool CheckDynamicRenderingSupport(VkPhysicalDevice device) {
+    if (!CheckDeviceExtensionSupport(device, {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME})) {
+        return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+    dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamicRendering;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return dynamicRendering.dynamicRendering;
+}
+
+bool CheckTimelineSemaphoreSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return features12.timelineSemaphore;
+}
+
 bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& requiredExtensions) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -223,4 +296,85 @@ void LogVulkanInfo(VkInstance instance, VkPhysicalDevice physicalDevice) {
         }
         std::cout << std::endl;
     }
-}
\ No newline at end of file
+}
+// Projections use Vulkan conventions: [0, 1] depth and a flipped Y axis
+glm::mat4 CreateProjectionMatrix(float fov, float aspectRatio, float nearPlane, float farPlane) {
+    glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(fov), aspectRatio, nearPlane, farPlane);
+    projection[1][1] *= -1.0f;
+    return projection;
+}
+
+glm::mat4 CreateOrthographicMatrix(float width, float height, float nearPlane, float farPlane) {
+    glm::mat4 projection = glm::orthoRH_ZO(-width * 0.5f, width * 0.5f, -height * 0.5f, height * 0.5f,
+                                           nearPlane, farPlane);
+    projection[1][1] *= -1.0f;
+    return projection;
+}
+
+glm::mat4 CreateViewMatrix(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up) {
+    return glm::lookAt(eye, center, up);
+}
+
+glm::mat4 CreateModelMatrix(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), translation);
+    model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(model, scale);
+}
+
+float CalculateAspectRatio(uint32_t width, uint32_t height) {
+    return height > 0 ? static_cast<float>(width) / static_cast<float>(height) : 1.0f;
+}
+
+// =============================================================================
+// DEFERRED DESTRUCTION
+// =============================================================================
+
+void DeletionQueue::Push(std::function<void()> destroy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_back({m_frame, std::move(destroy)});
+}
+
+void DeletionQueue::Collect(uint64_t completedFrames) {
+    // Destructors run outside the lock so they may push follow-up work
+    std::vector<std::function<void()>> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty() && m_entries.front().frame < completedFrames) {
+            expired.push_back(std::move(m_entries.front().destroy));
+            m_entries.pop_front();
+        }
+    }
+
+    for (auto& destroy : expired) {
+        destroy();
+    }
+}
+
+void DeletionQueue::NextFrame() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frame++;
+}
+
+void DeletionQueue::Flush() {
+    std::deque<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries.swap(m_entries);
+    }
+
+    for (auto& entry : entries) {
+        entry.destroy();
+    }
+}
+
+uint64_t DeletionQueue::GetFrame() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_frame;
+}
+
+size_t DeletionQueue::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}